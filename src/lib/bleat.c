@@ -8,6 +8,15 @@
 	Mods:		10 May 2016 - fix comment
 				01 Jun 2016 - Add auto cleanup of log files.
 							Corrected memory leak.
+				19 Oct 2026 - Add asynchronous mode: messages are formatted in a per
+							thread buffer and queued on a lock-free ring which is
+							drained by a writer thread. Cache the formatted timestamp
+							for each second rather than building it for every message.
+				19 Oct 2026 - Add per-subsystem levels, and suppression of repeated
+							messages and rate limiting keyed by call site.
+				19 Oct 2026 - Add housekeeping thread which rolls, compresses and
+							purges logs so that callers never open files or scan
+							the log directory.
 
 	Valgrind:	These are notes about valgrind complaints that cannot be
 				resolved, and are not considered harmful:
@@ -36,9 +45,15 @@
 #include <string.h>
 #include <time.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/wait.h>
 
 #include "vfdlib.h"
 
+#undef bleat_printf			// we provide the real functions which the macros in vfdlib.h front
+#undef bleat_will_it
 
 // --------------------- no way round these ------------------
 static int		cur_level = 0;
@@ -48,11 +63,79 @@ static int		log_is_std = 1;		// set when log is stderr so we don't close it
 static	time_t	time2flip = 0;		// time at which we need to flip the log (or first write after)
 static time_t	log_cycle = 0;		// cycle time for the log if dated
 static char*	fname_base = NULL;	// base name of the file that we add the date to
+static char*	log_fname = NULL;	// name of the dated file currently open (nil if not dated)
 
 static time_t	purge_threshold = 0;	// number of seconds afterwhich log files are purged
 static	char*	purge_directory = NULL;	// directory where we should purge on a regular basis
 static	char*	purge_prefix = NULL;	// prefix of files in the log directory that are purged
 
+// --------------------- async support -----------------------
+#define BLEAT_MAX_MSG	8192		// max formatted message (header + user message)
+#define BLEAT_SLOT_SIZE	1024		// max message queued in async mode; longer messages are truncated
+
+/*
+	A slot in the async ring. Seq is used to manage ownership between producers
+	and the writer (bounded mpmc queue a la Vyukov, though we have only one consumer).
+*/
+typedef struct {
+	volatile uint64_t seq;			// sequence the slot is ready for
+	int		len;					// bytes in msg (includes newline)
+	char	msg[BLEAT_SLOT_SIZE];
+} bslot_t;
+
+static bslot_t*	ring = NULL;		// ring of message slots when in async mode
+static uint64_t	ring_mask = 0;		// number of slots - 1 (slots is power of 2)
+static volatile uint64_t ring_head = 0;		// next slot producers will claim
+static uint64_t	ring_tail = 0;		// next slot the writer reads (only the writer touches)
+static volatile uint64_t ring_drops = 0;	// messages dropped because the ring was full
+static volatile int async_on = 0;	// set when bleat_printf should queue rather than write
+static volatile int writer_run = 0;	// cleared to stop the writer thread
+static pthread_t	writer_tid;
+static pthread_mutex_t	wlock = PTHREAD_MUTEX_INITIALIZER;	// serialises writer with log changes; producers never take it
+static volatile int emitters = 0;	// threads in emit(): writing to log directly or pushing onto the ring
+
+// --------------------- subsystems and flood control --------
+static int		ss_level[BLEAT_NSS] = { -1, -1, -1, -1, -1, -1, -1 };	// -1 == follow cur_level
+static const char* ss_names[BLEAT_NSS] = { "gen", "rif", "nic", "mbox", "qos", "mac", "stats" };
+
+#define DUP_SLOTS	1024			// call site table size (power of 2); collisions just evict
+
+/*
+	Flood control information for a call site. The busy flag is a try-lock; a
+	thread which finds it set does not wait, the message is just written
+	without dedup checks.
+*/
+typedef struct {
+	volatile char busy;
+	const char*	site;				// file:line of the call (pointer to a literal, so compare pointers)
+	uint64_t	mhash;				// hash of the last user message seen from the site
+	int			level;				// level of the last message (used for summaries)
+	int			repeats;			// number of identical messages suppressed since the last one written
+	time_t		first_rep;			// time of the first suppressed repeat
+	time_t		last_rep;			// time of the most recent suppressed repeat
+	time_t		rl_sec;				// second that rl_count applies to
+	int			rl_count;			// messages from the site during rl_sec
+	int			rl_drops;			// messages dropped by the rate limit not yet reported
+} dup_ent_t;
+
+static dup_ent_t dup_tab[DUP_SLOTS];
+static int		dup_window = 0;		// seconds to suppress repeats before summarising; 0 disables
+static int		rate_max = 0;		// max messages per second from a site; 0 disables
+
+// --------------------- housekeeping -----------------------
+static volatile int hk_on = 0;		// set when the housekeeping thread owns rolling and purging
+static volatile int hk_run = 0;		// cleared to stop the housekeeping thread
+static int		hk_compress = 0;	// gzip rolled files when set
+static pthread_t	hk_tid;
+static FILE*	retired = NULL;		// file replaced by the last roll; closed once no writer can hold it
+static char*	retired_name = NULL;
+
+extern char**	environ;			// passed to gzip
+
+static __thread	char	tl_obuf[BLEAT_MAX_MSG];		// per thread formatting buffer
+static __thread	time_t	tl_tsec = 0;				// second that the cached time string is for
+static __thread	char	tl_tstr[64];				// cached 'pretty' timestamp for tl_tsec
+
 // -- private -------------------------------------------------------------------------
 /*
 	Compute the next time we need to flip the log. The base is the roll time
@@ -66,18 +149,22 @@ static time_t get_flip_time( int base ) {
 }
 
 /*
-	Return a pretty time for the message
+	Return a pretty time for the message. The string is cached (per thread) and
+	rebuilt only when the second changes, so the pointer returned must not be
+	freed and is good only until the next call.
 */
 static char* pretty_time( time_t ts ) {
-	char	buf[128];	
 	struct tm	t;
 
-	memset( &t, 0, sizeof( t ) );
-	gmtime_r( (const time_t *) &ts, &t );		// see valgind notes (a) at top
+	if( ts != tl_tsec ) {
+		memset( &t, 0, sizeof( t ) );
+		gmtime_r( (const time_t *) &ts, &t );		// see valgind notes (a) at top
 	
-	snprintf( buf, sizeof( buf ), "%d/%02d/%02d %02d:%02d:%02dZ", t.tm_year+1900, t.tm_mon+1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec );
+		snprintf( tl_tstr, sizeof( tl_tstr ), "%d/%02d/%02d %02d:%02d:%02dZ", t.tm_year+1900, t.tm_mon+1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec );
+		tl_tsec = ts;
+	}
 
-	return strdup( buf );
+	return tl_tstr;
 }
 
 /*
@@ -195,6 +282,99 @@ extern int bleat_will_it( int l ) {
 	return l <= cur_level;
 }
 
+/*
+	Return the level in effect for the subsystem; the global level
+	unless a level has been set specifically for the subsystem.
+*/
+static inline int ss_eff_level( int ss ) {
+	if( ss > 0 && ss < BLEAT_NSS && ss_level[ss] >= 0 ) {
+		return ss_level[ss];
+	}
+
+	return cur_level;
+}
+
+/*
+	Like bleat_will_it() but for a specific subsystem.
+*/
+extern int bleat_ss_will_it( int ss, int l ) {
+	return l <= ss_eff_level( ss );
+}
+
+/*
+	Set the level for a subsystem. A level < 0 causes the subsystem to follow
+	the global level again. Returns the previous setting (-1 if it was following
+	the global level), or -2 if ss is not a valid subsystem. The general subsystem
+	always follows the global level (use bleat_set_lvl()).
+*/
+extern int bleat_set_ss_lvl( int ss, int l ) {
+	int r;
+
+	if( ss <= BLEAT_SS_GEN || ss >= BLEAT_NSS ) {
+		return -2;
+	}
+
+	r = ss_level[ss];
+	ss_level[ss] = l < 0 ? -1 : l;
+	return r;
+}
+
+/*
+	Return the level set for the subsystem; -1 if it is following the global
+	level and -2 if the subsystem is not valid.
+*/
+extern int bleat_get_ss_lvl( int ss ) {
+	if( ss < BLEAT_SS_GEN || ss >= BLEAT_NSS ) {
+		return -2;
+	}
+
+	return ss_level[ss];
+}
+
+/*
+	Map a subsystem name (e.g. "qos") to its id. Returns -1 if the name
+	is not known.
+*/
+extern int bleat_ss_id( const char* name ) {
+	int i;
+
+	if( name == NULL ) {
+		return -1;
+	}
+
+	for( i = 0; i < BLEAT_NSS; i++ ) {
+		if( strcmp( name, ss_names[i] ) == 0 ) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+	Return the name of the subsystem, or nil if ss isn't valid.
+*/
+extern const char* bleat_ss_name( int ss ) {
+	if( ss < BLEAT_SS_GEN || ss >= BLEAT_NSS ) {
+		return NULL;
+	}
+
+	return ss_names[ss];
+}
+
+/*
+	Configure flood control. Window is the number of seconds that identical
+	messages from a call site are suppressed before a "repeated" summary is
+	written (0 disables the suppression). Max_per_sec caps the number of messages
+	written from any one call site in a second (0 disables the cap). Both are
+	off by default. Level 0 messages (errors, critical and the like) are never
+	suppressed.
+*/
+extern void bleat_set_dedup( int window, int max_per_sec ) {
+	dup_window = window > 0 ? window : 0;
+	rate_max = max_per_sec > 0 ? max_per_sec : 0;
+}
+
 /*
 	Return the timestamp when the next flip will happen.
 */
@@ -232,21 +412,11 @@ extern void bleat_set_purge( const char* dname, const char* prefix, int seconds
 }
 
 /*
-	Set the file where we will write and open it.
-	Returns 0 if good; !0 otherwise. If ad_flag is true then we add
-	a datestamp to the log file and cause the log to roll at midnght.
-	Add flag is a cycle value 86400 causes the file to be cycled every
-	midnight, n*3600 causes it to be cycled every n hours (offset off of 
-	midnight), and n*60 causes it to be cycled every n minutes). File names
-	are suffixed with a suitble date/time stamp when ad_flag >0. 
+	Does the real work for bleat_set_log(); caller must hold the writer lock.
 */
-extern int bleat_set_log( char* fname, int ad_flag ) {
+static int set_log( char* fname, int ad_flag ) {
 	FILE*	f;
 
-	if( fname == NULL ) {
-		return 1;
-	}
-
 	if( ad_flag && ad_flag < 60 ) {
 		ad_flag = 60;
 	}
@@ -264,11 +434,15 @@ extern int bleat_set_log( char* fname, int ad_flag ) {
 			free( fname_base );
 			fname_base = NULL;
 		}
+		if( log_fname != NULL ) {
+			free( log_fname );
+			log_fname = NULL;
+		}
 		return 0;
 	}
 
 	if( ad_flag ) {
-		if( fname_base ) {
+		if( fname_base && fname_base != fname ) {
 			free( fname_base );
 		}
 		fname_base = strdup( fname );
@@ -285,66 +459,679 @@ extern int bleat_set_log( char* fname, int ad_flag ) {
 		return 1;
 	}
 
-	if( ! log_is_std ) {
+	if( ! log_is_std && log != NULL ) {
 		fclose( log  );				// open ok, can safely close the old one, but only if not stderr
 	}
 	log_is_std = 0;
 	log = f;
 
+	if( log_fname != NULL ) {
+		free( log_fname );
+		log_fname = NULL;
+	}
 	if( ad_flag ) {
-		free( fname );				// fname was overloaded with our add date string; must free
+		log_fname = fname;			// fname was overloaded with our add date string; we keep it
 	}
 	return 0;
 }
 
 /*
-	Send a message  to the log file if the level indicated is >= to the 
-	current level, otherwise nothing.
+	Set the file where we will write and open it.
+	Returns 0 if good; !0 otherwise. If ad_flag is true then we add
+	a datestamp to the log file and cause the log to roll at midnght.
+	Add flag is a cycle value 86400 causes the file to be cycled every
+	midnight, n*3600 causes it to be cycled every n hours (offset off of 
+	midnight), and n*60 causes it to be cycled every n minutes). File names
+	are suffixed with a suitble date/time stamp when ad_flag >0. 
+*/
+extern int bleat_set_log( char* fname, int ad_flag ) {
+	int		rc;
 
-	(Shamelessly stolen from Ningaui, and then modified.)
+	if( fname == NULL ) {
+		return 1;
+	}
+
+	pthread_mutex_lock( &wlock );			// writer thread must not be using log while we swap it
+	rc = set_log( fname, ad_flag );
+	pthread_mutex_unlock( &wlock );
+
+	return rc;
+}
+
+/*
+	Flip the log if the flip time has passed. Caller must hold wlock if the
+	async writer could be running.
 */
-void bleat_printf( int vlevel, const char *fmt, ... )
-{
-	va_list	argp;			/* pointer at variable arguments */
-	char	obuf[8192];		/* final msg buf - allow ng_buffer to caller, 1k for header*/
-	time_t	 gmt;			// timestamp
-	char	*uidx; 			/* index into output buffer for user message */
-	int	space; 				/* amount of space in obuf for user message */
-	int	hlen;  				/* size of header in output buffer */
-	char*	ptime;
+static void check_flip( void ) {
 	char*	obn;			// old base name
 
-	if( log == NULL ) {		// first call; initialise if not set
+	if( time2flip && time2flip < time( NULL ) ) {			// first bleat after flip time, close and reoopen the log
+		obn = strdup( fname_base );							// save because set_log will replace it
+		set_log( obn, log_cycle );
+		free( obn );
+		purge_old_files();									// purge old files if purge is set
+	}
+}
+
+/*
+	Queue a formatted message (len bytes, newline included) on the ring. Never
+	blocks; if the ring is full the message is dropped and counted so that the
+	writer can report the loss.
+*/
+static void ring_push( const char* msg, int len ) {
+	bslot_t*	slot;
+	uint64_t	pos;
+	int64_t		dif;
+
+	pos = __atomic_load_n( &ring_head, __ATOMIC_RELAXED );
+	for( ;; ) {
+		slot = &ring[pos & ring_mask];
+		dif = (int64_t) __atomic_load_n( &slot->seq, __ATOMIC_ACQUIRE ) - (int64_t) pos;
+		if( dif == 0 ) {
+			if( __atomic_compare_exchange_n( &ring_head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+				break;										// slot is ours
+			}
+		} else {
+			if( dif < 0 ) {									// writer hasn't freed this slot; ring is full
+				__atomic_add_fetch( &ring_drops, 1, __ATOMIC_RELAXED );
+				return;
+			}
+			pos = __atomic_load_n( &ring_head, __ATOMIC_RELAXED );		// another producer beat us; try again
+		}
+	}
+
+	if( len > BLEAT_SLOT_SIZE ) {							// truncate but keep the newline
+		len = BLEAT_SLOT_SIZE;
+		slot->msg[len-1] = '\n';
+		memcpy( slot->msg, msg, len - 1 );
+	} else {
+		memcpy( slot->msg, msg, len );
+	}
+	slot->len = len;
+
+	__atomic_store_n( &slot->seq, pos + 1, __ATOMIC_RELEASE );		// publish to the writer
+}
+
+/*
+	Write everything currently on the ring to the log. Returns the number of
+	messages written. Caller must hold wlock.
+*/
+static int ring_drain( void ) {
+	bslot_t*	slot;
+	uint64_t	drops;
+	int			n = 0;
+
+	while( 1 ) {
+		slot = &ring[ring_tail & ring_mask];
+		if( __atomic_load_n( &slot->seq, __ATOMIC_ACQUIRE ) != ring_tail + 1 ) {
+			break;													// nothing more published
+		}
+
+		fwrite( slot->msg, 1, slot->len, log );
+		__atomic_store_n( &slot->seq, ring_tail + ring_mask + 1, __ATOMIC_RELEASE );	// hand slot back for the next lap
+		ring_tail++;
+		n++;
+	}
+
+	if( (drops = __atomic_exchange_n( &ring_drops, 0, __ATOMIC_RELAXED )) > 0 ) {
+		fprintf( log, "%lld %s [0] bleat: %llu messages dropped; log ring was full\n", (long long) time( NULL ), pretty_time( time( NULL ) ), (unsigned long long) drops );
+		n++;
+	}
+
+	if( n > 0 ) {
+		fflush( log );
+	}
+
+	return n;
+}
+
+/*
+	Writer thread: drains the ring, and is the only thread which flips the
+	log while in async mode. Sleeps briefly when there is nothing to write.
+*/
+static void* bleat_writer( void* data ) {
+	struct timespec	nap = { 0, 5000000 };		// 5ms when idle
+	int	n;
+
+	while( 1 ) {
+		pthread_mutex_lock( &wlock );
+		if( ! hk_on ) {
+			check_flip();
+		}
+		n = ring_drain();
+		pthread_mutex_unlock( &wlock );
+
+		if( n == 0 ) {
+			if( ! __atomic_load_n( &writer_run, __ATOMIC_ACQUIRE ) ) {
+				break;									// stopped and fully drained
+			}
+			nanosleep( &nap, NULL );
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Enable asynchronous mode. Messages are formatted by the caller's thread and
+	queued on a ring of nslots (rounded up to a power of two) entries which is
+	written by a dedicated thread; a caller never blocks on log I/O. Messages
+	longer than BLEAT_SLOT_SIZE are truncated in this mode, and if the ring fills
+	messages are dropped (the count is written to the log).
+
+	Threads do not survive fork(), so this must be called after daemonising.
+	Returns 0 on success, !0 on failure (synchronous mode remains in effect).
+*/
+extern int bleat_set_async( int nslots ) {
+	uint64_t	size = 64;
+	uint64_t	i;
+
+	if( async_on ) {
+		return 0;
+	}
+
+	while( size < (uint64_t) nslots ) {
+		size <<= 1;
+	}
+
+	if( ring == NULL ) {
+		if( (ring = (bslot_t *) malloc( sizeof( *ring ) * size )) == NULL ) {
+			return 1;
+		}
+		ring_mask = size - 1;
+	}
+
+	for( i = 0; i <= ring_mask; i++ ) {
+		ring[i].seq = i;
+		ring[i].len = 0;
+	}
+	ring_head = ring_tail = 0;
+	ring_drops = 0;
+
+	if( log == NULL ) {
 		log = stderr;
 		log_is_std = 1;
+	}
+
+	writer_run = 1;
+	if( pthread_create( &writer_tid, NULL, bleat_writer, NULL ) != 0 ) {
+		writer_run = 0;
+		return 1;
+	}
+
+	__atomic_store_n( &async_on, 1, __ATOMIC_RELEASE );
+	return 0;
+}
+
+/*
+	Wait until no thread is in emit(). A thread which enters after the caller
+	changed the mode or the log sees the change, so once the count has been seen
+	at zero nothing can still be using what was there before.
+*/
+static void wait_emitters( void ) {
+	struct timespec	nap = { 0, 100000 };		// 100us
+
+	while( __atomic_load_n( &emitters, __ATOMIC_SEQ_CST ) > 0 ) {
+		nanosleep( &nap, NULL );
+	}
+}
+
+/*
+	Stop asynchronous mode. New messages are written directly from here on; the
+	producers which were already pushing are waited for, and then the writer
+	drains everything on the ring and exits. No message queued before the call
+	is lost. The ring is kept and reused if async mode is enabled again.
+*/
+extern void bleat_stop_async( void ) {
+	if( ! async_on ) {
+		return;
+	}
+
+	__atomic_store_n( &async_on, 0, __ATOMIC_SEQ_CST );		// stop accepting
+	wait_emitters( );										// pushes in progress are finished
+	__atomic_store_n( &writer_run, 0, __ATOMIC_RELEASE );	// writer exits only once the ring is empty
+	pthread_join( writer_tid, NULL );
+}
+
+/*
+	Compress a rolled log file with gzip. Run only from the housekeeping thread
+	so the caller of bleat_printf() never waits on it. The process is likely
+	to be large (hugepage mappings) and threaded, so gzip is started with
+	posix_spawnp() rather than fork()/exec; the child is reaped before we return.
+*/
+static void compress_file( const char* fname ) {
+	char*	argv[4];
+	pid_t	pid;
+	int		status;
+	int		rc;
+
+	argv[0] = "gzip";
+	argv[1] = "-f";
+	argv[2] = (char *) fname;
+	argv[3] = NULL;
+
+	if( (rc = posix_spawnp( &pid, "gzip", NULL, NULL, argv, environ )) != 0 ) {
+		bleat_printf( 0, "WRN: unable to start gzip for %s: %s", fname, strerror( rc ) );
+		return;
+	}
+
+	while( waitpid( pid, &status, 0 ) < 0 && errno == EINTR );
+	if( ! WIFEXITED( status ) || WEXITSTATUS( status ) != 0 ) {
+		bleat_printf( 1, "WRN: gzip of %s failed", fname );
+	}
+}
+
+/*
+	Roll the log to a newly dated file. The new file is opened without holding
+	the writer lock; the lock is held only to swap the pointer. The old file is
+	not closed immediately as a thread in bleat_printf() may still be using it
+	(synchronous writers don't take the lock); it is retired and closed once
+	no thread is in emit() (see hk_retire()).
+*/
+static void hk_roll( void ) {
+	char*	base;
+	char*	fname;
+	time_t	cycle;
+	FILE*	f;
+
+	pthread_mutex_lock( &wlock );
+	if( fname_base == NULL || log_cycle == 0 || retired != NULL ) {	// not dated, or last roll not finished
+		pthread_mutex_unlock( &wlock );
+		return;
+	}
+	base = strdup( fname_base );
+	cycle = log_cycle;
+	pthread_mutex_unlock( &wlock );
+
+	fname = add_date( base, cycle );
+	f = fopen( fname, "a" );
+
+	pthread_mutex_lock( &wlock );
+	if( f == NULL || fname_base == NULL || strcmp( base, fname_base ) != 0 || log_cycle != cycle ) {	// failed, or log changed under us
+		if( f != NULL ) {
+			fclose( f );
+		}
+		if( f == NULL && log_cycle ) {
+			time2flip = get_flip_time( log_cycle );						// don't retry until next cycle
+		}
+		pthread_mutex_unlock( &wlock );
+		free( fname );
+		free( base );
+		return;
+	}
+
+	retired = log;
+	retired_name = log_fname;
+
+	__atomic_store_n( &log, f, __ATOMIC_SEQ_CST );
+	log_fname = fname;
+	time2flip = get_flip_time( cycle );
+	pthread_mutex_unlock( &wlock );
+
+	free( base );
+}
+
+/*
+	Close the retired log, and compress it if that was requested. A writer counts
+	itself in emitters before it loads the log pointer, so once the count is seen
+	at zero after the swap no writer can still hold the retired file. If writers
+	are busy the close is left for the next call unless wait is set, in which
+	case we wait for them.
+*/
+static void hk_retire( int wait ) {
+	if( retired == NULL ) {
+		return;
+	}
+
+	if( wait ) {
+		wait_emitters( );
 	} else {
-		if( time2flip && time2flip < time( NULL ) ) {			// first bleat after flip time, close and reoopen the log
-			obn = strdup( fname_base );							// save because set_log will replace it
-			bleat_set_log( obn, log_cycle );
-			free( obn );
-			purge_old_files();									// purge old files if purge is set
+		if( __atomic_load_n( &emitters, __ATOMIC_SEQ_CST ) > 0 ) {
+			return;
+		}
+	}
+
+	fclose( retired );
+	retired = NULL;
+	if( retired_name != NULL ) {
+		if( hk_compress ) {
+			compress_file( retired_name );
+		}
+		free( retired_name );
+		retired_name = NULL;
+	}
+}
+
+/*
+	Housekeeping thread: rolls the log at the flip time, closes and compresses
+	the file rolled away from, and purges the log directory after each roll
+	and hourly.
+*/
+static void* bleat_hk( void* data ) {
+	struct timespec	nap = { 0, 250000000 };		// 250ms
+	time_t	next_purge = 0;
+	time_t	now;
+
+	while( __atomic_load_n( &hk_run, __ATOMIC_ACQUIRE ) ) {
+		now = time( NULL );
+		if( time2flip && time2flip <= now ) {
+			hk_roll( );
+			next_purge = 0;								// purge right after a roll
+		}
+
+		hk_retire( 0 );
+
+		if( now >= next_purge ) {
+			purge_old_files( );
+			next_purge = now + 3600;
 		}
+
+		nanosleep( &nap, NULL );
+	}
+
+	return NULL;
+}
+
+/*
+	Start the housekeeping thread. Once running, rolling the log, compressing
+	rolled files (when compress is set) and purging are done by the thread; a
+	bleat_printf() caller never opens files or scans the directory.
+
+	Threads do not survive fork(), so this must be called after daemonising.
+	Returns 0 on success, !0 on failure (callers continue to roll the log).
+*/
+extern int bleat_start_hk( int compress ) {
+	if( hk_on ) {
+		return 0;
+	}
+
+	hk_compress = compress;
+	hk_run = 1;
+	if( pthread_create( &hk_tid, NULL, bleat_hk, NULL ) != 0 ) {
+		hk_run = 0;
+		return 1;
 	}
 
-	if( vlevel > cur_level  )		// mod -- ningaui caps at 0x0f
+	__atomic_store_n( &hk_on, 1, __ATOMIC_RELEASE );
+	return 0;
+}
+
+/*
+	Stop the housekeeping thread; waits for it to exit. Any rolled file not yet
+	closed is closed (and compressed) now.
+*/
+extern void bleat_stop_hk( void ) {
+	if( ! hk_on ) {
 		return;
+	}
+
+	__atomic_store_n( &hk_run, 0, __ATOMIC_RELEASE );
+	pthread_join( hk_tid, NULL );
+	__atomic_store_n( &hk_on, 0, __ATOMIC_RELEASE );
+	hk_retire( 1 );
+}
+
+/*
+	Hand a formatted message (len bytes, newline included) to the log; either
+	queued or written directly depending on the mode. The thread is counted in
+	emitters while here so that the housekeeper knows when a rolled log can be
+	closed, and bleat_stop_async() knows when the last push has landed.
+*/
+static void emit( char* obuf, int len ) {
+	FILE*	lf;			// log we write to; the housekeeper may swap log under us
 
+	__atomic_add_fetch( &emitters, 1, __ATOMIC_SEQ_CST );
+	if( __atomic_load_n( &async_on, __ATOMIC_SEQ_CST ) ) {
+		ring_push( obuf, len );
+	} else {
+		if( (lf = __atomic_load_n( &log, __ATOMIC_SEQ_CST )) == NULL ) {		// first call; initialise if not set
+			log = lf = stderr;
+			log_is_std = 1;
+		} else {
+			if( ! hk_on ) {
+				check_flip();
+				lf = log;
+			}
+		}
+
+		fwrite( obuf, 1, len, lf );
+		fflush( lf );
+	}
+	__atomic_sub_fetch( &emitters, 1, __ATOMIC_SEQ_CST );
+}
+
+/*
+	Format the header for a message into buf, returning the length.
+*/
+static int fmt_header( char* buf, int len, time_t gmt, int vlevel ) {
+	return snprintf( buf, len, "%lld %s [%d] ", (long long) gmt, pretty_time( gmt ), vlevel );
+}
+
+/*
+	Write summaries for anything that flood control has suppressed for the entry.
+	Rate limit drops are reported only if rl_too is set. Caller must hold the entry.
+*/
+static void dup_report( dup_ent_t* e, time_t now, int rl_too ) {
+	char	buf[512];
+	int		len;
+
+	if( e->repeats > 0 ) {
+		len = fmt_header( buf, sizeof( buf ), now, e->level );
+		len += snprintf( buf + len, sizeof( buf ) - len, "last message repeated %d times (%s)\n", e->repeats, e->site );
+		emit( buf, len < (int) sizeof( buf ) ? len : (int) sizeof( buf ) - 1 );
+		e->repeats = 0;
+	}
+
+	if( rl_too && e->rl_drops > 0 ) {
+		len = fmt_header( buf, sizeof( buf ), now, e->level );
+		len += snprintf( buf + len, sizeof( buf ) - len, "%d messages suppressed by rate limit (%s)\n", e->rl_drops, e->site );
+		emit( buf, len < (int) sizeof( buf ) ? len : (int) sizeof( buf ) - 1 );
+		e->rl_drops = 0;
+	}
+}
+
+/*
+	Return the call site table entry for the site, or nil if another thread
+	is using it. On success the caller holds the entry and must release it.
+*/
+static dup_ent_t* dup_get( const char* site ) {
+	dup_ent_t*	e;
+	uintptr_t	h;
+
+	h = (uintptr_t) site;
+	h ^= h >> 17;
+	h *= 0x9e3779b1;
+	e = &dup_tab[(h >> 7) & (DUP_SLOTS - 1)];
+
+	if( __atomic_test_and_set( &e->busy, __ATOMIC_ACQUIRE ) ) {
+		return NULL;
+	}
+
+	return e;
+}
+
+static inline void dup_release( dup_ent_t* e ) {
+	__atomic_clear( &e->busy, __ATOMIC_RELEASE );
+}
+
+/*
+	Simple FNV-1a hash of the user portion of a message.
+*/
+static uint64_t msg_hash( const char* m ) {
+	uint64_t	h = 0xcbf29ce484222325ULL;
+
+	while( *m ) {
+		h ^= (unsigned char) *m++;
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+/*
+	Apply flood control to a message from site. Returns 1 if the message
+	should be written, 0 if it has been suppressed (and counted).
+*/
+static int dup_check( const char* site, int vlevel, const char* umsg, time_t now ) {
+	dup_ent_t*	e;
+	uint64_t	h;
+
+	if( (e = dup_get( site )) == NULL ) {
+		return 1;										// busy; write it rather than wait
+	}
+
+	h = msg_hash( umsg );
+	if( e->site != site ) {								// new site, or a collision which evicts the old one
+		if( e->site != NULL ) {
+			dup_report( e, now, 1 );
+		}
+		memset( (char *) e + sizeof( e->busy ), 0, sizeof( *e ) - sizeof( e->busy ) );
+		e->site = site;
+	}
+
+	if( dup_window > 0 && e->mhash == h && e->rl_sec != 0 ) {
+		if( e->repeats == 0 ) {
+			e->first_rep = now;
+		}
+		e->repeats++;
+		e->last_rep = now;
+		e->level = vlevel;
+		if( now - e->first_rep >= dup_window ) {		// storm is continuing; summarise periodically
+			dup_report( e, now, 0 );
+		}
+
+		dup_release( e );
+		return 0;
+	}
+
+	dup_report( e, now, e->rl_sec != now );			// different message, say what was suppressed first
+	e->mhash = h;
+	e->level = vlevel;
+
+	if( e->rl_sec != now ) {
+		e->rl_sec = now;
+		e->rl_count = 0;
+	}
+	if( rate_max > 0 && ++e->rl_count > rate_max ) {
+		e->rl_drops++;
+		dup_release( e );
+		return 0;
+	}
+
+	dup_release( e );
+	return 1;
+}
+
+/*
+	Write summaries for call sites whose repeats have stopped, and for rate
+	limit drops from a previous second. Should be called periodically (e.g.
+	from the main loop) so that the summary of a storm isn't held until the
+	next message from the same site.
+*/
+extern void bleat_flush_repeats( void ) {
+	dup_ent_t*	e;
+	time_t		now;
+	int			i;
+
+	if( dup_window <= 0 && rate_max <= 0 ) {
+		return;
+	}
+
+	now = time( NULL );
+	for( i = 0; i < DUP_SLOTS; i++ ) {
+		e = &dup_tab[i];
+		if( e->site == NULL || (e->repeats == 0 && e->rl_drops == 0) ) {	// unlocked peek; fine as we check again
+			continue;
+		}
+
+		if( (e = dup_get( dup_tab[i].site )) != &dup_tab[i] ) {
+			if( e != NULL ) {
+				dup_release( e );						// different slot (can't happen, but be safe)
+			}
+			continue;
+		}
+
+		if( (e->repeats > 0 && now - e->last_rep > 1) || (e->rl_drops > 0 && now != e->rl_sec) ) {
+			dup_report( e, now, now != e->rl_sec );
+			e->mhash = 0;								// next message, even if the same, is written
+		}
+		dup_release( e );
+	}
+}
+
+/*
+	Send a message to the log file if the level indicated is <= the level
+	in effect for the subsystem (ss), otherwise nothing. The message is formatted
+	in a per-thread buffer; in async mode it is queued for the writer thread,
+	otherwise it is written directly.
+
+	Site is the call site (file:line) supplied by the bleat_printf() macro, and
+	is used to suppress floods of messages; if nil, no flood control is applied.
+
+	(Shamelessly stolen from Ningaui, and then modified.)
+*/
+static void bleat_vxprintf( int ss, const char* site, int vlevel, const char *fmt, va_list argp ) {
+	char*	obuf;			/* final msg buf - allow ng_buffer to caller, 1k for header*/
+	time_t	 gmt;			// timestamp
+	char	*uidx; 			/* index into output buffer for user message */
+	int	space; 				/* amount of space in obuf for user message */
+	int	hlen;  				/* size of header in output buffer */
+	int	len;
+
+	if( vlevel > ss_eff_level( ss ) )		// mod -- ningaui caps at 0x0f
+		return;
+
+	obuf = tl_obuf;
  	gmt = time(  NULL );				// current time
-	ptime = pretty_time( gmt );
- 
-	snprintf( obuf, sizeof( obuf ), "%lld %s [%d] ", (long long) gmt, ptime, vlevel );
-	free( ptime );
+	hlen = fmt_header( obuf, BLEAT_MAX_MSG, gmt, vlevel );
 
-	hlen = strlen( obuf );          
-	space = sizeof( obuf ) - hlen;        /* space for user message */
+	space = BLEAT_MAX_MSG - hlen;         /* space for user message */
 	uidx = obuf + hlen;                   /* point past header stuff */
 
-	va_start( argp, fmt );                      /* point to first variable arg */
-	vsnprintf( uidx, space - 1, fmt, argp );	// bang the user message onto our header (argp not valid after call)
-	va_end( argp );                             /* cleanup of variable arg stuff */
+	len = vsnprintf( uidx, space - 1, fmt, argp );	// bang the user message onto our header (argp not valid after call)
 
-	fprintf(  log, "%s\n", obuf );
-	fflush( log );
+	if( len < 0 ) {
+		len = 0;
+	}
+	if( len > space - 2 ) {
+		len = space - 2;					// vsnprintf returns what it would have written
+	}
+
+	if( site != NULL && vlevel > 0 && (dup_window > 0 || rate_max > 0) ) {		// level 0 (ERR/CRI) is never suppressed
+		uidx[len] = 0;
+		if( ! dup_check( site, vlevel, uidx, gmt ) ) {
+			return;
+		}
+	}
+
+	len += hlen;
+	obuf[len++] = '\n';
+	obuf[len] = 0;
+
+	emit( obuf, len );
+}
+
+/*
+	Write a message for the subsystem; site is the call site used for flood control
+	(nil to disable). Generally invoked via the bleat_printf() macro.
+*/
+extern void bleat_xprintf( int ss, const char* site, int vlevel, const char *fmt, ... ) {
+	va_list	argp;
+
+	va_start( argp, fmt );
+	bleat_vxprintf( ss, site, vlevel, fmt, argp );
+	va_end( argp );
 }
 
+/*
+	Write a message using the global level and no flood control. Code which
+	includes vfdlib.h reaches bleat_xprintf() through the bleat_printf() macro,
+	this remains for anything which calls the function directly.
+*/
+extern void bleat_printf( int vlevel, const char *fmt, ... ) {
+	va_list	argp;
 
+	va_start( argp, fmt );
+	bleat_vxprintf( BLEAT_SS_GEN, NULL, vlevel, fmt, argp );
+	va_end( argp );
+}
@@ -0,0 +1,135 @@
+// :vi ts=4 sw=4:
+/*
+	Mneminic:	bleat_async_test.c
+	Abstract: 	Unit test for the asynchronous mode of the bleat module.
+				Several threads write messages concurrently; the log is then
+				read back to ensure that every line is whole (no interleaving)
+				and that every message written (less any reported as dropped)
+				is present.
+
+				bleat_async_test [threads [messages-per-thread]]
+
+	Date:		19 October 2026
+*/
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "vfdlib.h"
+
+#define LOG_NAME	"bleat_async_test.log"
+
+static int nmsgs = 10000;
+
+static void* writer( void* data ) {
+	int id;
+	int i;
+
+	id = *((int *) data);
+	for( i = 0; i < nmsgs; i++ ) {
+		bleat_printf( 1, "thread %d message %d of %d tail-marker", id, i, nmsgs );
+		bleat_printf( 3, "thread %d message %d should NOT be seen", id, i );
+	}
+
+	return NULL;
+}
+
+int main( int argc, char** argv ) {
+	pthread_t*	tids;
+	int*		ids;
+	int			nthreads = 4;
+	int			i;
+	int			rc = 0;
+	FILE*		f;
+	char		buf[2048];
+	long		good = 0;
+	long		bad = 0;
+	long		dropped = 0;
+	char*		tok;
+
+	if( argc > 1 ) {
+		nthreads = atoi( argv[1] );
+	}
+	if( argc > 2 ) {
+		nmsgs = atoi( argv[2] );
+	}
+
+	unlink( LOG_NAME );
+	bleat_set_lvl( 1 );
+	if( bleat_set_log( LOG_NAME, 0 ) != 0 ) {
+		fprintf( stderr, "[FAIL] unable to open log %s: %s\n", LOG_NAME, strerror( errno ) );
+		exit( 1 );
+	}
+
+	if( bleat_set_async( 4096 ) != 0 ) {
+		fprintf( stderr, "[FAIL] unable to start async mode\n" );
+		exit( 1 );
+	}
+
+	tids = (pthread_t *) malloc( sizeof( *tids ) * nthreads );
+	ids = (int *) malloc( sizeof( *ids ) * nthreads );
+	for( i = 0; i < nthreads; i++ ) {
+		ids[i] = i;
+		pthread_create( &tids[i], NULL, writer, &ids[i] );
+	}
+	for( i = 0; i < nthreads; i++ ) {
+		pthread_join( tids[i], NULL );
+	}
+
+	bleat_stop_async();					// must drain everything before returning
+	bleat_set_log( "stderr", 0 );
+
+	if( (f = fopen( LOG_NAME, "r" )) == NULL ) {
+		fprintf( stderr, "[FAIL] unable to open log for reading: %s\n", strerror( errno ) );
+		exit( 1 );
+	}
+
+	while( fgets( buf, sizeof( buf ), f ) != NULL ) {
+		if( strstr( buf, "NOT" ) != NULL ) {
+			bad++;
+			continue;
+		}
+
+		if( (tok = strstr( buf, "messages dropped" )) != NULL ) {
+			while( tok > buf && *(tok-1) == ' ' ) tok--;
+			while( tok > buf && *(tok-1) != ' ' ) tok--;
+			dropped += atol( tok );
+			continue;
+		}
+
+		if( strncmp( buf + strlen( buf ) - 12, "tail-marker\n", 12 ) == 0 && strstr( buf, "] thread " ) != NULL ) {
+			good++;
+		} else {
+			bad++;
+		}
+	}
+	fclose( f );
+
+	if( bad > 0 ) {
+		fprintf( stderr, "[FAIL] %ld lines were torn or should not have been written\n", bad );
+		rc = 1;
+	} else {
+		fprintf( stderr, "[OK]   no torn lines\n" );
+	}
+
+	if( good + dropped != (long) nthreads * nmsgs ) {
+		fprintf( stderr, "[FAIL] expected %ld messages, found %ld written and %ld dropped\n", (long) nthreads * nmsgs, good, dropped );
+		rc = 1;
+	} else {
+		fprintf( stderr, "[OK]   all messages accounted for: %ld written %ld dropped\n", good, dropped );
+	}
+
+	if( rc == 0 ) {
+		unlink( LOG_NAME );
+	}
+
+	free( tids );
+	free( ids );
+	exit( rc );
+}
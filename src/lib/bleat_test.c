@@ -11,6 +11,8 @@
 				seconds should be purged when the log file is rolled during
 				the test.
 
+				Flood control (repeat suppression and rate limiting) and
+				subsystem levels are also exercised; results are in foo.log.
 
 	Date:		08 March 2016
 	Author:		E. Scott Daniels
@@ -30,6 +32,7 @@ int main( int argc, char** argv ) {
 	int	id = 0;
 	int	psec = 0;
 	int rsec = 0;			// seconds to wait when testing log roll
+	int	i;
 
 	
 	id = getppid();
@@ -75,6 +78,35 @@ int main( int argc, char** argv ) {
 	bleat_printf( 2, "this message should NOT be seen it is level 2" );
 	bleat_printf( 0, "this is a level 0 should be SEEN data: %d",  id );
 
+	// subsystem levels
+	bleat_set_ss_lvl( BLEAT_SS_QOS, 3 );
+	bleat_ssprintf( BLEAT_SS_QOS, 3, "qos level set to 3 so this should be SEEN" );
+	bleat_ssprintf( BLEAT_SS_MBOX, 2, "mbox level follows global (1) so this should NOT be seen" );
+	bleat_set_ss_lvl( BLEAT_SS_QOS, -1 );
+	bleat_ssprintf( BLEAT_SS_QOS, 3, "qos reverted to global level so this should NOT be seen" );
+	if( bleat_ss_id( "mbox" ) != BLEAT_SS_MBOX || bleat_ss_id( "bogus" ) != -1 ) {
+		fprintf( stderr, "[FAIL] subsystem name lookup failed\n" );
+	}
+
+	// flood control; summaries are written by the flush once the flood stops
+	bleat_set_dedup( 30, 0 );
+	for( i = 0; i < 100; i++ ) {
+		bleat_printf( 1, "flood message should be SEEN once, followed by a 'repeated 99 times' message" );
+	}
+	sleep( 2 );
+	bleat_flush_repeats( );
+
+	bleat_set_dedup( 0, 10 );
+	for( i = 0; i < 100; i++ ) {
+		bleat_printf( 1, "rate limited message %d of 100 should be SEEN only 10 times, followed by a 'suppressed' message", i );
+	}
+	for( i = 0; i < 12; i++ ) {
+		bleat_printf( 0, "ERR: level 0 message %d of 12 should be SEEN every time; never limited", i );
+	}
+	sleep( 1 );
+	bleat_flush_repeats( );
+	bleat_set_dedup( 0, 0 );
+
 	if( rsec > 0 ) {
 		// these should to to foo.log.<date> in the current directory, hms should be added and the 
 		// log should 'roll' on rsec boundaries
@@ -20,8 +20,21 @@
 				07 Feb 2018 : Add memory support back.
 				14 Feb 2018 : Add default for vf config name.
 				13 Apr 2018 : Add cpu alarm threshold to the config.
-
-	TODO:		convert things to the new jw_xapi functions to make for easier to read code.
+				19 Oct 2026 : Add per pciid list of xstat name prefixes to export.
+				19 Oct 2026 : Add stats dump interval and format.
+				19 Oct 2026 : Add async_log option.
+				19 Oct 2026 : Add log flood control options (log_dedup, log_rate_max).
+				19 Oct 2026 : Add log_compress option.
+				19 Oct 2026 : Add snap_path and warm_restart options.
+				19 Oct 2026 : Decode the parm and vf config files directly into the structs
+					using schema tables (jw_decode) rather than building a jwrapper
+					hash and looking up each field. Unknown fields and bad types
+					are reported.
+				19 Oct 2026 : Add reattach option.
+				19 Oct 2026 : Add config_watch option.
+				19 Oct 2026 : Add socket (request socket path) option.
+				19 Oct 2026 : Add req_workers option.
+				19 Oct 2026 : Add pf_workers and pf_pin options.
 */
 
 #include <fcntl.h>
@@ -32,7 +45,9 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
+#include <stddef.h>
 
 #include "vfdlib.h"
 
@@ -140,6 +155,399 @@ static char* file_into_buf( char* fname, uid_t* uid ) {
 	return buf;
 }
 
+// ---- parm file decoding -------------------------------------------------------------
+/*
+	Things picked up from the parm file which are not kept in parms, or which
+	must wait until the whole file has been seen before they can be applied.
+*/
+typedef struct {
+	int		def_mtu;			// default_mtu (or the deprecated mtu)
+	int		old_mtu;
+	int		have_def_mtu;
+	int		have_old_mtu;
+} parm_dctx_t;
+
+/*
+	A traffic class as it is decoded; the priority determines where it lands.
+*/
+typedef struct {
+	int			pri;
+	tc_class_t	tc;
+} tc_dec_t;
+
+#define NOT_SET		(-1 - 0x7fffffff)		// value not in the json; default is filled in once everything is decoded
+
+static int dec_cpu_alarm( void* target, jw_val_t* val, void* data ) {
+	parms_t*	parms;
+
+	parms = (parms_t *) target;
+	switch( val->type ) {
+		case JW_VALUE:									// we allow real float value e.g. 1.05 == 105%, or string
+			parms->cpu_alrm_thresh = val->num;
+			return 1;
+
+		case JW_STRING:									// assume something like "30%" or just "30"
+			parms->cpu_alrm_thresh = (double) atoi( val->str ) / 100.0;
+			return 1;
+	}
+
+	return 0;
+}
+
+static int dec_mtu( void* target, jw_val_t* val, void* data ) {
+	parm_dctx_t*	pctx;
+
+	pctx = (parm_dctx_t *) data;
+	if( val->type != JW_VALUE && val->type != JW_BOOL ) {
+		return 0;
+	}
+
+	if( *val->name == 'd' ) {
+		pctx->def_mtu = (int) val->num;
+		pctx->have_def_mtu = 1;
+	} else {
+		pctx->old_mtu = (int) val->num;
+		pctx->have_old_mtu = 1;
+	}
+
+	return 1;
+}
+
+static int dec_stats_fmt( void* target, jw_val_t* val, void* data ) {
+	if( val->type != JW_STRING ) {
+		return 0;
+	}
+
+	((parms_t *) target)->stats_fmt = strcasecmp( val->str, "csv" ) == 0 ? SF_CSV : SF_JSON;
+	return 1;
+}
+
+/*
+	Numa mem may be given as a value or as a string (e.g. "64,64").
+*/
+static int dec_numa_mem( void* target, jw_val_t* val, void* data ) {
+	parms_t*	parms;
+	char		wbuf[64];
+
+	parms = (parms_t *) target;
+	switch( val->type ) {
+		case JW_VALUE:
+			snprintf( wbuf, sizeof( wbuf ), "%d", (int) val->num );
+			break;
+
+		case JW_STRING:
+			snprintf( wbuf, sizeof( wbuf ), "%s", val->str );
+			break;
+
+		default:
+			return 0;
+	}
+
+	SFREE( parms->numa_mem );
+	return (parms->numa_mem = strdup( wbuf )) != NULL ? 1 : -1;
+}
+
+/*
+	Drop the traffic classes that hang off of a pciid.
+*/
+static void free_tcs( pfdef_t* pf ) {
+	int	i;
+
+	if( pf->tcs[0] != NULL ) {
+		for( i = 0; i < MAX_TCS; i++ ) {
+			SFREE( pf->tcs[0][i].hr_name );
+		}
+		free( pf->tcs[0] );						// all of the blocks are allocated in one hunk
+	}
+	memset( pf->tcs, 0, sizeof( pf->tcs ) );
+}
+
+/*
+	Drop the xstat prefix list that hangs off of a pciid.
+*/
+static void free_xstats( pfdef_t* pf ) {
+	int	i;
+
+	for( i = 0; i < pf->nxstats; i++ ) {
+		SFREE( pf->xstats[i] );
+	}
+	SFREE( pf->xstats );
+	pf->xstats = NULL;
+	pf->nxstats = 0;
+}
+
+static const jw_field_t tc_schema[] = {
+	{ "pri",		JWD_NUM,	offsetof( tc_dec_t, pri ), 0, NULL },
+	{ "name",		JWD_STR,	offsetof( tc_dec_t, tc.hr_name ), 0, NULL },
+	{ "llatency",	JWD_FLAG,	offsetof( tc_dec_t, tc.flags ), TCF_LOW_LATENCY, NULL },
+	{ "lsp",		JWD_FLAG,	offsetof( tc_dec_t, tc.flags ), TCF_LNK_STRICTP, NULL },
+	{ "bsp",		JWD_FLAG,	offsetof( tc_dec_t, tc.flags ), TCF_BW_STRICTP, NULL },
+	{ "max_bw",		JWD_INT,	offsetof( tc_dec_t, tc.max_bw ), 0, NULL },
+	{ "min_bw",		JWD_INT,	offsetof( tc_dec_t, tc.min_bw ), 0, NULL },
+};
+
+/*
+	Traffic classes: an array of objects, each with a priority (0-7) which is
+	used to place it in the pciid's tcs array. A full set of classes is always
+	allocated so that tcs[0] can be used to free them.
+*/
+static int dec_tclasses( void* target, jw_val_t* val, void* data ) {
+	pfdef_t*	pf;
+	tc_class_t*	tc_block;
+	tc_dec_t	tcd;
+	jw_val_t	ele;
+	char		wbuf[128];
+	int			i;
+
+	pf = (pfdef_t *) target;
+	if( val->type != JW_ARRAY ) {
+		return 0;
+	}
+	if( val->len <= 0 ) {
+		return 1;
+	}
+
+	free_tcs( pf );											// tclasses given twice; last one wins
+	pf->ntcs = 4;
+
+	if( (tc_block = (tc_class_t *) malloc( sizeof( *tc_block ) * MAX_TCS )) == NULL ) {
+		errno = ENOMEM;
+		return -1;
+	}
+	memset( tc_block, 0, sizeof( *tc_block ) * MAX_TCS );
+	pf->tcs[0] = tc_block;									// dont chance that pri == 0 is always there; this ensures us a ptr to free
+
+	for( i = 0; jw_val_ele( val, i, &ele ); i++ ) {
+		memset( &tcd, 0, sizeof( tcd ) );
+		tcd.tc.max_bw = NOT_SET;							// sentinels so that bounds are applied only to given values
+		tcd.tc.min_bw = NOT_SET;
+
+		switch( jw_val_decode( &ele, tc_schema, sizeof( tc_schema ) / sizeof( jw_field_t ), &tcd, NULL ) ) {
+			case -1:
+				SFREE( tcd.tc.hr_name );
+				return -1;
+
+			case 0:
+				bleat_printf( 1, "WRN: tclasses element %d is not an object; ignored", i );
+				continue;
+		}
+
+		if( tcd.pri < 0 || tcd.pri >= MAX_TCS ) {					// don't allow priority out of range
+			SFREE( tcd.tc.hr_name );
+			continue;
+		}
+
+		if( tcd.pri > 3 ) {
+			pf->ntcs = 8;
+		}
+
+		if( tcd.tc.hr_name == NULL ) {
+			snprintf( wbuf, sizeof( wbuf ), "TC-%d", tcd.pri );
+			tcd.tc.hr_name = strdup( wbuf );
+		}
+		tcd.tc.max_bw = tcd.tc.max_bw == NOT_SET ? 100 : IBOUND( tcd.tc.max_bw, 1, 100 );
+		tcd.tc.min_bw = tcd.tc.min_bw == NOT_SET ? 1 : IBOUND( tcd.tc.min_bw, 1, 100 );
+
+		SFREE( tc_block[tcd.pri].hr_name );						// duplicate priority; last one wins
+		tc_block[tcd.pri] = tcd.tc;
+		pf->tcs[tcd.pri] = tc_block + tcd.pri;						// use priority as index into the block allocated
+	}
+
+	return 1;
+}
+
+/*
+	Optional list of xstat name prefixes to export for the PF.
+*/
+static int dec_xstats( void* target, jw_val_t* val, void* data ) {
+	pfdef_t*	pf;
+	jw_val_t	ele;
+	char*		stuff;
+	int			i;
+
+	pf = (pfdef_t *) target;
+	if( val->type != JW_ARRAY ) {
+		return 0;
+	}
+	if( val->len <= 0 ) {
+		return 1;
+	}
+
+	free_xstats( pf );										// given twice; last one wins
+
+	if( (pf->xstats = (char **) malloc( sizeof( char* ) * val->len )) == NULL ) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for( i = 0; jw_val_ele( val, i, &ele ); i++ ) {
+		if( ele.type == JW_STRING && (stuff = ltrim( ele.str )) != NULL ) {
+			pf->xstats[pf->nxstats++] = stuff;
+		}
+	}
+
+	return 1;
+}
+
+/*
+	One bandwidth group (bwg0 - bwg7): an array of the priorities of the
+	traffic classes in the group.
+*/
+static int dec_bwg( void* target, jw_val_t* val, void* data ) {
+	bw_grp_t*	bwg;
+	jw_val_t	ele;
+	int			i;
+
+	if( val->type != JW_ARRAY ) {
+		return 0;
+	}
+
+	bwg = &((pfdef_t *) target)->bw_grps[atoi( val->name + 3 )];			// name is bwgn, schema ensures n is in range
+	bwg->ntcs = 0;
+	for( i = 0; i < MAX_TCS && jw_val_ele( val, i, &ele ); i++ ) {
+		bwg->tcs[bwg->ntcs++] = ele.type == JW_VALUE || ele.type == JW_BOOL ? (int) ele.num : 0;
+	}
+
+	return 1;
+}
+
+static const jw_field_t bwg_schema[] = {
+	{ "bwg0",	JWD_FUNC,	0, 0, dec_bwg },
+	{ "bwg1",	JWD_FUNC,	0, 0, dec_bwg },
+	{ "bwg2",	JWD_FUNC,	0, 0, dec_bwg },
+	{ "bwg3",	JWD_FUNC,	0, 0, dec_bwg },
+	{ "bwg4",	JWD_FUNC,	0, 0, dec_bwg },
+	{ "bwg5",	JWD_FUNC,	0, 0, dec_bwg },
+	{ "bwg6",	JWD_FUNC,	0, 0, dec_bwg },
+	{ "bwg7",	JWD_FUNC,	0, 0, dec_bwg },
+};
+
+static int dec_bw_grps( void* target, jw_val_t* val, void* data ) {
+	if( val->type != JW_OBJECT ) {
+		return 0;
+	}
+
+	return jw_val_decode( val, bwg_schema, sizeof( bwg_schema ) / sizeof( jw_field_t ), target, data ) < 0 ? -1 : 1;
+}
+
+static const jw_field_t pciid_schema[] = {
+	{ "id",						JWD_STR,	offsetof( pfdef_t, id ), 0, NULL },
+	{ "mtu",					JWD_INT,	offsetof( pfdef_t, mtu ), 0, NULL },
+	{ "hw_strip_crc",			JWD_BOOL,	offsetof( pfdef_t, hw_strip_crc ), 0, NULL },
+	{ "promiscuous",			JWD_FLAG,	offsetof( pfdef_t, flags ), PFF_PROMISC, NULL },
+	{ "enable_loopback",		JWD_FLAG,	offsetof( pfdef_t, flags ), PFF_LOOP_BACK, NULL },
+	{ "vf_oversubscription",	JWD_FLAG,	offsetof( pfdef_t, flags ), PFF_VF_OVERSUB, NULL },
+	{ "tclasses",				JWD_FUNC,	0, 0, dec_tclasses },
+	{ "xstats",					JWD_FUNC,	0, 0, dec_xstats },
+	{ "bw_grps",				JWD_FUNC,	0, 0, dec_bw_grps },
+	{ "pf_driver",				JWD_IGNORE, 0, 0, NULL },			// used by vfd_pre_start
+	{ "vf_driver",				JWD_IGNORE, 0, 0, NULL },
+};
+
+/*
+	The list of pciids; each is either a string (just the id) or an object. The
+	mtu is left unset if not given as the default mtu might be later in the file.
+*/
+static int dec_pciids( void* target, jw_val_t* val, void* data ) {
+	parms_t*	parms;
+	pfdef_t*	pf;
+	jw_val_t	ele;
+	int			i;
+
+	parms = (parms_t *) target;
+	if( val->type != JW_ARRAY ) {
+		return 0;
+	}
+
+	if( parms->pciids != NULL ) {							// given twice; last one wins
+		for( i = 0; i < parms->npciids; i++ ) {
+			SFREE( parms->pciids[i].id );
+			free_tcs( &parms->pciids[i] );
+			free_xstats( &parms->pciids[i] );
+		}
+		SFREE( parms->pciids );
+		parms->pciids = NULL;
+		parms->npciids = 0;
+	}
+	if( val->len <= 0 ) {
+		return 1;
+	}
+
+	if( (parms->pciids = (pfdef_t *) malloc( sizeof( *parms->pciids ) * val->len )) == NULL ) {
+		errno = ENOMEM;
+		return -1;
+	}
+	memset( parms->pciids, 0, sizeof( *parms->pciids ) * val->len );
+
+	for( i = 0; jw_val_ele( val, i, &ele ); i++ ) {
+		pf = &parms->pciids[parms->npciids++];				// count as we go so that free_parms() gets what we've added
+		pf->mtu = NOT_SET;
+
+		switch( ele.type ) {
+			case JW_STRING:									// string, use default mtu
+				pf->id = ltrim( ele.str );
+				pf->flags |= PFF_PROMISC;					// this defaults to on to be consistent with original version
+				break;
+
+			case JW_OBJECT:									// full pciid object -- take values from it
+				pf->hw_strip_crc = 1;						// strip on by default
+				pf->ntcs = 4;								// default to 4 and we will up to 8 if we see pri > 3
+				if( jw_val_decode( &ele, pciid_schema, sizeof( pciid_schema ) / sizeof( jw_field_t ), pf, data ) < 0 ) {
+					return -1;
+				}
+				if( pf->id == NULL ) {
+					pf->id = strdup( "missing-id" );
+				}
+				break;
+
+			default:
+				bleat_printf( 1, "WRN: pciids element %d is not a string or object; ignored", i );
+				parms->npciids--;
+				break;
+		}
+	}
+
+	return 1;
+}
+
+static const jw_field_t parm_schema[] = {
+	{ "dpdk_log_level",			JWD_INT,	offsetof( parms_t, dpdk_log_level ), 0, NULL },
+	{ "dpdk_init_log_level",	JWD_INT,	offsetof( parms_t, dpdk_init_log_level ), 0, NULL },
+	{ "log_level",				JWD_INT,	offsetof( parms_t, log_level ), 0, NULL },
+	{ "init_log_level",			JWD_INT,	offsetof( parms_t, init_log_level ), 0, NULL },
+	{ "log_keep",				JWD_INT,	offsetof( parms_t, log_keep ), 0, NULL },
+	{ "log_dedup",				JWD_INT,	offsetof( parms_t, log_dedup ), 0, NULL },
+	{ "log_rate_max",			JWD_INT,	offsetof( parms_t, log_rate_max ), 0, NULL },
+	{ "delete_keep",			JWD_BOOL,	offsetof( parms_t, delete_keep ), 0, NULL },
+	{ "cpu_alarm",				JWD_FUNC,	0, 0, dec_cpu_alarm },
+	{ "cpu_alarm_type",			JWD_STR,	offsetof( parms_t, cpu_alrm_type ), 0, NULL },
+	{ "enable_qos",				JWD_FLAG,	offsetof( parms_t, rflags ), RF_ENABLE_QOS, NULL },
+	{ "huge_pages",				JWD_NFLAG,	offsetof( parms_t, rflags ), RF_NO_HUGE, NULL },		// on by default; flag is to disable
+	{ "async_log",				JWD_FLAG,	offsetof( parms_t, rflags ), RF_ASYNC_LOG, NULL },
+	{ "log_compress",			JWD_FLAG,	offsetof( parms_t, rflags ), RF_LOG_COMPRESS, NULL },
+	{ "warm_restart",			JWD_FLAG,	offsetof( parms_t, rflags ), RF_WARM_RESTART, NULL },		// off by default; the config directory is the source of truth
+	{ "reattach",				JWD_FLAG,	offsetof( parms_t, rflags ), RF_REATTACH, NULL },
+	{ "config_watch",			JWD_FLAG,	offsetof( parms_t, rflags ), RF_WATCH_CFG, NULL },
+	{ "pf_workers",				JWD_FLAG,	offsetof( parms_t, rflags ), RF_PF_WORKERS, NULL },
+	{ "pf_pin",					JWD_FLAG,	offsetof( parms_t, rflags ), RF_PF_PIN, NULL },
+	{ "enable_flowcontrol",		JWD_FLAG,	offsetof( parms_t, rflags ), RF_ENABLE_FC, NULL },
+	{ "default_mtu",			JWD_FUNC,	0, 0, dec_mtu },
+	{ "mtu",					JWD_FUNC,	0, 0, dec_mtu },			// deprecated
+	{ "config_dir",				JWD_STR,	offsetof( parms_t, config_dir ), 0, NULL },
+	{ "pid_fname",				JWD_STR,	offsetof( parms_t, pid_fname ), 0, NULL },
+	{ "stats_path",				JWD_STR,	offsetof( parms_t, stats_path ), 0, NULL },
+	{ "stats_interval",			JWD_INT,	offsetof( parms_t, stats_interval ), 0, NULL },
+	{ "stats_format",			JWD_FUNC,	0, 0, dec_stats_fmt },
+	{ "snap_path",				JWD_STR,	offsetof( parms_t, snap_path ), 0, NULL },
+	{ "fifo",					JWD_STR,	offsetof( parms_t, fifo_path ), 0, NULL },
+	{ "socket",					JWD_STR,	offsetof( parms_t, sock_path ), 0, NULL },
+	{ "req_workers",			JWD_INT,	offsetof( parms_t, req_workers ), 0, NULL },
+	{ "log_dir",				JWD_STR,	offsetof( parms_t, log_dir ), 0, NULL },
+	{ "cpu_mask",				JWD_STR,	offsetof( parms_t, cpu_mask ), 0, NULL },
+	{ "numa_mem",				JWD_FUNC,	0, 0, dec_numa_mem },
+	{ "pciids",					JWD_FUNC,	0, 0, dec_pciids },
+};
+
 /*
 	Open the file, and read the json there returning a populated structure from
 	the json bits we expect to find.
@@ -155,254 +563,90 @@ static char* file_into_buf( char* fname, uid_t* uid ) {
 */
 extern parms_t* read_parms( char* fname ) {
 	parms_t*	parms = NULL;
-	void*		jblob;			// parsed json
-	void*		pobj;			// parsed sub object
+	parm_dctx_t	pctx;			// things decoded which aren't kept in parms
 	char*		buf;			// buffer read from file (nil terminated)
-	char*		stuff;
-	char		sm_wrk[128];	// small work buffer
-	int			i, j, k;
 	int			def_mtu;		// default mtu (pulled and used to set pciid struct, but not kept in parms
-	tc_class_t* tc_class_ptr;	// ponter to heap location
-	int		 priority;	   // hold priority read from tclasses object
-	void*	   tcobj;
-	void*	   bwgrpobj;
+	int			i;
 
 	if( (buf = file_into_buf( fname, NULL )) == NULL ) {
 		return NULL;
 	}
 
-	if( *buf == 0 ) {											// empty/missing file
+	if( (parms = (parms_t *) malloc( sizeof( *parms ) )) == NULL ) {
 		free( buf );
-		buf = strdup( "{ \"empty\": true }" );					// dummy json to parse which will cause all defaults to be set
+		errno = ENOMEM;
+		return NULL;
 	}
-
-	if( (jblob = jw_new( buf )) != NULL ) {						// json successfully parsed
-		if( (parms = (parms_t *) malloc( sizeof( *parms ) )) == NULL ) {
-			errno = ENOMEM;
+	memset( parms, 0, sizeof( *parms ) );					// probably not needed, but we don't do this frequently enough to worry
+	memset( &pctx, 0, sizeof( pctx ) );
+
+	parms->init_log_level = 1;								// defaults for things which aren't 0/nil
+	parms->log_keep = 30;
+	parms->cpu_alrm_thresh = 0.10;							// default to 10%
+	parms->stats_fmt = SF_JSON;
+	parms->req_workers = 2;
+
+	if( *buf != 0 ) {										// empty/missing file results in all defaults
+		if( jw_decode( buf, parm_schema, sizeof( parm_schema ) / sizeof( jw_field_t ), parms, &pctx, fname ) < 0 ) {
+			fprintf( stderr, "internal mishap parsing json blob\n" );
+			free( buf );
+			free_parms( parms );
 			return NULL;
 		}
-		memset( parms, 0, sizeof( *parms ) );					// probably not needed, but we don't do this frequently enough to worry
-
-		parms->dpdk_log_level = !jw_is_value( jblob, "dpdk_log_level" ) ? 0 : (int) jw_value( jblob, "dpdk_log_level" );
-		parms->dpdk_init_log_level = !jw_is_value( jblob, "dpdk_init_log_level" ) ? 0 : (int) jw_value( jblob, "dpdk_init_log_level" );
-		parms->log_level = !jw_is_value( jblob, "log_level" ) ? 0 : (int) jw_value( jblob, "log_level" );
-		parms->init_log_level = !jw_is_value( jblob, "init_log_level" ) ? 1 : (int) jw_value( jblob, "init_log_level" );
-		parms->log_keep = !jw_is_value( jblob, "log_keep" ) ? 30 : (int) jw_value( jblob, "log_keep" );
-		parms->delete_keep = !jw_is_bool( jblob, "delete_keep" ) ? 0 : (int) jw_value( jblob, "delete_keep" );
-
-		parms->cpu_alrm_thresh = 0.10;										// default to 10%
-		if( jw_is_value( jblob, "cpu_alarm" ) ) {							// we allow real float value e.g. 1.05 == 105%, or string
-			parms->cpu_alrm_thresh = (double) jw_value( jblob, "cpu_alarm" );
-		} else {
-			if( (stuff = jw_string( jblob, "cpu_alarm" )) != NULL ) {		// assume something like "30%" or just "30"
-				k = atoi( stuff );
-				parms->cpu_alrm_thresh = (double) k / 100.0;
-			}
-		}
-		if( parms->cpu_alrm_thresh < 0.05 ) {
-			parms->cpu_alrm_thresh = .05;				// enforce some level of sanity
-		}
-
-		if( (stuff = jw_string( jblob, "cpu_alarm_type" )) != NULL ) {		// default to "WRN:" but allow them to change to CRI or something else
-			parms->cpu_alrm_type = strdup( stuff );
-		} else {
-			parms->cpu_alrm_type = strdup( "WRN:" );
-		}
-			
-		
-		if( jw_is_bool( jblob, "enable_qos" ) ) {
-			if( jw_value( jblob, "enable_qos" ) ) {
-				parms->rflags |= RF_ENABLE_QOS;
-			}
-		}
-
-		if( jw_is_bool( jblob, "huge_pages" ) ) {				// we enable huge pages by default, flag in parms is to disable (no_huge) set when this is false
-			if( ! jw_value( jblob, "huge_pages" ) ) {
-				parms->rflags |= RF_NO_HUGE;
-			}
-		}
-
-		if( jw_is_bool( jblob, "enable_flowcontrol" ) ) {
-			if( jw_value( jblob, "enable_flowcontrol" ) ) {
-				parms->rflags |= RF_ENABLE_FC;
-			}
-		}
-
-		if( jw_missing( jblob, "default_mtu" ) ) {			// could be an old install using deprecated mtu, so look for that and default if neither is there
-			def_mtu = jw_missing( jblob, "mtu" ) ? 9420 : (int) jw_value( jblob, "mtu" );
-		} else {
- 		 	def_mtu = (int) jw_value( jblob, "default_mtu" );
-		}
-
-		if(  (stuff = jw_string( jblob, "config_dir" )) ) {
-			parms->config_dir = ltrim( stuff );
-		} else {
-			parms->config_dir = strdup( "/var/lib/vfd/config" );
-		}
+	}
+	free( buf );
 
-		if(  (stuff = jw_string( jblob, "pid_fname" )) ) {
-			parms->pid_fname = ltrim( stuff );
-		} else {
-			parms->pid_fname = strdup( "/var/run/vfd.pid" );
-		}
+	if( parms->cpu_alrm_thresh < 0.05 ) {
+		parms->cpu_alrm_thresh = .05;				// enforce some level of sanity
+	}
+	if( parms->req_workers < 0 ) {
+		parms->req_workers = 0;
+	}
+	if( parms->stats_interval < 0 ) {
+		parms->stats_interval = 0;
+	}
 
-		if(  (stuff = jw_string( jblob, "stats_path" )) ) {
-			parms->stats_path = ltrim( stuff );
-		} else {
-			parms->stats_path = strdup( "/var/lib/vfd/stats" );
-		}
+	if( parms->cpu_alrm_type == NULL ) {		// default to "WRN:" but allow them to change to CRI or something else
+		parms->cpu_alrm_type = strdup( "WRN:" );
+	}
+	if( parms->config_dir == NULL ) {
+		parms->config_dir = strdup( "/var/lib/vfd/config" );
+	}
+	if( parms->pid_fname == NULL ) {
+		parms->pid_fname = strdup( "/var/run/vfd.pid" );
+	}
+	if( parms->stats_path == NULL ) {
+		parms->stats_path = strdup( "/var/lib/vfd/stats" );
+	}
+	if( parms->snap_path == NULL ) {
+		parms->snap_path = strdup( "/var/lib/vfd/running.snap" );
+	}
+	if( parms->fifo_path == NULL ) {
+		parms->fifo_path = strdup( "/var/lib/vfd/request" );
+	}
+	if( parms->log_dir == NULL ) {
+		parms->log_dir = strdup( "/var/log/vfd" );
+	}
+	if( parms->numa_mem == NULL ) {
+		parms->numa_mem = strdup( "64,64" );
+	}
 
-		if(  (stuff = jw_string( jblob, "fifo" )) ) {
-			parms->fifo_path = ltrim( stuff );
-		} else {
-			parms->fifo_path = strdup( "/var/lib/vfd/request" );
-		}
+	if( pctx.have_def_mtu ) {						// could be an old install using deprecated mtu, so look for that and default if neither is there
+		def_mtu = pctx.def_mtu;
+	} else {
+		def_mtu = pctx.have_old_mtu ? pctx.old_mtu : 9420;
+	}
 
-		if(  (stuff = jw_string( jblob, "log_dir" )) ) {
-			parms->log_dir = ltrim( stuff );
-		} else {
-			parms->log_dir = strdup( "/var/log/vfd" );
+	for( i = 0; i < parms->npciids; i++ ) {
+		if( parms->pciids[i].mtu == NOT_SET ) {
+			parms->pciids[i].mtu = def_mtu;
 		}
 
-		if( (stuff = jw_string( jblob, "cpu_mask" )) ) {
-			parms->cpu_mask = ltrim( stuff );
+		if(  parms->pciids[i].mtu > 9420 ) {
+			 parms->pciids[i].mtu = 9420;		// niantic has issues with packets > 9.5K when loopback is enabled, so cap here
 		}
-		
-		parms->numa_mem = jwx_get_value_as_str( jblob, "numa_mem", "64,64", JWFMT_INT );
-
-		if( (parms->npciids = jw_array_len( jblob, "pciids" )) > 0 ) {			// pick up the list of pciids
-			if( (parms->pciids = (pfdef_t *) malloc( sizeof( *parms->pciids ) * parms->npciids )) == NULL ) {
-				errno = ENOMEM;
-				jw_nuke( jblob );
-				free_parms( parms );
-				return NULL;
-			}
-			memset( parms->pciids, 0, sizeof( *parms->pciids ) * parms->npciids );
-
-			if( parms->pciids != NULL ) {
-				for( i = 0; i < parms->npciids; i++ ) {
-					stuff = (char *) jw_string_ele( jblob, "pciids", i );
-					if( stuff != NULL ) {										// string, use default mtu
-						parms->pciids[i].id = ltrim( stuff );
-						parms->pciids[i].mtu = def_mtu;
-						parms->pciids[i].flags &= ~PFF_LOOP_BACK;
-						parms->pciids[i].flags |= PFF_PROMISC;					// this defaults to on to be consistent with original version
-					} else {
-						if( (pobj = jw_obj_ele( jblob, "pciids", i )) != NULL ) {		// full pciid object -- take values from it
-							int jntcs;				// number of tc objects in the json
-
-							if( (stuff = jw_string( pobj, "id" )) == NULL ) {
-								snprintf( sm_wrk, sizeof( sm_wrk ),  "missing-id" );
-								stuff = sm_wrk;
-							}
-							parms->pciids[i].id = ltrim( stuff );
-
-							parms->pciids[i].mtu = !jw_is_value( pobj, "mtu" ) ? def_mtu : (int) jw_value( pobj, "mtu" );
-							parms->pciids[i].hw_strip_crc = jwx_get_bool( pobj, "hw_strip_crc", 1 );		// strip on by default
-							if( jwx_get_bool( pobj, "promiscuous", 0 ) ) {									// set promisc; default is off
-								parms->pciids[i].flags |= PFF_PROMISC;
-							} else {
-								parms->pciids[i].flags &= ~PFF_PROMISC;
-							}
-
-							if( !jw_is_bool( pobj, "enable_loopback" ) ? 0 : (int) jw_value( pobj, "enable_loopback" ) ) {		
-								parms->pciids[i].flags |= PFF_LOOP_BACK; 			// default to false if not there
-							} else {
-								parms->pciids[i].flags &= ~PFF_LOOP_BACK;			// disable if set to false
-							}
-							if( !jw_is_bool( pobj, "vf_oversubscription" ) ? 0 : (int) jw_value( pobj,  "vf_oversubscription" ) ) {	
-								parms->pciids[i].flags |= PFF_VF_OVERSUB; 			// default to false if not there
-							} else {
-								parms->pciids[i].flags &= ~PFF_VF_OVERSUB;		  // disable if set to false
-							}
-							
-							parms->pciids[i].ntcs = 4;							// default to 4 and we will up to 8 if we see pri > 3
-							if( (jntcs = jw_array_len( pobj, "tclasses" )) > 0 ) {					  				// number of tcs supplied in the json
-								//fprintf( stderr, "parsing tclasses = %d\n", parms->pciids[i].ntcs);  // **Debugging purpose only
-								if( (tc_class_ptr = (tc_class_t*) malloc (sizeof(tc_class_t) * MAX_TCS)) == NULL ) {	// allways allocate a full set
-									errno = ENOMEM;
-									jw_nuke( jblob );
-									free_parms( parms );
-									return NULL;
-								}
-								memset( tc_class_ptr, 0, sizeof(tc_class_t) * MAX_TCS );
-								parms->pciids[i].tcs[0] = tc_class_ptr;			// dont chance that pri == 0 is always there; this ensures us a ptr to free
-
-								for( j = 0; j < jntcs; j++ ) {
-									if( (tcobj = jw_obj_ele( pobj, "tclasses", j )) != NULL ) {					// pull out the next element
-										priority = (int) jw_value( tcobj, "pri" );
-										if( priority < 0 || priority >= MAX_TCS ) {								// don't allow priority out of range
-											continue;
-										}
-
-										if( priority > 3 ) {
-											parms->pciids[i].ntcs = 8;
-										}
-
-										parms->pciids[i].tcs[priority] = tc_class_ptr + priority;			// use priority as index into the block allocated
-
-										if( (stuff = jw_string( tcobj, "name" )) == NULL ) {
-											snprintf( sm_wrk, sizeof( sm_wrk ), "TC-%d", priority );
-											stuff = sm_wrk;
-										} 
-										parms->pciids[i].tcs[priority]->hr_name = ltrim( stuff );
-
-										if( !jw_is_bool( tcobj, "llatency" ) ? 0 : (int) jw_value( tcobj, "llatency" ) ) {
-											parms->pciids[i].tcs[priority]->flags |= TCF_LOW_LATENCY;
-										} else {
-											parms->pciids[i].tcs[priority]->flags &= ~TCF_LOW_LATENCY;
-										}
-										if( !jw_is_bool( tcobj, "lsp" ) ? 0 : (int) jw_value( tcobj, "lsp" ) ) {
-											parms->pciids[i].tcs[priority]->flags |= TCF_LNK_STRICTP;
-										} else {
-											parms->pciids[i].tcs[priority]->flags &= ~TCF_LNK_STRICTP;
-										}
-										if( !jw_is_bool( tcobj, "bsp" ) ? 0 : (int) jw_value( tcobj, "bsp" ) ) {
-											parms->pciids[i].tcs[priority]->flags |= TCF_BW_STRICTP;
-										} else {
-											parms->pciids[i].tcs[priority]->flags &= ~TCF_BW_STRICTP;
-										}
-										parms->pciids[i].tcs[priority]->max_bw = !jw_is_value( tcobj, "max_bw" ) ? 100 : IBOUND( (int)jw_value( tcobj, "max_bw" ), 1, 100 );
-										parms->pciids[i].tcs[priority]->min_bw = !jw_is_value( tcobj, "min_bw" ) ? 1 : IBOUND( (int)jw_value( tcobj, "min_bw" ), 1, 100 );
-									} else {
-										fprintf( stderr, "internal mishap parsing tclasses from config file j=%d expected=%d\n", j, parms->pciids[i].ntcs );
-										jw_nuke( jblob );
-										free_parms( parms );
-										return NULL;
-									}
-								}
-
-							}
-							if (( bwgrpobj = jw_blob( pobj, "bw_grps" )) != NULL) {
-								for ( j = 0; j < sizeof(parms->pciids[i].bw_grps)/sizeof(bw_grp_t); j++ ) {
-									sprintf(stuff, "bwg%d", j);
-									if( jw_exists(bwgrpobj, stuff) && (parms->pciids[i].bw_grps[j].ntcs  = jw_array_len( bwgrpobj, stuff )) > 0 ) {
-										for( k = 0; k < parms->pciids[i].bw_grps[j].ntcs; k++ ) {
-											parms->pciids[i].bw_grps[j].tcs[k] = (int) jw_value_ele( bwgrpobj, stuff, k );
-										}
-									}
-								}
-							}
-						}
-					}
-
-					if(  parms->pciids[i].mtu > 9420 ) {
-						 parms->pciids[i].mtu = 9420;		// niantic has issues with packets > 9.5K when loopback is enabled, so cap here
-					}
-				}
-			} else {
-				parms->npciids = 0;			// memory failure; return zip
-			}
-		} else {
-			parms->npciids = 0;				// could be set to neg value as a return length; ensure 0 if missing or none
-		}
-
-		jw_nuke( jblob );
-	} else {
-		fprintf( stderr, "internal mishap parsing json blob\n" );
 	}
 
-	free( buf );
 	return parms;
 }
 
@@ -417,16 +661,22 @@ extern void free_parms( parms_t* parms ) {
 	}
 
 	for( i = 0; i < parms->npciids; i++ ) {
-		SFREE( parms->pciids[i].tcs[0] );			// all of the blocks are allocated in one hunk
+		SFREE( parms->pciids[i].id );
+		free_tcs( &parms->pciids[i] );
+		free_xstats( &parms->pciids[i] );
 	}
 
 	SFREE( parms->log_dir );
 	SFREE( parms->fifo_path );
+	SFREE( parms->sock_path );
 	SFREE( parms->config_dir );
 	SFREE( parms->pciids );
 	SFREE( parms->pid_fname );
 	SFREE( parms->stats_path );
+	SFREE( parms->snap_path );
 	SFREE( parms->numa_mem );
+	SFREE( parms->cpu_alrm_type );
+	SFREE( parms->cpu_mask );
 
 	free( parms );
 }
@@ -434,188 +684,283 @@ extern void free_parms( parms_t* parms ) {
 
 // --------------------------- vf config --------------------------------------------------------------
 /*
-	Open and read a VF config file returning a struct with the information populated
-	and defaults in places where the information was omitted.
+	Things decoded from a vf config that are applied once the whole file has been seen.
 */
-extern vf_config_t*	read_config( char* fname ) {
-	vf_config_t*	vfc = NULL;
-	void*		jblob;			// parsed json
-	void*		mirror;			// mirror blob in the tree
-	char*		buf;			// buffer read from file (nil terminated)
-	char*		stuff;
-	int			val;
-	int			i;
-	uid_t		uid;
-	int			jnqueues;		// number of queue definitions in the json
-	void*		qobj;			// pointer to the queue object in the json
+typedef struct {
+	char*	mac;				// single mac; used only if the macs array is missing or empty
+} cfg_dctx_t;
+
+typedef struct {
+	int		pri;
+	char*	share;
+} queue_dec_t;
+
+typedef struct {
+	int		target;
+	char*	direction;
+} mirror_dec_t;
+
+static int dec_vlans( void* target, jw_val_t* val, void* data ) {
+	vf_config_t*	vfc;
+	jw_val_t		ele;
+	int				i;
+
+	vfc = (vf_config_t *) target;
+	if( val->type != JW_ARRAY ) {
+		return 0;
+	}
 
-	if( (buf = file_into_buf( fname, &uid )) == NULL ) {
-		return NULL;
+	SFREE( vfc->vlans );								// given twice; last one wins
+	vfc->vlans = NULL;
+	vfc->nvlans = 0;
+	if( val->len <= 0 ) {
+		return 1;
 	}
 
-	if( *buf == 0 ) {											// empty/missing file, an error in this situation because not everything has a default
-		free( buf );
-		return NULL;
+	if( (vfc->vlans = (int *) malloc( sizeof( *vfc->vlans ) * val->len )) == NULL ) {
+		errno = ENOMEM;
+		return -1;
 	}
 
-	if( (jblob = jw_new( buf )) != NULL ) {						// json successfully parsed
-		if( (vfc = (vf_config_t *) malloc( sizeof( *vfc ) )) == NULL ) {
-			errno = ENOMEM;
-			return NULL;
-		}
+	for( i = 0; jw_val_ele( val, i, &ele ); i++ ) {
+		vfc->vlans[i] = ele.type == JW_VALUE ? (int) ele.num : -1;			// vfd should toss out a -1
+	}
+	vfc->nvlans = i;
 
-		memset( vfc, 0, sizeof( *vfc ) );						// pointers default to nil
+	return 1;
+}
+
+static int dec_macs( void* target, jw_val_t* val, void* data ) {
+	vf_config_t*	vfc;
+	jw_val_t		ele;
+	int				i;
 
+	vfc = (vf_config_t *) target;
+	if( val->type != JW_ARRAY ) {
+		return 0;
+	}
 
-		vfc->owner = uid;
-		vfc->antispoof_mac = 1;				
-		vfc->antispoof_vlan = 1;	// these are forced to 1 regardless of what was in json
+	for( i = 0; i < vfc->nmacs; i++ ) {					// given twice; last one wins
+		SFREE( vfc->macs[i] );
+	}
+	SFREE( vfc->macs );
+	vfc->macs = NULL;
+	vfc->nmacs = 0;
+	if( val->len <= 0 ) {
+		return 1;
+	}
 
-		vfc->antispoof_mac = jw_missing( jblob, "mac_anti_spoof" ) ? 0 : (int) jw_value( jblob, "mac_anti_spoof" );
-		vfc->antispoof_vlan = jw_missing( jblob, "vlan_anti_spoof" ) ? 0 : (int) jw_value( jblob, "vlan_anti_spoof" );
+	if( (vfc->macs = (char **) malloc( sizeof( *vfc->macs ) * val->len )) == NULL ) {
+		errno = ENOMEM;
+		return -1;
+	}
 
-		vfc->allow_untagged = !jw_is_bool( jblob, "allow_untagged" ) ? 0 : (int) jw_value( jblob, "allow_untagged" );
+	for( i = 0; jw_val_ele( val, i, &ele ); i++ ) {
+		vfc->macs[i] = ele.type == JW_STRING ? ltrim( ele.str ) : NULL;
+	}
+	vfc->nmacs = i;
 
-		vfc->strip_stag = !jw_is_bool( jblob, "strip_stag" ) ? 0 : (int) jw_value( jblob, "strip_stag" );
-		vfc->strip_ctag = !jw_is_bool( jblob, "strip_ctag" ) ? 0 : (int) jw_value( jblob, "strip_ctag" );
-		vfc->allow_bcast = !jw_is_bool( jblob, "allow_bcast" ) ? 1 : (int) jw_value( jblob, "allow_bcast" );
-		vfc->allow_mcast = !jw_is_bool( jblob, "allow_mcast" ) ? 1 : (int) jw_value( jblob, "allow_mcast" );
-		vfc->allow_un_ucast = !jw_is_bool( jblob, "allow_un_ucast" ) ? 0 : (int) jw_value( jblob, "allow_un_ucast" );
-		vfc->vfid = !jw_is_value( jblob, "vfid" ) ? -1 : (int) jw_value( jblob, "vfid" );			// there is no real default value, so set to invalid
+	return 1;
+}
 
-		vfc->rate = jw_missing( jblob, "rate" ) ? 0 : (float) jw_value( jblob, "rate" );
-		vfc->min_rate = jw_missing( jblob, "min_rate" ) ? 0 : (float) jw_value( jblob, "min_rate" );
+/*
+	The single mac ("mac": "addr") is held until the end as the macs array,
+	if it is present, takes precedence.
+*/
+static int dec_mac( void* target, jw_val_t* val, void* data ) {
+	cfg_dctx_t*	cctx;
 
-		if(  (stuff = jw_string( jblob, "name" )) ) {
-			vfc->name = strdup( stuff );
-		} else {
-			vfc->name = strdup( "unnamed" );
-		}
+	cctx = (cfg_dctx_t *) data;
+	if( val->type != JW_STRING ) {
+		return 0;
+	}
 
-		if(  (stuff = jw_string( jblob, "pciid" )) ) {
-			vfc->pciid = ltrim( stuff );
-		}
+	SFREE( cctx->mac );
+	cctx->mac = ltrim( val->str );
+	return 1;
+}
 
-		if(  (stuff = jw_string( jblob, "stop_cb" )) ) {					// command that is executed on owner's behalf as we shutdown
-			vfc->stop_cb = ltrim( stuff );
-		}
-		if(  (stuff = jw_string( jblob, "start_cb" )) ) {					// command that is executed on owner's behalf as we start (last part of init)
-			vfc->start_cb = ltrim( stuff );
-		}
+static const jw_field_t queue_schema[] = {
+	{ "priority",	JWD_NUM,	offsetof( queue_dec_t, pri ), 0, NULL },
+	{ "share",		JWD_STR,	offsetof( queue_dec_t, share ), 0, NULL },
+};
+
+static int dec_queues( void* target, jw_val_t* val, void* data ) {
+	vf_config_t*	vfc;
+	queue_dec_t		qd;
+	jw_val_t		ele;
+	int				share;
+	int				i;
+
+	vfc = (vf_config_t *) target;
+	if( val->type != JW_ARRAY ) {
+		return 0;
+	}
 
-		if(  (stuff = jw_string( jblob, "link_status" )) ) {
-			vfc->link_status = ltrim( stuff );
-		} else {
-			vfc->link_status = strdup( "auto" );
+	for( i = 0; jw_val_ele( val, i, &ele ); i++ ) {
+		qd.pri = -1;
+		qd.share = NULL;
+		if( jw_val_decode( &ele, queue_schema, sizeof( queue_schema ) / sizeof( jw_field_t ), &qd, NULL ) < 0 ) {
+			SFREE( qd.share );
+			return -1;
 		}
 
-		if(  (stuff = jw_string( jblob, "vm_mac" )) ) {
-			vfc->vm_mac = ltrim( stuff );
-		}
-	
-		if( (vfc->nvlans = jw_array_len( jblob, "vlans" )) > 0 ) {						// pick up values from the json array
-			vfc->vlans = malloc( sizeof( *vfc->vlans ) * vfc->nvlans );
-			if( vfc->vlans != NULL ) {
-				for( i = 0; i < vfc->nvlans; i++ ) {
-					if( jw_is_value_ele( jblob, "vlans", i ) ) {
-						vfc->vlans[i] = (int) jw_value_ele( jblob, "vlans", i );
-					} else {
-						vfc->vlans[i] = -1;												// vfd should toss this out
-					}
-				}
-			} else {
-				// TODO -- how to handle error? free and return nil?
+		if( qd.share != NULL ) {
+			share = atoi( qd.share );
+			if( qd.pri >= 0 && qd.pri < MAX_TCS && share > 0 ) {
+				vfc->qshare[qd.pri] = share;
 			}
-		} else {
-			vfc->nvlans = 0;		// if not set len() might return -1
+			free( qd.share );
 		}
+	}
 
-		if( (vfc->nmacs = jw_array_len( jblob, "macs" )) > 0 ) {						// pick up values from the json array
-			vfc->macs = malloc( sizeof( *vfc->macs ) * vfc->nmacs );
-			if( vfc->macs != NULL ) {
-				for( i = 0; i < vfc->nmacs; i++ ) {
-					if( (stuff = jw_string_ele( jblob, "macs", i )) != NULL ) {
-						vfc->macs[i] = ltrim( stuff );
-					} else {
-						vfc->macs[i] = NULL;
-					}
-				}
-			} else {
-				// TODO -- how to handle error? free and return nil?
-			}
-		} else {
-			if(  (stuff = jw_string( jblob, "mac" )) ) {							// new, going forward, just one MAC
-				vfc->nmacs = 1;
-				vfc->macs = malloc( sizeof( *vfc->macs ) * 1 );						// VFd should always support an array 
-				vfc->macs[0] = ltrim( stuff );
-			} else {
-				vfc->nmacs = 0;		// if not set len() might return -1
-				vfc->macs = NULL;	// take no chances
-			}
-		}
+	return 1;
+}
 
-		// ---- pick up the qos parameters --------------------------
-		for( i = 0; i < MAX_TCS; i++ ) {
-			vfc->qshare[i] = 3;														// small default allowing 32 vfs to share evenly
-		}
-		if( (jnqueues = jw_array_len( jblob, "queues" )) > 0 ) {					// number of tcs supplied in the json
-			int pri;			// values converted from json block
-			int share;
-			char*	val;
-
-			for( i = 0; i < jnqueues; i++ ) {
-				if( (qobj = jw_obj_ele( jblob, "queues", i )) != NULL ) {			// pull out the next element as an object
-					pri = jw_missing( qobj, "priority" ) ? -1 : (int) jw_value( qobj, "priority" );
-					val = jw_string( qobj, "share" );
-					if( val ) {
-						share = atoi( val );
-						if( pri >= 0 && pri < 8 && share > 0 ) {
-							vfc->qshare[pri] = share;
-						}
-					}
+static const jw_field_t mirror_schema[] = {
+	{ "target",		JWD_NUM,	offsetof( mirror_dec_t, target ), 0, NULL },
+	{ "direction",	JWD_STR,	offsetof( mirror_dec_t, direction ), 0, NULL },
+};
+
+static int dec_mirror( void* target, jw_val_t* val, void* data ) {
+	vf_config_t*	vfc;
+	mirror_dec_t	md;
+	char*			direction;
+
+	vfc = (vf_config_t *) target;
+	md.target = -1;
+	md.direction = NULL;
+	switch( jw_val_decode( val, mirror_schema, sizeof( mirror_schema ) / sizeof( jw_field_t ), &md, NULL ) ) {
+		case -1:
+			SFREE( md.direction );
+			return -1;
+
+		case 0:
+			return 0;						// not an object
+	}
+
+	vfc->mirror_dir = MIRROR_OFF;
+	if( (vfc->mirror_target = md.target) >= 0 ) {
+		vfc->mirror_dir = MIRROR_ALL;			// if target given, default is all
+
+		direction = md.direction != NULL ? md.direction : "all";
+		switch( *direction ) {
+			case 'b':					// both or all
+			case 'a':
+				vfc->mirror_dir = MIRROR_ALL;
+				break;
+				
+			case 'o':
+				if( strcmp( direction, "out" ) == 0 ) {
+					vfc->mirror_dir = MIRROR_OUT;
+				} else {
+					vfc->mirror_dir = MIRROR_OFF;
 				}
-			}
+				break;
+				
+			case 'i':
+				vfc->mirror_dir = MIRROR_IN;
+				break;
 		}
-		
-		// ----- pick up mirror info --------------------------------
-		vfc->mirror_dir = MIRROR_OFF;
-		vfc->mirror_target = -1;
-
-		if( (mirror = jw_blob( jblob, "mirror" )) != NULL ) {
-			char *direction;
-
-			if( (vfc->mirror_target = jw_missing( mirror, "target" ) ? -1 : (int) jw_value( mirror, "target" )) >= 0 ) {
-				vfc->mirror_dir = MIRROR_ALL;			// if target given, default is all
-
-				direction = jw_missing( mirror, "direction" ) ? "all" : jw_string( mirror, "direction" );
-
-				switch( *direction ) {
-					case 'b':					// both or all
-					case 'a':
-						vfc->mirror_dir = MIRROR_ALL;
-						break;
-						
-					case 'o':
-						if( strcmp( direction, "out" ) == 0 ) {
-							vfc->mirror_dir = MIRROR_OUT;
-						} else {
-							vfc->mirror_dir = MIRROR_OFF;
-						}
-						break;
-						
-					case 'i':
-						vfc->mirror_dir = MIRROR_IN;
-						break;
-				}
-			}
+	}
+
+	SFREE( md.direction );
+	return 1;
+}
+
+static const jw_field_t vf_schema[] = {
+	{ "name",				JWD_STR,	offsetof( vf_config_t, name ), 0, NULL },
+	{ "pciid",				JWD_STR,	offsetof( vf_config_t, pciid ), 0, NULL },
+	{ "vfid",				JWD_INT,	offsetof( vf_config_t, vfid ), 0, NULL },
+	{ "mac_anti_spoof",		JWD_NUM,	offsetof( vf_config_t, antispoof_mac ), 0, NULL },
+	{ "vlan_anti_spoof",	JWD_NUM,	offsetof( vf_config_t, antispoof_vlan ), 0, NULL },
+	{ "allow_untagged",		JWD_BOOL,	offsetof( vf_config_t, allow_untagged ), 0, NULL },
+	{ "strip_stag",			JWD_BOOL,	offsetof( vf_config_t, strip_stag ), 0, NULL },
+	{ "strip_ctag",			JWD_BOOL,	offsetof( vf_config_t, strip_ctag ), 0, NULL },
+	{ "allow_bcast",		JWD_BOOL,	offsetof( vf_config_t, allow_bcast ), 0, NULL },
+	{ "allow_mcast",		JWD_BOOL,	offsetof( vf_config_t, allow_mcast ), 0, NULL },
+	{ "allow_un_ucast",		JWD_BOOL,	offsetof( vf_config_t, allow_un_ucast ), 0, NULL },
+	{ "rate",				JWD_FLOAT,	offsetof( vf_config_t, rate ), 0, NULL },
+	{ "min_rate",			JWD_FLOAT,	offsetof( vf_config_t, min_rate ), 0, NULL },
+	{ "stop_cb",			JWD_STR,	offsetof( vf_config_t, stop_cb ), 0, NULL },			// command that is executed on owner's behalf as we shutdown
+	{ "start_cb",			JWD_STR,	offsetof( vf_config_t, start_cb ), 0, NULL },		// command that is executed on owner's behalf as we start (last part of init)
+	{ "link_status",		JWD_STR,	offsetof( vf_config_t, link_status ), 0, NULL },
+	{ "vm_mac",				JWD_STR,	offsetof( vf_config_t, vm_mac ), 0, NULL },
+	{ "vlans",				JWD_FUNC,	0, 0, dec_vlans },
+	{ "macs",				JWD_FUNC,	0, 0, dec_macs },
+	{ "mac",				JWD_FUNC,	0, 0, dec_mac },			// new, going forward, just one MAC
+	{ "queues",				JWD_FUNC,	0, 0, dec_queues },
+	{ "mirror",				JWD_FUNC,	0, 0, dec_mirror },
+	{ "comments",			JWD_IGNORE, 0, 0, NULL },
+};
+
+/*
+	Open and read a VF config file returning a struct with the information populated
+	and defaults in places where the information was omitted. The json is decoded
+	directly into the struct (no intermediate hash tables); fields which are not
+	known, or are not the expected type, are reported and ignored.
+*/
+extern vf_config_t*	read_config( char* fname ) {
+	vf_config_t*	vfc = NULL;
+	cfg_dctx_t		cctx;		// things decoded that are applied at the end
+	char*			buf;		// buffer read from file (nil terminated)
+	uid_t			uid;
+	int				i;
+
+	if( (buf = file_into_buf( fname, &uid )) == NULL ) {
+		return NULL;
+	}
+
+	if( *buf == 0 ) {											// empty/missing file, an error in this situation because not everything has a default
+		free( buf );
+		return NULL;
+	}
+
+	if( (vfc = (vf_config_t *) malloc( sizeof( *vfc ) )) == NULL ) {
+		free( buf );
+		errno = ENOMEM;
+		return NULL;
+	}
+	memset( vfc, 0, sizeof( *vfc ) );						// pointers default to nil
+	memset( &cctx, 0, sizeof( cctx ) );
+
+	vfc->owner = uid;
+	vfc->allow_bcast = 1;									// defaults for things which aren't 0/nil
+	vfc->allow_mcast = 1;
+	vfc->vfid = -1;											// there is no real default value, so set to invalid
+	vfc->mirror_dir = MIRROR_OFF;
+	vfc->mirror_target = -1;
+	for( i = 0; i < MAX_TCS; i++ ) {
+		vfc->qshare[i] = 3;									// small default allowing 32 vfs to share evenly
+	}
+
+	if( jw_decode( buf, vf_schema, sizeof( vf_schema ) / sizeof( jw_field_t ), vfc, &cctx, fname ) < 0 ) {
+		if( errno != ENOMEM ) {
+			errno = EINVAL;
 		}
+		free( buf );
+		SFREE( cctx.mac );
+		free_config( vfc );
+		return NULL;
+	}
+	free( buf );
 
-		jw_nuke( jblob );
+	if( vfc->name == NULL ) {
+		vfc->name = strdup( "unnamed" );
+	}
+	if( vfc->link_status == NULL ) {
+		vfc->link_status = strdup( "auto" );
+	}
+
+	if( vfc->nmacs <= 0 && cctx.mac != NULL ) {					// VFd should always support an array 
+		SFREE( vfc->macs );
+		vfc->nmacs = 1;
+		vfc->macs = malloc( sizeof( *vfc->macs ) * 1 );
+		vfc->macs[0] = cctx.mac;
 	} else {
-		errno = EINVAL;	
+		SFREE( cctx.mac );
 	}
 
-	free( buf );
 	return vfc;
 }
 
@@ -635,6 +980,7 @@ extern void free_config( vf_config_t *vfc ) {
 	SFREE( vfc->vlans );
 	SFREE( vfc->start_cb );
 	SFREE( vfc->stop_cb );
+	SFREE( vfc->vm_mac );
 
 	for( i = 0; i < vfc->nmacs; i++ ) {		// drop each referenced string
 		SFREE( vfc->macs[i] );
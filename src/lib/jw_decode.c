@@ -0,0 +1,382 @@
+/*
+	Mnemonic:	jw_decode.c
+	Abstract:	Schema driven decoding of json directly into a struct. The caller
+				supplies a table which maps field names to the offset and type of
+				the member in the target struct; the jsmn tokens are walked once
+				and each value is converted and stored as it is encountered. No
+				hash tables are built and no lookups by name are needed after the
+				parse which makes this much cheaper than jw_new() followed by a
+				string of jw_value()/jw_string() calls when the caller knows what
+				fields it expects.
+
+				Fields in the json which are not in the schema, and values which
+				are not the expected type, are reported (bleat) and skipped
+				leaving whatever default the caller set in the target. Complex
+				things (arrays, nested objects, fields that may be one of several
+				types) are handled by a user function (JWD_FUNC) which is given
+				a jw_val_t and can use jw_val_ele() and jw_val_decode() to dig
+				further.
+
+	Date:		19 October 2026
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#define JSMN_HEADER 1		// types only; jsmn itself is pulled into jw_tok.c
+#include <jsmn.h>
+
+#include "vfdlib.h"
+#include "jw_tok.h"
+
+/*
+	Decoding context; referenced from each jw_val_t so user functions can
+	descend further into arrays and objects.
+*/
+typedef struct {
+	char*		json;			// the caller's json; strings are terminated in place
+	jsmntok_t*	toks;
+	int			ntoks;
+	const char*	what;			// file name or somesuch for messages
+	int			nwarn;			// number of problems reported
+} jw_dctx_t;
+
+/*
+	Fill in the value struct from the token at t.
+*/
+static void set_val( jw_dctx_t* ctx, jw_val_t* v, const char* name, int t ) {
+	jsmntok_t*	tok;
+	char*		data;
+
+	tok = &ctx->toks[t];
+	memset( v, 0, sizeof( *v ) );
+	v->name = name;
+	v->dctx = ctx;
+	v->tok = t;
+	v->ctok = t + 1;
+
+	switch( tok->type ) {
+		case JSMN_OBJECT:
+			v->type = JW_OBJECT;
+			v->len = tok->size;
+			break;
+
+		case JSMN_ARRAY:
+			v->type = JW_ARRAY;
+			v->len = tok->size;
+			break;
+
+		case JSMN_STRING:
+			v->type = JW_STRING;
+			ctx->json[tok->end] = 0;
+			v->str = &ctx->json[tok->start];
+			break;
+
+		case JSMN_PRIMITIVE:
+			ctx->json[tok->end] = 0;
+			data = &ctx->json[tok->start];
+			switch( *data ) {							// same interpretation as jwrapper; t/f are boolean
+				case 'T':
+				case 't':
+					v->type = JW_BOOL;
+					v->num = 1;
+					break;
+
+				case 'F':
+				case 'f':
+					v->type = JW_BOOL;
+					break;
+
+				case 'N':
+				case 'n':
+					v->type = JW_NULL;
+					break;
+
+				default:
+					v->type = JW_VALUE;
+					v->num = strtod( data, NULL );
+					break;
+			}
+			break;
+
+		default:
+			v->type = JW_NULL;
+			break;
+	}
+}
+
+/*
+	Human readable name for what a field type expects; for messages.
+*/
+static const char* expected( int type ) {
+	switch( type ) {
+		case JWD_BOOL:
+		case JWD_FLAG:
+		case JWD_NFLAG:
+			return "boolean";
+
+		case JWD_INT:
+			return "value";
+
+		case JWD_NUM:
+		case JWD_FLOAT:
+		case JWD_DOUBLE:
+			return "value or boolean";
+
+		case JWD_STR:
+			return "string";
+	}
+
+	return "usable value";
+}
+
+/*
+	Find the field in the schema. Returns nil if it's not there.
+*/
+static const jw_field_t* find_field( const jw_field_t* schema, int nfields, const char* name ) {
+	int i;
+
+	for( i = 0; i < nfields; i++ ) {
+		if( *schema[i].name == *name && strcmp( schema[i].name, name ) == 0 ) {
+			return &schema[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Store the value according to the field description. Returns 1 if all is
+	well, 0 if the value was the wrong type (not stored), and -1 on a hard error
+	(memory, or whatever the user function thinks is fatal).
+*/
+static int store( const jw_field_t* f, jw_val_t* v, void* target, void* data ) {
+	char*	mp;				// pointer to the member in the target
+	char*	ch;
+
+	mp = ((char *) target) + f->offset;
+
+	switch( f->type ) {
+		case JWD_IGNORE:
+			return 1;
+
+		case JWD_BOOL:
+			if( v->type != JW_BOOL ) {
+				return 0;
+			}
+			*((int *) mp) = (int) v->num;
+			return 1;
+
+		case JWD_FLAG:
+		case JWD_NFLAG:
+			if( v->type != JW_BOOL ) {
+				return 0;
+			}
+			if( (v->num != 0) == (f->type == JWD_FLAG) ) {
+				*((unsigned int *) mp) |= f->arg;
+			} else {
+				*((unsigned int *) mp) &= ~f->arg;
+			}
+			return 1;
+
+		case JWD_INT:
+			if( v->type != JW_VALUE ) {
+				return 0;
+			}
+			*((int *) mp) = (int) v->num;
+			return 1;
+
+		case JWD_NUM:
+		case JWD_FLOAT:
+		case JWD_DOUBLE:
+			if( v->type != JW_VALUE && v->type != JW_BOOL ) {
+				return 0;
+			}
+			if( f->type == JWD_NUM ) {
+				*((int *) mp) = (int) v->num;
+			} else {
+				if( f->type == JWD_FLOAT ) {
+					*((float *) mp) = (float) v->num;
+				} else {
+					*((double *) mp) = v->num;
+				}
+			}
+			return 1;
+
+		case JWD_STR:
+			if( v->type != JW_STRING ) {
+				return 0;
+			}
+			for( ch = v->str; *ch && isspace( *ch ); ch++ );		// leading whitespace is trimmed; an empty string is the same as not there
+
+			if( *((char **) mp) != NULL ) {						// a duplicate field; last one wins
+				free( *((char **) mp) );
+				*((char **) mp) = NULL;
+			}
+			if( *ch ) {
+				if( (*((char **) mp) = strdup( ch )) == NULL ) {
+					errno = ENOMEM;
+					return -1;
+				}
+			}
+			return 1;
+
+		case JWD_FUNC:
+			if( f->fn == NULL ) {
+				return 1;
+			}
+			return f->fn( target, v, data );
+	}
+
+	return 1;
+}
+
+/*
+	Decode the object at token o into the target.
+	Returns -1 on a hard error, 0 otherwise.
+*/
+static int decode_obj( jw_dctx_t* ctx, int o, const jw_field_t* schema, int nfields, void* target, void* data ) {
+	const jw_field_t* f;
+	jw_val_t	val;
+	char*		name;
+	int			end;
+	int			i;
+	int			v;
+	int			rc;
+
+	end = ctx->toks[o].end;
+	for( i = o + 1; i < ctx->ntoks && ctx->toks[i].start < end; i = jw_tok_next( ctx->toks, ctx->ntoks, v ) ) {
+		v = i + 1;
+		if( v >= ctx->ntoks || ctx->toks[v].start >= end ) {		// silently skip a trailing name without a value (as jwrapper does)
+			break;
+		}
+
+		if( ctx->toks[i].type != JSMN_STRING ) {
+			bleat_printf( 1, "WRN: %s: badly formed json; expected a field name near offset %d", ctx->what, ctx->toks[i].start );
+			ctx->nwarn++;
+			continue;
+		}
+		ctx->json[ctx->toks[i].end] = 0;
+		name = &ctx->json[ctx->toks[i].start];
+
+		if( (f = find_field( schema, nfields, name )) == NULL ) {
+			bleat_printf( 2, "%s: unknown field ignored: %s", ctx->what, name );
+			ctx->nwarn++;
+			continue;
+		}
+
+		set_val( ctx, &val, name, v );
+		if( (rc = store( f, &val, target, data )) < 0 ) {
+			return -1;
+		}
+
+		if( rc == 0 ) {
+			bleat_printf( 1, "WRN: %s: %s is not a %s; default used", ctx->what, name, expected( f->type ) );
+			ctx->nwarn++;
+		}
+	}
+
+	return 0;
+}
+
+// -------------------------------------------------------------------------------------
+
+/*
+	Fill ele with the idx-th element of the array v. Returns 1 if the element
+	exists and 0 if idx is out of range or v isn't an array. Elements are
+	found by walking the tokens; v remembers where the last one was so that
+	stepping through the array in order is cheap.
+*/
+extern int jw_val_ele( jw_val_t* v, int idx, jw_val_t* ele ) {
+	jw_dctx_t*	ctx;
+
+	if( v == NULL || ele == NULL || v->type != JW_ARRAY || idx < 0 || idx >= v->len ) {
+		return 0;
+	}
+
+	ctx = (jw_dctx_t *) v->dctx;
+	if( idx < v->cidx ) {							// back up; start from the first element
+		v->cidx = 0;
+		v->ctok = v->tok + 1;
+	}
+
+	for( ; v->cidx < idx && v->ctok < ctx->ntoks; v->cidx++ ) {
+		v->ctok = jw_tok_next( ctx->toks, ctx->ntoks, v->ctok );
+	}
+
+	if( v->ctok >= ctx->ntoks ) {
+		return 0;
+	}
+
+	set_val( ctx, ele, v->name, v->ctok );
+	return 1;
+}
+
+/*
+	Decode an object (a field value, or an array element) using the schema.
+	Returns -1 on a hard error, 0 if v wasn't an object and 1 if it was
+	decoded (which might include warnings about individual fields).
+*/
+extern int jw_val_decode( jw_val_t* v, const jw_field_t* schema, int nfields, void* target, void* data ) {
+	if( v == NULL || v->type != JW_OBJECT ) {
+		return 0;
+	}
+
+	if( decode_obj( (jw_dctx_t *) v->dctx, v->tok, schema, nfields, target, data ) < 0 ) {
+		return -1;
+	}
+
+	return 1;
+}
+
+/*
+	Parse the json and decode it into target using the schema. Fields are
+	stored as they are encountered, so the target should be initialised with
+	defaults before the call. Data is passed to JWD_FUNC functions; what is
+	used to identify the source in messages (file name).
+
+	The json is modified (strings are terminated in place) and strings stored
+	in the target are copies, so the json buffer can be freed after the call.
+
+	Returns the number of problems found (unknown fields, bad types) or -1 if
+	the json could not be parsed or there was a hard error (errno set).
+*/
+extern int jw_decode( char* json, const jw_field_t* schema, int nfields, void* target, void* data, const char* what ) {
+	jw_dctx_t	ctx;
+	jsmn_parser jp;
+	jsmntok_t*	toks;
+	size_t		jlen;
+	int			rc;
+
+	if( json == NULL || target == NULL ) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	jlen = strlen( json );
+	if( (toks = jw_tokenise( json, jlen, &jp, &rc )) == NULL ) {		// errno set
+		return -1;
+	}
+
+	if( rc < 1 || toks[0].type != JSMN_OBJECT ) {
+		bleat_printf( 0, "WRN: %s: badly formed json (%s)", what,
+			rc == JSMN_ERROR_INVAL ? "invalid character" : rc == JSMN_ERROR_PART ? "incomplete" : "not an object" );
+		free( toks );
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset( &ctx, 0, sizeof( ctx ) );
+	ctx.json = json;
+	ctx.toks = toks;
+	ctx.ntoks = rc;
+	ctx.what = what != NULL ? what : "json";
+
+	rc = decode_obj( &ctx, 0, schema, nfields, target, data );
+	free( toks );
+
+	return rc < 0 ? -1 : ctx.nwarn;
+}
@@ -0,0 +1,67 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	jw_tok.c
+	Abstract:	Tokenising of json with jsmn, shared by jwrapper.c and jw_decode.c
+				so that both grow the token buffer and step over nested tokens in
+				the same way. This is the only module which pulls in the jsmn
+				functions; the others include jsmn.h for the types only.
+
+	Date:		19 October 2026
+*/
+
+#include <stdlib.h>
+#include <errno.h>
+
+#define JSMN_STATIC 1		// jsmn no longer builds into a library; this pulls as static functions
+#include <jsmn.h>
+
+#include "jw_tok.h"
+
+/*
+	Tokenise jlen bytes of json. The token buffer is sized from a guess (a typical
+	token needs more than 8 bytes of json) and doubled each time jsmn runs out;
+	jsmn picks up where it left off when given more tokens. Jp is initialised
+	here and is left as jsmn leaves it (pos is useful when reporting an error).
+
+	Rc is set to jsmn's return: the number of tokens, or a JSMN_ERROR_ value if the
+	json is bad. Returns the token buffer which the caller must free (even when
+	rc is an error), or nil with errno set to ENOMEM if memory can't be had.
+*/
+extern jsmntok_t* jw_tokenise( const char* json, size_t jlen, jsmn_parser* jp, int* rc ) {
+	jsmntok_t*	toks;
+	jsmntok_t*	ntoks;			// reallocated token buffer
+	int			maxtoks;
+
+	maxtoks = jlen / 8 + 16;
+	if( (toks = (jsmntok_t *) malloc( sizeof( *toks ) * maxtoks )) == NULL ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	jsmn_init( jp );
+	while( (*rc = jsmn_parse( jp, json, jlen, toks, maxtoks )) == JSMN_ERROR_NOMEM ) {
+		maxtoks *= 2;
+		if( (ntoks = (jsmntok_t *) realloc( toks, sizeof( *toks ) * maxtoks )) == NULL ) {
+			free( toks );
+			errno = ENOMEM;
+			return NULL;
+		}
+		toks = ntoks;
+	}
+
+	return toks;
+}
+
+/*
+	Return the index of the token following the token at i and everything
+	that is nested inside of it.
+*/
+extern int jw_tok_next( const jsmntok_t* toks, int ntoks, int i ) {
+	int	end;
+
+	end = toks[i].end;
+	for( i++; i < ntoks && toks[i].start < end; i++ );
+
+	return i;
+}
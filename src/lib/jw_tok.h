@@ -0,0 +1,18 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	jw_tok.h
+	Abstract:	Internal to the library: jsmn tokenising shared by the json
+				parser (jwrapper.c) and the schema decoder (jw_decode.c). The
+				jsmn header must be included first.
+
+	Date:		19 October 2026
+*/
+
+#ifndef _JW_TOK_H_
+#define _JW_TOK_H_
+
+extern jsmntok_t* jw_tokenise( const char* json, size_t jlen, jsmn_parser* jp, int* rc );
+extern int jw_tok_next( const jsmntok_t* toks, int ntoks, int i );
+
+#endif
@@ -2,7 +2,7 @@
 /*
 	Mnemonic:	jwrapper.c
 	Abstract:	A wrapper interface to the jsmn library which makes it a bit easier
-				to use.  Parses a json string capturing the contents in a symtab.
+				to use.  Parses a json string capturing the contents in hash tables.
 	Author:		E. Scott Daniels
 	Date:		23 Feb 2016
 
@@ -11,20 +11,26 @@
 				13 Jun 2016 : Added more granularity to sussing out primative types
 								allowing the caller to determine whether the primative 
 								is a bool, value, or null.
+				19 Oct 2026 : Parse into a single arena rather than a symtab per object
+								with a malloc per value; nuke is now a free of the arena.
+				19 Oct 2026 : Grow the token buffer as needed rather than capping the number
+								of tokens at 1024; report jsmn errors.
+				19 Oct 2026 : Tokenising and token stepping moved to jw_tok.c (shared with
+								jw_decode.c).
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
-#define JSMN_STATIC 1		// jsmn no longer builds into a library; this pulls as static functions
+#define JSMN_HEADER 1		// types only; jsmn itself is pulled into jw_tok.c
 #include <jsmn.h>
 
 #include "vfdlib.h"
-#include "symtab.h"
+#include "jw_tok.h"
 
-#define JSON_SYM_NAME	"_jw_json_string"
-#define MAX_THINGS		1024		// max objects/elements
+#define JW_MIN_BLK		4096		// smallest arena block we'll allocate
 
 #define PT_UNKNOWN		0			// primative types; unk for non prim
 #define PT_VALUE		1
@@ -36,7 +42,20 @@ extern void jw_nuke( void* st );
 // ---------------------------------------------------------------------------------------
 
 /*
-	This is what we will manage in the symtab. Right now we store all values (primatives)
+	Everything built from a json string (the copy of the string, the tokens, the
+	objects, their hash tables and the things) is allocated from an arena. The first
+	block is sized from the input so that most documents need just one malloc; if it
+	is exhausted additional blocks are chained on. Nuking is just freeing the blocks.
+*/
+typedef struct jw_blk {
+	struct jw_blk*	next;
+	size_t	size;					// bytes available in data
+	size_t	used;
+	char	data[];
+} jw_blk_t;
+
+/*
+	This is what we will manage in the object. Right now we store all values (primatives)
 	as float, but we could be smarter about it and look for a decimal. Unsigned and 
 	differences between long, long long etc are tough.
 */
@@ -50,439 +69,567 @@ typedef struct jthing {
 	} v;
 } jthing_t;
 
+/*
+	Hash table entry. The hash is kept so that we compare strings only when
+	the hashes match.
+*/
+typedef struct jw_ent {
+	const char*	name;
+	uint32_t	hv;
+	jthing_t*	thing;
+} jw_ent_t;
 
 /*
-	Given the json token, 'extract' the element by marking the end with a
-	nil character, and returning a pointer to the start.  We do this so that
-	we don't create a bunch of small buffers that must be found and freed; we
-	can just release the json string and we'll be done (read won't leak).
+	An object; this is what the user gets as a 'blob' pointer. Names of members
+	of nested objects are also added using dotted notation (e.g. a.b.c) so that
+	they can be referenced directly from the outer object. Objects in an array
+	have their own namespace.
 */
-static char* extract( char* buf, jsmntok_t *jtoken ) {
-	buf[jtoken->end] = 0;
-	return &buf[jtoken->start];
-}
+typedef struct jw_obj {
+	int			nalloc;			// entries in tab (power of two)
+	int			nused;
+	jw_ent_t*	tab;			// open addressed (linear probe) table
+	jw_blk_t*	arena;			// first arena block; set only in the root object which owns the memory
+} jw_obj_t;
 
 /*
-	create a new jthing and add a reference to it in the symbol table st.
-	sets the number of elements to 1 by default.
+	Parsing context.
 */
-static jthing_t *mk_thing( void *st, char *name, int jsmn_type ) {
-	jthing_t 	*jtp;
+typedef struct {
+	jw_blk_t*	cur;			// block we are allocating from
+	char*		json;			// our copy of the json
+	jsmntok_t*	toks;
+	int			ntoks;
+} jw_pctx_t;
 
-	if( st == NULL ) {
-		return NULL;
+/*
+	Allocate len bytes from the arena. Memory is 8 byte aligned and is NOT cleared.
+*/
+static void* arena_alloc( jw_pctx_t* ctx, size_t len ) {
+	jw_blk_t*	b;
+	size_t		size;
+	void*		p;
+
+	len = (len + 7) & ~((size_t) 7);
+	b = ctx->cur;
+	if( b->size - b->used < len ) {
+		size = b->size / 2 > len ? b->size / 2 : len;
+		if( size < JW_MIN_BLK ) {
+			size = JW_MIN_BLK;
+		}
+		if( (b = (jw_blk_t *) malloc( sizeof( *b ) + size )) == NULL ) {
+			return NULL;
+		}
+		b->next = NULL;
+		b->size = size;
+		b->used = 0;
+		ctx->cur->next = b;
+		ctx->cur = b;
 	}
 
-	jtp = (jthing_t *) malloc( sizeof( *jtp ) );
-	if( jtp == NULL ) {
-		return NULL;
-	}
+	p = b->data + b->used;
+	b->used += len;
+	return p;
+}
 
-	jtp->jsmn_type = jsmn_type;
-	jtp->prim_type = PT_UNKNOWN;			// caller must set this
-	jtp->nele = 1;
-	jtp->v.fv = 0;
+/*
+	Free the arena blocks starting with b.
+*/
+static void free_arena( jw_blk_t* b ) {
+	jw_blk_t*	next;
 
-	sym_fmap( st, (unsigned char *) name, 0, jtp );
-	return jtp;
+	for( ; b != NULL; b = next ) {			// root object lives in the first block, so must get pointer first
+		next = b->next;
+		free( b );
+	}
 }
 
-
 /*
-	Find the named array. Returns a pointer to the jthing that represents
-	the array (type, size and pointer to actual array of jthings).
+	FNV-1a hash of a name.
 */
-static jthing_t* suss_array( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+static inline uint32_t name_hash( const char* name ) {
+	uint32_t	hv = 2166136261u;
 
-	if( st == NULL ) {
-		return NULL;
+	while( *name ) {
+		hv ^= (unsigned char) *(name++);
+		hv *= 16777619u;
 	}
 
-	if( (jtp = (jthing_t *) sym_get( st, name, 0 )) == NULL ) {
-		return NULL;
+	return hv;
+}
+
+/*
+	Find the table entry for name in the object. Returns the empty slot where it would
+	be inserted if it's not there.
+*/
+static jw_ent_t* find_ent( jw_obj_t* jo, const char* name, uint32_t hv ) {
+	jw_ent_t*	e;
+	int			mask;
+	int			i;
+
+	mask = jo->nalloc - 1;
+	for( i = hv & mask; ; i = (i + 1) & mask ) {
+		e = &jo->tab[i];
+		if( e->name == NULL || (e->hv == hv && strcmp( e->name, name ) == 0) ) {
+			return e;
+		}
 	}
+}
 
-	if( jtp->jsmn_type != JSMN_ARRAY ) {
+/*
+	Look up the thing referenced by name in the object.
+*/
+static jthing_t* find_thing( void* st, const char* name ) {
+	jw_ent_t*	e;
+
+	if( st == NULL || name == NULL ) {
 		return NULL;
 	}
 
-	return jtp;
+	e = find_ent( (jw_obj_t *) st, name, name_hash( name ) );
+	return e->thing;
 }
 
 /*
-	Private function to suss an array from the hash and return the ith
-	element.
+	Add (or replace) name in the object. The table is sized before anything is
+	added so it never fills.
 */
-static jthing_t* suss_element( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
-	jthing_t* jarray;
+static void put_thing( jw_obj_t* jo, const char* name, jthing_t* jtp ) {
+	jw_ent_t*	e;
+	uint32_t	hv;
+
+	hv = name_hash( name );
+	e = find_ent( jo, name, hv );
+	if( e->name == NULL ) {
+		e->name = name;
+		e->hv = hv;
+		jo->nused++;
+	}
+	e->thing = jtp;
+}
 
-	if( (jtp = suss_array( st, name )) == NULL ) {
-		return NULL;
+/*
+	Given the json token, 'extract' the element by marking the end with a
+	nil character, and returning a pointer to the start.  We do this so that
+	we don't create a bunch of small buffers; strings point into our copy of
+	the json which lives in the arena.
+*/
+static char* extract( char* buf, jsmntok_t *jtoken ) {
+	buf[jtoken->end] = 0;
+	return &buf[jtoken->start];
+}
+
+/*
+	Count the names which will be placed into the object at token o, including
+	the dotted names of members of nested objects.
+*/
+static int count_names( jw_pctx_t* ctx, int o ) {
+	int	i;
+	int	v;
+	int	end;
+	int	n = 0;
+
+	end = ctx->toks[o].end;
+	for( i = o + 1; i < ctx->ntoks && ctx->toks[i].start < end; i = jw_tok_next( ctx->toks, ctx->ntoks, v ) ) {
+		v = i + 1;
+		if( v >= ctx->ntoks || ctx->toks[v].start >= end ) {		// name without a value
+			break;
+		}
+
+		n++;
+		if( ctx->toks[v].type == JSMN_OBJECT ) {
+			n += count_names( ctx, v );
+		}
 	}
-	
-	if( idx < 0 || idx >= jtp->nele ) {				// out of range
-		return NULL;
+
+	return n;
+}
+
+/*
+	Set the primative type and value in the thing based on the string.
+*/
+static void set_prim( jthing_t* jtp, char* data ) {
+	jtp->jsmn_type = JSMN_PRIMITIVE;
+
+	switch( *data ) {								// assume T|t is true and F|f is false
+		case 0:
+			jtp->v.fv = 0;
+			jtp->prim_type = PT_VALUE;
+			break;
+
+		case 'T':
+		case 't':
+			jtp->prim_type = PT_BOOL;
+			jtp->v.fv = 1; 
+			break;
+
+		case 'F':
+		case 'f':
+			jtp->prim_type = PT_BOOL;
+			jtp->v.fv = 0; 
+			break;
+
+		case 'N':									// Null or some form of that
+		case 'n':
+			jtp->prim_type = PT_NULL;
+			jtp->v.fv = 0; 
+			break;
+
+		default:
+			jtp->prim_type = PT_VALUE;
+			jtp->v.fv = strtof( data, NULL ); 		// store all numerics as float
+			break;
 	}
+}
 
-	if( (jarray = jtp->v.pv)  == NULL ) {
+/*
+	Allocate a thing from the arena.
+*/
+static jthing_t* mk_thing( jw_pctx_t* ctx, int jsmn_type ) {
+	jthing_t*	jtp;
+
+	if( (jtp = (jthing_t *) arena_alloc( ctx, sizeof( *jtp ) )) == NULL ) {
 		return NULL;
 	}
 
-	return &jarray[idx];
+	jtp->jsmn_type = jsmn_type;
+	jtp->prim_type = PT_UNKNOWN;
+	jtp->nele = 1;
+	jtp->v.pv = NULL;
+	return jtp;
 }
 
+static jw_obj_t* parse_jobject( jw_pctx_t* ctx, int o );
 
 /*
-	Invoked for each thing in the symtab; we free the things that actually point to 
-	allocated data (e.g. arrays) and recurse to handle objects.
+	Build the array at token a into the thing.  Returns 0 on failure.
 */
-static void nix_things( void* st, void* se, const char* name,  void* ele, void *data ) {
-	jthing_t*	j;
+static int parse_jarray( jw_pctx_t* ctx, int a, jthing_t* jtp ) {
 	jthing_t*	jarray;
-	int i;
+	jsmntok_t*	tok;
+	int			size;
+	int			i;
+	int			n;
 
-	j = (jthing_t *) ele;
-	if( j ) {
-		switch( j->jsmn_type ) {
-			case JSMN_ARRAY:
-				if( (jarray = (jthing_t *) j->v.pv)  != NULL ) {
-					for( i = 0; i < j->nele; i++ ) {					// must look for embedded objects
-						if( jarray[i].jsmn_type == JSMN_OBJECT ) {
-							jw_nuke( jarray[i].v.pv );
-							jarray[i].jsmn_type = JSMN_UNDEFINED;			// prevent accidents
-						}
-					}
+	size = ctx->toks[a].size;
+	jtp->nele = size;
+	if( size <= 0 ) {
+		jtp->nele = 0;
+		return 1;
+	}
 
-					free( j->v.pv );			// must free the array (arrays aren't nested, so all things in the array don't reference allocated mem)
+	if( (jarray = (jthing_t *) arena_alloc( ctx, sizeof( *jarray ) * size )) == NULL ) {
+		return 0;
+	}
+	memset( jarray, 0, sizeof( *jarray ) * size );
+	jtp->v.pv = jarray;
+
+	for( n = 0, i = a + 1; n < size && i < ctx->ntoks; n++, i = jw_tok_next( ctx->toks, ctx->ntoks, i ) ) {
+		tok = &ctx->toks[i];
+		jarray[n].prim_type = PT_UNKNOWN;
+		jarray[n].nele = 1;
+
+		switch( tok->type ) {
+			case JSMN_OBJECT:
+				if( (jarray[n].v.pv = parse_jobject( ctx, i )) == NULL ) {		// object in an array has its own namespace
+					fprintf( stderr, "error: [%d] array element %d could not be parsed\n", a, n );
+					return 0;
 				}
+				jarray[n].jsmn_type = JSMN_OBJECT;
 				break;
 
-			case JSMN_OBJECT:
-				jw_nuke( j->v.pv );
-				j->jsmn_type = JSMN_UNDEFINED;			// prevent a double free
+			case JSMN_STRING:
+				jarray[n].v.pv = (void *) extract( ctx->json, tok );
+				jarray[n].jsmn_type = JSMN_STRING;
+				break;
+
+			case JSMN_PRIMITIVE:
+				set_prim( &jarray[n], extract( ctx->json, tok ) );
+				break;
+
+			case JSMN_ARRAY:
+				fprintf( stderr, "warn: [%d] array element %d is not valid type (array) is not string or primative\n", a, n );
+				break;
+
+			default:
+				fprintf( stderr, "warn: [%d] array element %d is not valid type (undefined) is not string or primative\n", a, n );
 				break;
 		}
 	}
+
+	return 1;
 }
 
 /*
-	Real work for parsing an object ({...}) from the json.   Called by jw_new() and 
-	recurses to deal with sub-objects.
+	Real work for parsing an object ({...}) from the json.  The object at token o
+	is built and returned. Called by jw_new() and recurses to deal with sub-objects.
+	Returns nil on error.
 */
-void* parse_jobject( void* st, char *json, char* prefix ) {
-	jthing_t	*jtp; 			// json thing that we just created
-	int 	i;
-	int 	n;					
-	char	*name;				// name in the json
-	char	*data;				// data string from the json
-	jthing_t*	jarray;			// array of jthings we'll coonstruct
-	int		size;
-	int		osize;
-	int		njtokens; 			// tokens actually sussed out
-	jsmn_parser jp;				// 'parser' object
-	jsmntok_t *jtokens;			// pointer to tokens returned by the parser
-	char	pname[1024];		// name with prefix
-	char	wbuf[256];			// temp buf to build a working name in
-	char*	dstr;				// dup'd string
-
-	jsmn_init( &jp );			// does this have a failure mode?
-
-	jtokens = (jsmntok_t *) malloc( sizeof( *jtokens ) * MAX_THINGS );
-	if( jtokens == NULL ) {
-		fprintf( stderr, "abort: cannot allocate tokens array\n" );
-		exit( 1 );
+static jw_obj_t* parse_jobject( jw_pctx_t* ctx, int o ) {
+	jw_obj_t*	jo;
+	jw_obj_t*	sub;
+	jthing_t*	jtp;
+	jsmntok_t*	tok;
+	char*		name;
+	char*		dname;		// dotted name
+	int			size;
+	int			end;
+	int			i;
+	int			j;
+	int			v;
+	int			nlen;
+	int			slen;
+
+	if( (jo = (jw_obj_t *) arena_alloc( ctx, sizeof( *jo ) )) == NULL ) {
+		return NULL;
 	}
 
-	njtokens = jsmn_parse( &jp, json, strlen( json ), jtokens, MAX_THINGS );
-
-	if( jtokens[0].type != JSMN_OBJECT ) {				// if it's not an object then we can't parse it.
-		fprintf( stderr, "warn: badly formed json; initial opening bracket ({) not detected\n" );
+	size = count_names( ctx, o );
+	for( jo->nalloc = 8; jo->nalloc < size * 2; jo->nalloc <<= 1 );	// keep load at 50% or less
+	if( (jo->tab = (jw_ent_t *) arena_alloc( ctx, sizeof( *jo->tab ) * jo->nalloc )) == NULL ) {
 		return NULL;
 	}
+	memset( jo->tab, 0, sizeof( *jo->tab ) * jo->nalloc );
+	jo->nused = 0;
+	jo->arena = NULL;
 
-	/* DEBUG
-	for( i = 1; i < njtokens-1; i++ ) {					// we'll silently skip the last token if its "name" without a value
-		fprintf( stderr, ">>> %4d: size=%d start=%d end=%d %s\n", i, jtokens[i].size, jtokens[i].start, jtokens[i].end, extract( json, &jtokens[i] ) );
-	}
-	*/
+	end = ctx->toks[o].end;
+	for( i = o + 1; i < ctx->ntoks && ctx->toks[i].start < end; i = jw_tok_next( ctx->toks, ctx->ntoks, v ) ) {
+		v = i + 1;
+		if( v >= ctx->ntoks || ctx->toks[v].start >= end ) {		// we'll silently skip the last token if its "name" without a value
+			break;
+		}
 
-	for( i = 1; i < njtokens-1; i++ ) {					// we'll silently skip the last token if its "name" without a value
-		if( jtokens[i].type != JSMN_STRING ) {
-			fprintf( stderr, "warn: badly formed json [%d]; expected name (string) found type=%d %s\n", i, jtokens[i].type, extract( json, &jtokens[i] ) );
-			sym_free( st );
+		if( ctx->toks[i].type != JSMN_STRING ) {
+			fprintf( stderr, "warn: badly formed json [%d]; expected name (string) found type=%d %s\n", i, ctx->toks[i].type, extract( ctx->json, &ctx->toks[i] ) );
 			return NULL;
 		}
-		name = extract( json, &jtokens[i] );
-		if( *prefix != 0 ) {
-			snprintf( pname, sizeof( pname ), "%s.%s", prefix, name );
-			name = pname;
-		}
-
-		size = jtokens[i].size;
-
-		i++;										// at the data token now
-		switch( jtokens[i].type ) {
-			case JSMN_UNDEFINED: 
-				fprintf( stderr, "warn: element [%d] in json is undefined\n", i );
-				break;
+		name = extract( ctx->json, &ctx->toks[i] );
 
-    		case JSMN_OBJECT:				// save object in two ways: as an object 'blob' and in the current symtab using name as a base (original)
-				dstr = strdup( extract( json, &jtokens[i] ) );
-				snprintf( wbuf, sizeof( wbuf ), "%s_json", name );	// must stash the json string in the symtab for clean up during nuke	
-				sym_fmap( st, (unsigned char *) wbuf, 0, dstr );
-				parse_jobject( st, dstr, name );					// recurse to add the object as objectname.xxxx elements
-				
-				jtp = mk_thing( st, name, jtokens[i].type );		// create thing and reference it in current symtab
-				if( jtp == NULL ) {
-					fprintf( stderr, "warn: memory alloc error processing element [%d] in json\n", i );
-					free( dstr );
-					sym_free( st );
-					return NULL;
-				}
-				jtp->v.pv = (void *) sym_alloc( 255 );						// object is just a blob
-				if( jtp->v.pv == NULL ) {
-					fprintf( stderr, "error: [%d] symtab for object blob could not be allocated\n", i );
-					sym_free( st );
-					free( dstr );
+		tok = &ctx->toks[v];
+		switch( tok->type ) {
+			case JSMN_OBJECT:						// the object is referenced as a blob, and its names are added to this namespace with name. as a prefix
+				if( (sub = parse_jobject( ctx, v )) == NULL ) {
 					return NULL;
 				}
-				dstr = strdup( extract( json, &jtokens[i] ) );
-				sym_fmap( jtp->v.pv, (unsigned char *) JSON_SYM_NAME, 0, dstr );		// must stash json so it is freed during nuke()
-				parse_jobject( jtp->v.pv,  dstr, "" );							// recurse acorss the string and build a new symtab
-
-				size = jtokens[i].end;											// done with them, we need to skip them 
-				i++;
-				while( i < njtokens-1  &&  jtokens[i].end < size ) {
-					//fprintf( stderr, "\tskip: [%d] object element start=%d end=%d (%s)\n", i, jtokens[i].start, jtokens[i].end, extract( json, &jtokens[i])  );
-					i++;
-				} 
-
-				i--;						// must allow loop to bump past the last
-				break;
-
-    		case JSMN_ARRAY:
-				size = jtokens[i].size;		// size is burried here, and not with the name
-				jtp = mk_thing( st, name, jtokens[i].type );
-
-				i++;						// first thing is the whole array string which I don't grock the need for, but it's their code...
-				if( jtp == NULL ) {
-					fprintf( stderr, "warn: memory alloc error processing element [%d] in json\n", i );
-					sym_free( st );
+				if( (jtp = mk_thing( ctx, JSMN_OBJECT )) == NULL ) {
+					fprintf( stderr, "warn: memory alloc error processing element [%d] in json\n", v );
 					return NULL;
 				}
-				jarray = jtp->v.pv = (jsmntok_t *) malloc( sizeof( *jarray ) * size );		// allocate the array
-				memset( jarray, 0, sizeof( *jarray ) * size );
-				jtp->nele = size;
-
-				for( n = 0; n < size; n++ ) {								// for each array element
-					jarray[n].prim_type	 = PT_UNKNOWN;						// assume not primative type
-					switch( jtokens[i+n].type ) {
-						case JSMN_UNDEFINED:
-							fprintf( stderr, "warn: [%d] array element %d is not valid type (undefined) is not string or primative\n", i, n );
-							fprintf( stderr, "\tstart=%d end=%d\n", jtokens[i+n].start, jtokens[i+n].end );
-							break;
-
-						case JSMN_OBJECT:
-							jarray[n].v.pv = (void *) sym_alloc( 255 );
-							if( jarray[n].v.pv == NULL ) {
-								fprintf( stderr, "error: [%d] array element %d size=%d could not allocate symtab\n", i, n, jtokens[i+n].size );
-								sym_free( st );
-								return NULL;
-							}
-
-							jarray[n].jsmn_type = JSMN_OBJECT;
-							parse_jobject( jarray[n].v.pv,  extract( json, &jtokens[i+n]  ), "" );		// recurse acorss the string and build a new symtab
-							osize = jtokens[i+n].end;									// done with them, we need to skip them 
-							i++;
-							while( i+n < njtokens-1  &&  jtokens[n+i].end < osize ) {
-								//fprintf( stderr, "\tskip: [%d] object element start=%d end=%d (%s)\n", i, jtokens[i].start, jtokens[i].end, extract( json, &jtokens[i])  );
-								i++;
-							}
-							i--;					// allow incr at loop end
-							break;
-
-						case JSMN_ARRAY:
-							fprintf( stderr, "warn: [%d] array element %d is not valid type (array) is not string or primative\n", i, n );
-							n += jtokens[i+n].size;			// this should skip the nested array
-							break;
-
-						case JSMN_STRING:
-							data = extract( json, &jtokens[i+n] );
-							jarray[n].v.pv = (void *) data;
-							jarray[n].jsmn_type = JSMN_STRING;
-							break;
-
-						case JSMN_PRIMITIVE:
-							data = extract( json, &jtokens[i+n] );
-							switch( *data ) {
-								case 0:
-									jarray[n].prim_type	 = PT_VALUE;
-									jarray[n].v.fv = 0;
-									break;
-
-								case 'T':
-								case 't':
-									jarray[n].v.fv = 1;
-									jarray[n].prim_type	 = PT_BOOL;
-									break;
-
-								case 'F':
-								case 'f':
-									jarray[n].prim_type	 = PT_BOOL;
-									jarray[n].v.fv = 0;
-									break;
-
-								case 'N':										// assume null, nil, or some variant
-								case 'n':
-									jarray[n].prim_type	 = PT_NULL;
-									jarray[n].v.fv = 0;
-									break;
-
-								default:
-									jarray[n].prim_type	 = PT_VALUE;
-									jarray[n].v.fv = strtof( data, NULL ); 		// store all numerics as float
-									break;
-							}
-
-							jarray[n].jsmn_type = JSMN_PRIMITIVE;
-							break;
-						
-						default:
-							fprintf( stderr, "warn: [%d] array element %d is not valid type (unknown=%d) is not string or primative\n", i, n, jtokens[i].type  );
-							sym_free( st );
+				jtp->v.pv = sub;
+				put_thing( jo, name, jtp );
+
+				nlen = strlen( name );
+				for( j = 0; j < sub->nalloc; j++ ) {
+					if( sub->tab[j].name != NULL ) {
+						slen = strlen( sub->tab[j].name );
+						if( (dname = (char *) arena_alloc( ctx, nlen + slen + 2 )) == NULL ) {
 							return NULL;
-							break;
+						}
+						memcpy( dname, name, nlen );
+						dname[nlen] = '.';
+						memcpy( dname + nlen + 1, sub->tab[j].name, slen + 1 );
+						put_thing( jo, dname, sub->tab[j].thing );		// things are shared; nothing is freed individually
 					}
 				}
-
-				i += size - 1;		// must allow loop to push to next
 				break;
 
-    		case JSMN_STRING:
-				data = extract( json, &jtokens[i] );
-				jtp = mk_thing( st, name, jtokens[i].type );
-				if( jtp == NULL ) {
-					fprintf( stderr, "warn: memory alloc error processing element [%d] in json\n", i );
-					sym_free( st );
+			case JSMN_ARRAY:
+				if( (jtp = mk_thing( ctx, JSMN_ARRAY )) == NULL || ! parse_jarray( ctx, v, jtp ) ) {
+					fprintf( stderr, "warn: memory alloc error processing element [%d] in json\n", v );
 					return NULL;
 				}
-				jtp->v.pv =  (void *) data;						// just point into the large json string
+				put_thing( jo, name, jtp );
 				break;
 
-    		case JSMN_PRIMITIVE:
-				data = extract( json, &jtokens[i] );
-				jtp = mk_thing( st, name, jtokens[i].type );
-				if( jtp == NULL ) {
-					fprintf( stderr, "warn: memory alloc error processing element [%d] in json\n", i );
-					sym_free( st );
+			case JSMN_STRING:
+				if( (jtp = mk_thing( ctx, JSMN_STRING )) == NULL ) {
+					fprintf( stderr, "warn: memory alloc error processing element [%d] in json\n", v );
 					return NULL;
 				}
-				switch( *data ) {								// assume T|t is true and F|f is false
-					case 0:
-						jtp->v.fv = 0;
-						jtp->prim_type = PT_VALUE;
-						break;
-
-					case 'T':
-					case 't':
-						jtp->prim_type = PT_BOOL;
-						jtp->v.fv = 1; 
-						break;
-
-					case 'F':
-					case 'f':
-						jtp->prim_type = PT_BOOL;
-						jtp->v.fv = 0; 
-						break;
-
-					case 'N':									// Null or some form of that
-					case 'n':
-						jtp->prim_type = PT_NULL;
-						jtp->v.fv = 0; 
-						break;
-
-					default:
-						jtp->prim_type = PT_VALUE;
-						jtp->v.fv = strtof( data, NULL ); 		// store all numerics as float
-						break;
+				jtp->v.pv = (void *) extract( ctx->json, tok );		// just point into the large json string
+				put_thing( jo, name, jtp );
+				break;
+
+			case JSMN_PRIMITIVE:
+				if( (jtp = mk_thing( ctx, JSMN_PRIMITIVE )) == NULL ) {
+					fprintf( stderr, "warn: memory alloc error processing element [%d] in json\n", v );
+					return NULL;
 				}
+				set_prim( jtp, extract( ctx->json, tok ) );
+				put_thing( jo, name, jtp );
+				break;
+
+			case JSMN_UNDEFINED:
+				fprintf( stderr, "warn: element [%d] in json is undefined\n", v );
 				break;
 
 			default:
-				fprintf( stderr, "unknown type at %d\n", i );
+				fprintf( stderr, "unknown type at %d\n", v );
 				break;
 		}
 	}
 
-	free( jtokens );
-	return st;
+	return jo;
+}
+
+/*
+	Find the named array. Returns a pointer to the jthing that represents
+	the array (type, size and pointer to actual array of jthings).
+*/
+static jthing_t* suss_array( void* st, const char* name ) {
+	jthing_t* jtp;									// thing that is referenced by the object
+
+	if( (jtp = find_thing( st, name )) == NULL ) {
+		return NULL;
+	}
+
+	if( jtp->jsmn_type != JSMN_ARRAY ) {
+		return NULL;
+	}
+
+	return jtp;
+}
+
+/*
+	Private function to suss an array from the hash and return the ith
+	element.
+*/
+static jthing_t* suss_element( void* st, const char* name, int idx ) {
+	jthing_t* jtp;									// thing that is referenced by the object
+	jthing_t* jarray;
+
+	if( (jtp = suss_array( st, name )) == NULL ) {
+		return NULL;
+	}
+	
+	if( idx < 0 || idx >= jtp->nele ) {				// out of range
+		return NULL;
+	}
+
+	if( (jarray = jtp->v.pv)  == NULL ) {
+		return NULL;
+	}
+
+	return &jarray[idx];
 }
 
 // --------------- public functions -----------------------------------------------------------------
 
 /*
-	Destroy all operating structures assocaited with the symtab pointer passed in.
+	Destroy everything assocaited with the blob pointer passed in; only the pointer
+	returned by jw_new() actually releases anything (sub-object blobs are part of
+	their parent's arena).
 */
 extern void jw_nuke( void* st ) {
-	char* 	buf;					// pointer to the original json to free
 	if( st == NULL ) {
 		return;
 	}
 
-	sym_foreach_class( st, 0, nix_things, NULL );			// free anything that the symtab references
-	sym_free( st );											// free the symtab itself
+	free_arena( ((jw_obj_t *) st)->arena );
 }
 
 /*
-	Given a json string, parse it, and put the things into a symtab.
-	return the symtab pointer to the caller. They pass the symtab
-	pointer back to the various get functions.
-
-	This is the entry point. It sets up the symbol table and invokes the parse object
-	funtion to start at the first level. Parse object will recurse for nested objects
-	if present.
+	Given a json string, parse it, and return an opaque pointer to the parsed
+	object. The caller passes the pointer back to the various get functions.
+
+	This is the entry point. It tokenises the json, growing the token buffer until
+	jsmn is happy, sets up an arena sized from the result, copies the json into it
+	(allows the user to free/overlay their buffer as needed) and invokes parse object
+	to start at the first level. Parse object will recurse for nested objects if present.
+	The tokens are needed only while parsing and are not kept in the arena.
 */
 extern void* jw_new( char* json ) {
-	void	*st;				// symbol table
+	jw_pctx_t	ctx;
+	jw_blk_t*	first;
+	jw_obj_t*	jo;
+	jsmn_parser jp;				// 'parser' object
+	jsmntok_t*	toks;
+	size_t		jlen;
+	size_t		size;
+	int			rc;
 
-	st = sym_alloc( MAX_THINGS );
-	if( st == NULL ) {
+	if( json == NULL ) {
+		return NULL;
+	}
+
+	jlen = strlen( json );
+	if( (toks = jw_tokenise( json, jlen, &jp, &rc )) == NULL ) {
 		return NULL;
 	}
 
-	json = strdup( json );												// allows user to free/overlay their buffer as needed
-	sym_fmap( st, (unsigned char *) JSON_SYM_NAME, 0, json );			// save a pointer so we can free on nuke (fmap flags the data to be free'd when deleted)
+	if( rc < 1 || toks[0].type != JSMN_OBJECT ) {		// if it's not an object then we can't parse it.
+		switch( rc ) {
+			case JSMN_ERROR_INVAL:
+				fprintf( stderr, "warn: badly formed json; invalid character near offset %u\n", jp.pos );
+				break;
+
+			case JSMN_ERROR_PART:
+				fprintf( stderr, "warn: badly formed json; json string is incomplete\n" );
+				break;
+
+			default:
+				fprintf( stderr, "warn: badly formed json; initial opening bracket ({) not detected\n" );
+				break;
+		}
+
+		free( toks );
+		return NULL;
+	}
+
+	size = jlen + 8 + (sizeof( jthing_t ) + 3 * sizeof( jw_ent_t )) * rc + 256;		// json copy and a guess at objects, tables and things
+	if( (first = (jw_blk_t *) malloc( sizeof( *first ) + size )) == NULL ) {
+		free( toks );
+		return NULL;
+	}
+	first->next = NULL;
+	first->size = size;
+	first->used = 0;
+
+	memset( &ctx, 0, sizeof( ctx ) );
+	ctx.cur = first;
+	ctx.json = (char *) arena_alloc( &ctx, jlen + 1 );		// token offsets apply to the copy
+	memcpy( ctx.json, json, jlen + 1 );
+	ctx.toks = toks;
+	ctx.ntoks = rc;
+
+	jo = parse_jobject( &ctx, 0 );
+	free( toks );
+
+	if( jo == NULL ) {
+		free_arena( first );
+		return NULL;
+	}
 
-	return parse_jobject( st,  json, "" );								// empty prefix for the root object
+	jo->arena = first;
+	return jo;
 }
 
 /*
 	Returns true (1) if the named field is missing. 
 */
 extern int jw_missing( void* st, const char* name ) {
-	return sym_get( st, name, 0 ) == NULL;
+	return find_thing( st, name ) == NULL;
 }
 
 /*
 	Returns true (1) if the named field is in the blob;
 */
 extern int jw_exists( void* st, const char* name ) {
-	return sym_get( st, name, 0 ) != NULL;
+	return find_thing( st, name ) != NULL;
 }
 
 /*
 	Returns true (1) if the primative type is value (float).
 */
 extern int jw_is_value( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return 0;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
+	jtp = find_thing( st, name );					// get it or NULL
 
 	if( ! jtp ) {
 		return 0;
@@ -495,13 +642,13 @@ extern int jw_is_value( void* st, const char* name ) {
 	Returns true (1) if the primative type is boolean.
 */
 extern int jw_is_bool( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return 0;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
+	jtp = find_thing( st, name );					// get it or NULL
 
 	if( ! jtp ) {
 		return 0;
@@ -514,13 +661,13 @@ extern int jw_is_bool( void* st, const char* name ) {
 	Returns true (1) if the primative type was a 'null' type.
 */
 extern int jw_is_null( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return 0;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
+	jtp = find_thing( st, name );					// get it or NULL
 
 	if( ! jtp ) {
 		return 0;
@@ -530,16 +677,16 @@ extern int jw_is_null( void* st, const char* name ) {
 }
 
 /*
-	Look up the name in the symtab and return the string (data).
+	Look up the name in the object and return the string (data).
 */
 extern char* jw_string( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return NULL;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
+	jtp = find_thing( st, name );					// get it or NULL
 
 	if( ! jtp ) {
 		return NULL;
@@ -556,13 +703,13 @@ extern char* jw_string( void* st, const char* name ) {
 	Look up name and return the value.
 */
 extern float jw_value( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return 0;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
+	jtp = find_thing( st, name );					// get it or NULL
 
 	if( ! jtp ) {
 		return 0;
@@ -576,16 +723,16 @@ extern float jw_value( void* st, const char* name ) {
 }
 
 /*
-	Look up name and return the blob (symtab).
+	Look up name and return the blob (object).
 */
 extern void* jw_blob( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return NULL;
 	}
 
-	jtp = (jthing_t *) sym_get( st, name, 0 );		// get it or NULL
+	jtp = find_thing( st, name );					// get it or NULL
 
 	if( ! jtp ) {
 		return NULL;
@@ -606,7 +753,7 @@ extern void* jw_blob( void* st, const char* name ) {
 		element is not a string
 */
 extern char* jw_string_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return NULL;
@@ -631,7 +778,7 @@ extern char* jw_string_ele( void* st, const char* name, int idx ) {
 		element is not a value
 */
 extern float jw_value_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return 0;
@@ -653,7 +800,7 @@ extern float jw_value_ele( void* st, const char* name, int idx ) {
 	Return true (1) if it is.
 */
 extern int jw_is_value_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return 0;
@@ -671,7 +818,7 @@ extern int jw_is_value_ele( void* st, const char* name, int idx ) {
 	Return true (1) if it is.
 */
 extern int jw_is_bool_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return 0;
@@ -689,7 +836,7 @@ extern int jw_is_bool_ele( void* st, const char* name, int idx ) {
 	Return true (1) if it is.
 */
 extern int jw_is_null_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return -1;
@@ -709,13 +856,13 @@ extern int jw_is_null_ele( void* st, const char* name, int idx ) {
 		index is out of range
 		element is not an object
 
-	An object in an array is a standalone symbol table. Thus the object
+	An object in an array is standalone. Thus the object
 	is treated differently than a nested object whose members are a 
 	part of the parent namespace.  An object in an array has its own
 	namespace.
 */
 extern void* jw_obj_ele( void* st, const char* name, int idx ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return NULL;
@@ -737,7 +884,7 @@ extern void* jw_obj_ele( void* st, const char* name, int idx ) {
 	and returns the number of elements otherwise.
 */
 extern int jw_array_len( void* st, const char* name ) {
-	jthing_t* jtp;									// thing that is referenced by the symtab entry
+	jthing_t* jtp;									// thing that is referenced by the object
 
 	if( st == NULL ) {
 		return -1;
@@ -0,0 +1,186 @@
+// :vi ts=4 sw=4:
+/*
+	Mnemonic:	jwrapper_bench.c
+	Abstract:	Benchmark for the json wrapper. Two documents are generated and
+				each is parsed, walked, and nuked repeatedly:
+					- a large VF config (long vlan and mac lists, queues, mirror)
+					- a batch request which carries 100 VF configs in an array
+
+				jwrapper_bench [iterations]
+
+	Date:		19 October 2026
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vfdlib.h"
+
+#define NVLANS		100
+#define NMACS		100
+#define NBATCH		100
+
+/*
+	Add a VF config to buf. If big is set, long vlan and mac lists are included.
+	Returns the number of bytes added.
+*/
+static int gen_vf( char* buf, int vfid, int big ) {
+	int	len;
+	int	i;
+	int	nv;
+	int	nm;
+
+	nv = big ? NVLANS : 4;
+	nm = big ? NMACS : 2;
+
+	len = sprintf( buf, "{ \"name\": \"vm-%04d\", \"pciid\": \"0000:07:00.1\", \"vfid\": %d, \"strip_stag\": false,"
+		" \"allow_bcast\": true, \"allow_mcast\": true, \"allow_un_ucast\": false, \"link_status\": \"auto\","
+		" \"start_cb\": \"/usr/bin/true\", \"stop_cb\": \"/usr/bin/true\", \"rate\": 0.5, \"vlans\": [", vfid, vfid % 32 );
+	for( i = 0; i < nv; i++ ) {
+		len += sprintf( buf + len, "%s %d", i ? "," : "", 10 + i );
+	}
+	len += sprintf( buf + len, " ], \"macs\": [" );
+	for( i = 0; i < nm; i++ ) {
+		len += sprintf( buf + len, "%s \"fa:16:3e:%02x:%02x:%02x\"", i ? "," : "", vfid & 0xff, i >> 8, i & 0xff );
+	}
+	len += sprintf( buf + len, " ], \"queues\": [" );
+	for( i = 0; i < 4; i++ ) {
+		len += sprintf( buf + len, "%s { \"priority\": %d, \"share\": \"%d%%\" }", i ? "," : "", i, 25 );
+	}
+	len += sprintf( buf + len, " ], \"mirror\": { \"target\": 3, \"direction\": \"all\" } }" );
+
+	return len;
+}
+
+/*
+	Touch everything in a VF config blob so that lookups are part of the timing.
+	Returns a count of things found which the caller can check.
+*/
+static int walk_vf( void* jblob ) {
+	void*	qobj;
+	int		n = 0;
+	int		i;
+	int		len;
+
+	n += jw_string( jblob, "name" ) != NULL;
+	n += jw_string( jblob, "pciid" ) != NULL;
+	n += jw_is_value( jblob, "vfid" );
+	n += jw_is_bool( jblob, "strip_stag" );
+	n += jw_is_bool( jblob, "allow_bcast" );
+	n += jw_string( jblob, "link_status" ) != NULL;
+	n += jw_exists( jblob, "rate" );
+
+	len = jw_array_len( jblob, "vlans" );
+	for( i = 0; i < len; i++ ) {
+		n += jw_is_value_ele( jblob, "vlans", i );
+	}
+	len = jw_array_len( jblob, "macs" );
+	for( i = 0; i < len; i++ ) {
+		n += jw_string_ele( jblob, "macs", i ) != NULL;
+	}
+	len = jw_array_len( jblob, "queues" );
+	for( i = 0; i < len; i++ ) {
+		if( (qobj = jw_obj_ele( jblob, "queues", i )) != NULL ) {
+			n += jw_is_value( qobj, "priority" );
+			n += jw_string( qobj, "share" ) != NULL;
+		}
+	}
+
+	n += jw_is_value( jblob, "mirror.target" );
+	n += jw_string( jw_blob( jblob, "mirror" ), "direction" ) != NULL;
+
+	return n;
+}
+
+static double now_us( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (double) ts.tv_sec * 1000000.0 + (double) ts.tv_nsec / 1000.0;
+}
+
+/*
+	Parse/walk/nuke the json iterations times and report. Returns 0 if
+	all went well.
+*/
+static int bench( const char* what, char* json, int iterations, int batch, int expect ) {
+	void*	jblob;
+	void*	vf;
+	double	start;
+	double	elapsed;
+	int		found;
+	int		i;
+	int		j;
+	int		n;
+
+	start = now_us( );
+	for( i = 0; i < iterations; i++ ) {
+		if( (jblob = jw_new( json )) == NULL ) {
+			fprintf( stderr, "[FAIL] %s: unable to parse json (%d bytes)\n", what, (int) strlen( json ) );
+			return 1;
+		}
+
+		found = 0;
+		if( batch ) {
+			n = jw_array_len( jblob, "params.vfs" );
+			for( j = 0; j < n; j++ ) {
+				if( (vf = jw_obj_ele( jblob, "params.vfs", j )) != NULL ) {
+					found += walk_vf( vf );
+				}
+			}
+		} else {
+			found = walk_vf( jblob );
+		}
+
+		jw_nuke( jblob );
+
+		if( found != expect ) {
+			fprintf( stderr, "[FAIL] %s: expected to find %d things, found %d\n", what, expect, found );
+			return 1;
+		}
+	}
+	elapsed = now_us( ) - start;
+
+	fprintf( stderr, "[OK]   %-16s %7d bytes  %6d iterations  %9.2f us/parse  %8.2f MB/s\n", what, (int) strlen( json ),
+		iterations, elapsed / iterations, ((double) strlen( json ) * iterations) / elapsed );
+	return 0;
+}
+
+int main( int argc, char** argv ) {
+	char*	vf_json;
+	char*	batch_json;
+	int		iterations = 10000;
+	int		len;
+	int		i;
+	int		rc = 0;
+	int		vf_expect;
+	int		small_expect;
+
+	if( argc > 1 ) {
+		iterations = atoi( argv[1] );
+	}
+
+	vf_json = (char *) malloc( 64 * 1024 );
+	gen_vf( vf_json, 1, 1 );
+	vf_expect = 7 + NVLANS + NMACS + 8 + 2;
+
+	batch_json = (char *) malloc( NBATCH * 2048 + 1024 );
+	len = sprintf( batch_json, "{ \"action\": \"add\", \"params\": { \"r_fifo\": \"/tmp/bench\", \"loglevel\": 0, \"vfs\": [" );
+	for( i = 0; i < NBATCH; i++ ) {
+		if( i ) {
+			batch_json[len++] = ',';
+		}
+		len += gen_vf( batch_json + len, i, 0 );
+	}
+	sprintf( batch_json + len, " ] } }" );
+	small_expect = 7 + 4 + 2 + 8 + 2;
+
+	rc += bench( "large vf config", vf_json, iterations, 0, vf_expect );
+	rc += bench( "100 vf batch", batch_json, iterations / 10 > 0 ? iterations / 10 : 1, 1, small_expect * NBATCH );
+
+	free( vf_json );
+	free( batch_json );
+	exit( rc ? 1 : 0 );
+}
@@ -10,6 +10,9 @@
 
 	Author:		E. Scott Daniels
 	Date:		31 March 2016
+
+	Mods:		19 Oct 2026 - Add test of a document with many more tokens than
+							the original fixed 1024 token limit.
 */
 
 #include <stdio.h>
@@ -176,6 +179,56 @@ static int check_value( void* jblob, char* field, float expect ) {
 }
 
 
+/*
+	Generate a document with a large value array and a large array of objects
+	(several thousand tokens) and ensure that everything made it through.
+*/
+static int check_large( void ) {
+	void*	jblob;
+	void*	obj;
+	char*	buf;
+	int		len;
+	int		i;
+	int		errors = 0;
+
+	buf = (char *) malloc( 256 * 1024 );
+	len = sprintf( buf, "{ \"name\": \"large\", \"values\": [" );
+	for( i = 0; i < 5000; i++ ) {
+		len += sprintf( buf + len, "%s %d", i ? "," : "", i );
+	}
+	len += sprintf( buf + len, " ], \"vfs\": [" );
+	for( i = 0; i < 300; i++ ) {
+		len += sprintf( buf + len, "%s { \"vfid\": %d, \"mac\": \"fa:16:3e:00:%02x:%02x\" }", i ? "," : "", i, i >> 8, i & 0xff );
+	}
+	sprintf( buf + len, " ], \"last\": \"end\" }" );
+
+	if( (jblob = jw_new( buf )) == NULL ) {
+		fprintf( stderr, "[FAIL]  unable to parse large document\n" );
+		free( buf );
+		return 1;
+	}
+
+	if( jw_array_len( jblob, "values" ) != 5000 || jw_value_ele( jblob, "values", 4999 ) != 4999.0 ) {
+		fprintf( stderr, "[FAIL]  large value array did not parse correctly: len=%d\n", jw_array_len( jblob, "values" ) );
+		errors++;
+	}
+
+	if( jw_array_len( jblob, "vfs" ) != 300 || (obj = jw_obj_ele( jblob, "vfs", 299 )) == NULL || jw_value( obj, "vfid" ) != 299.0 ) {
+		fprintf( stderr, "[FAIL]  large object array did not parse correctly: len=%d\n", jw_array_len( jblob, "vfs" ) );
+		errors++;
+	}
+
+	errors += check_str( jblob, "last", "end" );				// must see things after the large arrays too
+
+	if( ! errors ) {
+		fprintf( stderr, "[OK]   large document parsed correctly\n" );
+	}
+
+	jw_nuke( jblob );
+	free( buf );
+	return errors;
+}
+
 int main( int argc, char **argv ) {
 	void*	jblob;						// parsed json stuff
 	void*	sub_blob;					// nested object
@@ -237,6 +290,9 @@ int main( int argc, char **argv ) {
 
 	jw_nuke( jblob );
 
+	fprintf( stderr, "\n[INFO] testing a document with a large number of tokens\n" );
+	errors += check_large( );
+
 
 	// ----------------------------------------------------------------------------------------
 	if( errors ) {
@@ -34,16 +34,24 @@ void pprint( parms_t* parms ) {
 	fprintf( stderr, "\tlog_keep: %d\n", parms->log_keep );
 	fprintf( stderr, "\tdelete_keep: %d\n", parms->delete_keep );
 	fprintf( stderr, "\tfifo: %s\n", parms->fifo_path );
+	fprintf( stderr, "\tsocket: %s\n", parms->sock_path ? parms->sock_path : "none" );
+	fprintf( stderr, "\treq_workers: %d\n", parms->req_workers );
+	fprintf( stderr, "\tpf owners: %s%s\n", parms->rflags & RF_PF_WORKERS ? "on" : "off", parms->rflags & RF_PF_PIN ? " (pinned)" : "" );
 	fprintf( stderr, "\tcpu_mask: %s\n", parms->cpu_mask );
 	fprintf( stderr, "\tdpdk_log_level: %d\n", parms->dpdk_log_level );
 	fprintf( stderr, "\tdpdk_init_log_level: %d\n", parms->dpdk_init_log_level );
 	fprintf( stderr, "\trflags: 0x%02x\n", parms->rflags );
+	fprintf( stderr, "\tstats: %s every %ds (%s)\n", parms->stats_path, parms->stats_interval, parms->stats_fmt == SF_CSV ? "csv" : "json" );
+	fprintf( stderr, "\tsnapshot: %s (warm restart %s)\n", parms->snap_path, parms->rflags & RF_WARM_RESTART ? "on" : "off" );
 
 	fprintf( stderr, "\tnpciids: %d\n", parms->npciids );
 	for( i = 0; i < parms->npciids; i++ ) {
 		fprintf( stderr, "\tpciid[%d]: %s %d flags=%02x\n", i, parms->pciids[i].id, parms->pciids[i].mtu, parms->pciids[i].flags );
 		fprintf( stderr, "\t\thw_strip_crc=%d\n",  parms->pciids[i].hw_strip_crc );
 		fprintf( stderr, "\t\tpromisc=%d\n",  !!(parms->pciids[i].flags & PFF_PROMISC) );
+		for( j = 0; j < parms->pciids[i].nxstats; j++ ) {
+			fprintf( stderr, "\t\txstats[%d]: %s\n", j, parms->pciids[i].xstats[j] );
+		}
         for( j = 0; j < parms->pciids[i].ntcs; j++ ) {
             if( (tcp = parms->pciids[i].tcs[j]) != NULL ) {				// traffic class defined for this priority
                 fprintf( stderr, "\t\ttclasses[%d]: %s, flags=%02x, max_bw: %d, min_bw: %d\n", j, tcp->hr_name, tcp->flags, tcp->max_bw, tcp->min_bw );
@@ -35,6 +35,11 @@ Date:     11 Feb 2000
 Author:   E. Scott Daniels
 Mod:		2016 23 Feb - converted Symtab refs so that caller need only a
 				void pointer to use and struct does not need to be exposed.
+			2026 19 Oct - FNV-1a hash which is kept with each element and compared
+				before the name; table grows (incrementally) when the load
+				gets high. Fix sym_del() matching on class alone.
+			2026 19 Oct - Lookups don't move chains during a resize; only puts
+				and deletes change the table's structure.
 ------------------------------------------------------------------------------
 */
 
@@ -58,45 +63,135 @@ typedef struct Sym_ele
 	unsigned long rcount;          /* references to symbol */
 	unsigned int flags; 
 	unsigned int class;		/* helps divide things up and allows for duplicate names */
+	unsigned int hv;		/* full hash of the name; compared before the name and used to rehash */
 } Sym_ele;
 
+/*
+	When the table grows a new list is allocated and elements are moved from the
+	old list a few chains at a time as entries are added and deleted, so that no
+	single call pays for rehashing the whole table. While moving, old_list is not
+	nil and chains in it at or above old_next have not yet been moved. Lookups
+	only read the chains, but the table has no lock of its own: a caller sharing
+	a table between threads must keep puts and deletes from running alongside
+	anything else.
+*/
 typedef struct Sym_tab {
 	Sym_ele **symlist;			/* pointer to list of element pointerss */
 	long	inhabitants;             	/* number of active residents */
 	long	deaths;                 	/* number of deletes */
-	long	size;	
+	long	size;					/* always a power of two */
+	Sym_ele	**old_list;			/* list being emptied during a resize */
+	long	old_size;
+	long	old_next;			/* next chain in the old list to move */
+	int		walking;			/* foreach in progress; don't move things */
+	long	resizes;
 } Sym_tab;
 
+#define SYM_MAX_LOAD	2		/* grow when inhabitants/size exceeds this */
+#define SYM_MOVE_CHAINS	4		/* old chains moved per operation during a resize */
+
 /* ----- private functions ---- */
-static int sym_hash( const char *n, long size )
+
+/*
+	FNV-1a hash of the name.
+*/
+static inline unsigned int sym_hash( const char *n )
 {
-	const char *p;
-	unsigned long t = 0;
-	unsigned long tt = 0;
-	unsigned long x = 79;
+	unsigned int hv = 2166136261u;
 
-	for( p = n; *p; p++ )      /* a bit of magic */
-		t = (t * 79 ) + *p;
+	for( ; *n; n++ )
+		hv = (hv ^ (unsigned char) *n) * 16777619u;
 
-	if( t < 0 )
-		t = ~t;
+	return hv;
+}
 
-	return (int ) (t % size);
+/*
+	Return a pointer to the head of the chain where an element with the hash
+	value lives; the old list if it hasn't been moved yet.
+*/
+static inline Sym_ele **sym_chain( Sym_tab *table, unsigned int hv )
+{
+	long i;
+
+	if( table->old_list )
+	{
+		i = hv & (table->old_size - 1);
+		if( i >= table->old_next )
+			return &table->old_list[i];
+	}
+
+	return &table->symlist[hv & (table->size - 1)];
 }
 
-/* delete element pointed to by eptr at hash loc hv */
-static void del_ele( Sym_tab *table, int hv, Sym_ele *eptr )
+/*
+	Move up to n chains from the old list to the new one. Elements carry their
+	hash, so names are not rehashed. The old list is freed once empty.
+*/
+static void sym_move( Sym_tab *table, int n )
 {
-	Sym_ele **sym_tab;
+	Sym_ele *eptr;
+	Sym_ele *next;
+	Sym_ele **head;
 
-	sym_tab = table->symlist;
+	if( table->old_list == NULL || table->walking )
+		return;
+
+	for( ; n > 0 && table->old_next < table->old_size; n--, table->old_next++ )
+	{
+		for( eptr = table->old_list[table->old_next]; eptr; eptr = next )
+		{
+			next = eptr->next;
+			head = &table->symlist[eptr->hv & (table->size - 1)];
+			eptr->prev = NULL;
+			eptr->next = *head;
+			if( *head )
+				(*head)->prev = eptr;
+			*head = eptr;
+		}
+		table->old_list[table->old_next] = NULL;
+	}
+
+	if( table->old_next >= table->old_size )
+	{
+		free( table->old_list );
+		table->old_list = NULL;
+		table->old_size = 0;
+	}
+}
+
+/*
+	Start growing the table if the load is too high and we aren't already
+	in the middle of it. If the new list cannot be allocated we just carry
+	on with longer chains.
+*/
+static void sym_grow( Sym_tab *table )
+{
+	Sym_ele **nlist;
+
+	if( table->old_list || table->walking || table->inhabitants <= table->size * SYM_MAX_LOAD )
+		return;
+
+	if( (nlist = (Sym_ele **) malloc( sizeof( Sym_ele *) * table->size * 2 )) == NULL )
+		return;
+
+	memset( nlist, 0, sizeof( Sym_ele *) * table->size * 2 );
+	table->old_list = table->symlist;
+	table->old_size = table->size;
+	table->old_next = 0;
+	table->symlist = nlist;
+	table->size *= 2;
+	table->resizes++;
+}
 
+/* delete element pointed to by eptr on the chain at head */
+static void del_ele( Sym_tab *table, Sym_ele **head, Sym_ele *eptr )
+{
 	if( eptr )         /* unchain it */
 	{
 		if( eptr->prev )
 			eptr->prev->next = eptr->next;
 		else
-			sym_tab[hv] = eptr->next;
+			*head = eptr->next;
 
 		if( eptr->next )
 			eptr->next->prev = eptr->prev;
@@ -112,14 +207,27 @@ static void del_ele( Sym_tab *table, int hv, Sym_ele *eptr )
 	}
 }
 
-static int same( unsigned int c1, unsigned int c2, const char *s1, const char* s2 )
+static inline int same( unsigned int c1, unsigned int c2, unsigned int h1, unsigned int h2, const char *s1, const char* s2 )
 {
-	if( c1 != c2 )
-		return 0;		/* different class - not the same */
+	if( c1 != c2 || h1 != h2 )
+		return 0;		/* different class or hash - not the same */
 
-	if( *s1 == *s2 && strcmp( s1, s2 ) == 0 )
-		return 1;
-	return 0;
+	return strcmp( s1, s2 ) == 0;
+}
+
+/*
+	Find the element; head is set to the chain it is on (or would be added to).
+	Nothing is moved here so that a lookup never changes the table's structure;
+	chains are moved by puts and deletes only.
+*/
+static Sym_ele *find_ele( Sym_tab *table, const char *name, unsigned int class, unsigned int hv, Sym_ele ***head )
+{
+	Sym_ele *eptr;
+
+	*head = sym_chain( table, hv );
+	for( eptr = **head; eptr && ! same( class, eptr->class, hv, eptr->hv, name, eptr->name ); eptr=eptr->next );
+
+	return eptr;
 }
 
 /* generic rtn to put something into the table */
@@ -127,16 +235,13 @@ static int same( unsigned int c1, unsigned int c2, const char *s1, const char* s
 static int putin( Sym_tab *table, const char *name, unsigned int class, void *val, int flags )
 {
 	Sym_ele *eptr;    	/* pointer into hash table */ 
-	Sym_ele **sym_tab;    	/* pointer into hash table */ 
-	int hv;                  /* hash value */
+	Sym_ele **head;    	/* chain the element lives on */ 
+	unsigned int hv;                  /* hash value */
 	int rc = 0;              /* assume it existed */
 
-	sym_tab = table->symlist;
-
-	hv = sym_hash( name, table->size );
-
-
-	for(eptr=sym_tab[hv]; eptr && ! same( class, eptr->class, eptr->name, name); eptr=eptr->next );
+	sym_move( table, SYM_MOVE_CHAINS );
+	hv = sym_hash( name );
+	eptr = find_ele( table, name, class, hv, &head );
 
 	if( ! eptr )    /* new symbol for the table */
 	{
@@ -153,13 +258,16 @@ static int putin( Sym_tab *table, const char *name, unsigned int class, void *va
 		eptr->flags = flags & (UT_FL_FREE | UT_FL_COPY) ? UT_FL_FREE : 0;		/* set free flag if we made a copy of things */
 		eptr->prev = NULL;
 		eptr->class = class;
+		eptr->hv = hv;
 		eptr->mcount = eptr->rcount = 0;	/* init counters */
 		eptr->val = NULL;                	/* add to head of the list */
 		eptr->name = strdup( name );
-		eptr->next = sym_tab[hv];
-		sym_tab[hv] = eptr;
+		eptr->next = *head;
+		*head = eptr;
 		if( eptr->next )
 			eptr->next->prev = eptr;         /* chain back to new one */
+
+		sym_grow( table );
 	}
 
 	eptr->mcount++;
@@ -191,7 +299,18 @@ void sym_clear( void *vtable )
 
 	for( i = 0; i < table->size; i++ )
 		while( sym_tab[i] ) 
-			del_ele( table, i, sym_tab[i] );
+			del_ele( table, &sym_tab[i], sym_tab[i] );
+
+	if( (sym_tab = table->old_list) != NULL )		/* resize in progress; nothing left to move */
+	{
+		for( i = table->old_next; i < table->old_size; i++ )
+			while( sym_tab[i] ) 
+				del_ele( table, &sym_tab[i], sym_tab[i] );
+
+		free( table->old_list );
+		table->old_list = NULL;
+		table->old_size = 0;
+	}
 }
 
 /*
@@ -218,6 +337,7 @@ void sym_dump( void *vtable )
 	Sym_ele **sym_tab;
 
 	table = (Sym_tab *) vtable;
+	sym_move( table, table->old_size );		/* finish any resize so there is just one list */
 	sym_tab = table->symlist;
 
 	for( i = 0; i < table->size; i++ )
@@ -233,15 +353,16 @@ void sym_dump( void *vtable )
 	}
 }
 
-/* allocate a table the size requested - best if size is prime */
+/* allocate a table with at least the size requested; the size is rounded */
+/* up to a power of two and the table grows as needed */
 /* returns a pointer to the management block */
 void *sym_alloc( int size )
 {
 	int i;
 	Sym_tab *table;
 
-	if( size < 11 )     /* provide a bit of sanity */
-		size = 11;
+	for( i = 16; i < size && i < 0x40000000; i <<= 1 );     /* provide a bit of sanity */
+	size = i;
 
 	if( (table = (Sym_tab *) malloc( sizeof( Sym_tab ))) == NULL )
 	{
@@ -269,35 +390,26 @@ void *sym_alloc( int size )
 void sym_del( void *vtable, const char *name, unsigned int class )
 {
 	Sym_tab	*table;
-	Sym_ele **sym_tab;
+	Sym_ele **head;
 	Sym_ele *eptr;    /* pointer into hash table */ 
-	int hv;                  /* hash value */
 
 	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
-
-	hv = sym_hash( name, table->size );
 
-	for(eptr=sym_tab[hv]; eptr && eptr->class != class &&  ! same(class, eptr->class, eptr->name, name); eptr=eptr->next );
-
-	del_ele( table, hv, eptr );    /* ignors null ptr, so safe to always call */
+	sym_move( table, SYM_MOVE_CHAINS );
+	eptr = find_ele( table, name, class, sym_hash( name ), &head );
+	del_ele( table, head, eptr );    /* ignors null ptr, so safe to always call */
 }
 
 
 void *sym_get( void *vtable, const char *name, unsigned int class )
 {
 	Sym_tab	*table;
-	Sym_ele **sym_tab;
+	Sym_ele **head;
 	Sym_ele *eptr;    /* pointer into hash table */ 
-	int hv;                  /* hash value */
 
 	table = (Sym_tab *) vtable;
-	sym_tab = table->symlist;
-
-	hv = sym_hash( name, table->size );
-
-	for(eptr=sym_tab[hv]; eptr && ! same( eptr->class, class, eptr->name, name); eptr=eptr->next );
 
+	eptr = find_ele( table, name, class, sym_hash( name ), &head );
 	if( eptr )
 	{
 		eptr->rcount++;
@@ -364,6 +476,7 @@ void sym_stats( void *vtable, int level )
 	int twoper = 0;
 
 	table = (Sym_tab *) vtable;
+	sym_move( table, table->old_size );		/* finish any resize so there is just one list */
 	sym_tab = table->symlist;
 
 	for( i = 0; i < table->size; i++ )
@@ -406,8 +519,8 @@ void sym_stats( void *vtable, int level )
 		fprintf( stderr, "\n" );
 	}
 
-	fprintf( stderr, "sym:%ld(size)  %ld(inhab) %ld(occupied) %ld(dead) %ld(maxch) %d(>2per)\n", 
-			table->size, table->inhabitants, table->size - empty, table->deaths, max_chain, twoper );
+	fprintf( stderr, "sym:%ld(size)  %ld(inhab) %ld(occupied) %ld(dead) %ld(maxch) %d(>2per) %ld(resizes)\n", 
+			table->size, table->inhabitants, table->size - empty, table->deaths, max_chain, twoper, table->resizes );
 }
 
 void sym_foreach_class( void *vst, unsigned int class, void (* user_fun)( void*, void*, const char*, void*, void* ), void *user_data )
@@ -421,6 +534,8 @@ void sym_foreach_class( void *vst, unsigned int class, void (* user_fun)( void*,
 	st = (Sym_tab *) vst;
 
 	if( st && (list = st->symlist) != NULL && user_fun != NULL )
+	{
+		st->walking++;			/* nothing may move while we walk (user may delete via this) */
 		for( i = 0; i < st->size; i++ )
 			for( se = list[i]; se; se = next )		/* using next allows user to delet via this */
 			{
@@ -428,4 +543,15 @@ void sym_foreach_class( void *vst, unsigned int class, void (* user_fun)( void*,
 				if( class == se->class )
 					user_fun( st, se, se->name, se->val, user_data );
 			}
+
+		if( (list = st->old_list) != NULL )		/* resize in progress; walk what hasn't been moved */
+			for( i = st->old_next; i < st->old_size; i++ )
+				for( se = list[i]; se; se = next )
+				{
+					next = se->next;
+					if( class == se->class )
+						user_fun( st, se, se->name, se->val, user_data );
+				}
+		st->walking--;
+	}
 }
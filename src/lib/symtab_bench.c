@@ -0,0 +1,117 @@
+// :vi ts=4 sw=4:
+/*
+	Mnemonic:	symtab_bench.c
+	Abstract:	Benchmark for the symbol table. MAC address style names are
+				added to a table which starts small (as vfd's mac table does),
+				looked up (hits and misses) and then deleted. The time for each
+				phase is reported and sym_stats() is used to show the chain
+				lengths once the table has been loaded. A non-zero exit is
+				returned if any lookup gives the wrong answer.
+
+				symtab_bench [names [classes]]
+
+	Date:		19 October 2026
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "symtab.h"
+
+static double now_us( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (double) ts.tv_sec * 1000000.0 + (double) ts.tv_nsec / 1000.0;
+}
+
+static void report( const char* what, int n, double elapsed ) {
+	fprintf( stderr, "[OK]   %-12s %8d ops  %8.1f ms  %7.3f us/op\n", what, n, elapsed / 1000.0, elapsed / n );
+}
+
+int main( int argc, char** argv ) {
+	void*	st;
+	char**	names;
+	char	buf[64];
+	double	start;
+	int		nnames = 200000;
+	int		nclasses = 4;
+	int		i;
+	int		errors = 0;
+	long	val;
+
+	if( argc > 1 ) {
+		nnames = atoi( argv[1] );
+	}
+	if( argc > 2 ) {
+		nclasses = atoi( argv[2] );
+	}
+	if( nnames <= 0 || nclasses <= 0 ) {
+		fprintf( stderr, "usage: %s [names [classes]]\n", argv[0] );
+		exit( 1 );
+	}
+
+	names = (char **) malloc( sizeof( *names ) * nnames );
+	for( i = 0; i < nnames; i++ ) {
+		snprintf( buf, sizeof( buf ), "fa:16:3e:%02x:%02x:%02x", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff );
+		names[i] = strdup( buf );
+	}
+
+	st = sym_alloc( 1023 );
+
+	start = now_us();
+	for( i = 0; i < nnames; i++ ) {
+		sym_map( st, names[i], i % nclasses, (void *) (long) (i + 1) );
+	}
+	report( "insert", nnames, now_us() - start );
+
+	sym_stats( st, 1 );
+
+	start = now_us();
+	for( i = 0; i < nnames; i++ ) {
+		val = (long) sym_get( st, names[i], i % nclasses );
+		if( val != i + 1 ) {
+			errors++;
+		}
+	}
+	report( "lookup-hit", nnames, now_us() - start );
+
+	start = now_us();
+	for( i = 0; i < nnames; i++ ) {
+		if( sym_get( st, names[i], nclasses ) != NULL ) {		// no name was added with this class
+			errors++;
+		}
+	}
+	report( "lookup-miss", nnames, now_us() - start );
+
+	start = now_us();
+	for( i = 0; i < nnames; i += 2 ) {
+		sym_del( st, names[i], i % nclasses );
+	}
+	report( "delete-half", (nnames + 1) / 2, now_us() - start );
+
+	for( i = 0; i < nnames; i++ ) {
+		val = (long) sym_get( st, names[i], i % nclasses );
+		if( (i & 1) ? val != i + 1 : val != 0 ) {
+			errors++;
+		}
+	}
+
+	sym_stats( st, 1 );
+	sym_free( st );
+
+	for( i = 0; i < nnames; i++ ) {
+		free( names[i] );
+	}
+	free( names );
+
+	if( errors ) {
+		fprintf( stderr, "[FAIL] %d lookups returned the wrong value\n", errors );
+		exit( 1 );
+	}
+
+	fprintf( stderr, "[OK]   all lookups returned the expected value\n" );
+	exit( 0 );
+}
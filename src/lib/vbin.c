@@ -0,0 +1,495 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vbin.c
+	Abstract:	Compact binary framing for vfd requests and responses, and a small
+				client for the vfd request socket which uses it. The binary form is
+				an alternative to json for callers which send requests at a high
+				rate; vfd reads and answers it without building or parsing json.
+
+				A frame is a six byte header followed by a body of TLVs:
+					byte 0		VB_MAGIC (never the first byte of a json request)
+					byte 1		VB_VERSION
+					bytes 2-5	body length, network byte order
+
+				Each TLV is a one byte tag, a two byte value length (network byte
+				order) and the value. Strings are not nil terminated; integers are
+				unsigned and in network byte order in as many bytes as the length
+				says (1 to 8). Unknown tags are skipped so that either side may add
+				tags without breaking the other.
+
+				A request carries the action (same names as json), and optionally
+				the rid, resource (or filename), output, log level and async flag.
+				A response carries the kind (response or the completion of an async
+				operation), state, rid, op id (async) and the message as a single
+				string; newlines are kept and there is no @eom@ marker. A message
+				longer than a TLV can hold is sent as several VBT_MSG TLVs which the
+				reader concatenates.
+
+	Date:		19 October 2026
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+
+#include "vfdlib.h"
+
+/*
+	Grow the buffer so that it can take n more bytes. Returns 0 on failure.
+*/
+static int vb_room( vb_buf_t* b, int n ) {
+	unsigned char* nd;
+	int	nsize;
+
+	if( b->len + n <= b->size ) {
+		return 1;
+	}
+
+	nsize = b->size * 2 > b->len + n ? b->size * 2 : b->len + n + 256;
+	if( (nd = (unsigned char *) realloc( b->data, nsize )) == NULL ) {
+		return 0;
+	}
+	b->data = nd;
+	b->size = nsize;
+
+	return 1;
+}
+
+/*
+	Put an unsigned value into n bytes, network byte order.
+*/
+static void vb_put_uint( unsigned char* p, uint64_t v, int n ) {
+	while( n-- > 0 ) {
+		p[n] = (unsigned char) (v & 0xff);
+		v >>= 8;
+	}
+}
+
+/*
+	Read a frame's worth of bytes from the file descriptor (blocking). Returns
+	a malloc'd buffer with the whole frame and sets flen, or nil on error/eof.
+*/
+static unsigned char* vb_read_frame( int fd, int* flen ) {
+	unsigned char	hdr[VB_HDR_LEN];
+	unsigned char*	buf;
+	int	need;
+	int	got;
+	int	n;
+
+	for( got = 0; got < VB_HDR_LEN; got += n ) {
+		if( (n = read( fd, hdr + got, VB_HDR_LEN - got )) <= 0 ) {
+			if( n < 0 && errno == EINTR ) {
+				n = 0;
+				continue;
+			}
+			return NULL;
+		}
+	}
+
+	if( (need = vb_frame_len( hdr, VB_HDR_LEN )) <= 0 || (buf = (unsigned char *) malloc( need )) == NULL ) {
+		errno = EBADMSG;
+		return NULL;
+	}
+	memcpy( buf, hdr, VB_HDR_LEN );
+
+	for( ; got < need; got += n ) {
+		if( (n = read( fd, buf + got, need - got )) <= 0 ) {
+			if( n < 0 && errno == EINTR ) {
+				n = 0;
+				continue;
+			}
+			free( buf );
+			return NULL;
+		}
+	}
+
+	*flen = need;
+	return buf;
+}
+
+// ---- framing --------------------------------------------------------------------------------------------
+
+/*
+	Start a frame. Size is a hint for the initial allocation; the buffer grows as
+	needed. Returns nil if memory cannot be had.
+*/
+extern vb_buf_t* vb_start( int size ) {
+	vb_buf_t* b;
+
+	if( (b = (vb_buf_t *) malloc( sizeof( *b ) )) == NULL ) {
+		return NULL;
+	}
+
+	b->size = size > VB_HDR_LEN ? size : 256;
+	if( (b->data = (unsigned char *) malloc( b->size )) == NULL ) {
+		free( b );
+		return NULL;
+	}
+
+	b->data[0] = VB_MAGIC;
+	b->data[1] = VB_VERSION;
+	b->len = VB_HDR_LEN;
+	b->err = 0;
+
+	return b;
+}
+
+/*
+	Add a TLV with len bytes of value. Returns 0 (and marks the frame bad) if the
+	value is too long or memory cannot be had; vb_finish() then fails.
+*/
+extern int vb_add( vb_buf_t* b, int tag, const void* val, int len ) {
+	if( b == NULL || len < 0 || len > VB_MAX_VALUE || ! vb_room( b, len + 3 ) ) {
+		if( b != NULL ) {
+			b->err = 1;
+		}
+		return 0;
+	}
+
+	b->data[b->len] = (unsigned char) tag;
+	vb_put_uint( b->data + b->len + 1, len, 2 );
+	if( len > 0 ) {
+		memcpy( b->data + b->len + 3, val, len );
+	}
+	b->len += len + 3;
+
+	return 1;
+}
+
+/*
+	Add a string TLV; nothing is added if the string is nil. A string longer than
+	VB_MAX_VALUE is added as several TLVs with the same tag (the reader concatenates
+	them).
+*/
+extern int vb_add_str( vb_buf_t* b, int tag, const char* s ) {
+	int	len;
+	int	n;
+
+	if( s == NULL ) {
+		return 1;
+	}
+
+	len = strlen( s );
+	do {
+		n = len > VB_MAX_VALUE ? VB_MAX_VALUE : len;
+		if( ! vb_add( b, tag, s, n ) ) {
+			return 0;
+		}
+		s += n;
+		len -= n;
+	} while( len > 0 );
+
+	return 1;
+}
+
+/*
+	Add an unsigned integer TLV using n bytes (1-8).
+*/
+extern int vb_add_uint( vb_buf_t* b, int tag, uint64_t v, int n ) {
+	unsigned char	ibuf[8];
+
+	if( n < 1 || n > 8 ) {
+		n = 8;
+	}
+	vb_put_uint( ibuf, v, n );
+
+	return vb_add( b, tag, ibuf, n );
+}
+
+/*
+	Fill in the body length. Returns the length of the whole frame (data[0]
+	through data[len-1]), or -1 if an add failed or the frame is over the max.
+*/
+extern int vb_finish( vb_buf_t* b ) {
+	if( b == NULL || b->err || b->len > VB_MAX_FRAME ) {
+		return -1;
+	}
+
+	vb_put_uint( b->data + 2, b->len - VB_HDR_LEN, 4 );
+	return b->len;
+}
+
+/*
+	Free the frame buffer.
+*/
+extern void vb_free( vb_buf_t* b ) {
+	if( b == NULL ) {
+		return;
+	}
+
+	if( b->data != NULL ) {
+		free( b->data );
+	}
+	free( b );
+}
+
+/*
+	Given the first len bytes received, return the length of the whole frame. Returns
+	0 if the header isn't all there yet, and -1 if this isn't a frame we can take
+	(wrong magic or version, or longer than VB_MAX_FRAME).
+*/
+extern int vb_frame_len( const unsigned char* buf, int len ) {
+	uint64_t blen;
+
+	if( buf == NULL || len < 1 ) {
+		return 0;
+	}
+	if( buf[0] != VB_MAGIC || (len > 1 && buf[1] != VB_VERSION) ) {
+		return -1;
+	}
+	if( len < VB_HDR_LEN ) {
+		return 0;
+	}
+
+	blen = vb_uint( buf + 2, 4 );
+	if( blen > VB_MAX_FRAME - VB_HDR_LEN ) {
+		return -1;
+	}
+
+	return (int) blen + VB_HDR_LEN;
+}
+
+/*
+	Step through the TLVs in a complete frame. Len is the number of bytes actually in
+	the buffer; nothing past it is read even if the header claims more (such a frame
+	is treated as empty). Off is the caller's cursor and must be 0 on the first call.
+	Returns 1 and sets tag, val and vlen for each TLV; returns 0 at the end of the
+	frame or if a TLV runs past it.
+*/
+extern int vb_next( const unsigned char* frame, int len, int* off, int* tag, const unsigned char** val, int* vlen ) {
+	int	flen;
+	int	o;
+
+	if( frame == NULL || off == NULL || len < VB_HDR_LEN || (flen = vb_frame_len( frame, len )) <= 0 || flen > len ) {
+		return 0;
+	}
+
+	o = *off < VB_HDR_LEN ? VB_HDR_LEN : *off;
+	if( o + 3 > flen ) {
+		return 0;
+	}
+
+	*tag = frame[o];
+	*vlen = (int) vb_uint( frame + o + 1, 2 );
+	if( o + 3 + *vlen > flen ) {
+		return 0;
+	}
+
+	*val = frame + o + 3;
+	*off = o + 3 + *vlen;
+	return 1;
+}
+
+/*
+	Return the value as an unsigned integer (network byte order, up to 8 bytes).
+*/
+extern uint64_t vb_uint( const unsigned char* val, int vlen ) {
+	uint64_t v = 0;
+	int	i;
+
+	for( i = 0; i < vlen && i < 8; i++ ) {
+		v = (v << 8) | val[i];
+	}
+
+	return v;
+}
+
+/*
+	Return a nil terminated copy of a string value. Caller must free.
+*/
+extern char* vb_strdup( const unsigned char* val, int vlen ) {
+	char*	s;
+
+	if( (s = (char *) malloc( vlen + 1 )) == NULL ) {
+		return NULL;
+	}
+	memcpy( s, val, vlen );
+	s[vlen] = 0;
+
+	return s;
+}
+
+// ---- client -------------------------------------------------------------------------------------------
+
+/*
+	Connect to the vfd request socket. Returns the file descriptor or -1 on error
+	(errno is set).
+*/
+extern int vbc_connect( const char* path ) {
+	struct sockaddr_un	addr;
+	int	fd;
+
+	if( path == NULL || strlen( path ) >= sizeof( addr.sun_path ) ) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if( (fd = socket( AF_UNIX, SOCK_STREAM, 0 )) < 0 ) {
+		return -1;
+	}
+
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sun_family = AF_UNIX;
+	strcpy( addr.sun_path, path );
+	if( connect( fd, (struct sockaddr *) &addr, sizeof( addr ) ) < 0 ) {
+		close( fd );
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+	Send a request. Action is one of the json action names (add, delete, show, ping...);
+	resource is the config file name or show target and may be nil, as may rid. Returns
+	0 on success, -1 on error (errno is set).
+*/
+extern int vbc_send( int fd, const char* action, const char* rid, const char* resource, int loglevel, int async ) {
+	vb_buf_t*	b;
+	int	len;
+	int	n;
+	int	off;
+
+	if( action == NULL || (b = vb_start( 256 )) == NULL ) {
+		errno = action == NULL ? EINVAL : ENOMEM;
+		return -1;
+	}
+
+	vb_add_str( b, VBT_ACTION, action );
+	vb_add_str( b, VBT_RID, rid );
+	vb_add_str( b, VBT_RESOURCE, resource );
+	if( loglevel > 0 ) {
+		vb_add_uint( b, VBT_LOGLEVEL, loglevel, 1 );
+	}
+	if( async ) {
+		vb_add_uint( b, VBT_ASYNC, 1, 1 );
+	}
+
+	if( (len = vb_finish( b )) < 0 ) {
+		vb_free( b );
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	for( off = 0; off < len; off += n ) {
+		if( (n = write( fd, b->data + off, len - off )) <= 0 ) {
+			if( n < 0 && errno == EINTR ) {
+				n = 0;
+				continue;
+			}
+			vb_free( b );
+			return -1;
+		}
+	}
+
+	vb_free( b );
+	return 0;
+}
+
+/*
+	Append a value to a nil terminated string (nil to start); returns the new
+	string. The old one is freed.
+*/
+static char* vb_strcat( char* s, const unsigned char* val, int vlen ) {
+	char*	ns;
+	int		slen;
+
+	if( s == NULL ) {
+		return vb_strdup( val, vlen );
+	}
+
+	slen = strlen( s );
+	if( (ns = (char *) realloc( s, slen + vlen + 1 )) == NULL ) {
+		return s;
+	}
+	memcpy( ns + slen, val, vlen );
+	ns[slen + vlen] = 0;
+
+	return ns;
+}
+
+/*
+	Read the next message from vfd (blocking): a response, or the completion of an
+	async operation (kind is VBK_COMPLETE). Returns nil on error or if vfd closed the
+	connection. Caller must free with vbc_free_resp().
+*/
+extern vb_resp_t* vbc_read( int fd ) {
+	vb_resp_t*	r;
+	unsigned char*	frame;
+	const unsigned char* val;
+	int	flen;
+	int	off = 0;
+	int	tag;
+	int	vlen;
+
+	if( (frame = vb_read_frame( fd, &flen )) == NULL ) {
+		return NULL;
+	}
+
+	if( (r = (vb_resp_t *) malloc( sizeof( *r ) )) == NULL ) {
+		free( frame );
+		return NULL;
+	}
+	memset( r, 0, sizeof( *r ) );
+	r->kind = VBK_RESPONSE;
+
+	while( vb_next( frame, flen, &off, &tag, &val, &vlen ) ) {
+		switch( tag ) {
+			case VBT_KIND:		r->kind = (int) vb_uint( val, vlen ); break;
+			case VBT_STATE:		r->state = (int) vb_uint( val, vlen ); break;
+			case VBT_OPID:		r->op_id = vb_uint( val, vlen ); break;
+			case VBT_RID:		if( r->rid == NULL ) r->rid = vb_strdup( val, vlen ); break;
+			case VBT_MSG:		r->msg = vb_strcat( r->msg, val, vlen ); break;
+			default:			break;								// newer tag; ignore
+		}
+	}
+
+	free( frame );
+	return r;
+}
+
+/*
+	Send a request and wait for its response. Completions of earlier async
+	operations which arrive first are passed to cb (if given) and otherwise
+	dropped. Returns nil on error.
+*/
+extern vb_resp_t* vbc_request( int fd, const char* action, const char* rid, const char* resource, int loglevel, int async, void (*cb)( vb_resp_t* ) ) {
+	vb_resp_t*	r;
+
+	if( vbc_send( fd, action, rid, resource, loglevel, async ) < 0 ) {
+		return NULL;
+	}
+
+	while( (r = vbc_read( fd )) != NULL && r->kind == VBK_COMPLETE ) {
+		if( cb != NULL ) {
+			cb( r );
+		}
+		vbc_free_resp( r );
+	}
+
+	return r;
+}
+
+/*
+	Free a response.
+*/
+extern void vbc_free_resp( vb_resp_t* r ) {
+	if( r == NULL ) {
+		return;
+	}
+
+	if( r->rid != NULL ) {
+		free( r->rid );
+	}
+	if( r->msg != NULL ) {
+		free( r->msg );
+	}
+	free( r );
+}
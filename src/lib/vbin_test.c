@@ -0,0 +1,190 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vbin_test.c
+	Abstract:	Tests for the binary request framing: builds a request and picks it
+				apart as vfd does, checks that short and bad frames are recognised,
+				and reads responses with the client over a socket pair.
+	Date:		19 October 2026
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vfdlib.h"
+
+/*
+	Write a response frame to fd as vfd would.
+*/
+static int send_resp( int fd, int kind, int state, uint64_t op_id, const char* rid, const char* msg ) {
+	vb_buf_t*	b;
+	int	len;
+	int	rc;
+
+	b = vb_start( 64 );
+	vb_add_uint( b, VBT_KIND, kind, 1 );
+	vb_add_uint( b, VBT_STATE, state, 1 );
+	if( op_id ) {
+		vb_add_uint( b, VBT_OPID, op_id, 8 );
+	}
+	vb_add_str( b, VBT_RID, rid );
+	vb_add_str( b, VBT_MSG, msg );
+	vb_add_uint( b, 99, 7, 2 );					// tag the client doesn't know; must be skipped
+
+	len = vb_finish( b );
+	rc = write( fd, b->data, len ) == len;
+	vb_free( b );
+
+	return rc;
+}
+
+static int ncb = 0;
+static void completion( vb_resp_t* r ) {
+	if( r->op_id == 42 ) {
+		ncb++;
+	}
+}
+
+int main( ) {
+	vb_buf_t*	b;
+	vb_resp_t*	r;
+	const unsigned char* val;
+	unsigned char	big[VB_HDR_LEN];
+	char*	action = NULL;
+	char*	resource = NULL;
+	int		fds[2];
+	int		flen;
+	int		off = 0;
+	int		tag;
+	int		vlen;
+	int		level = 0;
+	int		async = 0;
+	int		errors = 0;
+	char	long_msg[VB_MAX_VALUE * 2 + 100];
+
+	b = vb_start( 8 );								// small so that the buffer must grow
+	vb_add_str( b, VBT_ACTION, "add" );
+	vb_add_str( b, VBT_RID, "rid-1" );
+	vb_add_str( b, VBT_RESOURCE, "/var/lib/vfd/config/vm1.json" );
+	vb_add_str( b, VBT_OUTPUT, NULL );				// nil adds nothing
+	vb_add_uint( b, VBT_LOGLEVEL, 2, 1 );
+	vb_add_uint( b, VBT_ASYNC, 1, 1 );
+	if( (flen = vb_finish( b )) != b->len ) {
+		printf( "[FAIL] finish returned %d, expected %d\n", flen, b->len );
+		errors++;
+	}
+
+	if( vb_frame_len( b->data, 3 ) != 0 || vb_frame_len( b->data, flen ) != flen ) {
+		printf( "[FAIL] frame length not recognised correctly (partial or whole)\n" );
+		errors++;
+	} else {
+		printf( "[OK]   frame of %d bytes recognised\n", flen );
+	}
+
+	if( vb_next( b->data, flen - 1, &off, &tag, &val, &vlen ) || off != 0 ) {		// header claims more than the buffer holds
+		printf( "[FAIL] truncated frame was not refused\n" );
+		errors++;
+	} else {
+		printf( "[OK]   truncated frame refused\n" );
+	}
+
+	while( vb_next( b->data, flen, &off, &tag, &val, &vlen ) ) {
+		switch( tag ) {
+			case VBT_ACTION:	action = vb_strdup( val, vlen ); break;
+			case VBT_RESOURCE:	resource = vb_strdup( val, vlen ); break;
+			case VBT_LOGLEVEL:	level = (int) vb_uint( val, vlen ); break;
+			case VBT_ASYNC:		async = (int) vb_uint( val, vlen ); break;
+			case VBT_OUTPUT:	printf( "[FAIL] nil string was added\n" ); errors++; break;
+		}
+	}
+	if( off != flen || action == NULL || strcmp( action, "add" ) != 0 || resource == NULL ||
+		strcmp( resource, "/var/lib/vfd/config/vm1.json" ) != 0 || level != 2 || async != 1 ) {
+		printf( "[FAIL] request did not decode: off=%d action=%s resource=%s level=%d async=%d\n",
+			off, action ? action : "nil", resource ? resource : "nil", level, async );
+		errors++;
+	} else {
+		printf( "[OK]   request decoded\n" );
+	}
+	free( action );
+	free( resource );
+
+	b->data[1] = VB_VERSION + 1;
+	if( vb_frame_len( b->data, flen ) != -1 ) {
+		printf( "[FAIL] wrong version was not rejected\n" );
+		errors++;
+	}
+	vb_free( b );
+
+	big[0] = VB_MAGIC;
+	big[1] = VB_VERSION;
+	big[2] = big[3] = big[4] = big[5] = 0x7f;
+	if( vb_frame_len( big, VB_HDR_LEN ) != -1 || vb_frame_len( (unsigned char *) "{ \"action\"", 10 ) != -1 ) {
+		printf( "[FAIL] oversized frame or json was not rejected\n" );
+		errors++;
+	} else {
+		printf( "[OK]   bad frames rejected\n" );
+	}
+
+	memset( long_msg, 'x', sizeof( long_msg ) );				// must go as more than one tlv
+	long_msg[sizeof( long_msg ) - 1] = 0;
+	b = vb_start( 0 );
+	vb_add( b, VBT_MSG, long_msg, VB_MAX_VALUE + 1 );				// too long for one tlv
+	if( vb_finish( b ) != -1 ) {
+		printf( "[FAIL] oversized value was not refused\n" );
+		errors++;
+	}
+	vb_free( b );
+
+	if( socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) < 0 ) {
+		printf( "[FAIL] unable to create socket pair\n" );
+		return 1;
+	}
+
+	send_resp( fds[1], VBK_COMPLETE, 0, 42, "earlier", "vf added successfully" );
+	send_resp( fds[1], VBK_RESPONSE, 1, 0, "rid-2", "line one\nline two" );
+	send_resp( fds[1], VBK_RESPONSE, 0, 0, "rid-3", long_msg );
+	if( (r = vbc_request( fds[0], "show", "rid-2", "all", 0, 0, completion )) == NULL ) {
+		printf( "[FAIL] no response read\n" );
+		errors++;
+	} else {
+		if( ncb != 1 || r->kind != VBK_RESPONSE || r->state != 1 || r->rid == NULL || strcmp( r->rid, "rid-2" ) != 0 ||
+			r->msg == NULL || strcmp( r->msg, "line one\nline two" ) != 0 ) {
+			printf( "[FAIL] response not as expected: ncb=%d kind=%d state=%d rid=%s\n", ncb, r->kind, r->state, r->rid ? r->rid : "nil" );
+			errors++;
+		} else {
+			printf( "[OK]   response read; earlier completion passed to the callback\n" );
+		}
+		vbc_free_resp( r );
+	}
+
+	if( (r = vbc_read( fds[0] )) == NULL || r->msg == NULL || strcmp( r->msg, long_msg ) != 0 ) {
+		printf( "[FAIL] long message was not reassembled\n" );
+		errors++;
+	} else {
+		printf( "[OK]   long message reassembled (%d bytes)\n", (int) strlen( r->msg ) );
+	}
+	vbc_free_resp( r );
+
+	if( (r = vbc_read( fds[1] )) == NULL ) {		// the request the client sent must read back as a frame
+		printf( "[FAIL] request sent by the client was not readable as a frame\n" );
+		errors++;
+	} else {
+		vbc_free_resp( r );
+	}
+
+	close( fds[1] );
+	if( (r = vbc_read( fds[0] )) != NULL ) {
+		printf( "[FAIL] read after close returned a response\n" );
+		vbc_free_resp( r );
+		errors++;
+	}
+	close( fds[0] );
+
+	printf( "%s vbin tests\n", errors ? "[FAIL]" : "[OK]  " );
+	return errors ? 1 : 0;
+}
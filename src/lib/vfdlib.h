@@ -16,6 +16,57 @@
 #define JWFMT_INT		2
 #define JWFMT_FLOAT		3
 
+// ----- jw_decode ------------------------
+#define JW_STRING		1			// value types (jw_val_t type)
+#define JW_VALUE		2
+#define JW_BOOL			3
+#define JW_NULL			4
+#define JW_ARRAY		5
+#define JW_OBJECT		6
+
+#define JWD_IGNORE		0			// schema field types: known field, but nothing done with it
+#define JWD_BOOL		1			// boolean into an int
+#define JWD_INT			2			// value into an int
+#define JWD_NUM			3			// value or boolean into an int
+#define JWD_FLOAT		4			// value or boolean into a float
+#define JWD_DOUBLE		5			// value or boolean into a double
+#define JWD_STR			6			// string, leading space trimmed, into a malloc'd char*
+#define JWD_FLAG		7			// boolean; true sets, false clears, bit(s) arg in an unsigned int
+#define JWD_NFLAG		8			// boolean; false sets, true clears, bit(s) arg
+#define JWD_FUNC		9			// fn is called to deal with the value
+
+/*
+	A value as it is presented to a JWD_FUNC function. Str is valid for strings,
+	num for values and booleans (0/1), and len is the number of elements in an
+	array. The remaining fields are for the decoder.
+*/
+typedef struct {
+	int			type;				// JW_ constants
+	const char*	name;				// field name
+	char*		str;
+	double		num;
+	int			len;
+
+	void*		dctx;				// decoder private
+	int			tok;
+	int			ctok;				// array element cursor
+	int			cidx;
+} jw_val_t;
+
+/*
+	Maps a json field name to a member of the target struct. Fn is invoked for
+	JWD_FUNC fields with the target, the value and the user data pointer given
+	to jw_decode(); it returns 1 if all is well, 0 if the value was not usable
+	(a warning is generated) or -1 to abort the decode.
+*/
+typedef struct {
+	const char*	name;
+	int			type;				// JWD_ constants
+	size_t		offset;				// offsetof() the member in the target struct
+	unsigned int arg;				// flag bits for JWD_FLAG/JWD_NFLAG
+	int			(*fn)( void* target, jw_val_t* val, void* data );
+} jw_field_t;
+
 //----------------- config.c --------------------------------------------------------------------------
 #define MIRROR_OFF			0		// mirror directions
 #define MIRROR_IN			1		// mirror just inbound traffic
@@ -36,6 +87,17 @@
 #define RF_INITIALISED	0x02		// init has finished
 #define RF_ENABLE_FC	0x04		// enable flow control for all PFs
 #define RF_NO_HUGE		0x08		// disable huget pages
+#define RF_ASYNC_LOG	0x10		// bleat messages are queued and written by a separate thread
+#define RF_LOG_COMPRESS	0x20		// rolled log files are compressed
+#define RF_WARM_RESTART	0x40		// save the running config snapshot and restore from it at start (off by default)
+#define RF_REATTACH		0x80		// adopt running ports rather than resetting them; leave them running on exit
+#define RF_WATCH_CFG	0x100		// watch the config directories (inotify) and apply changes without a request
+#define RF_PF_WORKERS	0x200		// each PF is programmed by its own (owner) thread during nic updates
+#define RF_PF_PIN		0x400		// pin each PF owner thread to the cpus local to the PF
+
+									// stats dump formats (parms stats_fmt)
+#define SF_JSON			0
+#define SF_CSV			1
 
 #define MAX_TCS			8			// max number of traffic classes supported (0 - 7)
 #define NUM_BWGS		8			// number of bandwidth groups
@@ -72,6 +134,8 @@ typedef struct {
     int32_t ntcs;					// number of TCs (4 or 8)
     tc_class_t* tcs[MAX_TCS];		// defined TCs (0-3 or 0-7) position in the array is the priority (from pri in the json)
     bw_grp_t    bw_grps[NUM_BWGS];	// definition of each bandwidth group
+	int		nxstats;				// number of xstat name prefixes in xstats
+	char**	xstats;					// xstat name prefixes to export for the PF (nil == use the default set)
 } pfdef_t;
 
 /*
@@ -84,12 +148,19 @@ typedef struct {
 	int		dpdk_log_level;			// log level passed to dpdk; allow it to be different than verbose level
 	int		dpdk_init_log_level;	// log level for dpdk during initialisation
 	char*	fifo_path;      		// path to fifo that cli will write to
+	char*	sock_path;				// unix domain socket for requests (persistent connections); nil disables
+	int		req_workers;			// threads serving read only requests (ping, show, export) from config snapshots; 0 disables
 	int		log_keep;       		// number of days of logs to keep (do we need this?)
+	int		log_dedup;				// seconds identical messages from a call site are suppressed; 0 (default) disables
+	int		log_rate_max;			// max messages per second from a single call site; 0 (default) disables
 	int		delete_keep;			// if true we will keep the deleted config files in the confid directory (marked with trailing -)
 	double	cpu_alrm_thresh;		// we'll alarm if our cpu usage is over this amount
 	char*	cpu_alrm_type;			// allow user to decide if these are critical, errors, or just warnings; default is warn
 	char*	config_dir;     		// directory where nova writes pf config files
 	char*	stats_path;				// filename where we might dump stats
+	int		stats_interval;			// seconds between stats dumps to stats_path; 0 disables
+	int		stats_fmt;				// format of the stats dump (SF_ constants)
+	char*	snap_path;				// filename where the running config snapshot is kept for warm restart
 	char*	pid_fname;				// if we daemonise we should write our pid here.
 	char*	cpu_mask;				// should be something like 0x04, but could be decimal.  string so it can have lead 0x
 	char*	numa_mem;				// something like 64 or 64,64 or 64,128.  For our little app, the default 64,64 should be fine
@@ -183,6 +254,16 @@ extern void free_list( char** list, int size );
 #define BLEAT_ADD_DATE	1
 #define BLEAT_NO_DATE	0
 
+									// subsystems which may have their own level
+#define BLEAT_SS_GEN	0			// general; always follows the global level
+#define BLEAT_SS_RIF	1			// request interface
+#define BLEAT_SS_NIC	2			// nic/driver management
+#define BLEAT_SS_MBOX	3			// vf mailbox callbacks
+#define BLEAT_SS_QOS	4
+#define BLEAT_SS_MAC	5
+#define BLEAT_SS_STATS	6
+#define BLEAT_NSS		7
+
 extern int bleat_set_lvl( int l );
 extern void bleat_set_purge( const char* dname, const char* prefix, int seconds );
 extern time_t bleat_next_roll( void );
@@ -192,6 +273,32 @@ extern void bleat_pop_lvl( void );
 extern int bleat_will_it( int l );
 extern int bleat_set_log( char* fname, int add_date );
 extern void bleat_printf( int level, const char* fmt, ... );
+extern int bleat_set_async( int nslots );
+extern void bleat_stop_async( void );
+extern void bleat_xprintf( int ss, const char* site, int level, const char* fmt, ... );
+extern int bleat_ss_will_it( int ss, int l );
+extern int bleat_set_ss_lvl( int ss, int l );
+extern int bleat_get_ss_lvl( int ss );
+extern int bleat_ss_id( const char* name );
+extern const char* bleat_ss_name( int ss );
+extern void bleat_set_dedup( int window, int max_per_sec );
+extern void bleat_flush_repeats( void );
+extern int bleat_start_hk( int compress );
+extern void bleat_stop_hk( void );
+
+// these must follow the prototypes above
+#ifndef BLEAT_SUBSYS				// a module may define this before including to tag its messages
+#define BLEAT_SUBSYS	BLEAT_SS_GEN
+#endif
+
+#define BLEAT_STR_(x)	#x
+#define BLEAT_STR(x)	BLEAT_STR_(x)
+#define BLEAT_SITE		__FILE__ ":" BLEAT_STR( __LINE__ )
+
+									// messages are tagged with the subsystem and call site (flood control)
+#define bleat_printf( lvl, ... )	bleat_xprintf( BLEAT_SUBSYS, BLEAT_SITE, (lvl), __VA_ARGS__ )
+#define bleat_ssprintf( ss, lvl, ... )	bleat_xprintf( (ss), BLEAT_SITE, (lvl), __VA_ARGS__ )
+#define bleat_will_it( lvl )		bleat_ss_will_it( BLEAT_SUBSYS, (lvl) )
 
 //---------------- hot_plug -------------------------------------------------------------------------------
 extern int user_cmd( uid_t uid, char* cmd );
@@ -222,6 +329,11 @@ extern int jwx_get_ivalue( void* jblob, char const* field_name, int def_value );
 extern char* jwx_get_value_as_str( void* jblob, char const* field_name, char const* def_value, int  fmt );
 extern char* jwx_get_str( void* jblob, char const* field_name, char const* def_value );
 
+// ---------------- jw_decode -------------------------------------------------------------------------------
+extern int jw_decode( char* json, const jw_field_t* schema, int nfields, void* target, void* data, const char* what );
+extern int jw_val_decode( jw_val_t* v, const jw_field_t* schema, int nfields, void* target, void* data );
+extern int jw_val_ele( jw_val_t* v, int idx, jw_val_t* ele );
+
 //----------------- idmgr -----------------------------------------------------------------------------------
 extern void* mk_idm( int num_ids );
 extern int idm_alloc( void* vid );
@@ -240,6 +352,60 @@ extern int is_fifo( const_str pathname );
 extern int file_exists( const_str pathname );
 extern int cp_file( const_str path1, const_str path2, int rm_src );
 
+//----------------- vbin (binary request framing and client) ----------------------------------------------
+#define VB_MAGIC		0xfb		// first byte of a binary frame; a json request never starts with it
+#define VB_VERSION		1
+#define VB_HDR_LEN		6			// magic, version, body length (4 bytes, network order)
+#define VB_MAX_FRAME	(4 * 1024 * 1024)	// largest frame (header included); vfd takes requests up to 8k
+#define VB_MAX_VALUE	0xffff		// largest single TLV value; longer messages are sent in pieces
+
+#define VBT_ACTION		1			// request tags: action name (string)
+#define VBT_RID			2			// caller's request id (string); returned in the response
+#define VBT_RESOURCE	3			// config file name, show target, etc. (string)
+#define VBT_OUTPUT		4			// output file (export)
+#define VBT_RFIFO		5			// response fifo (ignored on the socket)
+#define VBT_LOGLEVEL	6			// uint
+#define VBT_ASYNC		7			// uint; non-zero for accept-then-complete
+#define VBT_KIND		16			// response tags: VBK_ const (uint)
+#define VBT_STATE		17			// 0 ok, 1 error (uint)
+#define VBT_OPID		18			// async operation id (uint)
+#define VBT_MSG			19			// message (string, newlines kept); repeated for long messages, concatenated
+
+#define VBK_RESPONSE	1			// response kinds
+#define VBK_COMPLETE	2			// an async operation finished
+
+typedef struct vb_buf {
+	unsigned char*	data;			// the frame; header first
+	int		len;					// bytes used
+	int		size;					// bytes allocated
+	int		err;					// an add failed; vb_finish() will fail
+} vb_buf_t;
+
+typedef struct vb_resp {
+	int		kind;					// VBK_ const
+	int		state;					// 0 ok, 1 error
+	uint64_t	op_id;				// async operation id, 0 if none
+	char*	rid;
+	char*	msg;
+} vb_resp_t;
+
+extern vb_buf_t* vb_start( int size );
+extern int vb_add( vb_buf_t* b, int tag, const void* val, int len );
+extern int vb_add_str( vb_buf_t* b, int tag, const char* s );
+extern int vb_add_uint( vb_buf_t* b, int tag, uint64_t v, int n );
+extern int vb_finish( vb_buf_t* b );
+extern void vb_free( vb_buf_t* b );
+extern int vb_frame_len( const unsigned char* buf, int len );
+extern int vb_next( const unsigned char* frame, int len, int* off, int* tag, const unsigned char** val, int* vlen );
+extern uint64_t vb_uint( const unsigned char* val, int vlen );
+extern char* vb_strdup( const unsigned char* val, int vlen );
+
+extern int vbc_connect( const char* path );
+extern int vbc_send( int fd, const char* action, const char* rid, const char* resource, int loglevel, int async );
+extern vb_resp_t* vbc_read( int fd );
+extern vb_resp_t* vbc_request( int fd, const char* action, const char* rid, const char* resource, int loglevel, int async, void (*cb)( vb_resp_t* ) );
+extern void vbc_free_resp( vb_resp_t* r );
+
 
 
 #endif
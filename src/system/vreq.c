@@ -12,6 +12,7 @@
 				invoke this for the generic user commands).
 	Author:		E. Scott Daniels
 	Date:		03 April 2017
+	Mods:		19 Oct 2026 - Add show perf.
 */
 
 #include <fcntl.h>
@@ -40,7 +41,7 @@ typedef struct {
 static void usage( void ) {
 	const char *version = VERSION "    build: " __DATE__ " " __TIME__;
 
-	fprintf( stdout, "vreq [-c channel-path] {dump | show {all|n|ex|pfs} | ping}\n" );
+	fprintf( stdout, "vreq [-c channel-path] {dump | show {all|n|ex|pfs|perf} | ping}\n" );
 }
 
 /*
@@ -165,8 +166,8 @@ int do_show( int argc, char** argv, char* v_channel, char* r_channel ) {
 				rc = 1;
 				break;
 
-			case 'p':					// just pfs
-				snprintf( buf, sizeof( buf ), fmt, "pfs" );
+			case 'p':					// just pfs, or request latency
+				snprintf( buf, sizeof( buf ), fmt, strncmp( argv[0], "pe", 2 ) == 0 ? "perf" : "pfs" );
 				rc = 1;
 				break;
 	
@@ -80,6 +80,34 @@
 				19 Feb 2018 - Add support to ensure config directories exist. (#263)
 				26 Mar 2018 - Send log to file unless log_dir == stderr; allow -f for container with log file.
 				18 Apr 2018 - Correct stop point when dumping mac addresses.
+				19 Oct 2026 - Resolve each PF's xstat id list once after port init.
+				19 Oct 2026 - Drive the periodic stats dump from the main loop.
+				19 Oct 2026 - Start the asynchronous bleat writer when async_log is set.
+				19 Oct 2026 - Enable bleat flood control and flush its summaries from the main loop.
+				19 Oct 2026 - Start the bleat housekeeping thread so log rolling/purging is off the
+							logging path.
+				19 Oct 2026 - Restore the VFs from the running config snapshot when it is current
+							and keep the snapshot up to date from the main loop.
+				19 Oct 2026 - Add reattach mode (-r): compatible ports are adopted rather than reset,
+							VF settings read back from the NIC are left alone, and ports are left
+							running on shutdown.
+				19 Oct 2026 : Start the config directory watcher and wait on it in the main loop.
+				19 Oct 2026 : Add --validate (-V) to check a directory of vf configs offline.
+				19 Oct 2026 : Reload the parm file on SIGHUP or a reload request: PFs which were
+							added are initialised and those removed are retired; others are
+							not touched. Per PF initialisation moved to init_pf().
+				19 Oct 2026 - Push only the changes made by an update request to the nic.
+				19 Oct 2026 - Hold the link down on a prepared (not yet committed) VF.
+				19 Oct 2026 - Hold the port's device lock around the stats calls in gen_stats().
+				19 Oct 2026 - Open the request socket (if configured) alongside the fifo.
+				19 Oct 2026 - Flush queued responses from the main loop.
+				19 Oct 2026 - Publish a config snapshot after each nic update; mailbox policy
+					checks read the snapshot rather than waiting on the update lock.
+					Start the request workers.
+				19 Oct 2026 - Split the per port work of vfd_update_nic() into update_port() and
+					run it on the pf owner threads (in parallel) when pf_workers is set.
+				19 Oct 2026 - Time nic updates for the request latency stats.
+				19 Oct 2026 - Ignore SIGPIPE rather than trap it; the handler isn't signal safe.
 */
 
 
@@ -91,7 +119,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <errno.h>
+#include <pthread.h>
 
 
 #include "sriov.h"		// main header file
@@ -109,6 +139,9 @@
 
 // ---------------------globals: bad form, but unavoidable -------------------------------------------------------
 static parms_t *g_parms = NULL;											// dpdk callback does not allow data pointer so we must have a global. all other functions should accept a pointer!
+static char*	g_parm_file = NULL;										// parm file name; kept for reload
+static struct rte_mempool* g_mbuf_pool = NULL;							// kept so that PFs added by a parm reload can be initialised
+static volatile int reload_pending = 0;									// set by SIGHUP; main loop drives the reload
 
 
 // -- global initialisation ----
@@ -311,17 +344,27 @@ struct mirror_s* suss_mirror( int port, int vfid ) {
 	integer can be sussed out.
 
 	Depends on global running config pointer so that callback functions have
-	access.
+	access. The current config snapshot is used when there is one so that the
+	callback never waits on the update lock.
 */
 extern int get_vf_setting( int portid, int vf, int what ) {
 	struct vf_s *p;
+	cfg_snap_t*	s;
 	int		rval = 0;			// return value
 
-	if( (p = suss_vf( portid, vf )) == NULL ) {
+	if( (s = rcu_acquire( )) != NULL ) {
+		p = rcu_vf( s, portid, vf );
+	} else {
+		p = suss_vf( portid, vf );
+	}
+	if( p == NULL ) {
+		rcu_release( );
 		return 0;
 	}
 
-	rte_spinlock_lock( &running_config->update_lock );	// ensure it doesn't change while we read
+	if( s == NULL ) {
+		pthread_mutex_lock( &running_config->update_lock );	// ensure it doesn't change while we read
+	}
 	switch( what ) {
 		case VF_VAL_MCAST:
 			rval = p->allow_mcast;
@@ -356,7 +399,10 @@ extern int get_vf_setting( int portid, int vf, int what ) {
 			break;
 	}
 
-	rte_spinlock_unlock( &running_config->update_lock );
+	if( s == NULL ) {
+		pthread_mutex_unlock( &running_config->update_lock );
+	}
+	rcu_release( );
 	return rval;
 }
 
@@ -366,9 +412,16 @@ extern int get_vf_setting( int portid, int vf, int what ) {
 */
 int valid_vlan( int port, int vfid, int vlan ) {
 	struct vf_s *vf;
+	cfg_snap_t*	s;
 	int i;
 
-	if( (vf = suss_vf( port, vfid )) == NULL ) {
+	if( (s = rcu_acquire( )) != NULL ) {				// check against the snapshot if there is one
+		vf = rcu_vf( s, port, vfid );
+	} else {
+		vf = suss_vf( port, vfid );
+	}
+	if( vf == NULL ) {
+		rcu_release( );
 		bleat_printf( 2, "valid_vlan: cannot find port/vf pair: %d/%d", port, vfid );
 		return 0;
 	}
@@ -376,11 +429,13 @@ int valid_vlan( int port, int vfid, int vlan ) {
 	
 	for( i = 0; i < vf->num_vlans; i++ ) {
 		if( vf->vlans[i] == vlan ) {				// this is in the list; allowed
+			rcu_release( );
 			bleat_printf( 2, "valid_vlan: vlan OK for port/vfid %d/%d: %d", port, vfid, vlan );
 			return 1;
 		}
 	}
 
+	rcu_release( );
 	bleat_printf( 1, "valid_vlan: vlan not valid for port/vfid %d/%d: %d", port, vfid, vlan );
 	return 0;
 }
@@ -391,12 +446,20 @@ int valid_vlan( int port, int vfid, int vlan ) {
 */
 int suss_loopback( int port ) {
 	struct sriov_port_s *p;
+	cfg_snap_t*	s;
+	int	rval = 0;
 
-	if( (p = suss_port( port )) != NULL ) {
-		return !!(p->flags & PF_LOOPBACK);
+	if( (s = rcu_acquire( )) != NULL ) {
+		p = rcu_port( s, port );
+	} else {
+		p = suss_port( port );
+	}
+	if( p != NULL ) {
+		rval = !!(p->flags & PF_LOOPBACK);
 	}
 
-	return 0;
+	rcu_release( );
+	return rval;
 }
 
 /*
@@ -404,18 +467,28 @@ int suss_loopback( int port ) {
 */
 int valid_mtu( int port, int mtu ) {
 	struct sriov_port_s *p;
+	cfg_snap_t*	s;
+	int	pmtu;
 
-	if( (p = suss_port( port )) == NULL ) {				// find our struct
+	if( (s = rcu_acquire( )) != NULL ) {
+		p = rcu_port( s, port );
+	} else {
+		p = suss_port( port );
+	}
+	if( p == NULL ) {				// find our struct
+		rcu_release( );
 		bleat_printf( 2, "valid_mtu: port doesn't map: %d", port );
 		return 0;
 	}
+	pmtu = p->mtu;
+	rcu_release( );
 
-	if( mtu >= 0 &&  mtu <= p->mtu ) {
-		bleat_printf( 2, "valid_mtu: mtu OK for port/mtu %d/%d: %d", port, p->mtu, mtu );
+	if( mtu >= 0 &&  mtu <= pmtu ) {
+		bleat_printf( 2, "valid_mtu: mtu OK for port/mtu %d/%d: %d", port, pmtu, mtu );
 		return 1;
 	}
 	
-	bleat_printf( 1, "valid_mtu: mtu is not accptable for port/mtu %d/%d: %d", port, p->mtu, mtu );
+	bleat_printf( 1, "valid_mtu: mtu is not accptable for port/mtu %d/%d: %d", port, pmtu, mtu );
 	return 0;
 }
 
@@ -433,6 +506,11 @@ static void close_ports( void ) {
 	struct sriov_port_s* port;
 	//char	dev_name[1024];
 
+	if( g_parms != NULL && (g_parms->rflags & RF_REATTACH) ) {				// leave everything running for the next vfd to adopt
+		bleat_printf( 0, "reattach mode: ports, VFs and mirrors are left as they are" );
+		return;
+	}
+
 	bleat_printf( 2, "terminating active mirrors begins" );
 	for( i = 0; i < running_config->num_ports; i++ ) {
 		port = &running_config->ports[i];
@@ -612,6 +690,10 @@ static int vfd_eal_init( parms_t* parms ) {
 	Generate a set of stats to a single buffer. Return buffer to caller (caller must free).
 	If pf_only is true, then the VF stats are skipped. If pf >= 0, then only that pf, and
 	its VFs are printed.
+
+	Conf may be a config snapshot being used by a request worker without the update lock,
+	so each port's device lock is held around the driver calls; the port's owner holds it
+	while programming the port.
 */
 char*  gen_stats( sriov_conf_t* conf, int pf_only, int pf ) {
 	char*	rbuf;			// buffer to return
@@ -681,7 +763,9 @@ char*  gen_stats( sriov_conf_t* conf, int pf_only, int pf ) {
 		strcat( rbuf+rbidx,  buf );
 		rbidx += l;		
    				
+		pfw_port_lock( conf->ports[i].rte_port_number );
 		l = nic_stats_display( conf->ports[i].rte_port_number, buf, sizeof( buf ) );
+		pfw_port_unlock( conf->ports[i].rte_port_number );
 
 		if( l + rbidx > rblen ) {
 			rblen += BUF_SIZE + l;
@@ -707,7 +791,10 @@ char*  gen_stats( sriov_conf_t* conf, int pf_only, int pf ) {
 			qsort(vf_arr, conf->ports[i].num_vfs, sizeof(int), cmp_vfs);
 			
 			for (v = 0; v < conf->ports[i].num_vfs; v++) {
-				if( (l = vf_stats_display(conf->ports[i].rte_port_number, pf_ari, vf_arr[v], buf, sizeof( buf ))) > 0 ) {  // < 0 out of range, not in use
+				pfw_port_lock( conf->ports[i].rte_port_number );
+				l = vf_stats_display(conf->ports[i].rte_port_number, pf_ari, vf_arr[v], buf, sizeof( buf ));
+				pfw_port_unlock( conf->ports[i].rte_port_number );
+				if( l > 0 ) {  // < 0 out of range, not in use
 					if( l + rbidx > rblen ) {
 						rblen += BUF_SIZE + l;
 						rbuf = (char *) realloc( rbuf, sizeof( char ) * rblen );
@@ -739,6 +826,83 @@ cmp_vfs (const void * a, const void * b)
    return ( *(const int*)a - *(const int*)b );
 }
 
+/*
+	Reattach support: returns true if the vlan is in the list read back from the
+	NIC; false if it's not or the list is unknown.
+*/
+static int hws_has_vlan( vf_hwstate_t* hws, int vlan ) {
+	int i;
+
+	if( ! (hws->known & HWS_VLANS) ) {
+		return 0;
+	}
+
+	for( i = 0; i < hws->num_vlans; i++ ) {
+		if( hws->vlans[i] == vlan ) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+	Reattach support: returns true if the mac is in the list read back from the NIC.
+*/
+static int hws_has_mac( vf_hwstate_t* hws, const char* mac ) {
+	int i;
+
+	if( ! (hws->known & HWS_MACS) ) {
+		return 0;
+	}
+
+	for( i = 0; i < hws->num_macs; i++ ) {
+		if( strcasecmp( hws->macs[i], mac ) == 0 ) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+	Reattach support: returns true if the NIC has exactly the macs that are in the
+	VF's list.
+*/
+static int hws_macs_match( vf_hwstate_t* hws, struct vf_s* vf ) {
+	int m;
+
+	if( ! (hws->known & HWS_MACS) || hws->num_macs != vf->num_macs ) {
+		return 0;
+	}
+
+	for( m = vf->first_mac; m < vf->first_mac + vf->num_macs; m++ ) {
+		if( ! hws_has_mac( hws, vf->macs[m] ) ) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+	Reattach support: returns true if the insert/strip settings on the NIC are what
+	vfd_set_ins_strip() would set. Ctag strip/insert can't be read back.
+*/
+static int hws_ins_strip_match( vf_hwstate_t* hws, struct vf_s* vf ) {
+	int insert = 0;
+
+	if( ! (hws->known & HWS_INS_STRIP) || vf->strip_ctag ) {
+		return 0;
+	}
+
+	if( vf->num_vlans == 1 && vf->strip_stag ) {
+		insert = vf->vlans[0];
+	}
+
+	return hws->insert_vlan == insert && hws->strip == !!vf->strip_stag;
+}
+
 /*
 	2017/03/23 - We now allow strip/insert when there are multiple VLAN IDs:
 		If strip == true and one ID is supplied, that ID will stripped on Rx and 
@@ -814,308 +978,494 @@ extern void log_port_state( struct sriov_port_s* port, const_str msg ) {
 	}
 }
 
+static pthread_mutex_t mir_id_lock = PTHREAD_MUTEX_INITIALIZER;	// pf owners may return mirror ids at the same time
+
 /*
-	Runs through the configuration and makes adjustments.  This is
-	a tweak of the original code (update_ports_config) inasmuch as the dynamic
-	changes to the configuration based on nova add/del requests are made to the
-	"running config" -- there is no longer a new/old config to compare with.  This
-	function will update a port/vf based on the last_updated flag in any port/VF
-	in the config:
-		-1 delete (remove macs and vlans)
-		0  no change, no action
-		1  add (add macs  and vlans)
+	Return a mirror id to the allocator. Ids are allocated by the thread holding
+	the update lock, but pf owners release them while updating their ports in
+	parallel, so the return is serialised here.
+*/
+static void return_mirror_id( sriov_conf_t* conf, int id ) {
+	pthread_mutex_lock( &mir_id_lock );
+	idm_return( conf->mir_id_mgr, id );
+	pthread_mutex_unlock( &mir_id_lock );
+}
 
-	Bleat messages have been added so that dynamically adjusted verbosity is
-	available.
+/*
+	Push the changes an update request made to a VF (vf->delta) to the nic. Only
+	what changed is touched so that traffic on the VF continues; in particular
+	VLANs and MACs which remain are not removed and re-added. Y is the VF's index
+	in the port. The delta is freed. Returns true if the VF's queue shares changed
+	(the port's qos must be recomputed).
+*/
+static int apply_vf_delta( struct sriov_port_s* port, int y, struct vf_s* vf, uint32_t link_speed ) {
+	vf_delta_t* delta;
+	struct mirror_s* mirror;
+	uint32_t vf_mask;
+	int	pn;								// rte port number
+	int	strip_on;
+	int	v;
+	int	qs_changed;
+
+	if( (delta = vf->delta) == NULL ) {
+		return 0;
+	}
+	vf->delta = NULL;
+
+	pn = port->rte_port_number;
+	vf_mask = VFN2MASK( vf->num );
+	strip_on = (vf->strip_stag || vf->strip_ctag) ? 1 : 0;
+	bleat_printf( 1, "reconfigure vf for update port: %d vf=%d changes=0x%03x", pn, vf->num, delta->what );
+
+	if( delta->what & VD_MIRROR ) {
+		mirror = &port->mirrors[y];
+		if( delta->old_mirror.dir != MIRROR_OFF ) {
+			set_mirror_wrp( pn, vf->num, delta->old_mirror.id, delta->old_mirror.target, MIRROR_OFF );
+			if( port->num_mirrors > 0 ) {
+				port->num_mirrors--;
+			}
+			if( mirror->dir == MIRROR_OFF ) {
+				return_mirror_id( running_config, delta->old_mirror.id );
+			}
+		}
+		if( mirror->dir != MIRROR_OFF ) {
+			set_mirror_wrp( pn, vf->num, mirror->id, mirror->target, mirror->dir );
+			port->num_mirrors++;
+		}
+	}
 
-	Conf is the configuration to check. If parms->forreal is set, then we actually
-	make the dpdk calls to do the work.
+	if( delta->what & VD_VLANS ) {
+		if( (get_nic_type( pn ) != VFD_MLX5) || !strip_on ) {					// strip/insert vlan is set differently in mlx5
+			for( v = 0; v < delta->nvlans_del; v++ ) {
+				bleat_printf( 2, "update: delete vlan: port: %d vf=%d vlan=%d", pn, vf->num, delta->vlans_del[v] );
+				set_vf_rx_vlan( pn, delta->vlans_del[v], vf_mask, SET_OFF );
+			}
+			for( v = 0; v < delta->nvlans_add; v++ ) {
+				bleat_printf( 2, "update: add vlan: port: %d vf=%d vlan=%d", pn, vf->num, delta->vlans_add[v] );
+				set_vf_rx_vlan( pn, delta->vlans_add[v], vf_mask, SET_ON );
+			}
+		}
+	}
 
+	if( delta->what & (VD_MACS | VD_DEFMAC) ) {
+		for( v = 0; v < delta->nmacs_del; v++ ) {
+			bleat_printf( 2, "update: delete mac: port: %d vf=%d mac=%s", pn, vf->num, delta->macs_del[v] );
+			set_vf_rx_mac( pn, delta->macs_del[v], vf->num, SET_OFF );
+		}
 
-	TODO:  the original, and thus this, function always return 0 (good); we need to
-		figure out how to handle errors back from the rte_ calls.
-*/
-extern int vfd_update_nic( parms_t* parms, sriov_conf_t* conf ) {
-	int i;
-	int need_ready_msg = 0;			// we only write a ready message for the port when added
-	int on = 1;
-    uint32_t vf_mask;
-    int y;
+		if( delta->what & VD_DEFMAC ) {
+			set_macs( pn, vf->num );										// default changed; push the list so it lands last
+		} else {
+			for( v = 0; v < delta->nmacs_add; v++ ) {
+				bleat_printf( 2, "update: add mac: port: %d vf=%d mac=%s", pn, vf->num, delta->macs_add[v] );
+				set_vf_rx_mac( pn, delta->macs_add[v], vf->num, SET_ON );
+			}
+		}
+	}
 
-	if( (parms->rflags & RF_INITIALISED) == 0 ) {
-		bleat_printf( 2, "update_nic: not initialised, nic settings not updated" );
-		return 0;
+	if( delta->what & VD_INS_STRIP ) {
+		vfd_set_ins_strip( port, vf );
 	}
 
-	if( ! parms->forreal ) {
-		bleat_printf( 1, "nic update skipped: -n mode set" );
-		return 0;
+	if( delta->what & VD_RXMODE ) {
+		bleat_printf( 2, "update: port: %d vf: %d set allow bcast/mcast/un-ucast to %d/%d/%d", pn, vf->num, vf->allow_bcast, vf->allow_mcast, vf->allow_un_ucast );
+		set_vf_allow_bcast( pn, vf->num, vf->allow_bcast );
+		set_vf_allow_mcast( pn, vf->num, vf->allow_mcast );
+		set_vf_allow_un_ucast( pn, vf->num, vf->allow_un_ucast );
 	}
 
-	rte_spinlock_lock( &running_config->update_lock );
-	
-	for (i = 0; i < conf->num_ports; ++i){												// run each port we know about to apply port only changes
-		int ret;
-		struct sriov_port_s* port;
-		struct rte_eth_link link;
+	if( delta->what & VD_RATE ) {												// a rate of 0 turns the limit off
+		bleat_printf( 1, "update: setting rate: %d", (int) ( (float) link_speed * vf->rate ) );
+		set_vf_rate_limit( pn, vf->num, (uint16_t)( (float) link_speed * vf->rate ), 0x01 );
+	}
 
-		port = &conf->ports[i];
+	if( delta->what & VD_MIN_RATE ) {
+		bleat_printf( 1, "update: setting min_rate: %d", (int) ( (float) link_speed * vf->min_rate ) );
+		set_vf_min_rate( pn, vf->num, (uint16_t)( (float) link_speed * vf->min_rate ), 0x01 );
+	}
 
-		rte_eth_link_get(port->rte_port_number, &link);
+	if( delta->what & VD_LINK ) {
+		bleat_printf( 2, "update: port: %d vf: %d set link status to %d", pn, vf->num, VF_LINK( vf ) );
+		set_vf_link_status( pn, vf->num, VF_LINK( vf ) );
+	}
 
-		//  WHY is this and disable pool done every time?  why is it not just done at the time of add?
-		tx_set_loopback( port->rte_port_number, !!(port->flags & PF_LOOPBACK) );		// enable loopback if set (disabled: all vm-vm traffic must go to TOR and back
+	qs_changed = !!(delta->what & VD_QSHARES);
+	free( delta );
+	return qs_changed;
+}
 
-		// do NOT call set_queue_drop() as it causes packetloss; drop enable handled by callback process now
+/*
+	Push the changes for one port (and its VFs) to the nic. This is the per port
+	body of vfd_update_nic(); it is run by the port's owner thread when pf owners are
+	enabled, so it must touch nothing belonging to another port. Data is the config.
+*/
+static void update_port( void* vconf, struct sriov_port_s* port ) {
+	sriov_conf_t* conf;
+	int ret;
+	int need_ready_msg = 0;			// we only write a ready message for the port when added
+	int on = 1;
+	uint32_t vf_mask;
+	int y;
+	struct rte_eth_link link;
 
-		disable_default_pool( port->rte_port_number );
+	conf = (sriov_conf_t *) vconf;
 
-		if( port->last_updated == ADDED ) {								// updated since last call, reconfigure
-			port->num_mirrors = 0;
-			need_ready_msg = 1;											// log port ready when VFs are finished configuring
+	rte_eth_link_get(port->rte_port_number, &link);
 
-			bleat_printf( 1, "port updated: %s/%s",  port->name, port->pciid );
+	//  WHY is this and disable pool done every time?  why is it not just done at the time of add?
+	tx_set_loopback( port->rte_port_number, !!(port->flags & PF_LOOPBACK) );		// enable loopback if set (disabled: all vm-vm traffic must go to TOR and back
 
-			if( port->flags & PF_PROMISC ) {
-				bleat_printf( 1, "enabling promiscuous mode for port %d", port->rte_port_number );
-				rte_eth_promiscuous_enable(port->rte_port_number);
-			}
-			else {
-				bleat_printf( 1, "disabling promiscuous mode for port %d", port->rte_port_number );
-				rte_eth_promiscuous_disable(port->rte_port_number);
-			}
-			
-			if (get_nic_type(port->rte_port_number) == VFD_BNXT)
-				rte_eth_allmulticast_disable(port->rte_port_number);
-			else
-				rte_eth_allmulticast_enable(port->rte_port_number);
-		
-			if (get_nic_type(port->rte_port_number) == VFD_NIANTIC) {
-				ret = rte_eth_dev_uc_all_hash_table_set(port->rte_port_number, on);
-				
-				if (ret < 0)
-					bleat_printf( 0, "ERR: bad unicast hash table parameter, return code = %d", ret);
-			}	
+	// do NOT call set_queue_drop() as it causes packetloss; drop enable handled by callback process now
 
-			port->last_updated = UNCHANGED;								// mark that we did this for next go round
-		} else {
-			bleat_printf( 2, "update configs: skipped port, not changed: %s/%s", port->name, port->pciid );
+	disable_default_pool( port->rte_port_number );
+
+	if( port->last_updated == ADDED ) {								// updated since last call, reconfigure
+		port->num_mirrors = 0;
+		need_ready_msg = 1;											// log port ready when VFs are finished configuring
+
+		bleat_printf( 1, "port updated: %s/%s",  port->name, port->pciid );
+
+		if( port->flags & PF_PROMISC ) {
+			bleat_printf( 1, "enabling promiscuous mode for port %d", port->rte_port_number );
+			rte_eth_promiscuous_enable(port->rte_port_number);
+		}
+		else {
+			bleat_printf( 1, "disabling promiscuous mode for port %d", port->rte_port_number );
+			rte_eth_promiscuous_disable(port->rte_port_number);
 		}
+		
+		if (get_nic_type(port->rte_port_number) == VFD_BNXT)
+			rte_eth_allmulticast_disable(port->rte_port_number);
+		else
+			rte_eth_allmulticast_enable(port->rte_port_number);
+	
+		if (get_nic_type(port->rte_port_number) == VFD_NIANTIC) {
+			ret = rte_eth_dev_uc_all_hash_table_set(port->rte_port_number, on);
+			
+			if (ret < 0)
+				bleat_printf( 0, "ERR: bad unicast hash table parameter, return code = %d", ret);
+		}	
 
-	    for(y = 0; y < port->num_vfs; ++y){ 							/* go through all VF's and (un)set VLAN's/macs for any vf that has changed */
-			int v;
-			int	change2port;							// set true if one or more VFs changed; need to redo qos allotment if so
-			struct vf_s *vf = &port->vfs[y];   			// at the VF to work on
+		port->last_updated = UNCHANGED;								// mark that we did this for next go round
+	} else {
+		bleat_printf( 2, "update configs: skipped port, not changed: %s/%s", port->name, port->pciid );
+	}
 
-			vf_mask = VFN2MASK(vf->num);
+    for(y = 0; y < port->num_vfs; ++y){ 							/* go through all VF's and (un)set VLAN's/macs for any vf that has changed */
+		int v;
+		int	change2port;							// set true if one or more VFs changed; need to redo qos allotment if so
+		int	qs_changed;								// queue shares changed by an update
+		struct vf_s *vf = &port->vfs[y];   			// at the VF to work on
+		vf_hwstate_t hws;							// settings read back from the nic when reattaching (nothing known otherwise)
 
-			change2port = 0;
-			if( vf->last_updated != UNCHANGED ) {					// this vf was changed (add/del/reset), reconfigure it
-				const char* reason;
+		vf_mask = VFN2MASK(vf->num);
+
+		change2port = 0;
+		qs_changed = apply_vf_delta( port, y, vf, link.link_speed );		// in place update; nil delta is a no-op
+		if( vf->last_updated == UPDATED ) {
+			vf->last_updated = UNCHANGED;						// nothing more to do
+		}
 
-				change2port = 1;
+		if( vf->last_updated != UNCHANGED ) {					// this vf was changed (add/del/reset), reconfigure it
+			const char* reason;
 
-				switch( vf->last_updated ) {
-					case ADDED:		
-						reason = "add"; 
+			change2port = 1;
+
+			switch( vf->last_updated ) {
+				case ADDED:		
+					reason = "add"; 
 #if VFD_KERNEL
-						device_message(port->rte_port_number, vf->num, NL_PF_ADD_DEV_RQ, NL_PF_RESP_OK);
+					device_message(port->rte_port_number, vf->num, NL_PF_ADD_DEV_RQ, NL_PF_RESP_OK);
 #endif
-						break;						
-					case DELETED:	
-						reason = "delete"; 
+					break;						
+				case DELETED:	
+					reason = "delete"; 
 #if VFD_KERNEL
-						device_message(port->rte_port_number, vf->num, NL_PF_DEL_DEV_RQ, NL_PF_RESP_OK);
+					device_message(port->rte_port_number, vf->num, NL_PF_DEL_DEV_RQ, NL_PF_RESP_OK);
 #endif						
-						break;					
-					case RESET:		reason = "reset"; break;
-					default:		reason = "unknown reason"; break;
+					break;					
+				case RESET:		reason = "reset"; break;
+				default:		reason = "unknown reason"; break;
+			}
+			bleat_printf( 1, "reconfigure vf for %s port: %d vf=%d", reason, port->rte_port_number, vf->num );
+
+			memset( &hws, 0, sizeof( hws ) );						// nothing known unless read back below
+			if( vf->last_updated == ADDED && (port->flags & PF_REATTACHED) ) {		// adopted port; only change what differs from the nic
+				if( get_vf_hwstate( port->rte_port_number, vf->num, &hws ) ) {
+					bleat_printf( 1, "reattach: settings read back from nic for port: %d vf=%d known=0x%02x", port->rte_port_number, vf->num, hws.known );
 				}
-				bleat_printf( 1, "reconfigure vf for %s port: %d vf=%d", reason, port->rte_port_number, vf->num );
+			}
 
-				// TODO: order from original kept; probably can group into to blocks based on updated flag
-				if( vf->last_updated == DELETED ) { 							// delete vlans, free any buffers
-					if( vf->start_cb ) {
-						free( vf->start_cb );
-						vf->start_cb = NULL;
-					}
-					if( vf->stop_cb ) {
-						free( vf->stop_cb );
-						vf->stop_cb = NULL;
-					}
+			// TODO: order from original kept; probably can group into to blocks based on updated flag
+			if( vf->last_updated == DELETED ) { 							// delete vlans, free any buffers
+				if( vf->start_cb ) {
+					free( vf->start_cb );
+					vf->start_cb = NULL;
+				}
+				if( vf->stop_cb ) {
+					free( vf->stop_cb );
+					vf->stop_cb = NULL;
+				}
+				if( vf->prep_name ) {
+					free( vf->prep_name );
+					vf->prep_name = NULL;
+				}
 
-					if( port->mirrors[y].dir != MIRROR_OFF ) {													// stop the mirror on delete
-						set_mirror_wrp( port->rte_port_number, vf->num, port->mirrors[y].id, port->mirrors[y].target, MIRROR_OFF );		// turn off
-						port->mirrors[y].dir = MIRROR_OFF;
-						port->mirrors[y].target = MAX_VFS + 1;													// target is unsigned -- set out of range high
-						idm_return( conf->mir_id_mgr, port->mirrors[y].id );									// mark the id as unused in allocator
-						if( port->num_mirrors > 0 ) {
-							port->num_mirrors--; 
-						}
+				if( port->mirrors[y].dir != MIRROR_OFF ) {													// stop the mirror on delete
+					set_mirror_wrp( port->rte_port_number, vf->num, port->mirrors[y].id, port->mirrors[y].target, MIRROR_OFF );		// turn off
+					port->mirrors[y].dir = MIRROR_OFF;
+					port->mirrors[y].target = MAX_VFS + 1;													// target is unsigned -- set out of range high
+					return_mirror_id( conf, port->mirrors[y].id );									// mark the id as unused in allocator
+					if( port->num_mirrors > 0 ) {
+						port->num_mirrors--; 
 					}
+				}
 
-					//AZif (get_nic_type(port->rte_port_number) == VFD_NIANTIC)
-					//set_vf_rx_vlan(port->rte_port_number, 0, vf_mask, 0);		// remove vlan id 0 do we need it here for i40e?
-					
-					for(v = 0; v < vf->num_vlans; ++v) {
-						int vlan = vf->vlans[v];
-						int strip_on = (vf->strip_stag || vf->strip_ctag) ? 1 : 0;
-						if ((get_nic_type(port->rte_port_number) != VFD_MLX5) || !strip_on) { // strip/insert vlan is set differently in mlx5
-							bleat_printf( 2, "delete vlan: port: %d vf: %d vlan: %d", port->rte_port_number, vf->num, vlan );
-							set_vf_rx_vlan(port->rte_port_number, vlan, vf_mask, SET_OFF );		// remove the vlan id from the list
-						}
+				//AZif (get_nic_type(port->rte_port_number) == VFD_NIANTIC)
+				//set_vf_rx_vlan(port->rte_port_number, 0, vf_mask, 0);		// remove vlan id 0 do we need it here for i40e?
+				
+				for(v = 0; v < vf->num_vlans; ++v) {
+					int vlan = vf->vlans[v];
+					int strip_on = (vf->strip_stag || vf->strip_ctag) ? 1 : 0;
+					if ((get_nic_type(port->rte_port_number) != VFD_MLX5) || !strip_on) { // strip/insert vlan is set differently in mlx5
+						bleat_printf( 2, "delete vlan: port: %d vf: %d vlan: %d", port->rte_port_number, vf->num, vlan );
+						set_vf_rx_vlan(port->rte_port_number, vlan, vf_mask, SET_OFF );		// remove the vlan id from the list
 					}
-				} else {
-					int v;
+				}
+			} else {
+				int v;
 
-					if( port->mirrors[y].dir != MIRROR_OFF ) {						// setup the mirror
-						set_mirror_wrp( port->rte_port_number, vf->num, port->mirrors[y].id, port->mirrors[y].target, port->mirrors[y].dir );		// set target and type (in/out/both)
-						port->num_mirrors++;
-					}
+				if( port->mirrors[y].dir != MIRROR_OFF ) {						// setup the mirror
+					set_mirror_wrp( port->rte_port_number, vf->num, port->mirrors[y].id, port->mirrors[y].target, port->mirrors[y].dir );		// set target and type (in/out/both)
+					port->num_mirrors++;
+				}
 
-					for(v = 0; v < vf->num_vlans; ++v) {
-						int vlan = vf->vlans[v];
-						int strip_on = (vf->strip_stag || vf->strip_ctag) ? 1 : 0;
-						if ((get_nic_type(port->rte_port_number) != VFD_MLX5) || !strip_on) { // strip/insert vlan is set differently in mlx5
-							bleat_printf( 2, "add vlan: port: %d vf=%d vlan=%d", port->rte_port_number, vf->num, vlan );
-							set_vf_rx_vlan(port->rte_port_number, vlan, vf_mask, on );		// add the vlan id to the list
-						}
+				for(v = 0; v < vf->num_vlans; ++v) {
+					int vlan = vf->vlans[v];
+					int strip_on = (vf->strip_stag || vf->strip_ctag) ? 1 : 0;
+					if( hws_has_vlan( &hws, vlan ) ) {
+						bleat_printf( 2, "reattach: vlan already set: port: %d vf=%d vlan=%d", port->rte_port_number, vf->num, vlan );
+						continue;
+					}
+					if ((get_nic_type(port->rte_port_number) != VFD_MLX5) || !strip_on) { // strip/insert vlan is set differently in mlx5
+						bleat_printf( 2, "add vlan: port: %d vf=%d vlan=%d", port->rte_port_number, vf->num, vlan );
+						set_vf_rx_vlan(port->rte_port_number, vlan, vf_mask, on );		// add the vlan id to the list
 					}
 				}
 
-				if( vf->last_updated == DELETED ) {				// delete the macs (need to disable anti-spoof first
-					if (vf->mac_anti_spoof) {
-						bleat_printf( 2, "port: %d vf: %d set mac-anti-spoof to %d", port->rte_port_number, vf->num, 0 );
-						set_vf_mac_anti_spoofing(port->rte_port_number, vf->num, SET_OFF);
+				for( v = 0; (hws.known & HWS_VLANS) && v < hws.num_vlans; v++ ) {		// reattach: drop anything the nic has that the config doesn't
+					int i;
+
+					for( i = 0; i < vf->num_vlans && vf->vlans[i] != hws.vlans[v]; i++ );
+					if( i >= vf->num_vlans ) {
+						bleat_printf( 1, "reattach: delete stale vlan: port: %d vf=%d vlan=%d", port->rte_port_number, vf->num, hws.vlans[v] );
+						set_vf_rx_vlan( port->rte_port_number, hws.vlans[v], vf_mask, SET_OFF );
 					}
+				}
+			}
+
+			if( vf->last_updated == DELETED ) {				// delete the macs (need to disable anti-spoof first
+				if (vf->mac_anti_spoof) {
+					bleat_printf( 2, "port: %d vf: %d set mac-anti-spoof to %d", port->rte_port_number, vf->num, 0 );
+					set_vf_mac_anti_spoofing(port->rte_port_number, vf->num, SET_OFF);
+				}
 
-					clear_macs( port->rte_port_number, vf->num, RESET_DEFAULT );	// remove all MAC addresses and set a random default
+				clear_macs( port->rte_port_number, vf->num, RESET_DEFAULT );	// remove all MAC addresses and set a random default
+			} else {
+				if( hws_macs_match( &hws, vf ) ) {
+					bleat_printf( 2, "reattach: macs already set: port: %d vf=%d", port->rte_port_number, vf->num );
 				} else {
+					for( v = 0; (hws.known & HWS_MACS) && v < hws.num_macs; v++ ) {		// reattach: drop anything the nic has that the config doesn't
+						int m;
+
+						for( m = vf->first_mac; m < vf->first_mac + vf->num_macs && strcasecmp( vf->macs[m], hws.macs[v] ) != 0; m++ );
+						if( m >= vf->first_mac + vf->num_macs ) {
+							bleat_printf( 1, "reattach: delete stale mac: port: %d vf=%d mac=%s", port->rte_port_number, vf->num, hws.macs[v] );
+							set_vf_rx_mac( port->rte_port_number, hws.macs[v], vf->num, SET_OFF );
+						}
+					}
+
 					set_macs( port->rte_port_number, vf->num );
 				}
+			}
 
-				if( vf->rate || vf->min_rate ) {
-					if( vf->rate ) {
-						bleat_printf( 1, "setting rate: %d", (int)  ( (float)link.link_speed * vf->rate ) );
-						set_vf_rate_limit( port->rte_port_number, vf->num, (uint16_t)( (float)link.link_speed * vf->rate ), 0x01 );
-					}
+			if( vf->rate || vf->min_rate ) {
+				if( vf->rate ) {
+					bleat_printf( 1, "setting rate: %d", (int)  ( (float)link.link_speed * vf->rate ) );
+					set_vf_rate_limit( port->rte_port_number, vf->num, (uint16_t)( (float)link.link_speed * vf->rate ), 0x01 );
+				}
 
-					if( vf->min_rate ) {
-						bleat_printf( 1, "setting min_rate: %d", (int)  ( (float)link.link_speed * vf->min_rate ) );
-						set_vf_min_rate( port->rte_port_number, vf->num, (uint16_t)( (float)link.link_speed * vf->min_rate ), 0x01 );
-					}
+				if( vf->min_rate ) {
+					bleat_printf( 1, "setting min_rate: %d", (int)  ( (float)link.link_speed * vf->min_rate ) );
+					set_vf_min_rate( port->rte_port_number, vf->num, (uint16_t)( (float)link.link_speed * vf->min_rate ), 0x01 );
 				}
+			}
 
-				if( vf->last_updated == DELETED ) {				// do this last!
-					if( vf->rate > 0 ) { //disable rate limit
-						bleat_printf( 1, "disabling rate limit");
-						set_vf_rate_limit( port->rte_port_number, vf->num, 0, 0x01 );
-					}
+			if( vf->last_updated == DELETED ) {				// do this last!
+				if( vf->rate > 0 ) { //disable rate limit
+					bleat_printf( 1, "disabling rate limit");
+					set_vf_rate_limit( port->rte_port_number, vf->num, 0, 0x01 );
+				}
 
-					if( vf->min_rate > 0 ) { //disable rate guarantee
-						bleat_printf( 1, "disabling min rate guarantee");
-						set_vf_min_rate( port->rte_port_number, vf->num, 0, 0x01 );
-					}
+				if( vf->min_rate > 0 ) { //disable rate guarantee
+					bleat_printf( 1, "disabling min rate guarantee");
+					set_vf_min_rate( port->rte_port_number, vf->num, 0, 0x01 );
+				}
 
-					/* retoring VF cfg to default */
-					vfd_set_ins_strip( port, vf );
+				/* retoring VF cfg to default */
+				vfd_set_ins_strip( port, vf );
 
-					bleat_printf( 2, "port: %d vf: %d set link status to %d", port->rte_port_number, vf->num, VF_LINK_AUTO);
-					set_vf_link_status( port->rte_port_number, vf->num, VF_LINK_AUTO);
+				bleat_printf( 2, "port: %d vf: %d set link status to %d", port->rte_port_number, vf->num, VF_LINK_AUTO);
+				set_vf_link_status( port->rte_port_number, vf->num, VF_LINK_AUTO);
 
-					bleat_printf( 2, "port: %d vf: %d set allow un-ucast to %d", port->rte_port_number, vf->num, SET_OFF );
-					set_vf_allow_un_ucast(port->rte_port_number, vf->num, SET_OFF);
+				bleat_printf( 2, "port: %d vf: %d set allow un-ucast to %d", port->rte_port_number, vf->num, SET_OFF );
+				set_vf_allow_un_ucast(port->rte_port_number, vf->num, SET_OFF);
 
-					bleat_printf( 2, "port: %d vf: %d set allow mcast to %d", port->rte_port_number, vf->num, SET_OFF );
-					set_vf_allow_mcast(port->rte_port_number, vf->num, SET_OFF);
-				
-					vf->num = -1;								// must reset this so an add request with the now deleted number will succeed
-					// TODO -- is there anything else that we need to clean up in the struct?
-				}
+				bleat_printf( 2, "port: %d vf: %d set allow mcast to %d", port->rte_port_number, vf->num, SET_OFF );
+				set_vf_allow_mcast(port->rte_port_number, vf->num, SET_OFF);
+			
+				vf->num = -1;								// must reset this so an add request with the now deleted number will succeed
+				// TODO -- is there anything else that we need to clean up in the struct?
+			}
 
-				if( vf->num >= 0 ) {
-					if (get_nic_type(port->rte_port_number) == VFD_BNXT) {
-						bleat_printf( 2, "%s vf: %d set keep stats", port->name, vf->num);
-						rte_pmd_bnxt_set_vf_persist_stats(port->rte_port_number, vf->num, 1);
-					}
+			if( vf->num >= 0 ) {
+				if (get_nic_type(port->rte_port_number) == VFD_BNXT) {
+					bleat_printf( 2, "%s vf: %d set keep stats", port->name, vf->num);
+					rte_pmd_bnxt_set_vf_persist_stats(port->rte_port_number, vf->num, 1);
+				}
+				if( !(hws.known & HWS_SPOOF) || hws.vlan_anti_spoof != !!vf->vlan_anti_spoof ) {
 					bleat_printf( 2, "port: %d vf: %d set anti-spoof to %d", port->rte_port_number, vf->num, vf->vlan_anti_spoof );
 					set_vf_vlan_anti_spoofing(port->rte_port_number, vf->num, vf->vlan_anti_spoof);
+				}
 
+				if( !(hws.known & HWS_SPOOF) || hws.mac_anti_spoof != !!vf->mac_anti_spoof ) {
 					bleat_printf( 2, "port: %d vf: %d set mac-anti-spoof to %d", port->rte_port_number, vf->num, vf->mac_anti_spoof );
 					set_vf_mac_anti_spoofing(port->rte_port_number, vf->num, vf->mac_anti_spoof);
+				}
 
+				if( ! hws_ins_strip_match( &hws, vf ) ) {
 					vfd_set_ins_strip( port, vf );				// set insert/strip options
+				}
 
+				if( !(hws.known & HWS_RXMODE) || hws.allow_bcast != !!vf->allow_bcast ) {
 					bleat_printf( 2, "port: %d vf: %d set allow broadcast to %d", port->rte_port_number, vf->num, vf->allow_bcast );
 					set_vf_allow_bcast(port->rte_port_number, vf->num, vf->allow_bcast);
+				}
 
+				if( !(hws.known & HWS_RXMODE) || hws.allow_mcast != !!vf->allow_mcast ) {
 					bleat_printf( 2, "port: %d vf: %d set allow multicast to %d", port->rte_port_number, vf->num, vf->allow_mcast );
 					set_vf_allow_mcast(port->rte_port_number, vf->num, vf->allow_mcast);
+				}
 
+				if( !(hws.known & HWS_RXMODE) || hws.allow_un_ucast != !!vf->allow_un_ucast ) {
 					bleat_printf( 2, "port: %d vf: %d set allow un-ucast to %d", port->rte_port_number, vf->num, vf->allow_un_ucast );
 					set_vf_allow_un_ucast(port->rte_port_number, vf->num, vf->allow_un_ucast);
-
-					bleat_printf( 2, "port: %d vf: %d set link status to %d", port->rte_port_number, vf->num, vf->link);
-					set_vf_link_status( port->rte_port_number, vf->num, vf->link);
-				
 				}
 
+				bleat_printf( 2, "port: %d vf: %d set link status to %d%s", port->rte_port_number, vf->num, VF_LINK( vf ), vf->prep_name ? " (prepared)" : "" );
+				set_vf_link_status( port->rte_port_number, vf->num, VF_LINK( vf ) );
+			
+			}
 
 
-				vf->last_updated = UNCHANGED;				// mark processed
-			}
 
-			if( change2port && (g_parms->rflags & RF_ENABLE_QOS) ) {		// changes, we must recompute queue shares and push to nic
-				gen_port_qshares( port );									// compute and save in the port struct
-				if (get_nic_type(port->rte_port_number) == VFD_MLX5) {
-					mlx5_set_vf_tcqos( port, link.link_speed );
-				} else {
-					//uint8_t* pp;
-					qos_set_credits( port->rte_port_number, port->mtu, port->vftc_qshares, TC_4PERQ_MODE );	// push out to nic
-					//qos_set_credits( port->rte_port_number, port->mtu, pp, TC_4PERQ_MODE );	// push out to nic
-				}
+			vf->last_updated = UNCHANGED;				// mark processed
+		}
+
+		if( (change2port || qs_changed) && (g_parms->rflags & RF_ENABLE_QOS) ) {		// changes, we must recompute queue shares and push to nic
+			gen_port_qshares( port );									// compute and save in the port struct
+			if (get_nic_type(port->rte_port_number) == VFD_MLX5) {
+				mlx5_set_vf_tcqos( port, link.link_speed );
+			} else {
+				//uint8_t* pp;
+				qos_set_credits( port->rte_port_number, port->mtu, port->vftc_qshares, TC_4PERQ_MODE );	// push out to nic
+				//qos_set_credits( port->rte_port_number, port->mtu, pp, TC_4PERQ_MODE );	// push out to nic
 			}
+		}
 
-			if( change2port && vf->num >= 0 ) {
-				bleat_printf( 3, "set promiscuous: port: %d, vf: %d ", port->rte_port_number, vf->num);
-		
-				// az says: figure out if we have to update it every time we change VLANS/MACS
-				// 			or once when update ports config
-				if( port->flags & PF_PROMISC ) {
-					bleat_printf( 1, "enabling promiscuous mode for port %d", port->rte_port_number );
-					rte_eth_promiscuous_enable(port->rte_port_number);
-				}
-				else {
-					bleat_printf( 1, "disabling promiscuous mode for port %d", port->rte_port_number );
-					rte_eth_promiscuous_disable(port->rte_port_number);
-				}
-				
-				if (get_nic_type(port->rte_port_number) == VFD_BNXT)
-					rte_eth_allmulticast_disable(port->rte_port_number);
-				else
-					rte_eth_allmulticast_enable(port->rte_port_number);
-				
-				if (get_nic_type(port->rte_port_number) == VFD_NIANTIC) {
-					ret = rte_eth_dev_uc_all_hash_table_set(port->rte_port_number, on);
-					
-					if (ret < 0)
-						bleat_printf( 0, "ERR: bad unicast hash table parameter, return code = %d", ret);
-				}					
+		if( change2port && vf->num >= 0 ) {
+			bleat_printf( 3, "set promiscuous: port: %d, vf: %d ", port->rte_port_number, vf->num);
+	
+			// az says: figure out if we have to update it every time we change VLANS/MACS
+			// 			or once when update ports config
+			if( port->flags & PF_PROMISC ) {
+				bleat_printf( 1, "enabling promiscuous mode for port %d", port->rte_port_number );
+				rte_eth_promiscuous_enable(port->rte_port_number);
+			}
+			else {
+				bleat_printf( 1, "disabling promiscuous mode for port %d", port->rte_port_number );
+				rte_eth_promiscuous_disable(port->rte_port_number);
+			}
+			
+			if (get_nic_type(port->rte_port_number) == VFD_BNXT)
+				rte_eth_allmulticast_disable(port->rte_port_number);
+			else
+				rte_eth_allmulticast_enable(port->rte_port_number);
+			
+			if (get_nic_type(port->rte_port_number) == VFD_NIANTIC) {
+				ret = rte_eth_dev_uc_all_hash_table_set(port->rte_port_number, on);
 				
-				// don't accept untagged frames
-				set_vf_allow_untagged(port->rte_port_number, vf->num, !on);
-
+				if (ret < 0)
+					bleat_printf( 0, "ERR: bad unicast hash table parameter, return code = %d", ret);
+			}					
 			
-			}
-		}				// end for each vf on this port
+			// don't accept untagged frames
+			set_vf_allow_untagged(port->rte_port_number, vf->num, !on);
 
-		if( need_ready_msg ) {									// only on the first port init; all other updates are quiet
-			log_port_state( port, "ready" );
-			need_ready_msg = 0;
+		
 		}
-    }   				  // end for each port
+	}				// end for each vf on this port
+
+	if( need_ready_msg ) {									// only on the first port init; all other updates are quiet
+		log_port_state( port, "ready" );
+	}
+}
+
+/*
+	Runs through the configuration and makes adjustments.  This is
+	a tweak of the original code (update_ports_config) inasmuch as the dynamic
+	changes to the configuration based on nova add/del requests are made to the
+	"running config" -- there is no longer a new/old config to compare with.  This
+	function will update a port/vf based on the last_updated flag in any port/VF
+	in the config:
+		-1 delete (remove macs and vlans)
+		0  no change, no action
+		1  add (add macs  and vlans)
+		3  update (push only the changes in vf->delta)
+
+	Bleat messages have been added so that dynamically adjusted verbosity is
+	available.
+
+	Conf is the configuration to check. If parms->forreal is set, then we actually
+	make the dpdk calls to do the work.
+
+
+	TODO:  the original, and thus this, function always return 0 (good); we need to
+		figure out how to handle errors back from the rte_ calls.
+*/
+extern int vfd_update_nic( parms_t* parms, sriov_conf_t* conf ) {
+	uint64_t start;
+
+	if( (parms->rflags & RF_INITIALISED) == 0 ) {
+		bleat_printf( 2, "update_nic: not initialised, nic settings not updated" );
+		return 0;
+	}
 
-	rte_spinlock_unlock( &running_config->update_lock );
+	if( ! parms->forreal ) {
+		bleat_printf( 1, "nic update skipped: -n mode set" );
+		return 0;
+	}
+
+	start = perf_now( );
+	pthread_mutex_lock( &running_config->update_lock );
+	rcu_publish( conf );										// guests configuring during the update must see the new policy
+	
+	pfw_run( conf, update_port, conf );						// each port by its owner (in parallel) if pf owners are running
+
+
+	rcu_publish( conf );										// and again as it now is on the nic (deleted VFs gone)
+	pthread_mutex_unlock( &running_config->update_lock );
+	perf_nic_add( perf_now( ) - start );						// charged to the request being handled (if any)
 	return 0;
 }
 
@@ -1172,6 +1522,14 @@ static void sig_int( int sig ) {
 	return;
 }
 
+/*
+	SIGHUP: request a parm file reload. The work is done in the main loop; nothing
+	here that isn't signal safe.
+*/
+static void sig_hup( int sig ) {
+	reload_pending = 1;
+}
+
 /*
 	Signals we choose to ignore drive this.
 */
@@ -1188,7 +1546,7 @@ sig_ign( int sig ) {
 */
 static void set_signals( void ) {
 	struct sigaction sa;
-	int	sig_list[] = { SIGINT, SIGQUIT, SIGILL, SIGABRT, SIGFPE, SIGSEGV, SIGPIPE,				// list of signals we trap
+	int	sig_list[] = { SIGINT, SIGQUIT, SIGILL, SIGABRT, SIGFPE, SIGSEGV,						// list of signals we trap
        				SIGALRM, SIGTERM, SIGUSR1 , SIGUSR2, SIGBUS, SIGPROF, SIGSYS,
 					SIGTRAP, SIGURG, SIGVTALRM, SIGXCPU, SIGXFSZ, SIGIO };
 
@@ -1196,11 +1554,17 @@ static void set_signals( void ) {
 	int nele;		// number of elements in the list
 	
 	memset( &sa, 0, sizeof( sa ) );
-	sa.sa_handler = sig_ign;						// we ignore hup, so special function for this
+	sa.sa_handler = sig_hup;						// hup drives a parm file reload
 	if( sigaction( SIGHUP, &sa, NULL ) < 0 ) {
 		bleat_printf( 0, "WRN: unable to set signal trap for %d: %s", SIGHUP, strerror( errno ) );
 	}
 
+	memset( &sa, 0, sizeof( sa ) );
+	sa.sa_handler = SIG_IGN;						// a departed fifo/socket reader surfaces as EPIPE on the write
+	if( sigaction( SIGPIPE, &sa, NULL ) < 0 ) {
+		bleat_printf( 0, "WRN: unable to ignore signal %d: %s", SIGPIPE, strerror( errno ) );
+	}
+
 	nele = (int) ( sizeof( sig_list )/sizeof( int ) );		// convert raw size to the number of elements
 	for( i = 0; i < nele; i ++ ) {
 		memset( &sa, 0, sizeof( sa ) );
@@ -1211,6 +1575,320 @@ static void set_signals( void ) {
 	}
 }
 
+/*
+	Record the real (dpdk) port number for the port at pfidx in our config and
+	map the real port back to the config.
+*/
+static void map_pf( portid_t portid, int pfidx ) {
+	struct rte_eth_dev_info dev_info;
+
+	rte_eth_dev_info_get( portid, &dev_info );
+	port2config_map[portid] = pfidx;										// map real port to our array index
+	running_config->ports[pfidx].rte_port_number = portid; 					// record the real pf number
+	running_config->ports[pfidx].nvfs_config = dev_info.max_vfs;			// number of configured VFs (could be less than max)
+	if( strcmp( dev_info.driver_name, "net_mlx5" ) == 0 ) {
+		running_config->ports[pfidx].nvfs_config = vfd_mlx5_get_num_vfs( portid );
+	}
+}
+
+/*
+	Initialise a PF which is in our config; the port has already been mapped to the real
+	(dpdk) port number. Used at start up and when a PF is added by a parm reload.
+	Returns 0 on success, non-zero on failure.
+*/
+static int init_pf( portid_t portid, struct sriov_port_s* port, int hw_strip_crc ) {
+	struct rte_eth_dev_info dev_info;
+	struct rte_eth_dev_info pf_dev;
+	struct rte_pci_device const* pci_dev;
+	uint32_t pci_control_r = 0;
+	int		state;
+	int		j;
+
+	rte_eth_dev_info_get( portid, &dev_info );
+	#if RTE_VER_YEAR >= 18   && RTE_VER_MONTH >= 05  
+		pci_dev = port_to_pcidev( portid );
+	#else
+		pci_dev = dev_info.pci_dev;
+	#endif
+
+	for( j = 0; j < 64; j++ ) {						//???  hardcoded 64 seems very dodgy!
+		set_split_erop( portid, j, SET_ON );							// set the split receive drop enable for all VFs
+	}
+
+	if( (g_parms->rflags & RF_REATTACH) && port_can_reattach( portid, port, !!(g_parms->rflags & RF_ENABLE_QOS) ) ) {
+		state = port_reattach( portid );								// adopt as is; resetting would bounce every VF
+		port->flags |= PF_REATTACHED;
+	} else if( g_parms->rflags & RF_ENABLE_QOS ) {
+		state = dcb_port_init( port, g_mbuf_pool );
+	} else {
+		state = port_init( portid, g_mbuf_pool, hw_strip_crc, port );
+		set_fc_on( portid, !!(g_parms->rflags & RF_ENABLE_FC) );		// if override is set, then force our setting for fc onto nic
+	}
+
+	if( state != 0 ) {
+		bleat_printf( 0, "ERR: port initialisation failed: %d (%s)", (int) portid, port->pciid );
+		return -1;
+	}
+	bleat_printf( 2, "port initialisation successful for port %d [%s]", portid, port->pciid );
+
+	set_pfrx_drop( portid, 1 );			// enable the drop bit for the PF queues on this port
+	port_xstats_init( port );			// resolve xstat names to ids once; stats fetch by id from here on
+
+	rte_eth_macaddr_get(portid, &addr);
+	bleat_printf( 1,  "mapping port: %u, MAC: %02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ", ",
+			(unsigned)portid,
+			addr.addr_bytes[0], addr.addr_bytes[1],
+			addr.addr_bytes[2], addr.addr_bytes[3],
+			addr.addr_bytes[4], addr.addr_bytes[5]);
+	
+	bleat_printf( 1, "driver: %s, index %d, pkts rx: %lu", dev_info.driver_name, dev_info.if_index, st.pcount);
+	bleat_printf( 1, "pci: %04X:%02X:%02X.%01X, max VF's: %d", pci_dev->addr.domain, pci_dev->addr.bus,
+		pci_dev->addr.devid , pci_dev->addr.function, dev_info.max_vfs );
+	
+	rte_eth_dev_info_get(portid, &pf_dev);
+	switch( get_nic_type( portid ) ) {		// read pci config to get a generic offset and stride of VFs
+		case VFD_BNXT:
+			{
+				uint16_t	cfg_offset = 0x100;
+
+				do {
+					rte_pci_read_config(pci_dev, &pci_control_r, 32, cfg_offset);
+					bleat_printf(4, "Header: %08x (%04x)", pci_control_r, cfg_offset);
+					if ((pci_control_r & 0xffff) == 0x0010)
+						break;
+					cfg_offset = (pci_control_r >> 20) & ~3;
+					if (cfg_offset == 0)
+						break;
+				} while(1);
+
+				if (cfg_offset == 0) {
+					bleat_printf(0, "Unable to locate SR-IOV configuration");
+					return -1;
+				}
+
+				rte_pci_read_config( pci_dev, &pci_control_r, 32, cfg_offset + 20);
+			}
+			break;
+
+		case VFD_NIANTIC:
+			rte_pci_read_config(pci_dev, &pci_control_r, 32, 0x174);
+			break;
+
+		case VFD_FVL25:
+			rte_pci_read_config(pci_dev, &pci_control_r, 32, 0x174);
+			break;
+
+		case VFD_MLX5:
+			pci_control_r = vfd_mlx5_pf_vf_offset(port->pciid) | (1 << 16);
+			break;
+	}
+
+	port->vf_offset = pci_control_r & 0x0ffff;
+	port->vf_stride = pci_control_r >> 16;
+
+	return 0;
+}
+
+/*
+	Find the definition for the pciid in the parms; nil if it's not there.
+*/
+static pfdef_t* find_pfdef( parms_t* parms, const_str pciid ) {
+	int i;
+
+	for( i = 0; i < parms->npciids; i++ ) {
+		if( parms->pciids[i].id != NULL && strcmp( parms->pciids[i].id, pciid ) == 0 ) {
+			return &parms->pciids[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Returns the number of VFs configured on the port.
+*/
+static int count_vfs( struct sriov_port_s* port ) {
+	int i;
+	int n = 0;
+
+	for( i = 0; i < port->num_vfs; i++ ) {
+		if( port->vfs[i].num >= 0 ) {
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/*
+	Stop and detach a PF and drop it from the config.
+*/
+static void retire_pf( sriov_conf_t* conf, int pidx ) {
+	char	dev_name[RTE_ETH_NAME_MAX_LEN];
+	portid_t portid;
+
+	portid = conf->ports[pidx].rte_port_number;
+	port2config_map[portid] = -1;						// no callbacks should map from here on
+
+	rte_eth_dev_stop( portid );
+	rte_eth_dev_close( portid );
+	if( rte_eth_dev_detach( portid, dev_name ) == 0 ) {
+		bleat_printf( 2, "device closed and detached: %s", dev_name );
+	} else {
+		bleat_printf( 1, "WRN: device closed but could not be detached: port %d", portid );
+	}
+
+	vfd_del_port( conf, pidx );
+}
+
+/*
+	Attach and initialise a PF that was added to the parm file. Returns 0 on success.
+*/
+static int add_pf( sriov_conf_t* conf, pfdef_t* pfc ) {
+	portid_t portid;
+	int		pidx;
+
+	if( rte_eth_dev_get_port_by_name( pfc->id, &portid ) != 0 ) {			// not already known to dpdk (expected as the whitelist is set at start)
+		if( rte_eth_dev_attach( pfc->id, &portid ) != 0 ) {
+			bleat_printf( 0, "ERR: reload: unable to attach device: %s", pfc->id );
+			return -1;
+		}
+	}
+
+	if( (pidx = vfd_add_port( conf, pfc )) < 0 ) {
+		return -1;
+	}
+
+	map_pf( portid, pidx );
+	if( init_pf( portid, &conf->ports[pidx], pfc->hw_strip_crc ) != 0 ) {
+		retire_pf( conf, pidx );
+		return -1;
+	}
+
+	if( portid >= n_ports ) {
+		n_ports = portid + 1;							// so close and discard loops see it
+	}
+
+	return 0;
+}
+
+/*
+	Reread the parm file and apply changes to the list of PFs. A PF which is no longer
+	listed is stopped, detached and dropped; a PF which is newly listed is attached and
+	initialised. A PF whose definition changed (mtu, flags, TCs etc.) is retired and
+	added again. PFs which still have VFs configured are not retired (the VFs must be
+	deleted first) and PFs whose definition didn't change are not touched. Other
+	parm file values are not changed by a reload.
+
+	A summary (newline separated) is left in mbuf. Returns 0 if everything was applied
+	and non-zero if the file couldn't be read or something was skipped or failed.
+*/
+extern int vfd_reload( parms_t* parms, sriov_conf_t* conf, char* mbuf, int mlen ) {
+	parms_t*	newp;
+	pfdef_t*	pfc;
+	pfdef_t*	swap;
+	struct sriov_port_s* port;
+	char		pciid[64];
+	int*		present;				// new defs which are matched by an unchanged (or kept) port
+	int			len = 0;
+	int			nvfs;
+	int			nadded = 0;
+	int			nretired = 0;
+	int			nerrs = 0;
+	int			i;
+	int			nswap;
+
+	*mbuf = 0;
+	if( ! parms->forreal ) {
+		snprintf( mbuf, mlen, "reload ignored: running in no-nic (-n) mode" );
+		return 1;
+	}
+
+	if( (newp = read_parms( g_parm_file )) == NULL ) {
+		snprintf( mbuf, mlen, "reload failed: unable to read parm file: %s: %s", g_parm_file, strerror( errno ) );
+		bleat_printf( 0, "%s", mbuf );
+		return 1;
+	}
+
+	bleat_printf( 0, "reloading pf definitions from %s", g_parm_file );
+	present = (int *) calloc( newp->npciids + 1, sizeof( *present ) );
+
+	for( i = conf->num_ports - 1; i >= 0; i-- ) {							// backwards as retiring a port slides those above down
+		port = &conf->ports[i];
+		pfc = find_pfdef( newp, port->pciid );
+
+		if( pfc != NULL && ! vfd_port_differs( port, find_pfdef( parms, port->pciid ), pfc ) ) {
+			present[pfc - newp->pciids] = 1;								// unchanged; leave it be
+			continue;
+		}
+
+		if( (nvfs = count_vfs( port )) > 0 ) {
+			if( pfc != NULL ) {
+				present[pfc - newp->pciids] = 1;							// can't re-add what we didn't retire
+			}
+			len += snprintf( mbuf + len, mlen - len, "pf %s: %s but not retired; %d VFs are configured\n", port->pciid, pfc ? "changed" : "removed", nvfs );
+			if( len >= mlen ) {
+				len = mlen - 1;
+			}
+			nerrs++;
+			continue;
+		}
+
+		snprintf( pciid, sizeof( pciid ), "%s", port->pciid );				// port is gone after retire
+		retire_pf( conf, i );
+		nretired++;
+		len += snprintf( mbuf + len, mlen - len, "pf %s: %s\n", pciid, pfc ? "changed; retired to be added again" : "retired" );
+		if( len >= mlen ) {
+			len = mlen - 1;
+		}
+	}
+
+	for( i = 0; i < newp->npciids; i++ ) {
+		if( present[i] ) {
+			continue;
+		}
+
+		if( add_pf( conf, &newp->pciids[i] ) == 0 ) {
+			nadded++;
+			len += snprintf( mbuf + len, mlen - len, "pf %s: added\n", newp->pciids[i].id );
+		} else {
+			nerrs++;
+			len += snprintf( mbuf + len, mlen - len, "pf %s: add failed\n", newp->pciids[i].id );
+		}
+		if( len >= mlen ) {
+			len = mlen - 1;
+		}
+	}
+
+	swap = parms->pciids;													// new definitions are now the reference for the next reload
+	nswap = parms->npciids;
+	parms->pciids = newp->pciids;
+	parms->npciids = newp->npciids;
+	newp->pciids = swap;
+	newp->npciids = nswap;
+	free_parms( newp );
+	free( present );
+
+	if( (nadded > 0 || nretired > 0) && (parms->rflags & RF_PF_WORKERS) ) {
+		pthread_mutex_lock( &conf->update_lock );							// one owner per port; restart to match the new set
+		pfw_stop( );
+		pfw_start( conf, !!(parms->rflags & RF_PF_PIN) );
+		pthread_mutex_unlock( &conf->update_lock );
+	}
+
+	if( nadded > 0 ) {
+		vfd_update_nic( parms, conf );										// drive the promisc etc. settings on the new ports
+	}
+
+	pthread_mutex_lock( &conf->update_lock );
+	rcu_publish( conf );													// retired ports must disappear from the snapshot too
+	pthread_mutex_unlock( &conf->update_lock );
+
+	snprintf( mbuf + len, mlen - len, "reload complete: %d added, %d retired, %d not applied", nadded, nretired, nerrs );
+	bleat_printf( 0, "%s", mbuf );
+	return nerrs;
+}
+
 //-----------------------------------------------------------------------------------------------------------------------
 
 // Time difference in millisecond
@@ -1430,17 +2108,18 @@ main(int argc, char **argv)
 	int		opt;
 	int		fd = -1;
 	int		enable_qos = 0;				// off by default enable_qos in config should be used to set on
-	int		state;
-	int 	j;
 	int		no_huge = 0;				// -H will turn on and we will flip the appropriate bit in parms
 
 	int		enable_fc = 0;				// enable flow control (-F sets)
+	int		reattach = 0;				// adopt running ports rather than resetting them (-r sets)
+	char*	validate_dir = NULL;		// --validate: check configs in this directory and exit
 	u_int16_t portid;
 
 
   const char * main_help =
 		"\n"
-		"Usage: vfd [-f] [-F] [-H] [-n] [-p parm-file] [-v level] [-q]\n"
+		"Usage: vfd [-f] [-F] [-H] [-n] [-p parm-file] [-v level] [-q] [-r]\n"
+		"Usage: vfd [-p parm-file] --validate config-dir\n"
 		"Usage: vfd -?\n"
 		"  Options:\n"
 		"\t -f        keep in 'foreground'\n"
@@ -1449,13 +2128,19 @@ main(int argc, char **argv)
 		"\t -n        no-nic actions executed\n"
 		"\t -p <file> parmm file (/etc/vfd/vfd.cfg)\n"
 		"\t -q        enable dcb qos (use config file parm as general rule)\n"
+		"\t -r        reattach to running ports; don't reset them and leave them running on exit\n"
+		"\t -V <dir>  (--validate) check the vf configs in dir against the parm file and exit; dpdk is not started\n"
 
 		"\t -h|?  Display this help screen\n"
 		"\n";
 
+	static struct option long_opts[] = {				// long forms; each maps to a short flag
+		{ "validate",	required_argument,	NULL, 'V' },
+		{ NULL,			0,					NULL, 0 }
+	};
+
   		//"\t -s <num>  syslog facility 0-11 (log_kern - log_ftp) 16-23 (local0-local7) see /usr/include/sys/syslog.h\n"
 
-	struct rte_mempool *mbuf_pool = NULL;
 	prog_name = strdup(argv[0]);
  	useSyslog = 1;
 
@@ -1463,7 +2148,7 @@ main(int argc, char **argv)
 	log_file = (char *) malloc( sizeof( char ) * BUF_1K );
 
   // Parse command line options
-  while ( (opt = getopt(argc, argv, "?qfFHhnqv:p:s:")) != -1)
+  while ( (opt = getopt_long(argc, argv, "?qfFHhnqrv:p:s:V:", long_opts, NULL)) != -1)
   {
     switch (opt)
     {
@@ -1497,6 +2182,14 @@ main(int argc, char **argv)
 			enable_qos = 1;
 			break;
 
+		case 'r':
+			reattach = 1;
+			break;
+
+		case 'V':
+			validate_dir = strdup( optarg );
+			break;
+
 		case 'h':
 		case '?':
 			printf( "\nVFd %s %s\n", vnum, version );
@@ -1531,8 +2224,23 @@ main(int argc, char **argv)
 		g_parms->rflags |= RF_ENABLE_FC;
 	}
 
+	if( reattach ) {						// can be set on cmd line or in config
+		g_parms->rflags |= RF_REATTACH;
+	}
+
 	g_parms->forreal = forreal;
 
+	if( validate_dir != NULL ) {						// offline check; nothing below here (dirs, logs, dpdk) is needed
+		if( (running_config = (sriov_conf_t *) calloc( 1, sizeof( *running_config ) )) == NULL ) {
+			fprintf( stderr, "abort: unable to allocate memory for running config\n" );
+			exit( 1 );
+		}
+		pthread_mutex_init( &running_config->update_lock, NULL );
+		bleat_set_lvl( g_parms->init_log_level );
+
+		exit( vfd_validate( g_parms, running_config, validate_dir ) ? 1 : 0 );
+	}
+
 	if( ! check_dirs( g_parms ) ) { // ensure config directories are good	
 		exit( 1 );
 	}
@@ -1543,7 +2251,7 @@ main(int argc, char **argv)
 		exit( 1 );
 	}
 	memset( running_config, 0, sizeof( *running_config ) );
-	rte_spinlock_init( &running_config->update_lock );						// initialise and leave unlocked
+	pthread_mutex_init( &running_config->update_lock, NULL );						// initialise and leave unlocked
 	running_config->mir_id_mgr = mk_idm( 256 );								// make an id manager with 256 ID 'slots' for allocating mirror IDs
 
 	if( strcmp( g_parms->log_dir, "stderr" ) != 0 ) {						// something other than stdin, we'll switch even if -f given
@@ -1565,6 +2273,20 @@ main(int argc, char **argv)
 		bleat_printf( 2, "-f supplied, staying attached to parent process" );
 	}
 
+	bleat_set_dedup( g_parms->log_dedup, g_parms->log_rate_max );		// flood control for the log
+
+	if( bleat_start_hk( g_parms->rflags & RF_LOG_COMPRESS ) != 0 ) {	// like the async writer, must be started after daemonise
+		bleat_printf( 0, "WRN: unable to start log housekeeping thread; logs will be rolled by the writer" );
+	}
+
+	if( g_parms->rflags & RF_ASYNC_LOG ) {							// writer thread must be started after daemonise (threads don't survive fork)
+		if( bleat_set_async( 4096 ) != 0 ) {
+			bleat_printf( 0, "WRN: unable to start asynchronous log writer; logging synchronously" );
+		} else {
+			bleat_printf( 1, "asynchronous logging enabled" );
+		}
+	}
+
 
 	bleat_printf( 0, "VFD %s %s initialising", vnum, version );
 	bleat_printf( 0, "config dir set to: %s", g_parms->config_dir );
@@ -1573,6 +2295,9 @@ main(int argc, char **argv)
 		bleat_printf( 0, "CRI: abort: unable to initialise request fifo" );
 		exit( 1 );
 	}
+	if( sock_init( g_parms ) < 0 ) {												// not fatal; the fifo still works
+		bleat_printf( 0, "WRN: unable to initialise request socket; requests accepted only on the fifo" );
+	}
 
 	if( vfd_eal_init( g_parms ) < 0 ) {												// dpdk function returns -1 on error
 		bleat_printf( 0, "CRI: abort: unable to initialise dpdk eal environment" );
@@ -1586,7 +2311,6 @@ main(int argc, char **argv)
 	if( g_parms->forreal ) {										// begin dpdk setup and device discovery
 		int ret;					// returned value from some call
 		u_int16_t portid;
-		uint32_t pci_control_r;
 
 		bleat_printf( 1, "starting rte initialisation" );
 		
@@ -1632,8 +2356,8 @@ main(int argc, char **argv)
 #endif
 		
 		bleat_printf( 1, "creating memory pool" ); 									// Creates a new mempool in memory to hold the mbufs.  
-		mbuf_pool = rte_pktmbuf_pool_create("sriovctl", NUM_MBUFS, MBUF_CACHE_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
-		if (mbuf_pool == NULL) {
+		g_mbuf_pool = rte_pktmbuf_pool_create("sriovctl", NUM_MBUFS, MBUF_CACHE_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+		if (g_mbuf_pool == NULL) {
 			bleat_printf( 0, "CRI: abort: mbuf pool creation failed" );
 			rte_exit(EXIT_FAILURE, "Cannot create mbuf pool\n");
 		}
@@ -1644,8 +2368,6 @@ main(int argc, char **argv)
 			char pciid[25];
 			struct rte_eth_dev_info dev_info;
 			int	pfidx;																// port index in our array if we find it; -1 otherwise.
-			struct rte_eth_dev_info pf_dev;
-			struct sriov_port_s* port;
 			struct rte_pci_device const* pci_dev;
 
 
@@ -1661,91 +2383,17 @@ main(int argc, char **argv)
 				if (strcmp(pciid, running_config->ports[i].pciid) == 0) {
 					bleat_printf( 2, "physical port %i maps to config %d (%s)", portid, i, pciid );
 					pfidx = i;
-					port2config_map[portid] = i;									// map real port to our array index
-					running_config->ports[i].rte_port_number = portid; 				// record the real pf number
-					running_config->ports[i].nvfs_config = dev_info.max_vfs;		// number of configured VFs (could be less than max)
-					if (strcmp(dev_info.driver_name, "net_mlx5") == 0)
-						running_config->ports[i].nvfs_config = vfd_mlx5_get_num_vfs(portid);
+					map_pf( portid, i );
 					break;
 				}
 			}
 
 			// CAUTION:   port id is the dpdk port and pfidx is the index into our array of ports for; don't mix them up in this block of code!
 			if( pfidx >= 0 ) {														// initialise only if in our confilg file list (we may not manage everything)
-				port  = &running_config->ports[pfidx];
-
-				for( j = 0; j < 64; j++ ) {						//???  hardcoded 64 seems very dodgy!
-					set_split_erop( portid, j, SET_ON );							// set the split receive drop enable for all VFs
-				}
-
-				if( g_parms->rflags & RF_ENABLE_QOS ) {
-					state = dcb_port_init( &running_config->ports[pfidx], mbuf_pool );
-				} else {
-					state = port_init(portid, mbuf_pool, g_parms->pciids[pfidx].hw_strip_crc, &running_config->ports[pfidx] );  // g_parms order is same as running_config
-					set_fc_on( portid, !!(g_parms->rflags & RF_ENABLE_FC) );		// if override is set, then force our setting for fc onto nic
-				}
-
-				if( state != 0 ) {
+				if( init_pf( portid, &running_config->ports[pfidx], g_parms->pciids[pfidx].hw_strip_crc ) != 0 ) {	// g_parms order is same as running_config
 					bleat_printf( 0, "CRI: abort: port initialisation failed: %d", (int) portid );
-					rte_exit(EXIT_FAILURE, "Cannot init port %"PRIu8 "\n", portid);
-				} else {
-					bleat_printf( 2, "port initialisation successful for port %d [%d]", portid, pfidx );
+					rte_exit( EXIT_FAILURE, "Cannot init port %"PRIu8 "; see log(s) in: %s\n", portid, g_parms->log_dir );
 				}
-
-				set_pfrx_drop( portid, 1 );			// enable the drop bit for the PF queues on this port
-			
-				rte_eth_macaddr_get(portid, &addr);
-				bleat_printf( 1,  "mapping port: %u, MAC: %02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ":%02" PRIx8 ", ",
-						(unsigned)portid,
-						addr.addr_bytes[0], addr.addr_bytes[1],
-						addr.addr_bytes[2], addr.addr_bytes[3],
-						addr.addr_bytes[4], addr.addr_bytes[5]);
-	
-				bleat_printf( 1, "driver: %s, index %d, pkts rx: %lu", dev_info.driver_name, dev_info.if_index, st.pcount);
-				bleat_printf( 1, "pci: %04X:%02X:%02X.%01X, max VF's: %d", pci_dev->addr.domain, pci_dev->addr.bus,
-					pci_dev->addr.devid , pci_dev->addr.function, dev_info.max_vfs );
-				
-				rte_eth_dev_info_get(portid, &pf_dev);
-				switch( get_nic_type( portid ) ) {		// read pci config to get a generic offset and stride of VFs
-					case VFD_BNXT:
-						{
-							uint16_t	cfg_offset = 0x100;
-
-							do {
-								rte_pci_read_config(pci_dev, &pci_control_r, 32, cfg_offset);
-								bleat_printf(4, "Header: %08x (%04x)", pci_control_r, cfg_offset);
-								if ((pci_control_r & 0xffff) == 0x0010)
-									break;
-								cfg_offset = (pci_control_r >> 20) & ~3;
-								if (cfg_offset == 0)
-									break;
-							} while(1);
-
-							if (cfg_offset == 0) {
-								bleat_printf(0, "Unable to locate SR-IOV configuration");
-								rte_exit( EXIT_FAILURE, "initialisation failure, see log(s) in: %s\n", g_parms->log_dir );
-								exit ( 1 );
-							}
-
-							rte_pci_read_config( pci_dev, &pci_control_r, 32, cfg_offset + 20);
-						}
-						break;
-
-					case VFD_NIANTIC:
-						rte_pci_read_config(pci_dev, &pci_control_r, 32, 0x174);
-						break;
-
-					case VFD_FVL25:
-						rte_pci_read_config(pci_dev, &pci_control_r, 32, 0x174);
-						break;
-
-					case VFD_MLX5:
-						pci_control_r = vfd_mlx5_pf_vf_offset(port->pciid) | (1 << 16);
-						break;
-				}
-
-				port->vf_offset = pci_control_r & 0x0ffff;
-				port->vf_stride = pci_control_r >> 16;
 			} else {
 				port2config_map[portid] = -1;					// we must not allow an interrupt to map (we shouldn't get interrupts, but be parinoid)
 				bleat_printf( 0, "pf %d (%s) is NOT in vfd config file and was not initialised", portid, pciid );
@@ -1768,7 +2416,13 @@ main(int argc, char **argv)
 	}
 
 
-	vfd_add_all_vfs( g_parms, running_config );							// read all existing config files and add the VFs to the config
+	if( ! snap_load( g_parms, running_config, parm_file ) ) {			// warm restart from the snapshot if configs haven't changed
+		vfd_add_all_vfs( g_parms, running_config );						// else read all existing config files and add the VFs to the config
+	}
+
+	if( forreal && (g_parms->rflags & RF_PF_WORKERS) ) {
+		pfw_start( running_config, !!(g_parms->rflags & RF_PF_PIN) );		// each pf is programmed by its own thread
+	}
 
 	if( vfd_update_nic( g_parms, running_config ) != 0 ) {				// now that dpdk is initialised run the list and 'activate' everything
 		bleat_printf( 0, "CRI: abort: unable to initialise nic with base config:" );
@@ -1780,6 +2434,7 @@ main(int argc, char **argv)
 	}
 	
 	run_start_cbs( running_config );				// run any user startup callback commands defined in VF configs
+	watch_init( g_parms, running_config );			// if enabled, apply anything left in the config dir and start watching
 
 	bleat_printf( 0, "version: %s", version );
 	bleat_printf( 0, "initialisation complete, setting bleat level to %d; starting to loop", g_parms->log_level );
@@ -1791,7 +2446,8 @@ main(int argc, char **argv)
 		rte_log_set_level( RTE_LOGTYPE_PORT, g_parms->dpdk_log_level );
 	}
 
-	free( parm_file );			// now it's safe to free the parm file
+	g_parm_file = parm_file;	// kept for parm reload
+	vfd_start_workers( g_parms, g_parms->req_workers );			// read only requests are handled off the main thread
 
 #if VFD_KERNEL
 	// send message to kernel module asking to update netdev list
@@ -1800,11 +2456,23 @@ main(int argc, char **argv)
 
 	while(!terminated)
 	{
-		usleep(50000);			// .5s
+		watch_wait( 50 );		// .05s, or less if a config file lands or a socket needs attention
+		sock_flush();			// push queued responses to readers that can take them
+		rcu_reclaim();			// free config snapshots that readers have finished with (rcu locks its own list)
+
+		watch_check( g_parms, running_config );							// apply config directory changes (if watching)
+		if( reload_pending ) {
+			char	rbuf[BUF_1K * 4];
 
+			reload_pending = 0;
+			vfd_reload( g_parms, running_config, rbuf, sizeof( rbuf ) );	// results are logged
+		}
 		while( vfd_req_if( g_parms, running_config, 0 ) ); 				// process _all_ pending requests before going on
 
 		chk_cpu_usage( g_parms->cpu_alrm_type, g_parms->cpu_alrm_thresh );
+		stats_dump_check( g_parms, running_config );					// write stats to stats_path if the interval has popped
+		snap_check( g_parms, running_config );							// save the running config snapshot if it changed
+		bleat_flush_repeats();											// report suppressed messages once a flood stops
 
 		// Discard any RX traffic...
 		for (portid = 0; portid < n_ports; portid++)
@@ -1818,6 +2486,15 @@ main(int argc, char **argv)
 #endif	
 
 	bleat_printf( 0, "terminating" );
+	vfd_stop_workers();
+	pthread_mutex_lock( &running_config->update_lock );				// no update may be handing work to the owners
+	pfw_stop();
+	pthread_mutex_unlock( &running_config->update_lock );
+	sock_close();
+	rcu_shutdown();
+	if( forreal ) {
+		snap_save( g_parms, running_config );							// capture anything changed since the last check
+	}
 	log_port_state( NULL, "not ready" );								// mark all ports down in log
 	run_stop_cbs( running_config );										// run any user stop callback commands that were given in VF conf files
 
@@ -1829,6 +2506,8 @@ main(int argc, char **argv)
 
 	gettimeofday(&st.endTime, NULL);
 	bleat_printf( 1, "duration %.f sec\n", timeDelta(&st.endTime, &st.startTime)/1000 );
+	bleat_stop_hk();
+	bleat_stop_async();				// flush anything queued if running async
 
 	return EXIT_SUCCESS;
 }
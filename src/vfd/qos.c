@@ -40,6 +40,7 @@
 	Date:		06 June 2016
 */
 
+#define BLEAT_SUBSYS	BLEAT_SS_QOS		// tag our bleat messages; must be set before vfdlib.h is included
 #include "sriov.h"
 #include "vfd_qos.h"
 #include <vfdlib.h>		// if vfdlib.h needs an include it must be included there, can't be include prior
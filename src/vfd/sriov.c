@@ -33,12 +33,21 @@
 				22 May 2017 - Add ability to remove a whitelist RX mac.
 				10 Oct 2017 - Add range check on mirror target.
 				07 Jun 2017 - Don't use an empty MAC address from the white list.
+				19 Oct 2026 - Resolve xstat names to ids once per port and fetch only
+					the selected counters with rte_eth_xstats_get_by_id().
+				19 Oct 2026 - Split counter fetch from formatting for PF, VF and xstats so
+					that the periodic stats dump can use raw values.
+				19 Oct 2026 - Add VF hardware state read back and port reattach support.
+				19 Oct 2026 - Refresh queue drives restores after releasing the queue lock.
+				19 Oct 2026 - Add vf_link_holdable() so that callers can tell whether a
+					VF's link can be forced down on the port's NIC.
 
 	useful doc:
 				 http://www.intel.com/content/dam/doc/design-guide/82599-sr-iov-driver-companion-guide.pdf
 */
 
 
+#define BLEAT_SUBSYS	BLEAT_SS_NIC		// tag our bleat messages; must be set before vfdlib.h is included
 #include "vfdlib.h"
 #include "sriov.h"
 #include "vfd_dcb.h"
@@ -180,6 +189,17 @@ get_nic_type(portid_t port_id)
 	return 0;
 }
 
+/*
+	Returns true if set_vf_link_status() can force a VF's link down on the port's
+	NIC. The call is a no-op for the others, so a VF there passes traffic once its
+	filters are programmed regardless of the link setting.
+*/
+int
+vf_link_holdable(portid_t port_id)
+{
+	return get_nic_type(port_id) == VFD_MLX5;
+}
+
 int
 set_vf_link_status(portid_t port_id, uint16_t vf, int status)
 {
@@ -939,6 +959,37 @@ int get_split_ctlreg( portid_t port_id, uint16_t vf_id ) {
 	return ret;
 }
 
+/*
+	Read the current settings for the VF from the NIC. Hws->known has a bit set
+	for each group of settings the driver was able to read back; it is 0 for
+	NICs which don't support read back. Returns 1 if anything is known.
+*/
+int get_vf_hwstate( portid_t port_id, uint16_t vf_id, vf_hwstate_t* hws ) {
+	memset( hws, 0, sizeof( *hws ) );
+
+	uint dev_type = get_nic_type(port_id);
+	switch (dev_type) {
+		case VFD_NIANTIC:
+			vfd_ixgbe_get_vf_hwstate( port_id, vf_id, hws );
+			break;
+
+		case VFD_FVL25:				// these are known, but don't support read back
+			break;
+
+		case VFD_BNXT:
+			break;
+
+		case VFD_MLX5:
+			break;
+
+		default:
+			bleat_printf( 0, "get_vf_hwstate: unknown device type: %u, port: %u", port_id, dev_type);
+			break;
+	}
+
+	return hws->known != 0;
+}
+
 /*
 	Set/reset the enable drop bit in the split receive control register. State is either 1 (on) or 0 (off).
 
@@ -1263,14 +1314,20 @@ static void enable_refresh_queue(u_int8_t port_id, uint16_t vf_id)
 	This is executed in it's own thread and is responsible for checking the
 	queue of pending resets. When a pending reset becomes 'enabled' then
 	the following happen:
+		- the block is removed from the queue
 		- restore_vf_settings() executed for the VF
 		- drop enable bit is CLEARED for all of the VF's queues.
-		- the block is removed from the queue
+
+	Enabled blocks are pulled from the queue under the lock, but the restores
+	are driven after it is released; a restore waits for the update lock and
+	programs the nic, and the mailbox callbacks which queue resets must not
+	wait behind that.
 */
 void
 process_refresh_queue(void)
 {
 	struct rq_entry* next_item;		// pointer makes delete and free safe in loop
+	struct rq_entry* ready;			// enabled blocks pulled from the queue this pass
 
 	while(1) {
 
@@ -1278,20 +1335,14 @@ process_refresh_queue(void)
 		//usleep(5000000);
 		struct rq_entry *refresh_item;
 
+		ready = NULL;
 		rte_spinlock_lock(&rte_refresh_q_lock);
 		for( refresh_item = rq_list; refresh_item != NULL; refresh_item = next_item ) {
 			next_item = refresh_item->next;			// if we delete we need this to go forward
 
 			//printf("checking the queue:  PORT: %d, VF: %d, Enabled: %d\n", refresh_item->port_id, refresh_item->vf_id, refresh_item->enabled);
-			/* check if item's q is enabled, update VF and remove item from queue */
+			/* check if item's q is enabled, remove item from queue to update the VF */
 			if(refresh_item->enabled){
-				bleat_printf( 2, "refresh item enabled: updating VF: %d", refresh_item->vf_id);
- 
-				restore_vf_setings(refresh_item->port_id, refresh_item->vf_id);		// refresh all of our configuration back onto the NIC
-				
-				bleat_printf( 3, "refresh_queue: clearing enable queue drop for %d/%d", refresh_item->port_id, refresh_item->vf_id );
-				set_rx_drop( refresh_item->port_id, refresh_item->vf_id, SET_OFF );
-
 				if( refresh_item->prev ) {
 					refresh_item->prev->next = refresh_item->next;
 				} else {
@@ -1300,8 +1351,9 @@ process_refresh_queue(void)
 				if( refresh_item->next ) {
 					refresh_item->next->prev = refresh_item->prev;
 				}
-				memset( refresh_item, 0, sizeof( *refresh_item ) );
-				free(refresh_item);
+
+				refresh_item->next = ready;
+				ready = refresh_item;
 			}
 			else
 			{
@@ -1311,6 +1363,19 @@ process_refresh_queue(void)
 		}
 
 		rte_spinlock_unlock(&rte_refresh_q_lock);
+
+		for( refresh_item = ready; refresh_item != NULL; refresh_item = next_item ) {
+			next_item = refresh_item->next;
+
+			bleat_printf( 2, "refresh item enabled: updating VF: %d", refresh_item->vf_id);
+			restore_vf_setings(refresh_item->port_id, refresh_item->vf_id);		// refresh all of our configuration back onto the NIC
+
+			bleat_printf( 3, "refresh_queue: clearing enable queue drop for %d/%d", refresh_item->port_id, refresh_item->vf_id );
+			set_rx_drop( refresh_item->port_id, refresh_item->vf_id, SET_OFF );
+
+			memset( refresh_item, 0, sizeof( *refresh_item ) );
+			free(refresh_item);
+		}
 	}
 }
 
@@ -1338,18 +1403,19 @@ nic_stats_clear(portid_t port_id)
 }
 
 
-int
-nic_stats_display(uint16_t port_id, char * buff, int bsize)
+/*
+	Fetch the PF counters, link state and spoofed packet count for the port. The
+	spoof counters on some NICs are reset on read, so this is the only place that
+	they should be read; the running total is kept in spoffed[].
+*/
+void
+nic_stats_get( uint16_t port_id, struct rte_eth_stats* stats, struct rte_eth_link* link, uint64_t* spoofed )
 {
-	struct rte_eth_stats stats;
-	struct rte_eth_link link;
-	char status[6];
-
-	memset( &link, 0, sizeof( link ) );
-	link.link_speed = 1;						// no return code, fill with strange values to determine success/failure of call
+	memset( link, 0, sizeof( *link ) );
+	link->link_speed = 1;						// no return code, fill with strange values to determine success/failure of call
 
-	rte_eth_link_get(port_id, &link);
-	rte_eth_stats_get(port_id, &stats);	
+	rte_eth_link_get(port_id, link);
+	rte_eth_stats_get(port_id, stats);	
 
 	uint dev_type = get_nic_type(port_id);
 	switch (dev_type) {
@@ -1370,9 +1436,22 @@ nic_stats_display(uint16_t port_id, char * buff, int bsize)
 			break;
 
 		default:
-			bleat_printf( 0, "nic_stats_display: unknown device type: %u, port: %u", port_id, dev_type);
+			bleat_printf( 0, "nic_stats_get: unknown device type: %u, port: %u", port_id, dev_type);
 			break;	
 	}
+
+	*spoofed = spoffed[port_id];
+}
+
+int
+nic_stats_display(uint16_t port_id, char * buff, int bsize)
+{
+	struct rte_eth_stats stats;
+	struct rte_eth_link link;
+	uint64_t	spoofed;
+	char status[6];
+
+	nic_stats_get( port_id, &stats, &link, &spoofed );
 	
 	if( link.link_speed == 1 ) {   // unchanged, so assume all data is unreliable
 		stpcpy(status, "-UNK-");
@@ -1395,10 +1474,58 @@ nic_stats_display(uint16_t port_id, char * buff, int bsize)
 		(long long) stats.opackets,
 		(long long) stats.obytes,
 		(int) stats.oerrors,
-		(long long) spoffed[port_id]
+		(long long) spoofed
 	);
 }
 
+/*
+	Fetch the counters for a single VF. Stats is zeroed first as not all NICs fill
+	every field. Spoofed is set to UINT64_MAX-ish values by some drivers when the
+	count cannot be read (left as 0 when the NIC does not support it).
+	Returns the driver's result (0 == success).
+*/
+int
+vf_stats_get( uint16_t port_id, uint32_t vf, struct rte_eth_stats* stats, uint64_t* spoofed )
+{
+	int result = 0;
+	uint64_t vf_spoffed = 0;
+
+	memset( stats, 0, sizeof( *stats ) );			// not all NICs fill all data, so ensure we have 0s
+	uint dev_type = get_nic_type(port_id);
+	switch (dev_type) {
+		case VFD_NIANTIC:
+			result = vfd_ixgbe_get_vf_stats(port_id, vf, stats);
+			stats->oerrors = 0;
+			break;
+			
+		case VFD_FVL25:		
+			result = vfd_i40e_get_vf_stats(port_id, vf, stats);
+			break;
+
+		case VFD_BNXT:
+			result = vfd_bnxt_get_vf_stats(port_id, vf, stats);
+			if (rte_pmd_bnxt_get_vf_tx_drop_count(port_id, vf, &vf_spoffed))
+				vf_spoffed = UINT64_MAX;
+			break;
+			
+		case VFD_MLX5:
+			result = vfd_mlx5_get_vf_stats(port_id, vf, stats);
+			vf_spoffed = vfd_mlx5_get_vf_spoof_stats(port_id, vf);
+			break;
+
+		default:
+			bleat_printf( 0, "vf_stats_get: unknown device type: %u, port: %u", port_id, dev_type);
+			break;	
+	}
+	
+	if( result != 0 ) {
+		bleat_printf( 0, "fail: vf_stats_get: port %d, vf=%d: errno=%d", port_id, vf, result );
+	}
+
+	*spoofed = vf_spoffed;
+	return result;
+}
+
 /*
 *	prints VF statistics
 	Returns number of characters placd into buff, or -1 if error (vf not in use
@@ -1410,7 +1537,6 @@ int
 vf_stats_display(uint16_t port_id, uint32_t pf_ari, int ivf, char * buff, int bsize)
 {
 	uint32_t vf;
-	int result = 0;
 	uint64_t vf_spoffed = 0;
 	uint64_t vf_rx_dropped = 0;
 		
@@ -1437,37 +1563,7 @@ vf_stats_display(uint16_t port_id, uint32_t pf_ari, int ivf, char * buff, int bs
 
 
 	struct rte_eth_stats stats;
-	memset( &stats, 0, sizeof( stats ) );			// not all NICs fill all data, so ensure we have 0s
-	uint dev_type = get_nic_type(port_id);
-	switch (dev_type) {
-		case VFD_NIANTIC:
-			result = vfd_ixgbe_get_vf_stats(port_id, vf, &stats);
-			stats.oerrors = 0;
-			break;
-			
-		case VFD_FVL25:		
-			result = vfd_i40e_get_vf_stats(port_id, vf, &stats);
-			break;
-
-		case VFD_BNXT:
-			result = vfd_bnxt_get_vf_stats(port_id, vf, &stats);
-			if (rte_pmd_bnxt_get_vf_tx_drop_count(port_id, vf, &vf_spoffed))
-				vf_spoffed = UINT64_MAX;
-			break;
-			
-		case VFD_MLX5:
-			result = vfd_mlx5_get_vf_stats(port_id, vf, &stats);
-			vf_spoffed = vfd_mlx5_get_vf_spoof_stats(port_id, vf);
-			break;
-
-		default:
-			bleat_printf( 0, "vf_stats_display: unknown device type: %u, port: %u", port_id, dev_type);
-			break;	
-	}
-	
-	if( result != 0 ) {
-		bleat_printf( 0, "fail: vf_stats_display: port %d, vf=%d: errno=%d", port_id, vf, result );
-	}
+	vf_stats_get( port_id, vf, &stats, &vf_spoffed );
 
 
 	char status[5];
@@ -1486,70 +1582,203 @@ vf_stats_display(uint16_t port_id, uint32_t pf_ari, int ivf, char * buff, int bs
 
 
 /*
-	prints extended PF statistics
-	rx_size_64_packets: 0
-	rx_size_65_to_127_packets: 0
-	rx_size_128_to_255_packets: 0
-	rx_size_256_to_511_packets: 0
-	rx_size_512_to_1023_packets: 0
-	rx_size_1024_to_max_packets: 0
-	tx_size_64_packets: 0
-	tx_size_65_to_127_packets: 0
-	tx_size_128_to_255_packets: 0
-	tx_size_256_to_511_packets: 0
-	tx_size_512_to_1023_packets: 0
-	tx_size_1024_to_max_packets: 0
+	Default set of xstat name prefixes exported when the parm file does not
+	supply a list for the PF: packet size histograms, per-queue counters,
+	per-priority pause (xon/xoff) counters and missed packets.
+*/
+static const_str def_xstat_pfx[] = {
+	"rx_size_", "tx_size_",
+	"rx_q", "tx_q",
+	"rx_priority", "tx_priority",
+	"rx_missed",
+	NULL
+};
 
-	eturns number of characters placed into buff.
+/*
+	Release the cached xstat id/name lists for the port. Safe to call if the
+	list was never resolved.
+*/
+void
+port_xstats_free( sriov_port_t* pf )
+{
+	int i;
+
+	if( pf == NULL ) {
+		return;
+	}
+
+	if( pf->xstat_names != NULL ) {
+		for( i = 0; i < pf->nxstats; i++ ) {
+			free( pf->xstat_names[i] );
+		}
+		free( pf->xstat_names );
+	}
+	free( pf->xstat_ids );
+	free( pf->xstat_vals );
+
+	pf->xstat_names = NULL;
+	pf->xstat_ids = NULL;
+	pf->xstat_vals = NULL;
+	pf->nxstats = 0;
+}
+
+/*
+	Returns true if the xstat name matches one of the prefixes we export for the port.
+*/
+static int want_xstat( sriov_port_t* pf, const char* name )
+{
+	int i;
+
+	if( pf->xstat_pfx != NULL ) {
+		for( i = 0; i < pf->nxstat_pfx; i++ ) {
+			if( strncmp( name, pf->xstat_pfx[i], strlen( pf->xstat_pfx[i] ) ) == 0 ) {
+				return 1;
+			}
+		}
+
+		return 0;
+	}
+
+	for( i = 0; def_xstat_pfx[i] != NULL; i++ ) {
+		if( strncmp( name, def_xstat_pfx[i], strlen( def_xstat_pfx[i] ) ) == 0 ) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+	Resolve the xstat name table for the port once and keep the ids of the
+	counters we export so that only those values need be fetched (by id)
+	when stats are generated. The name table is fixed for a device, so this
+	needs to be redone only if the port is reinitialised.
+
+	Returns the number of xstats selected, or -1 on error.
 */
 int
-port_xstats_display(uint16_t port_id, char * buff, int bsize)
+port_xstats_init( sriov_port_t* pf )
 {
-	struct rte_eth_xstat *xstats;
-	int cnt_xstats, idx_xstat;
 	struct rte_eth_xstat_name *xstats_names;
+	int cnt_xstats;
+	int idx_xstat;
+	int n = 0;
+	portid_t port_id;
+
+	if( pf == NULL ) {
+		return -1;
+	}
+
+	port_xstats_free( pf );
+	port_id = pf->rte_port_number;
 
 	cnt_xstats = rte_eth_xstats_get_names(port_id, NULL, 0);
-	if (cnt_xstats  < 0) {
+	if (cnt_xstats  <= 0) {
 		bleat_printf( 0, "fail: unable to get count of xstats for port: %d", port_id);
-		return 0;
+		return -1;
 	}
 
 	xstats_names = malloc(sizeof(struct rte_eth_xstat_name) * cnt_xstats);
-	if (xstats_names == NULL) {
+	pf->xstat_ids = malloc( sizeof( *pf->xstat_ids ) * cnt_xstats );			// worst case size; small and allocated once
+	pf->xstat_vals = malloc( sizeof( *pf->xstat_vals ) * cnt_xstats );
+	pf->xstat_names = malloc( sizeof( *pf->xstat_names ) * cnt_xstats );
+	if( xstats_names == NULL || pf->xstat_ids == NULL || pf->xstat_vals == NULL || pf->xstat_names == NULL ) {
 		bleat_printf( 0, "fail: unable to allocate memory for xstat names for port: %d", port_id);
-		return 0;
+		free( xstats_names );
+		port_xstats_free( pf );
+		return -1;
 	}
-	
+
 	if (cnt_xstats != rte_eth_xstats_get_names(port_id, xstats_names, cnt_xstats)) {
 		bleat_printf( 0, "fail: unable to get xstat names for port: %d", port_id);
 		free(xstats_names);
+		port_xstats_free( pf );
+		return -1;
+	}
+
+	for (idx_xstat = 0; idx_xstat < cnt_xstats; idx_xstat++) {
+		if( want_xstat( pf, xstats_names[idx_xstat].name ) ) {
+			pf->xstat_ids[n] = idx_xstat;									// the id is the index in the name table
+			pf->xstat_names[n] = strdup( xstats_names[idx_xstat].name );
+			n++;
+		}
+	}
+	pf->nxstats = n;
+
+	free(xstats_names);
+
+	bleat_printf( 1, "port %d: %d of %d xstats selected for export", port_id, n, cnt_xstats );
+	return n;
+}
+
+/*
+	Fetch the values of the selected xstats for the port into pf->xstat_vals
+	(parallel to pf->xstat_names). The id list is resolved if it has not been.
+	Returns the number of values fetched; 0 if none are selected, or -1 on error.
+*/
+int
+port_xstats_get( sriov_port_t* pf )
+{
+	if( pf == NULL ) {
+		return -1;
+	}
+
+	if( pf->xstat_ids == NULL ) {								// not resolved at init (or invalidated); try now
+		if( port_xstats_init( pf ) < 0 ) {
+			return -1;
+		}
+	}
+
+	if( pf->nxstats <= 0 ) {
 		return 0;
 	}
 
-	xstats = malloc(sizeof(struct rte_eth_xstat) * cnt_xstats);
-	if (xstats == NULL) {
-		bleat_printf( 0, "fail: unable to allocate memory for xstat for port: %d", port_id);
-		free(xstats_names);
+	if( rte_eth_xstats_get_by_id( pf->rte_port_number, pf->xstat_ids, pf->xstat_vals, pf->nxstats ) != pf->nxstats ) {
+		bleat_printf( 0, "fail: unable to get xstat for port: %d", pf->rte_port_number );
+		port_xstats_free( pf );								// force the ids to be resolved again on next call
+		return -1;
+	}
+
+	return pf->nxstats;
+}
+
+/*
+	prints extended PF statistics; only those selected when the port's xstat id
+	list was resolved are fetched (by id) and formatted. With the default set the
+	output looks like:
+	rx_size_64_packets: 0
+	rx_size_65_to_127_packets: 0
+	...
+	tx_size_1024_to_max_packets: 0
+	rx_q0packets: 0
+	...
+	rx_priority0_xon_packets: 0
+	...
+	rx_missed_errors: 0
+
+	eturns number of characters placed into buff.
+*/
+int
+port_xstats_display(uint16_t port_id, char * buff, int bsize)
+{
+	sriov_port_t* pf;
+	int idx_xstat;
+	int lw = 0;
+
+	if( (pf = suss_port( port_id )) == NULL ) {
+		bleat_printf( 0, "fail: xstats: port doesn't map: %d", port_id);
 		return 0;
 	}
-	
-	if (cnt_xstats != rte_eth_xstats_get(port_id, xstats, cnt_xstats)) {
-		bleat_printf( 0, "fail: unable to get xstat for port: %d", port_id);
-		free(xstats_names);
-		free(xstats);
+
+	if( port_xstats_get( pf ) <= 0 ) {
 		return 0;
 	}
 
-  int lw = 0;
-	for (idx_xstat = 0; idx_xstat < cnt_xstats; idx_xstat++)
-		if (strncmp(xstats_names[idx_xstat].name, "rx_size_", 8) == 0 || strncmp(xstats_names[idx_xstat].name, "tx_size_", 8) == 0)
-			lw += snprintf(buff + lw, bsize - lw, "%s: %"PRIu64"\n", xstats_names[idx_xstat].name, xstats[idx_xstat].value);		
+	for (idx_xstat = 0; idx_xstat < pf->nxstats && lw < bsize; idx_xstat++) {
+		lw += snprintf(buff + lw, bsize - lw, "%s: %"PRIu64"\n", pf->xstat_names[idx_xstat], pf->xstat_vals[idx_xstat]);
+	}
 
-	free(xstats_names);
-	free(xstats);
-	
-	return lw;
+	return lw < bsize ? lw : bsize - 1;
 }
 
 
@@ -1775,6 +2004,75 @@ port_init(uint16_t port, __attribute__((__unused__)) struct rte_mempool *mbuf_po
 	return 0;
 }
 
+/*
+	Returns true if the port can be adopted as it is (reattach) rather than
+	being reset by port_init(). The link must already be up (a reset on probe
+	would have dropped it) and the driver must confirm that the port is set up
+	the way that we'd set it up. Only NICs whose driver can read back the VF
+	settings are considered.
+*/
+int port_can_reattach( uint16_t port, sriov_port_t *pf, int dcb ) {
+	struct rte_eth_link link;
+
+	memset( &link, 0, sizeof( link ) );
+	rte_eth_link_get_nowait( port, &link );
+	if( ! link.link_status ) {
+		bleat_printf( 1, "port %d cannot be reattached: link is down", port );
+		return 0;
+	}
+
+	uint dev_type = get_nic_type(port);
+	switch (dev_type) {
+		case VFD_NIANTIC:
+			if( vfd_ixgbe_port_compatible( port, pf->mtu, dcb ) ) {
+				return 1;
+			}
+			bleat_printf( 1, "port %d cannot be reattached: configuration is not compatible", port );
+			break;
+
+		default:
+			bleat_printf( 1, "port %d cannot be reattached: not supported for device type %u", port, dev_type );
+			break;
+	}
+
+	return 0;
+}
+
+/*
+	Adopt a port which is already configured and running. The port is not
+	configured or started (either resets the NIC and the VFs with it), so no
+	queues are set up for the PF; only the callbacks are registered so that
+	link state changes and VF mailbox requests are handled.
+
+	Return 0 if there were no errors, 1 otherwise.
+*/
+int port_reattach( uint16_t port ) {
+	int retval = 0;
+
+	rte_eth_dev_callback_register(port,
+				RTE_ETH_EVENT_INTR_LSC,
+				lsi_event_callback, NULL);
+
+	uint dev_type = get_nic_type(port);
+	switch (dev_type) {
+		case VFD_NIANTIC:
+			retval = rte_eth_dev_callback_register(port, RTE_ETH_EVENT_VF_MBOX, vfd_ixgbe_vf_msb_event_callback, NULL);
+			break;
+
+		default:
+			bleat_printf( 0, "port_reattach: unsupported device type: %u, port: %u", port, dev_type);
+			return 1;
+	}
+
+	if (retval != 0) {
+		bleat_printf( 0, "CRI: abort: cannot register callback function %u, retval %d", port, retval);
+		return 1;
+	}
+
+	bleat_printf( 1, "port %d reattached; port was not reset", port );
+	return 0;
+}
+
 /*
 	Set flow control on.  We normally require switches to disable flow control on ports 
 	connected to VFd managed PFs, however if this cannot be controlled this provides the
@@ -14,6 +14,18 @@
 					Fix comment in same initialisation.
 				16 May 2017 - Add flow control flag constant.
 				10 Oct 2017 - Change set_mirror proto.
+				19 Oct 2026 - Add cached xstat id list to the port struct.
+				19 Oct 2026 - Add snapshot (warm restart) and claim_macs protos.
+				19 Oct 2026 - Add VF hardware state (reattach) struct and protos.
+				19 Oct 2026 - Add the VF delta (in place update) struct and del_mac proto.
+				19 Oct 2026 - Add prepared (two phase add) name to the VF struct.
+				19 Oct 2026 - Add request socket protos.
+				19 Oct 2026 - Add response queue protos.
+				19 Oct 2026 - Add config snapshot (cfg_snap_t) and its protos.
+				19 Oct 2026 - Add pf owner thread protos.
+				19 Oct 2026 - Add request latency (perf) protos.
+				19 Oct 2026 - Update lock is a mutex; it's held while pf owners program the ports.
+				19 Oct 2026 - Add per port device lock protos; snapshots hold only the ports in use.
 */
 
 #ifndef _SRIOV_H_
@@ -74,6 +86,7 @@
 #include <rte_string_fns.h>
 #include <rte_spinlock.h>
 #include <rte_version.h>
+#include <pthread.h>
 
 #if VFD_KERNEL
 #include "vfd_nl.h"
@@ -131,6 +144,7 @@
 #define VF_LINK_ON	1
 #define VF_LINK_OFF	-1
 #define VF_LINK_AUTO 0
+#define VF_LINK(vf)	((vf)->prep_name != NULL ? VF_LINK_OFF : (vf)->link)	// link setting to push; prepared VFs are held down
 
 #define TOGGLE(i) ((i+ 1) & 1)
 //#define TV_TO_US(tv) ((tv)->tv_sec * 1000000 + (tv)->tv_usec)
@@ -173,6 +187,7 @@ typedef uint16_t streamid_t;
 #define PF_OVERSUB	0x02		// allow qos oversubscription
 #define PF_FC_ON	0x04		// turn flow control on for port
 #define PF_PROMISC	0x08		// set promisc for the port when high
+#define PF_REATTACHED	0x10	// port was adopted as it was found (reattach) rather than reset
 
 
 #define VFD_MAX_CPU	5			// CPU% threshold
@@ -267,6 +282,8 @@ struct vf_s
 	char*	stop_cb;
 	char*	config_name;			// name given in config file for delete confirmation
 	uint8_t	qshares[MAX_TCS];		// percentage of each queue (TC) that has been set in the config for the vf
+	struct vf_delta_s*	delta;		// changes from an update request not yet pushed to the nic
+	char*	prep_name;				// config file basename while prepared (link held down until commit); nil when live
 };
 
 
@@ -281,6 +298,66 @@ struct mirror_s
 };
 
 
+/*
+	What an update request changed on a VF. The VF struct already has the new
+	values; this has what is needed to take the old ones off the nic. Update_nic
+	pushes only these changes and then frees the struct.
+*/
+#define VD_VLANS		0x01		// vlans added and/or removed
+#define VD_MACS			0x02		// white list macs added and/or removed
+#define VD_DEFMAC		0x04		// default mac changed
+#define VD_INS_STRIP	0x08		// strip/insert settings (or the insert id) changed
+#define VD_RXMODE		0x10		// bcast, mcast or un-ucast changed
+#define VD_RATE			0x20
+#define VD_MIN_RATE		0x40
+#define VD_LINK			0x80
+#define VD_MIRROR		0x100
+#define VD_QSHARES		0x200
+
+typedef struct vf_delta_s
+{
+	int		what;						// VD_ flags
+	int		nvlans_add;
+	int		vlans_add[MAX_VF_VLANS];
+	int		nvlans_del;
+	int		vlans_del[MAX_VF_VLANS];
+	int		nmacs_add;
+	char	macs_add[MAX_VF_MACS][18];
+	int		nmacs_del;
+	char	macs_del[MAX_VF_MACS][18];
+	struct mirror_s old_mirror;			// mirror as it was before the update
+} vf_delta_t;
+
+
+/*
+	VF settings read back from the NIC (reattach). Known has a HWS_ bit set for
+	each group that the driver was able to read; anything else is unknown and
+	must be programmed.
+*/
+#define HWS_SPOOF		0x01		// mac and vlan anti-spoof
+#define HWS_RXMODE		0x02		// bcast, mcast, un-ucast and untagged
+#define HWS_VLANS		0x04		// vlan filter list
+#define HWS_MACS		0x08		// mac filter list (default included)
+#define HWS_INS_STRIP	0x10		// vlan insert id and strip
+
+typedef struct vf_hwstate_s
+{
+	int		known;					// HWS_ constants
+	int		mac_anti_spoof;
+	int		vlan_anti_spoof;
+	int		allow_bcast;
+	int		allow_mcast;
+	int		allow_un_ucast;
+	int		allow_untagged;
+	int		strip;
+	int		insert_vlan;			// vlan id inserted on tx; 0 if none
+	int		num_vlans;
+	int		vlans[MAX_VF_VLANS];
+	int		num_macs;
+	char	macs[MAX_VF_MACS][18];
+} vf_hwstate_t;
+
+
 /*
 	Manages information for a single NIC port. Each port may have up to MAX_VFS configured.
 */
@@ -305,6 +382,13 @@ typedef struct sriov_port_s
 	// will keep PCI First VF offset and Stride here
 	uint16_t vf_offset;
 	uint16_t vf_stride;
+
+	int			nxstat_pfx;				// number of xstat name prefixes (from the parm file)
+	char**		xstat_pfx;				// xstat name prefixes to export; nil if the default set should be used
+	int			nxstats;				// number of xstats resolved into the id list
+	uint64_t*	xstat_ids;				// xstat ids resolved once (nil until port_xstats_init() is successful)
+	char**		xstat_names;			// names parallel to the id list
+	uint64_t*	xstat_vals;				// value buffer filled by rte_eth_xstats_get_by_id()
 } sriov_port_t;
 
 /*
@@ -314,10 +398,27 @@ typedef struct sriov_conf_c
 {
 	int     num_ports;						// number of ports actually used in ports array
 	struct sriov_port_s ports[MAX_PORTS];	// ports; CAUTION: order may not be device id order
-	rte_spinlock_t update_lock;				// we lock the config during update and deployment
+	pthread_mutex_t update_lock;			// we lock the config during update and deployment; held across nic updates so waiters must sleep
 	void*	mir_id_mgr;						// reference point for the id manager to allocate mirror ids
 } sriov_conf_t;
 
+/*
+	Immutable copy of the configuration published after each nic update for readers
+	which must not wait on the update lock (vfd_rcu.c). Only num_ports and the ports
+	in use are present in conf (the allocation stops after the last of them, so the
+	update lock and mirror id manager must not be referenced), and in each port only
+	the VFs and mirrors in use are valid. Port pointers (tc config, xstats) and the
+	VF callback and delta pointers are nil.
+*/
+typedef struct cfg_snap_s
+{
+	uint64_t	version;					// increases with each publish
+	uint64_t	retired_at;					// epoch when replaced
+	struct cfg_snap_s* next;				// retired list
+	int			port_map[MAX_PORTS];		// port2config_map when published
+	sriov_conf_t conf;						// must be last
+} cfg_snap_t;
+
 
 enum print_warning {
 	ENABLED_WARN = 0,
@@ -507,6 +608,7 @@ int  rx_vft_set(portid_t port_id, uint16_t vlan_id, int on);
 void init_port_config(void);
 
 int get_split_ctlreg( portid_t port_id, uint16_t vf_id );
+int get_vf_hwstate( portid_t port_id, uint16_t vf_id, vf_hwstate_t* hws );
 int set_mirror( portid_t port_id, uint32_t vf, uint8_t id, uint8_t target, uint8_t direction );
 int set_mirror_wrp( portid_t port_id, uint32_t vf, uint8_t id, uint8_t target, uint8_t direction );
 void set_queue_drop( portid_t port_id, int state );
@@ -527,15 +629,23 @@ void set_vf_mac_anti_spoofing(portid_t port_id, uint32_t vf, uint8_t on);
 int set_vf_rate_limit(portid_t port_id, uint16_t vf, uint16_t rate, uint64_t q_msk);
 int set_vf_min_rate(portid_t port_id, uint16_t vf, uint16_t rate, uint64_t q_msk);
 int set_vf_link_status(portid_t port_id, uint16_t vf, int status);
+int vf_link_holdable(portid_t port_id);
 
 void nic_stats_clear(portid_t port_id);
 int nic_stats_display(uint16_t port_id, char * buff, int blen);
 int vf_stats_display(uint16_t port_id, uint32_t pf_ari, int vf, char * buff, int bsize);
 int port_xstats_display(uint16_t port_id, char * buff, int bsize);
+int port_xstats_init( sriov_port_t* pf );
+int port_xstats_get( sriov_port_t* pf );
+void nic_stats_get( uint16_t port_id, struct rte_eth_stats* stats, struct rte_eth_link* link, uint64_t* spoofed );
+int vf_stats_get( uint16_t port_id, uint32_t vf, struct rte_eth_stats* stats, uint64_t* spoofed );
+void port_xstats_free( sriov_port_t* pf );
 int dump_all_vlans(portid_t port_id);
 void ping_vfs(portid_t port_id, int vf);
 
 int port_init(uint16_t port, struct rte_mempool *mbuf_pool, int hw_strip_crc, sriov_port_t *pf );
+int port_can_reattach( uint16_t port, sriov_port_t *pf, int dcb );
+int port_reattach( uint16_t port );
 void tx_set_loopback(portid_t port_id, u_int8_t on);
 
 int ether_aton_r(const char *asc, struct ether_addr * addr);
@@ -575,6 +685,7 @@ void process_refresh_queue(void);
 int is_rx_queue_on(portid_t port_id, uint16_t vf_id, int* mcounter );
 
 int vfd_update_nic( parms_t* parms, sriov_conf_t* conf );
+int vfd_reload( parms_t* parms, sriov_conf_t* conf, char* mbuf, int mlen );
 int vfd_init_fifo( parms_t* parms );
 //int is_valid_mac_str( char* mac );
 char*  gen_stats( sriov_conf_t* conf, int pf_only, int pf );
@@ -590,7 +701,9 @@ void log_port_state( struct sriov_port_s* port, const_str msg );
 extern int mac_init( void );
 extern int add_mac( int port, int vfid, char* mac );
 extern int can_add_mac( int port, int vfid, char* mac );
+extern int claim_macs( int port, int vfid );
 extern int clear_macs( int port, int vfid, int assign_random );
+extern int del_mac( int port, int vfid, char* mac );
 extern int push_mac( int port, int vfid, char* mac );
 extern int set_macs( int port, int vfid );
 
@@ -602,14 +715,74 @@ extern void set_rx_pbsize( portid_t port_id );
 //------- queue support -------------------------
 void set_pfrx_drop(portid_t port_id, int state );
 
+// ---- periodic stats dump (vfd_stats.c) ---------------
+extern int stats_dump( parms_t* parms, sriov_conf_t* conf );
+extern void stats_dump_check( parms_t* parms, sriov_conf_t* conf );
+
+// ---- running config snapshot for warm restart (vfd_snap.c) ---------------
+extern int snap_load( parms_t* parms, sriov_conf_t* conf, const char* parm_file );
+extern int snap_save( parms_t* parms, sriov_conf_t* conf );
+extern void snap_check( parms_t* parms, sriov_conf_t* conf );
+
+// ---- config directory watcher (vfd_watch.c) ---------------
+extern int watch_init( parms_t* parms, sriov_conf_t* conf );
+extern int watch_check( parms_t* parms, sriov_conf_t* conf );
+extern void watch_wait( int ms );
+extern int watch_is_live( const_str fname );
+
+// ---- request socket (vfd_sock.c) ---------------------------
+struct pollfd;
+extern int sock_init( parms_t* parms );
+extern void sock_close( void );
+extern char* sock_read( int* cid, int* len );
+extern int sock_pollfds( struct pollfd* pfds, int max );
+extern int sock_adopt( int fd );
+extern int sock_send( int cid, const_str buf, int len );
+extern void sock_flush( void );
+
+// ---- config snapshots for lock free readers (vfd_rcu.c) -----
+extern uint64_t rcu_publish( sriov_conf_t* conf );
+extern void rcu_reclaim( void );
+extern cfg_snap_t* rcu_acquire( void );
+extern void rcu_release( void );
+extern struct sriov_port_s* rcu_port( cfg_snap_t* s, int portid );
+extern struct vf_s* rcu_vf( cfg_snap_t* s, int portid, int vfid );
+extern void rcu_shutdown( void );
+
+// ---- pf owner threads (vfd_pfw.c) -------------------------
+typedef void (*pfw_fn_t)( void* data, struct sriov_port_s* port );
+extern int pfw_start( sriov_conf_t* conf, int pin );
+extern void pfw_run( sriov_conf_t* conf, pfw_fn_t fn, void* data );
+extern void pfw_stop( void );
+extern void pfw_port_lock( int portid );
+extern void pfw_port_unlock( int portid );
+
+// ---- request latency (vfd_perf.c) -------------------------
+#define PS_QUEUE	0			// request handling stages timed
+#define PS_PARSE	1
+#define PS_APPLY	2
+#define PS_NIC		3
+#define PS_RESPOND	4
+#define PS_TOTAL	5
+#define PS_NSTAGES	6
+
+extern uint64_t perf_now( void );
+extern void perf_record( int rtype, int stage, uint64_t us );
+extern void perf_error( int rtype );
+extern void perf_begin( void );
+extern void perf_nic_add( uint64_t us );
+extern uint64_t perf_nic_us( void );
+extern char* perf_show( void );
+extern void perf_dump( FILE* f, int fmt, time_t now );
+
 // --- tools --------------------------------------------
 extern int stricmp(const char *s1, const char *s2);
 
 
 // ---- new qos, merge up after initial testing ----
 void gen_port_qshares( sriov_port_t *port );
-int check_qs_oversub( struct sriov_port_s* port, uint8_t *qshares );
-int check_qs_spread( struct sriov_port_s* port, uint8_t* qshares );
+int check_qs_oversub( struct sriov_port_s* port, uint8_t *qshares, int skip );
+int check_qs_spread( struct sriov_port_s* port, uint8_t* qshares, int skip );
 
 // --- qos hard coded nic funcitons that need to move to dpdk
 void qos_set_credits( portid_t pf, int mtu, int* rates, int tc8_mode );
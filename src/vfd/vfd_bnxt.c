@@ -1,4 +1,5 @@
 
+#define BLEAT_SUBSYS	BLEAT_SS_NIC		// tag our bleat messages; must be set before vfdlib.h is included
 #include "vfd_bnxt.h"
 
 
@@ -477,7 +478,7 @@ vfd_bnxt_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type, v
 	if (restore)
 		restore_vf_setings(port_id, vf);	// refresh all of our configuration back onto the NIC
 
-	bleat_printf( 3, "Type: %d, Port: %d, VF: %d, OUT: %d, _T: %d",
+	bleat_ssprintf( BLEAT_SS_MBOX, 3, "Type: %d, Port: %d, VF: %d, OUT: %d, _T: %d",
 	             type, port_id, vf, p->retval, mbox_type);
 
 	return 0;   // CAUTION:  as of 2017/07/05 it seems this value is ignored by dpdk, but it might not alwyas be
@@ -15,6 +15,7 @@
 
 */
 
+#define BLEAT_SUBSYS	BLEAT_SS_NIC		// tag our bleat messages; must be set before vfdlib.h is included
 #include <vfdlib.h>		// if vfdlib.h needs an include it must be included there, can't be include prior
 #include "sriov.h"
 #include "vfd_dcb.h"
@@ -1,4 +1,5 @@
 
+#define BLEAT_SUBSYS	BLEAT_SS_NIC		// tag our bleat messages; must be set before vfdlib.h is included
 #include "sriov.h"
 
 int  
@@ -357,10 +358,10 @@ vfd_i40e_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type, v
 	RTE_SET_USED(data);
 
 	//fprintf( stderr, "------------------- MBOX port: %d, vf: %d, configured: %d box_type: %d-------------------\n", port_id, vf, vfp->num_vlans, mbox_type );
-	bleat_printf( 3, "i40e: processing callback starts: pf/vf=%d/%d, evtype=%d mbtype=%d", port_id, vf, type, mbox_type);
+	bleat_ssprintf( BLEAT_SS_MBOX, 3, "i40e: processing callback starts: pf/vf=%d/%d, evtype=%d mbtype=%d", port_id, vf, type, mbox_type);
 			
 	if( vfp == NULL ) {					// for a pf/vf that isn't known to jus; just bail
-		bleat_printf( 3, "i40e: processing callback ends, pf/vf not configured: pf/vf=%d/%d, evtype=%d mbtype=%d", port_id, vf, type, mbox_type);
+		bleat_ssprintf( BLEAT_SS_MBOX, 3, "i40e: processing callback ends, pf/vf not configured: pf/vf=%d/%d, evtype=%d mbtype=%d", port_id, vf, type, mbox_type);
 		p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 		return 0;
 	}
@@ -368,45 +369,45 @@ vfd_i40e_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type, v
 	/* check & process VF to PF mailbox message */
 	switch (mbox_type) {
 		case I40E_VIRTCHNL_OP_RESET_VF:
-			bleat_printf( 1, "reset event received: port=%d", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "reset event received: port=%d", port_id );
 
-			rte_spinlock_lock( &running_config->update_lock );
+			pthread_mutex_lock( &running_config->update_lock );
 			//running_config->ports[cport].vfs[vf].rx_q_ready = 0;		// set queue ready flag off
 			vfp->rx_q_ready = 0;		// set queue ready flag off
-			rte_spinlock_unlock( &running_config->update_lock );
+			pthread_mutex_unlock( &running_config->update_lock );
 			
 			set_vf_allow_untagged(port_id, vf, 0);
 			
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			
-			bleat_printf( 3, "Port: %d, VF: %d, OUT: %d, _T: %s ",
+			bleat_ssprintf( BLEAT_SS_MBOX, 3, "Port: %d, VF: %d, OUT: %d, _T: %s ",
 				port_id, vf, p->retval, "I40E_VIRTCHNL_OP_RESET_VF");
 			break;
 
 		case I40E_VIRTCHNL_OP_ADD_ETHER_ADDRESS:
-			bleat_printf( 1, "setmac event received: port=%d", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "setmac event received: port=%d", port_id );
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;    						// do what's needed
-			bleat_printf( 3, "Port: %d, VF: %d, OUT: %d, _T: %s ",
+			bleat_ssprintf( BLEAT_SS_MBOX, 3, "Port: %d, VF: %d, OUT: %d, _T: %s ",
 				port_id, vf, p->retval, "I40E_VIRTCHNL_OP_ADD_ETHER_ADDRESS");
 
 			new_mac = (struct ether_addr *) (&msgbuf[1]);
 
 			if (is_valid_assigned_ether_addr(new_mac)) {
-				bleat_printf( 3, "setting ucast mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
+				bleat_ssprintf( BLEAT_SS_MBOX, 3, "setting ucast mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
 					" %02" PRIx8 " %02" PRIx8 " %02" PRIx8,
 					(uint32_t)vf,
 					new_mac->addr_bytes[0], new_mac->addr_bytes[1],
 					new_mac->addr_bytes[2], new_mac->addr_bytes[3],
 					new_mac->addr_bytes[4], new_mac->addr_bytes[5]);
 			} else if (is_multicast_ether_addr(new_mac)){
-				bleat_printf( 3, "setting mcast mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
+				bleat_ssprintf( BLEAT_SS_MBOX, 3, "setting mcast mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
 					" %02" PRIx8 " %02" PRIx8 " %02" PRIx8,
 					(uint32_t)vf,
 					new_mac->addr_bytes[0], new_mac->addr_bytes[1],
 					new_mac->addr_bytes[2], new_mac->addr_bytes[3],
 					new_mac->addr_bytes[4], new_mac->addr_bytes[5]);				
 			} else {
-				bleat_printf( 3, "setting mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
+				bleat_ssprintf( BLEAT_SS_MBOX, 3, "setting mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
 					" %02" PRIx8 " %02" PRIx8 " %02" PRIx8,
 					(uint32_t)vf,
 					new_mac->addr_bytes[0], new_mac->addr_bytes[1],
@@ -416,29 +417,29 @@ vfd_i40e_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type, v
 			break;
 
 		case I40E_VIRTCHNL_OP_DEL_ETHER_ADDRESS:
-			bleat_printf( 1, "setmac event received: port=%d", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "setmac event received: port=%d", port_id );
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;    						// do what's needed			
-			bleat_printf( 3, "Port: %d, VF: %d, OUT: %d, _T: %s ",
+			bleat_ssprintf( BLEAT_SS_MBOX, 3, "Port: %d, VF: %d, OUT: %d, _T: %s ",
 				port_id, vf, p->retval, "I40E_VIRTCHNL_OP_DEL_ETHER_ADDRESS");
 
 			new_mac = (struct ether_addr *) (&msgbuf[1]);
 
 			if (is_valid_assigned_ether_addr(new_mac)) {
-				bleat_printf( 3, "deleting ucast mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
+				bleat_ssprintf( BLEAT_SS_MBOX, 3, "deleting ucast mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
 					" %02" PRIx8 " %02" PRIx8 " %02" PRIx8,
 					(uint32_t)vf,
 					new_mac->addr_bytes[0], new_mac->addr_bytes[1],
 					new_mac->addr_bytes[2], new_mac->addr_bytes[3],
 					new_mac->addr_bytes[4], new_mac->addr_bytes[5]);
 			} else if (is_multicast_ether_addr(new_mac)){
-				bleat_printf( 3, "deleting mcast mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
+				bleat_ssprintf( BLEAT_SS_MBOX, 3, "deleting mcast mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
 					" %02" PRIx8 " %02" PRIx8 " %02" PRIx8,
 					(uint32_t)vf,
 					new_mac->addr_bytes[0], new_mac->addr_bytes[1],
 					new_mac->addr_bytes[2], new_mac->addr_bytes[3],
 					new_mac->addr_bytes[4], new_mac->addr_bytes[5]);				
 			} else {
-				bleat_printf( 3, "deleting mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
+				bleat_ssprintf( BLEAT_SS_MBOX, 3, "deleting mac, vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
 					" %02" PRIx8 " %02" PRIx8 " %02" PRIx8,
 					(uint32_t)vf,
 					new_mac->addr_bytes[0], new_mac->addr_bytes[1],
@@ -448,67 +449,67 @@ vfd_i40e_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type, v
 			break;
 
 		case I40E_VIRTCHNL_OP_ADD_VLAN:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_ADD_VLAN");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_ADD_VLAN");
 			if (0 == (int) msgbuf[1]){
-				bleat_printf( 1, "vlan set event approved: port=%d vf=%d vlan=%d (responding ack)", port_id, vf, (int) msgbuf[1] );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "vlan set event approved: port=%d vf=%d vlan=%d (responding ack)", port_id, vf, (int) msgbuf[1] );
 				p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;     // allow to set VLAN 0
 			} else if ( valid_vlan( port_id, vf, (int) msgbuf[1] )) {
-				bleat_printf( 1, "vlan set event approved: port=%d vf=%d vlan=%d (responding ack)", port_id, vf, (int) msgbuf[1] );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "vlan set event approved: port=%d vf=%d vlan=%d (responding ack)", port_id, vf, (int) msgbuf[1] );
 				p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;     // good rc to VM while not changing anything
 			} else {
-				bleat_printf( 1, "vlan set event rejected; vlan not not configured: port=%d vf=%d vlan=%d (responding noop-ack)", port_id, vf, (int) msgbuf[1] );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "vlan set event rejected; vlan not not configured: port=%d vf=%d vlan=%d (responding noop-ack)", port_id, vf, (int) msgbuf[1] );
 				p->retval = RTE_PMD_I40E_MB_EVENT_NOOP_NACK;     // VM should see failure
 			}
 			break;
 			
 		case I40E_VIRTCHNL_OP_DEL_VLAN:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_DEL_VLAN");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_DEL_VLAN");
 			if (0 == (int) msgbuf[1]){
-				bleat_printf( 1, "vlan delete event approved: port=%d vf=%d vlan=%d (responding ack)", port_id, vf, (int) msgbuf[1] );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "vlan delete event approved: port=%d vf=%d vlan=%d (responding ack)", port_id, vf, (int) msgbuf[1] );
 				p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;     // allow to set VLAN 0
 			} else if( valid_vlan( port_id, vf, (int) msgbuf[1] )) {
-				bleat_printf( 1, "vlan delete event approved: port=%d vf=%d vlan=%d (responding ack)", port_id, vf, (int) msgbuf[1] );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "vlan delete event approved: port=%d vf=%d vlan=%d (responding ack)", port_id, vf, (int) msgbuf[1] );
 				p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;     // good rc to VM while not changing anything
 			} else {
-				bleat_printf( 1, "vlan delete event rejected; vlan not not configured: port=%d vf=%d vlan=%d (responding noop-ack)", port_id, vf, (int) msgbuf[1] );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "vlan delete event rejected; vlan not not configured: port=%d vf=%d vlan=%d (responding noop-ack)", port_id, vf, (int) msgbuf[1] );
 				p->retval = RTE_PMD_I40E_MB_EVENT_NOOP_NACK;     // VM should see failure
 			}
 			break;			
 			
 		case I40E_VIRTCHNL_OP_UNKNOWN:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_UNKNOWN");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_UNKNOWN");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_VERSION:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_VERSION");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_VERSION");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_GET_VF_RESOURCES:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_GET_VF_RESOURCES");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_GET_VF_RESOURCES");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_CONFIG_TX_QUEUE:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_TX_QUEUE");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_TX_QUEUE");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_CONFIG_RX_QUEUE:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_RX_QUEUE");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_RX_QUEUE");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_CONFIG_VSI_QUEUES:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_VSI_QUEUES");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_VSI_QUEUES");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_CONFIG_IRQ_MAP:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_IRQ_MAP");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_IRQ_MAP");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_ENABLE_QUEUES:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_ENABLE_QUEUES");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_ENABLE_QUEUES");
 			
-			rte_spinlock_lock( &running_config->update_lock );
+			pthread_mutex_lock( &running_config->update_lock );
 			vfp->rx_q_ready = 1;										// set queue ready flag on
-			rte_spinlock_unlock( &running_config->update_lock );			
+			pthread_mutex_unlock( &running_config->update_lock );			
 			
 			add_refresh_queue(port_id, vf);
 					
@@ -520,44 +521,44 @@ vfd_i40e_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type, v
 			
 			break;
 		case I40E_VIRTCHNL_OP_DISABLE_QUEUES:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_DISABLE_QUEUES");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_DISABLE_QUEUES");
 			
-			rte_spinlock_lock( &running_config->update_lock );
+			pthread_mutex_lock( &running_config->update_lock );
 			vfp->rx_q_ready = 0;										// set queue ready flag off
-			rte_spinlock_unlock( &running_config->update_lock );		
+			pthread_mutex_unlock( &running_config->update_lock );		
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_CONFIG_PROMISCUOUS_MODE:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_PROMISCUOUS_MODE");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_PROMISCUOUS_MODE");
 								
 			// return allowed promisc modes based on specified in config
 			struct i40e_virtchnl_promisc_info *promisc = (struct i40e_virtchnl_promisc_info *)p->msg;
 						
 			if ( vfp->allow_un_ucast) {
 				promisc->flags &= I40E_FLAG_VF_UNICAST_PROMISC;
-				bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "UCAST PROM ENABLE");
+				bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "UCAST PROM ENABLE");
 			} else {
 				promisc->flags &= ~I40E_FLAG_VF_UNICAST_PROMISC;
-				bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "UCAST PROM DISABLE");
+				bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "UCAST PROM DISABLE");
 			}
 			
 			if ( vfp->allow_mcast) {
 				promisc->flags &= I40E_FLAG_VF_MULTICAST_PROMISC;
-				bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "MCAST PROM ENABLE");
+				bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "MCAST PROM ENABLE");
 			} else {
 				promisc->flags &= ~I40E_FLAG_VF_MULTICAST_PROMISC;
-				bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "MCAST PROM DISABLE");
+				bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "MCAST PROM DISABLE");
 			}
 			
 			
 			
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s PCI: %s, PORT # %d", port_id, vf, "-----------------", running_config->ports[cport].pciid, running_config->ports[cport].rte_port_number);
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s PCI: %s, PORT # %d", port_id, vf, "-----------------", running_config->ports[cport].pciid, running_config->ports[cport].rte_port_number);
 
 			add_refresh_queue(port_id, vf);
 			
 			if( vfp->num < 0 ) {									// unconfigured vf will have -1 in num; nack if not configured
 				p->retval = RTE_PMD_I40E_MB_EVENT_NOOP_NACK;
-				bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "PROM VF NOT CONFIGURED");
+				bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "PROM VF NOT CONFIGURED");
 			} else {
 				p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			}
@@ -567,45 +568,45 @@ vfd_i40e_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type, v
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED; 		// VF's driver is getting stats every 2 sec
 			break;
 		case I40E_VIRTCHNL_OP_FCOE:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_FCOE");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_FCOE");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_EVENT:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_EVENT");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_EVENT");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_CONFIG_RSS_KEY:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_RSS_KEY");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_RSS_KEY");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_CONFIG_RSS_LUT:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_RSS_LUT");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_CONFIG_RSS_LUT");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_GET_RSS_HENA_CAPS:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_GET_RSS_HENA_CAPS");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_GET_RSS_HENA_CAPS");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;
 		case I40E_VIRTCHNL_OP_SET_RSS_HENA:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_SET_RSS_HENA");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_SET_RSS_HENA");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;			
 		case I40E_VIRTCHNL_OP_ENABLE_VLAN_STRIPPING:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_ENABLE_VLAN_STRIPPING");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_ENABLE_VLAN_STRIPPING");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;			
 		case I40E_VIRTCHNL_OP_DISABLE_VLAN_STRIPPING:
-			bleat_printf(3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_DISABLE_VLAN_STRIPPING");
+			bleat_ssprintf( BLEAT_SS_MBOX,3, "Port: %d, VF: %d, _T: %s", port_id, vf, "I40E_VIRTCHNL_OP_DISABLE_VLAN_STRIPPING");
 			p->retval = RTE_PMD_I40E_MB_EVENT_PROCEED;
 			break;	
 			
 		default:
-			bleat_printf( 1, "unknown  event request received: port=%d (responding nop+nak)", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "unknown  event request received: port=%d (responding nop+nak)", port_id );
 			p->retval = RTE_PMD_I40E_MB_EVENT_NOOP_NACK;     /* noop & nack */
 			break;
 	}
 
-	bleat_printf( 3, "i40e: processing callback finished: pf/vf=%d/%d, evtype=%d mbtype=%d", port_id, vf, type, mbox_type);
+	bleat_ssprintf( BLEAT_SS_MBOX, 3, "i40e: processing callback finished: pf/vf=%d/%d, evtype=%d mbtype=%d", port_id, vf, type, mbox_type);
 
 	return 0;   // CAUTION:  as of 2017/07/05 it seems this value is ignored by dpdk, but it might not alwyas be
 }
@@ -1,4 +1,5 @@
 
+#define BLEAT_SUBSYS	BLEAT_SS_NIC		// tag our bleat messages; must be set before vfdlib.h is included
 #include "sriov.h"
 
 /*
@@ -332,7 +333,7 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 
 	p = (struct rte_pmd_ixgbe_mb_event_param*) param;
 	if( p == NULL ) {									// yes this has happened
-		bleat_printf( 2, "callback driven with null pointer data=%p", data );
+		bleat_ssprintf( BLEAT_SS_MBOX, 2, "callback driven with null pointer data=%p", data );
 		return 0;
 	}
 
@@ -340,12 +341,12 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 	mbox_type = p->msg_type;
 	msgbuf = (uint32_t *) p->msg;
 
-	bleat_printf( 3, "ixgbe: processing callback starts: pf/vf=%d/%d, evtype=%d mbtype=%d", port_id, vf, type, mbox_type);
+	bleat_ssprintf( BLEAT_SS_MBOX, 3, "ixgbe: processing callback starts: pf/vf=%d/%d, evtype=%d mbtype=%d", port_id, vf, type, mbox_type);
 
 	/* check & process VF to PF mailbox message */
 	switch (mbox_type) {
 		case IXGBE_VF_RESET:
-			bleat_printf( 1, "reset event received: port=%d", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "reset event received: port=%d", port_id );
 
 			p->retval = RTE_PMD_IXGBE_MB_EVENT_NOOP_ACK;				/* noop & ack */
 
@@ -353,7 +354,7 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 			break;
 
 		case IXGBE_VF_SET_MAC_ADDR:
-			bleat_printf( 1, "setmac event approved for: port=%d", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "setmac event approved for: port=%d", port_id );
 			p->retval = RTE_PMD_IXGBE_MB_EVENT_PROCEED;    						// do what's needed
 
 			new_mac = (struct ether_addr *) (&msgbuf[1]);
@@ -362,21 +363,21 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 					new_mac->addr_bytes[2], new_mac->addr_bytes[3], new_mac->addr_bytes[4], new_mac->addr_bytes[5] );
 
 			if( ! push_mac( port_id, vf, wbuf ) ) {								// push onto the head of our list
-				bleat_printf( 1, "guest attempt to push mac address fails: %s: (sending nack)", wbuf );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "guest attempt to push mac address fails: %s: (sending nack)", wbuf );
 				p->retval = RTE_PMD_IXGBE_MB_EVENT_NOOP_NACK;     				// guest should see failure
 			} else {
-				bleat_printf( 1, "guest attempt to push mac address successful: %s", wbuf );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "guest attempt to push mac address successful: %s", wbuf );
 			}
 	
 			add_refresh_queue(port_id, vf);
 			break;
 
 		case IXGBE_VF_SET_MULTICAST:
-			bleat_printf( 1, "set multicast event received: port=%d", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "set multicast event received: port=%d", port_id );
 			p->retval = RTE_PMD_IXGBE_MB_EVENT_PROCEED;    /* do what's needed */
 
 			new_mac = (struct ether_addr *) (&msgbuf[1]);
-			bleat_printf( 3, "multicast mac set, pf %u vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
+			bleat_ssprintf( BLEAT_SS_MBOX, 3, "multicast mac set, pf %u vf %u, MAC: %02" PRIx8 " %02" PRIx8 " %02" PRIx8
 					" %02" PRIx8 " %02" PRIx8 " %02" PRIx8,
 					(uint) port_id,
 					(uint32_t)vf,
@@ -391,25 +392,25 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 		case IXGBE_VF_SET_VLAN:
 			// NOTE: we _always_ approve this.  This is the VMs setting of what will be an 'inner' vlan ID and thus we don't care
 			if( valid_vlan( port_id, vf, (int) msgbuf[1] )) {
-				bleat_printf( 1, "vlan set event approved: port=%d vf=%d vlan=%d (responding noop-ack)", port_id, vf, (int) msgbuf[1] );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "vlan set event approved: port=%d vf=%d vlan=%d (responding noop-ack)", port_id, vf, (int) msgbuf[1] );
 				p->retval = RTE_PMD_IXGBE_MB_EVENT_NOOP_ACK;     // good rc to VM while not changing anything
 			} else {
-				bleat_printf( 1, "vlan set event rejected; vlan not not configured: port=%d vf=%d vlan=%d (responding noop-ack)", port_id, vf, (int) msgbuf[1] );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "vlan set event rejected; vlan not not configured: port=%d vf=%d vlan=%d (responding noop-ack)", port_id, vf, (int) msgbuf[1] );
 				p->retval = RTE_PMD_IXGBE_MB_EVENT_NOOP_NACK;     // VM should see failure
 			}
 
 			add_refresh_queue( port_id, vf );		// schedule a complete refresh when the queue goes hot
 
-			//bleat_printf( 3, "setting vlan id = %d", p[1]);
+			//bleat_ssprintf( BLEAT_SS_MBOX, 3, "setting vlan id = %d", p[1]);
 			break;
 
 		case IXGBE_VF_SET_LPE:
-			bleat_printf( 1, "set lpe event received %d %d", port_id, (int) msgbuf[1]  );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "set lpe event received %d %d", port_id, (int) msgbuf[1]  );
 			if( valid_mtu( port_id, (int) msgbuf[1] ) ) {
-				bleat_printf( 1, "mtu set event approved: port=%d vf=%d mtu=%d", port_id, vf, (int) msgbuf[1]  );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "mtu set event approved: port=%d vf=%d mtu=%d", port_id, vf, (int) msgbuf[1]  );
 				p->retval = RTE_PMD_IXGBE_MB_EVENT_PROCEED;
 			} else {
-				bleat_printf( 1, "mtu set event rejected: port=%d vf=%d mtu=%d", port_id, vf, (int) msgbuf[1] );
+				bleat_ssprintf( BLEAT_SS_MBOX, 1, "mtu set event rejected: port=%d vf=%d mtu=%d", port_id, vf, (int) msgbuf[1] );
 				p->retval = RTE_PMD_IXGBE_MB_EVENT_NOOP_NACK;     /* noop & nack */
 			}
 			
@@ -426,7 +427,7 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 			switch( addr_len ) {
 				case 0:							// we'll accept this and respond proceed
 					// TODO -- should we consider this a reset and clear all values?
-					bleat_printf( 1, "set macvlan event has no length; ignoring: pf/vf=%d/%d", port_id, vf );
+					bleat_ssprintf( BLEAT_SS_MBOX, 1, "set macvlan event has no length; ignoring: pf/vf=%d/%d", port_id, vf );
 					p->retval = RTE_PMD_IXGBE_MB_EVENT_PROCEED;			// if no addresses, let them go on, but no refresh
 					break;
 
@@ -442,23 +443,23 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 					}
 		
 					if( i >= 6 ) {												// all 0s -- assume reset (don't save the 0s)
-						bleat_printf( 1, "set macvlan event received with address of 0s: clearing all but default MAC: pf/vf=%d/%d", port_id, vf );
+						bleat_ssprintf( BLEAT_SS_MBOX, 1, "set macvlan event received with address of 0s: clearing all but default MAC: pf/vf=%d/%d", port_id, vf );
 						clear_macs( port_id, vf, KEEP_DEFAULT );
 						p->retval = RTE_PMD_IXGBE_MB_EVENT_PROCEED;
 					} else {
 						if( add_mac( port_id, vf, wbuf ) ) {					// add to the VF's mac list, if not there and if room on both pf and vf
-							bleat_printf( 1, "set macvlan event received: pf/vf=%d/%d %s (responding proceed)", port_id, vf, wbuf );
+							bleat_ssprintf( BLEAT_SS_MBOX, 1, "set macvlan event received: pf/vf=%d/%d %s (responding proceed)", port_id, vf, wbuf );
 							p->retval = RTE_PMD_IXGBE_MB_EVENT_PROCEED;
 							add_refresh = 1;
 						} else {
-							bleat_printf( 1, "set macvlan event: add to vfd table rejected: pf/vf=%d/%d %s (responding nop+nak)", port_id, vf, wbuf );
+							bleat_ssprintf( BLEAT_SS_MBOX, 1, "set macvlan event: add to vfd table rejected: pf/vf=%d/%d %s (responding nop+nak)", port_id, vf, wbuf );
 							break;
 						}
 					}
 					break;
 
 				default:
-					bleat_printf( 1, "set macvlan event received, bad address length: %u pf/vf=%d/%d (responding nop+nak)", addr_len, port_id, vf );
+					bleat_ssprintf( BLEAT_SS_MBOX, 1, "set macvlan event received, bad address length: %u pf/vf=%d/%d (responding nop+nak)", addr_len, port_id, vf );
 					p->retval =  RTE_PMD_IXGBE_MB_EVENT_NOOP_NACK;    						/* something rejected so noop & nack */
 					break;
 			}
@@ -471,7 +472,7 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 			break;
 
 		case IXGBE_VF_API_NEGOTIATE:
-			bleat_printf( 1, "set negotiate event received: port=%d (responding proceed)", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "set negotiate event received: port=%d (responding proceed)", port_id );
 			p->retval =  RTE_PMD_IXGBE_MB_EVENT_PROCEED;   /* do what's needed */
 			
 			set_fc_on( port_id, !FORCE );									// enable flow control if allowed
@@ -480,28 +481,28 @@ vfd_ixgbe_vf_msb_event_callback(uint16_t port_id, enum rte_eth_event_type type,
 			break;
 
 		case IXGBE_VF_GET_QUEUES:
-			bleat_printf( 1, "get queues event received: port=%d (responding proceed)", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "get queues event received: port=%d (responding proceed)", port_id );
 			p->retval =  RTE_PMD_IXGBE_MB_EVENT_PROCEED;   /* do what's needed */
 
 			add_refresh_queue( port_id, vf );		// schedule a complete refresh when the queue goes hot
 			break;
 	
 		case IXGBE_VF_UPDATE_XCAST_MODE:
-			bleat_printf( 1, "update xcast mode event received: port=%d (responding proceed)", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "update xcast mode event received: port=%d (responding proceed)", port_id );
 			p->retval =  RTE_PMD_IXGBE_MB_EVENT_PROCEED;   /* do what's needed */
 
 			add_refresh_queue( port_id, vf );		// schedule a complete refresh when the queue goes hot
 			break;
 
 		default:
-			bleat_printf( 1, "unknown event request received: port=%d (responding nop+nak)", port_id );
+			bleat_ssprintf( BLEAT_SS_MBOX, 1, "unknown event request received: port=%d (responding nop+nak)", port_id );
 			p->retval = RTE_PMD_IXGBE_MB_EVENT_NOOP_NACK;     /* noop & nack */
 
 			restore_vf_setings(port_id, vf);		// refresh all of our configuration back onto the NIC
 			break;
 	}
 
-	bleat_printf( 3, "ixgbe: processing callback finished: %d, pf/vf=%d/%d, rc=%d mbtype=%d", type, port_id, vf, p->retval, mbox_type);
+	bleat_ssprintf( BLEAT_SS_MBOX, 3, "ixgbe: processing callback finished: %d, pf/vf=%d/%d, rc=%d mbtype=%d", type, port_id, vf, p->retval, mbox_type);
 
 	return 0;   // CAUTION:  as of 2017/07/05 it seems this value is ignored by dpdk, but it might not alwyas be
 }
@@ -705,3 +706,117 @@ vfd_ixgbe_dump_all_vlans(uint16_t port_id)
 	return count;
 }
 
+
+
+/*
+	Returns true if the port looks like it was left configured by a previous
+	vfd: virtualisation is enabled, the max frame size matches the mtu we'd set
+	and, when dcb is set, the tx arbiters are enabled. Used to decide if the
+	port can be adopted (reattach) rather than reset.
+*/
+int 
+vfd_ixgbe_port_compatible(uint16_t port_id, int mtu, int dcb)
+{
+	uint32_t vt_ctl;
+	uint32_t maxfrs;
+	uint32_t mtqc;
+
+	vt_ctl = port_pci_reg_read( port_id, IXGBE_VT_CTL );
+	maxfrs = port_pci_reg_read( port_id, IXGBE_MAXFRS );
+	mtqc = port_pci_reg_read( port_id, IXGBE_MTQC );
+
+	bleat_printf( 2, "vfd_ixgbe_port_compatible: port=%d vt_ctl=0x%08x maxfrs=0x%08x mtqc=0x%08x mtu=%d dcb=%d", port_id, vt_ctl, maxfrs, mtqc, mtu, dcb );
+
+	if( ! (vt_ctl & IXGBE_VT_CTL_VT_ENABLE) ) {
+		return 0;
+	}
+	if( (int) (maxfrs >> IXGBE_MHADD_MFS_SHIFT) != mtu ) {
+		return 0;
+	}
+	if( dcb && ! (mtqc & IXGBE_MTQC_RT_ENA) ) {
+		return 0;
+	}
+
+	return 1;
+}
+
+
+/*
+	Read back the settings for the VF from the NIC registers. Everything in
+	the hwstate struct is known for the niantic.
+*/
+int 
+vfd_ixgbe_get_vf_hwstate(uint16_t port_id, uint16_t vf_id, struct vf_hwstate_s* hws)
+{
+	uint32_t reg;
+	uint32_t pools;
+	uint32_t ral;
+	uint32_t rah;
+	uint32_t bit;
+	int		ix;
+
+	memset( hws, 0, sizeof( *hws ) );
+	if( vf_id > 63 ) {
+		return 0;
+	}
+	bit = 1 << (vf_id % 32);
+
+	reg = port_pci_reg_read( port_id, IXGBE_PFVFSPOOF( vf_id / 8 ) );
+	hws->mac_anti_spoof = !!(reg & (1 << (vf_id % 8)));
+	hws->vlan_anti_spoof = !!(reg & (1 << ((vf_id % 8) + IXGBE_SPOOF_VLANAS_SHIFT)));
+	hws->known |= HWS_SPOOF;
+
+	reg = port_pci_reg_read( port_id, IXGBE_VMOLR( vf_id ) );
+	hws->allow_bcast = !!(reg & IXGBE_VMOLR_BAM);
+	hws->allow_mcast = !!(reg & IXGBE_VMOLR_MPE);
+	hws->allow_un_ucast = !!(reg & IXGBE_VMOLR_ROPE);
+	hws->allow_untagged = !!(reg & IXGBE_VMOLR_AUPE);
+	hws->known |= HWS_RXMODE;
+
+	reg = port_pci_reg_read( port_id, IXGBE_VMVIR( vf_id ) );
+	hws->insert_vlan = (reg & IXGBE_VMVIR_VLANA_DEFAULT) ? (int) (reg & IXGBE_VMVIR_VLAN_VID_MASK) : 0;
+	reg = port_pci_reg_read( port_id, IXGBE_RXDCTL( vf_id * get_max_qpp( port_id ) ) );		// strip is set on all of the vf's queues; first is enough
+	hws->strip = !!(reg & IXGBE_RXDCTL_VME);
+	hws->known |= HWS_INS_STRIP;
+
+	for( ix = 1; ix < IXGBE_VLVF_ENTRIES; ix++ ) {
+		reg = port_pci_reg_read( port_id, IXGBE_VLVF( ix ) );
+		if( ! (reg & IXGBE_VLVF_VIEN) ) {
+			continue;
+		}
+
+		pools = port_pci_reg_read( port_id, IXGBE_VLVFB( (ix * 2) + (vf_id / 32) ) );
+		if( pools & bit ) {
+			if( hws->num_vlans >= MAX_VF_VLANS ) {
+				break;
+			}
+			hws->vlans[hws->num_vlans++] = (int) (reg & IXGBE_VLVF_VLANID_MASK);
+		}
+	}
+	if( ix >= IXGBE_VLVF_ENTRIES ) {
+		hws->known |= HWS_VLANS;
+	}
+
+	for( ix = 1; ix < IXGBE_82599_RAR_ENTRIES; ix++ ) {				// 0 is the PF's address
+		rah = port_pci_reg_read( port_id, IXGBE_RAH( ix ) );
+		if( ! (rah & IXGBE_RAH_AV) ) {
+			continue;
+		}
+
+		pools = port_pci_reg_read( port_id, vf_id < 32 ? IXGBE_MPSAR_LO( ix ) : IXGBE_MPSAR_HI( ix ) );
+		if( pools & bit ) {
+			if( hws->num_macs >= MAX_VF_MACS ) {
+				break;
+			}
+			ral = port_pci_reg_read( port_id, IXGBE_RAL( ix ) );
+			snprintf( hws->macs[hws->num_macs++], sizeof( hws->macs[0] ), "%02x:%02x:%02x:%02x:%02x:%02x",
+				ral & 0xff, (ral >> 8) & 0xff, (ral >> 16) & 0xff, (ral >> 24) & 0xff, rah & 0xff, (rah >> 8) & 0xff );
+		}
+	}
+	if( ix >= IXGBE_82599_RAR_ENTRIES ) {
+		hws->known |= HWS_MACS;
+	}
+
+	bleat_printf( 3, "vfd_ixgbe_get_vf_hwstate: port=%d vf=%d nvlans=%d nmacs=%d insert=%d strip=%d", port_id, vf_id, hws->num_vlans, hws->num_macs, hws->insert_vlan, hws->strip );
+	return 1;
+}
@@ -9,6 +9,8 @@
 
 // ------------- prototypes ----------------------------------------------
 
+struct vf_hwstate_s;			// defined in sriov.h
+
 int vfd_ixgbe_ping_vfs(uint16_t port, int16_t vf);
 int vfd_ixgbe_set_vf_mac_anti_spoof(uint16_t port, uint16_t vf_id, uint8_t on);
 int vfd_ixgbe_set_vf_vlan_anti_spoof(uint16_t port, uint16_t vf_id, uint8_t on);
@@ -42,6 +44,8 @@ void vfd_ixgbe_set_rx_drop(uint16_t port_id, uint16_t vf_id, int state);
 void vfd_ixgbe_set_split_erop(uint16_t port_id, uint16_t vf_id, int state);
 int vfd_ixgbe_get_split_ctlreg(uint16_t port_id, uint16_t vf_id);
 int vfd_ixgbe_dump_all_vlans(uint16_t port_id);
+int vfd_ixgbe_port_compatible(uint16_t port_id, int mtu, int dcb);
+int vfd_ixgbe_get_vf_hwstate(uint16_t port_id, uint16_t vf_id, struct vf_hwstate_s* hws);
 
 #endif
 
@@ -11,11 +11,17 @@
 					white list macs, and possible one off bug in clear macs.
 				07 Jun 2018 - Correct bug (issue 304) which was causing the
 					mac insertion point to be advanced when it should have been.
+				19 Oct 2026 - Add claim_macs() for VFs restored from a snapshot.
+				19 Oct 2026 - Add del_mac() for in place VF updates.
+				19 Oct 2026 - Lock the mac table; it's used by the pf owner threads and
+					the mailbox callbacks at the same time.
 */
 
 
+#define BLEAT_SUBSYS	BLEAT_SS_MAC		// tag our bleat messages; must be set before vfdlib.h is included
 #include <vfdlib.h>		// if vfdlib.h needs an include it must be included there, can't be include prior
 #include <symtab.h>		// our symbol table things
+#include <pthread.h>
 #include "sriov.h"
 
 
@@ -27,6 +33,39 @@
 	decides to push the same MAC in as the default there won't be a collision.	
 */
 static void*	mac_stab = NULL;
+static pthread_mutex_t	mac_lock = PTHREAD_MUTEX_INITIALIZER;	// every use of mac_stab; owners for different PFs and the mailbox callbacks run at once
+
+/*
+	Look the mac up in the PF's space (port). The table is shared by all PFs so the
+	lock is held for lookups as well as changes.
+*/
+static void* mac_tab_get( const char* mac, int port ) {
+	void* v;
+
+	pthread_mutex_lock( &mac_lock );
+	v = sym_get( mac_stab, mac, port );
+	pthread_mutex_unlock( &mac_lock );
+
+	return v;
+}
+
+/*
+	Mark the mac as in use on the PF.
+*/
+static void mac_tab_put( const char* mac, int port ) {
+	pthread_mutex_lock( &mac_lock );
+	sym_map( mac_stab, mac, port, (void*) 1 );
+	pthread_mutex_unlock( &mac_lock );
+}
+
+/*
+	Release the mac on the PF.
+*/
+static void mac_tab_del( const char* mac, int port ) {
+	pthread_mutex_lock( &mac_lock );
+	sym_del( mac_stab, mac, port );
+	pthread_mutex_unlock( &mac_lock );
+}
 
 // -----------------------------------------------------------------------------------------------------------
 
@@ -177,7 +216,7 @@ extern int can_add_mac( int port, int vfid, char* mac ) {
 		return 0;
 	}
 
-	if( (sresult = sym_get( mac_stab, mac, port )) ) {			// see if defined for any VF on the PF
+	if( (sresult = mac_tab_get( mac, port )) ) {			// see if defined for any VF on the PF
 		bleat_printf( 1, "can_add_mac: mac is already assigned to on port %d: %s", port, mac );
 		return 0;
 	}
@@ -258,7 +297,7 @@ extern int add_mac( int port, int vfid, char* mac ) {
 	vf->num_macs++;
 	bleat_printf( 2, "add_mac: allowed: pf/vf=%d/%d pf_nm=%d nm=%d fm=%d ip=%d %s", port, vfid, total+1, vf->num_macs, vf->first_mac, ip, mac );
 
-	sym_map( mac_stab, mac, port, (void*) 1 );		// assign this to the PF space for dup checking
+	mac_tab_put( mac, port );							// assign this to the PF space for dup checking
 	strncpy( vf->macs[ip], mac, 17 );					// will add final 0 if a:b:c style resulting in short string
 	vf->macs[ip][17] = 0;								// if long string passed in; ensure 0 terminated
 
@@ -266,6 +305,44 @@ extern int add_mac( int port, int vfid, char* mac ) {
 }
 
 
+/*
+	Removes a single configured (white list) MAC from the list for the PF/VF and
+	makes it available to other VFs on the PF. A MAC the guest pushed ([0]) is
+	not a configured MAC and is never removed by this function.
+
+	As with add_mac() nothing is pushed to the NIC; the caller must take the MAC
+	off the NIC (set_vf_rx_mac()).
+
+	Returns 1 if the MAC was removed; 0 if it wasn't in the list or the VF doesn't map.
+*/
+extern int del_mac( int port, int vfid, char* mac ) {
+	struct vf_s* vf;
+	int m;
+	int	si;								// stop index
+
+	if( mac == NULL || (vf = suss_vf( port, vfid )) == NULL ) {
+		bleat_printf( 1, "del_mac: nil mac or vf doesn't map: pf/vf=%d/%d", port, vfid );
+		return 0;
+	}
+
+	si = vf->num_macs + vf->first_mac;
+	for( m = 1; m < si && strcmp( vf->macs[m], mac ) != 0; m++ );
+	if( m >= si ) {
+		bleat_printf( 2, "del_mac: mac not in list for pf/vf=%d/%d: %s", port, vfid, mac );
+		return 0;
+	}
+
+	mac_tab_del( vf->macs[m], port );
+	for( ; m < si - 1; m++ ) {							// close the hole
+		strcpy( vf->macs[m], vf->macs[m+1] );
+	}
+	vf->num_macs--;
+
+	bleat_printf( 2, "del_mac: removed from list: pf/vf=%d/%d nm=%d %s", port, vfid, vf->num_macs, mac );
+	return 1;
+}
+
+
 /*
 	Clears all of the MAC addresses that have been assigned to this PF/VF combination.
 	The setting of random determines how the default MAC address is handled. If 
@@ -300,12 +377,12 @@ extern int clear_macs( int port, int vfid, int assign_random ) {
 		mac = vf->macs[m];
 		bleat_printf( 2, "clear macs:  [%d] pf/vf=%d/%d %s", m, pf->rte_port_number, vf->num, mac );
 		
-		sym_del( mac_stab, vf->macs[m], port );							// nix from the symtab
+		mac_tab_del( vf->macs[m], port );								// nix from the symtab
 		set_vf_rx_mac( port, mac, vfid, SET_OFF );						// clear from 'white list'
 	}
 
 	if( assign_random ) {										// if replacing the default, do so with a random address
-		sym_del( mac_stab, vf->macs[vf->first_mac], port );		// ensure old one is not in the symtab
+		mac_tab_del( vf->macs[vf->first_mac], port );			// ensure old one is not in the symtab
 
 		rmac = gen_rand_hrmac();								// random mac to push into the nic
 		set_vf_default_mac( port, rmac, vfid );
@@ -328,6 +405,29 @@ extern int clear_macs( int port, int vfid, int assign_random ) {
 	return 1;
 }
 
+/*
+	Marks the MACs already in the VF's list as assigned on the PF so that dup checking
+	works for a VF which was restored (snapshot) rather than added with add_mac().
+	As with add_mac() a MAC the guest pushed ([0]) is not put into the table.
+
+	Returns 0 on failure; 1 on success.
+*/
+extern int claim_macs( int port, int vfid ) {
+	struct vf_s* vf;
+	int m;
+
+	if( (vf = suss_vf( port, vfid )) == NULL ) {
+		bleat_printf( 1, "claim_macs: vf doesn't map: pf/vf=%d/%d", port, vfid );
+		return 0;
+	}
+
+	for( m = 1; m < vf->num_macs + vf->first_mac; m++ ) {
+		mac_tab_put( vf->macs[m], port );
+	}
+
+	return 1;
+}
+
 /*
 	Pushes the mac string onto the head of the list for the given port/vf combination. Sets
 	the first mac index to be 0 so that it is used if a port/vf reset is triggered.
@@ -1,4 +1,5 @@
 
+#define BLEAT_SUBSYS	BLEAT_SS_NIC		// tag our bleat messages; must be set before vfdlib.h is included
 #include "sriov.h"
 #include "vfd_mlx5.h"
 
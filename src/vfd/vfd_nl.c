@@ -6,6 +6,7 @@
 
 */
 
+#define BLEAT_SUBSYS	BLEAT_SS_NIC		// tag our bleat messages; must be set before vfdlib.h is included
 #include "sriov.h"
 #include "vfd_nl.h"
 #include "vfd_mlx5.h"
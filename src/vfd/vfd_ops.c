@@ -0,0 +1,283 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vfd_ops.c
+	Abstract:	Operation table for asynchronous requests. A mutation request
+				which has async set in its params is answered as soon as it is
+				read ("accepted" with an operation id) and is then handled in
+				turn by the main thread. Its outcome is kept here so that the
+				client can ask for it (opstatus request); if the request arrived
+				on a socket connection a completion message is also sent on the
+				connection when the operation finishes.
+
+				Async adds which are queued back to back share a single nic
+				update: each is applied to the config and deferred, and the
+				deferred operations are completed together when the nic update
+				that follows the last of them is done.
+
+				The table is a ring of OP_MAX entries; an operation's status can
+				be had until its slot is reused. A slot holding an unfinished
+				operation is never reused: the ring is larger than the number of
+				requests which can be pending (queued plus a deferred batch), and
+				if it somehow wraps onto one anyway the new request is refused.
+
+	Date:		19 October 2026
+*/
+
+#include <pthread.h>
+
+#define BLEAT_SUBSYS	BLEAT_SS_RIF		// tag our bleat messages; must be set before vfdlib.h is included
+#include <vfdlib.h>
+#include "sriov.h"
+#include "vfd_rif.h"
+
+#define OP_MAX		(RQ_MAX_PENDING * 4)	// must exceed RQ_MAX_PENDING + OP_MAX_BATCH so that unfinished ops aren't reached
+#define OP_LIST		64				// operations listed by an "all" status request (most recent)
+
+#define OP_QUEUED	0				// operation states
+#define OP_RUNNING	1
+#define OP_NICWAIT	2				// applied to the config; waiting for the batch's nic update
+#define OP_DONE		3
+#define OP_FAILED	4
+
+typedef struct {
+	uint64_t	id;					// 0 when the slot has never been used
+	int			rtype;
+	int			state;
+	int			cid;				// socket connection for the completion; -1 if none
+	int			binary;				// request was a binary frame; so is the completion
+	char*		rid;				// caller's request id
+	char*		resource;
+	char*		msg;				// outcome message once finished (or deferred)
+	time_t		accepted;
+	time_t		done;
+} op_t;
+
+static pthread_mutex_t	op_lock = PTHREAD_MUTEX_INITIALIZER;
+static op_t		ops[OP_MAX];
+static uint64_t	next_id = 1;
+static int		ndeferred = 0;
+
+static const char* state_names[] = { "queued", "running", "nic-wait", "done", "failed" };
+
+/*
+	Find the operation; nil if the id is unknown or its slot has been reused.
+	Caller must hold the lock.
+*/
+static op_t* find_op( uint64_t id ) {
+	op_t* op;
+
+	if( id == 0 ) {
+		return NULL;
+	}
+
+	op = &ops[id % OP_MAX];
+	return op->id == id ? op : NULL;
+}
+
+/*
+	Record the outcome, and send the completion if the operation came in on a
+	socket connection. Caller must hold the lock.
+*/
+static void finish_op( op_t* op, int state, const_str msg ) {
+	if( msg != NULL && op->msg != msg ) {
+		if( op->msg != NULL ) {
+			free( op->msg );
+		}
+		op->msg = strdup( msg );
+	}
+
+	op->state = state == RESP_OK ? OP_DONE : OP_FAILED;
+	op->done = time( NULL );
+	bleat_printf( 2, "op %llu %s: %s", (unsigned long long) op->id, state_names[op->state], op->msg ? op->msg : "" );
+
+	if( op->cid >= 0 ) {
+		vfd_op_notify( op->cid, op->binary, op->rid, op->id, state, op->msg );
+	}
+}
+
+/*
+	Format one operation into buf.
+*/
+static int fmt_op( op_t* op, char* buf, int blen ) {
+	return snprintf( buf, blen, "op %llu %s %.128s: %s %lds: %.256s\n",
+		(unsigned long long) op->id, vfd_rtype_name( op->rtype ), op->resource ? op->resource : "",
+		state_names[op->state], (long) ((op->done ? op->done : time( NULL )) - op->accepted),
+		op->msg ? op->msg : "" );
+}
+
+// -----------------------------------------------------------------------------------------
+
+/*
+	Record a new operation for the request and return its id. Returns 0 if the
+	slot the id maps to still holds an unfinished operation; the caller must
+	refuse the request as the unfinished op's completion would otherwise be lost.
+*/
+extern uint64_t op_accept( req_t* req ) {
+	op_t*	op;
+	uint64_t id;
+
+	pthread_mutex_lock( &op_lock );
+	op = &ops[next_id % OP_MAX];
+	if( op->id != 0 && op->state < OP_DONE ) {
+		bleat_printf( 0, "WRN: op slot for %llu is held by unfinished op %llu; request not accepted",
+			(unsigned long long) next_id, (unsigned long long) op->id );
+		pthread_mutex_unlock( &op_lock );
+		return 0;
+	}
+	id = next_id++;
+
+	if( op->rid != NULL ) {
+		free( op->rid );
+	}
+	if( op->resource != NULL ) {
+		free( op->resource );
+	}
+	if( op->msg != NULL ) {
+		free( op->msg );
+	}
+	memset( op, 0, sizeof( *op ) );
+
+	op->id = id;
+	op->rtype = req->rtype;
+	op->state = OP_QUEUED;
+	op->cid = req->rsock;
+	op->binary = req->binary;
+	op->rid = req->vfd_rid ? strdup( req->vfd_rid ) : NULL;
+	op->resource = req->resource ? strdup( req->resource ) : NULL;
+	op->accepted = time( NULL );
+	pthread_mutex_unlock( &op_lock );
+
+	return id;
+}
+
+/*
+	Mark the operation as being worked on.
+*/
+extern void op_start( uint64_t id ) {
+	op_t* op;
+
+	pthread_mutex_lock( &op_lock );
+	if( (op = find_op( id )) != NULL ) {
+		op->state = OP_RUNNING;
+	}
+	pthread_mutex_unlock( &op_lock );
+}
+
+/*
+	Finish the operation with the state (RESP_ const) and message.
+*/
+extern void op_complete( uint64_t id, int state, const_str msg ) {
+	op_t* op;
+
+	pthread_mutex_lock( &op_lock );
+	if( (op = find_op( id )) != NULL ) {
+		if( op->state == OP_NICWAIT ) {
+			ndeferred--;
+		}
+		finish_op( op, state, msg );
+	} else {
+		bleat_printf( 1, "op %llu finished but its slot was reused: %s", (unsigned long long) id, msg ? msg : "" );
+	}
+	pthread_mutex_unlock( &op_lock );
+}
+
+/*
+	The operation's config change is done but its nic update is left to the next
+	one; msg is given when op_nic_done() reports success.
+*/
+extern void op_defer( uint64_t id, const_str msg ) {
+	op_t* op;
+
+	pthread_mutex_lock( &op_lock );
+	if( (op = find_op( id )) != NULL ) {
+		if( op->msg != NULL ) {
+			free( op->msg );
+		}
+		op->msg = msg ? strdup( msg ) : NULL;
+		op->state = OP_NICWAIT;
+		ndeferred++;
+	}
+	pthread_mutex_unlock( &op_lock );
+}
+
+/*
+	Return the number of operations waiting for a nic update.
+*/
+extern int op_ndeferred( void ) {
+	int n;
+
+	pthread_mutex_lock( &op_lock );
+	n = ndeferred;
+	pthread_mutex_unlock( &op_lock );
+
+	return n;
+}
+
+/*
+	A nic update which covers the deferred operations has finished (state is a
+	RESP_ const); complete them all.
+*/
+extern void op_nic_done( int state ) {
+	int i;
+
+	pthread_mutex_lock( &op_lock );
+	for( i = 0; i < OP_MAX && ndeferred > 0; i++ ) {
+		if( ops[i].id != 0 && ops[i].state == OP_NICWAIT ) {
+			ndeferred--;
+			if( state == RESP_OK ) {
+				finish_op( &ops[i], state, ops[i].msg );
+			} else {
+				finish_op( &ops[i], state, "unable to configure the vf: nic update failed" );
+			}
+		}
+	}
+	ndeferred = 0;
+	pthread_mutex_unlock( &op_lock );
+}
+
+/*
+	Generate the status of an operation (which is the id), or of the most recent
+	OP_LIST operations if which is nil or "all", oldest first. Caller must free the
+	buffer.
+*/
+extern char* op_status( const_str which ) {
+	char*	buf;
+	int		bsize = BUF_1K * 32;
+	int		blen = 0;
+	uint64_t id;
+	uint64_t first;
+	op_t*	op;
+
+	if( (buf = (char *) malloc( bsize )) == NULL ) {
+		return NULL;
+	}
+	*buf = 0;
+
+	pthread_mutex_lock( &op_lock );
+	if( which != NULL && *which && strcmp( which, "all" ) != 0 ) {
+		id = strtoull( which, NULL, 10 );
+		if( (op = find_op( id )) != NULL ) {
+			fmt_op( op, buf, bsize );
+		} else {
+			snprintf( buf, bsize, "op %s is unknown or has expired\n", which );
+		}
+	} else {
+		first = next_id > OP_LIST ? next_id - OP_LIST : 1;
+		for( id = first; id < next_id; id++ ) {
+			if( (op = find_op( id )) != NULL ) {
+				if( blen >= bsize - 512 ) {
+					snprintf( buf + blen, bsize - blen, "<truncated>\n" );
+					break;
+				}
+				blen += fmt_op( op, buf + blen, bsize - blen );
+			}
+		}
+		if( blen == 0 ) {
+			snprintf( buf, bsize, "no operations\n" );
+		}
+	}
+	pthread_mutex_unlock( &op_lock );
+
+	return buf;
+}
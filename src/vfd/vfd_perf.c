@@ -0,0 +1,337 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vfd_perf.c
+	Abstract:	Request latency counters. For each request action (add, delete,
+				show, ...) a count, an error count and a log-linear histogram of
+				microseconds are kept for each stage of handling:
+					queue	-- from when the request was read until it was picked
+							   up by the main thread or a worker
+					parse	-- json parse of the raw request
+					apply	-- handling, less any nic update (for read only
+							   requests this is generating the response)
+					nic		-- vfd_update_nic() time spent on behalf of the request
+					respond	-- building and writing/queueing the response
+					total	-- read to response written
+
+				Histogram buckets are log-linear: values below 4 have a bucket
+				each, and each power of two above that is split into four equal
+				buckets (so the error is under 25%). Counters are updated with
+				atomics so that the main thread and the request workers record
+				without a lock. The data is reported by "show perf" and is added
+				to the periodic stats dump.
+
+	Date:		19 October 2026
+*/
+
+#define BLEAT_SUBSYS	BLEAT_SS_STATS		// tag our bleat messages; must be set before vfdlib.h is included
+#include <vfdlib.h>
+#include "sriov.h"
+#include "vfd_rif.h"
+
+#define PERF_NBUCKETS	128				// 4 per power of two; the last bucket holds everything over ~2^33us
+#define PERF_NACTIONS	17				// RT_ types 0-15 and one for unknown
+
+typedef struct {
+	uint64_t	count;
+	uint64_t	sum;					// total us
+	uint64_t	max;
+	uint64_t	buckets[PERF_NBUCKETS];
+} perf_hist_t;
+
+typedef struct {
+	uint64_t	errors;					// requests which got an error response
+	perf_hist_t	stage[PS_NSTAGES];
+} perf_action_t;
+
+static perf_action_t	perf[PERF_NACTIONS];
+
+static const char* anames[PERF_NACTIONS] = {
+	"nop", "add", "delete", "show", "ping", "verbose", "dump", "mirror",
+	"cpu_alarm", "export", "reload", "update", "prepare", "commit", "abort", "opstatus", "unknown"
+};
+
+static const char* snames[PS_NSTAGES] = { "queue", "parse", "apply", "nic", "respond", "total" };
+
+static __thread uint64_t nic_us = 0;		// vfd_update_nic() time accumulated by the thread since perf_begin()
+
+/*
+	Map a request type to its row in the table.
+*/
+static int action_idx( int rtype ) {
+	if( rtype < 0 || rtype >= PERF_NACTIONS - 1 ) {
+		return PERF_NACTIONS - 1;
+	}
+
+	return rtype;
+}
+
+/*
+	Return the name of a request type (as used in the perf table); "unknown" for
+	anything not recognised.
+*/
+extern const char* vfd_rtype_name( int rtype ) {
+	return anames[action_idx( rtype )];
+}
+
+/*
+	Return the bucket for a value.
+*/
+static int bucket_idx( uint64_t v ) {
+	int msb;
+	int idx;
+
+	if( v < 4 ) {
+		return (int) v;
+	}
+
+	msb = 63 - __builtin_clzll( v );
+	idx = ((msb - 1) * 4) + (int) ((v >> (msb - 2)) & 0x03);
+	return idx < PERF_NBUCKETS ? idx : PERF_NBUCKETS - 1;
+}
+
+/*
+	Return the smallest value which lands in the bucket.
+*/
+static uint64_t bucket_low( int idx ) {
+	if( idx < 4 ) {
+		return (uint64_t) idx;
+	}
+
+	return (uint64_t) (4 + (idx % 4)) << ((idx / 4) - 1);
+}
+
+/*
+	Return the largest value which lands in the bucket; the last bucket has no
+	bound so the max seen is used.
+*/
+static uint64_t bucket_high( perf_hist_t* h, int idx ) {
+	if( idx >= PERF_NBUCKETS - 1 ) {
+		return __atomic_load_n( &h->max, __ATOMIC_RELAXED );
+	}
+
+	return bucket_low( idx + 1 ) - 1;
+}
+
+/*
+	Return the value at or below which fraction p of the samples fall. The upper
+	bound of the bucket is given (the last bucket reports the max).
+*/
+static uint64_t hist_pct( perf_hist_t* h, uint64_t count, double p ) {
+	uint64_t	want;
+	uint64_t	seen = 0;
+	int			i;
+
+	if( count == 0 ) {
+		return 0;
+	}
+
+	want = (uint64_t) ((double) count * p);
+	if( want < 1 ) {
+		want = 1;
+	}
+
+	for( i = 0; i < PERF_NBUCKETS - 1; i++ ) {
+		if( (seen += __atomic_load_n( &h->buckets[i], __ATOMIC_RELAXED )) >= want ) {
+			return bucket_high( h, i );
+		}
+	}
+
+	return __atomic_load_n( &h->max, __ATOMIC_RELAXED );
+}
+
+// -----------------------------------------------------------------------------------------
+
+/*
+	Return a monotonic timestamp in microseconds.
+*/
+extern uint64_t perf_now( void ) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/*
+	Record us microseconds for the request type's stage.
+*/
+extern void perf_record( int rtype, int stage, uint64_t us ) {
+	perf_hist_t* h;
+	uint64_t	max;
+
+	if( stage < 0 || stage >= PS_NSTAGES ) {
+		return;
+	}
+
+	h = &perf[action_idx( rtype )].stage[stage];
+	__atomic_fetch_add( &h->buckets[bucket_idx( us )], 1, __ATOMIC_RELAXED );
+	__atomic_fetch_add( &h->sum, us, __ATOMIC_RELAXED );
+	__atomic_fetch_add( &h->count, 1, __ATOMIC_RELAXED );
+
+	max = __atomic_load_n( &h->max, __ATOMIC_RELAXED );
+	while( us > max && ! __atomic_compare_exchange_n( &h->max, &max, us, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) );
+}
+
+/*
+	Count an error response for the request type.
+*/
+extern void perf_error( int rtype ) {
+	__atomic_fetch_add( &perf[action_idx( rtype )].errors, 1, __ATOMIC_RELAXED );
+}
+
+/*
+	Called when a thread starts to handle a request; clears the nic update time
+	collected by the thread.
+*/
+extern void perf_begin( void ) {
+	nic_us = 0;
+}
+
+/*
+	Add nic update time for the request the thread is handling.
+*/
+extern void perf_nic_add( uint64_t us ) {
+	nic_us += us;
+}
+
+/*
+	Return the nic update time collected by the thread since perf_begin().
+*/
+extern uint64_t perf_nic_us( void ) {
+	return nic_us;
+}
+
+/*
+	Generate the "show perf" text: one line per stage for each action that has been
+	seen. Times are in microseconds. Caller must free the buffer.
+*/
+extern char* perf_show( void ) {
+	perf_hist_t* h;
+	char*	buf;
+	int		blen = 0;
+	int		bsize = BUF_1K * 16;
+	int		a;
+	int		s;
+	uint64_t	count;
+	uint64_t	total;
+
+	if( (buf = (char *) malloc( bsize )) == NULL ) {
+		return NULL;
+	}
+
+	blen = snprintf( buf, bsize, "\n%-10s %-8s %10s %8s %10s %10s %10s %10s %10s\n",
+		"action", "stage", "count", "errors", "mean_us", "p50_us", "p90_us", "p99_us", "max_us" );
+
+	for( a = 0; a < PERF_NACTIONS; a++ ) {
+		if( (total = __atomic_load_n( &perf[a].stage[PS_TOTAL].count, __ATOMIC_RELAXED )) == 0 ) {
+			continue;
+		}
+
+		for( s = 0; s < PS_NSTAGES; s++ ) {
+			h = &perf[a].stage[s];
+			if( (count = __atomic_load_n( &h->count, __ATOMIC_RELAXED )) == 0 ) {
+				continue;
+			}
+
+			if( blen >= bsize - 256 ) {
+				snprintf( buf + blen, bsize - blen, "<truncated>\n" );
+				return buf;
+			}
+
+			blen += snprintf( buf + blen, bsize - blen, "%-10s %-8s %10llu %8llu %10llu %10llu %10llu %10llu %10llu\n",
+				anames[a], snames[s], (unsigned long long) count,
+				(unsigned long long) (s == PS_TOTAL ? __atomic_load_n( &perf[a].errors, __ATOMIC_RELAXED ) : 0),
+				(unsigned long long) (__atomic_load_n( &h->sum, __ATOMIC_RELAXED ) / count),
+				(unsigned long long) hist_pct( h, count, 0.50 ),
+				(unsigned long long) hist_pct( h, count, 0.90 ),
+				(unsigned long long) hist_pct( h, count, 0.99 ),
+				(unsigned long long) __atomic_load_n( &h->max, __ATOMIC_RELAXED ) );
+		}
+	}
+
+	return buf;
+}
+
+/*
+	Add the request latency data to the stats dump. For json an object (perf) is
+	written with a member for each action seen; each stage has its summary and the
+	non-empty buckets as [upper-bound-us, count] pairs. Json is written as a member
+	of the enclosing object and is preceded by a comma. For csv, one line is written
+	for each summary value and non-empty bucket with the pf and vf fields empty
+	(e.g. perf.add.nic.p99_us).
+*/
+extern void perf_dump( FILE* f, int fmt, time_t now ) {
+	perf_hist_t* h;
+	const char*	asep = "";
+	const char*	bsep;
+	char		name[128];
+	uint64_t	count;
+	uint64_t	v;
+	int			a;
+	int			s;
+	int			i;
+
+	if( fmt != SF_CSV ) {
+		fprintf( f, ",\n  \"perf\": {" );
+	}
+
+	for( a = 0; a < PERF_NACTIONS; a++ ) {
+		if( __atomic_load_n( &perf[a].stage[PS_TOTAL].count, __ATOMIC_RELAXED ) == 0 ) {
+			continue;
+		}
+
+		if( fmt == SF_CSV ) {
+			fprintf( f, "%ld,,,perf.%s.errors,%llu\n", (long) now, anames[a], (unsigned long long) __atomic_load_n( &perf[a].errors, __ATOMIC_RELAXED ) );
+		} else {
+			fprintf( f, "%s\n    \"%s\": { \"errors\": %llu", asep, anames[a], (unsigned long long) __atomic_load_n( &perf[a].errors, __ATOMIC_RELAXED ) );
+			asep = ",";
+		}
+
+		for( s = 0; s < PS_NSTAGES; s++ ) {
+			h = &perf[a].stage[s];
+			if( (count = __atomic_load_n( &h->count, __ATOMIC_RELAXED )) == 0 ) {
+				continue;
+			}
+
+			if( fmt == SF_CSV ) {
+				snprintf( name, sizeof( name ), "perf.%s.%s", anames[a], snames[s] );
+				fprintf( f, "%ld,,,%s.count,%llu\n", (long) now, name, (unsigned long long) count );
+				fprintf( f, "%ld,,,%s.sum_us,%llu\n", (long) now, name, (unsigned long long) __atomic_load_n( &h->sum, __ATOMIC_RELAXED ) );
+				fprintf( f, "%ld,,,%s.p50_us,%llu\n", (long) now, name, (unsigned long long) hist_pct( h, count, 0.50 ) );
+				fprintf( f, "%ld,,,%s.p90_us,%llu\n", (long) now, name, (unsigned long long) hist_pct( h, count, 0.90 ) );
+				fprintf( f, "%ld,,,%s.p99_us,%llu\n", (long) now, name, (unsigned long long) hist_pct( h, count, 0.99 ) );
+				fprintf( f, "%ld,,,%s.max_us,%llu\n", (long) now, name, (unsigned long long) __atomic_load_n( &h->max, __ATOMIC_RELAXED ) );
+				for( i = 0; i < PERF_NBUCKETS; i++ ) {
+					if( (v = __atomic_load_n( &h->buckets[i], __ATOMIC_RELAXED )) > 0 ) {
+						fprintf( f, "%ld,,,%s.le_%llu,%llu\n", (long) now, name, (unsigned long long) bucket_high( h, i ), (unsigned long long) v );
+					}
+				}
+			} else {
+				fprintf( f, ",\n      \"%s\": { \"count\": %llu, \"sum_us\": %llu, \"p50_us\": %llu, \"p90_us\": %llu, \"p99_us\": %llu, \"max_us\": %llu,\n        \"buckets\": [",
+					snames[s], (unsigned long long) count,
+					(unsigned long long) __atomic_load_n( &h->sum, __ATOMIC_RELAXED ),
+					(unsigned long long) hist_pct( h, count, 0.50 ),
+					(unsigned long long) hist_pct( h, count, 0.90 ),
+					(unsigned long long) hist_pct( h, count, 0.99 ),
+					(unsigned long long) __atomic_load_n( &h->max, __ATOMIC_RELAXED ) );
+
+				bsep = "";
+				for( i = 0; i < PERF_NBUCKETS; i++ ) {
+					if( (v = __atomic_load_n( &h->buckets[i], __ATOMIC_RELAXED )) > 0 ) {
+						fprintf( f, "%s [%llu, %llu]", bsep, (unsigned long long) bucket_high( h, i ), (unsigned long long) v );
+						bsep = ",";
+					}
+				}
+				fprintf( f, " ] }" );
+			}
+		}
+
+		if( fmt != SF_CSV ) {
+			fprintf( f, "\n    }" );
+		}
+	}
+
+	if( fmt != SF_CSV ) {
+		fprintf( f, "\n  }" );
+	}
+}
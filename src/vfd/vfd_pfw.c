@@ -0,0 +1,339 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vfd_pfw.c
+	Abstract:	PF owner threads. When enabled (pf_workers in the parm file) each
+				configured PF is given a thread which does all of the NIC
+				programming for that PF during a nic update. vfd_update_nic()
+				hands each port to its owner and waits for all of them, so
+				independent PFs are programmed in parallel rather than one after
+				another; the time an update holds the update lock is that of the
+				slowest port rather than the sum of all of them.
+
+				Config changes are still made under the update lock by whoever
+				holds it. Work is only ever queued by the lock holder, and an
+				owner never takes the update lock, so an owner can't be stuck
+				behind the thread waiting on it.
+
+				If pf_pin is also set, each owner binds itself to the CPUs local
+				to its PF (from sysfs) so that register access and the port's
+				memory stay on the PF's NUMA node.
+
+				Each port also has a device lock which is held while the port is
+				programmed by pfw_run() (owner or serial). Threads which read the
+				port's counters without the update lock (request workers answering
+				show from a config snapshot) take it so that the driver's stats
+				calls don't run alongside the port being programmed.
+
+	Date:		19 October 2026
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE				// cpu_set_t and pthread_setaffinity_np()
+#endif
+#include <pthread.h>
+#include <sched.h>
+
+#define BLEAT_SUBSYS	BLEAT_SS_NIC		// tag our bleat messages; must be set before vfdlib.h is included
+#include <vfdlib.h>
+#include "sriov.h"
+
+typedef struct pfw_batch {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	int				pending;			// jobs not yet finished
+} pfw_batch_t;
+
+typedef struct pfw_job {
+	pfw_fn_t		fn;
+	void*			data;
+	struct sriov_port_s* port;
+	pfw_batch_t*	batch;
+	struct pfw_job*	next;
+} pfw_job_t;
+
+typedef struct {
+	pthread_t		tid;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	pfw_job_t*		head;
+	pfw_job_t*		tail;
+	int				pidx;				// index of the owned port in the config
+	int				portid;				// dpdk port number (thread name and log)
+	int				pin;				// bind to the PF's local cpus at start
+	int				stop;
+	char			pciid[64];
+} pf_worker_t;
+
+static pf_worker_t	owners[MAX_PORTS];
+static int			nowners = 0;			// owners running; 0 means updates are done serially by the caller
+
+static pthread_mutex_t	dev_locks[MAX_PORTS] = { [0 ... MAX_PORTS-1] = PTHREAD_MUTEX_INITIALIZER };	// by dpdk port id
+
+static __thread int	pfw_self = -1;			// port index owned by the thread; -1 if not an owner
+
+/*
+	Run a job's function for the port with the port's device lock held.
+*/
+static void run_locked( pfw_fn_t fn, void* data, struct sriov_port_s* port ) {
+	pfw_port_lock( port->rte_port_number );
+	fn( data, port );
+	pfw_port_unlock( port->rte_port_number );
+}
+
+/*
+	Mark one of the batch's jobs finished and wake the waiter if it was the last.
+*/
+static void job_done( pfw_batch_t* b ) {
+	pthread_mutex_lock( &b->lock );
+	if( --b->pending <= 0 ) {
+		pthread_cond_signal( &b->cond );
+	}
+	pthread_mutex_unlock( &b->lock );
+}
+
+/*
+	Bind the calling thread to the CPUs local to the PF. The pciid's local_cpulist
+	in sysfs is a list of cpus and ranges (e.g. 0-13,28-41). Returns the number of
+	cpus the thread was bound to; 0 if it was left alone.
+*/
+static int pin_owner( const_str pciid ) {
+	cpu_set_t	cpus;
+	char	fname[256];
+	char	buf[1024];
+	char	list[1024];
+	char*	tok;
+	char*	strtok_p = NULL;
+	char*	dash;
+	FILE*	f;
+	int		first;
+	int		last;
+	int		n = 0;
+
+	snprintf( fname, sizeof( fname ), "/sys/bus/pci/devices/%s/local_cpulist", pciid );
+	if( (f = fopen( fname, "r" )) == NULL ) {
+		bleat_printf( 1, "pf owner: cannot read %s: %s; thread is not pinned", fname, strerror( errno ) );
+		return 0;
+	}
+
+	if( fgets( buf, sizeof( buf ), f ) == NULL ) {
+		*buf = 0;
+	}
+	fclose( f );
+	snprintf( list, sizeof( list ), "%s", buf );		// strtok trashes buf; keep a copy for the log
+
+	CPU_ZERO( &cpus );
+	for( tok = strtok_r( buf, ",\n", &strtok_p ); tok != NULL; tok = strtok_r( NULL, ",\n", &strtok_p ) ) {
+		first = atoi( tok );
+		last = (dash = strchr( tok, '-' )) != NULL ? atoi( dash + 1 ) : first;
+		for( ; first >= 0 && first <= last && first < CPU_SETSIZE; first++ ) {
+			CPU_SET( first, &cpus );
+			n++;
+		}
+	}
+
+	if( n == 0 ) {
+		return 0;
+	}
+
+	if( pthread_setaffinity_np( pthread_self(), sizeof( cpus ), &cpus ) != 0 ) {
+		bleat_printf( 1, "pf owner: unable to pin thread for %s to cpus %s", pciid, list );
+		return 0;
+	}
+
+	return n;
+}
+
+/*
+	Owner thread: run jobs for the port until told to stop.
+*/
+static void* pf_owner( void* vw ) {
+	pf_worker_t* w;
+	pfw_job_t*	job;
+	int	ncpus;
+
+	w = (pf_worker_t *) vw;
+	pfw_self = w->pidx;
+
+	if( w->pin && (ncpus = pin_owner( w->pciid )) > 0 ) {
+		bleat_printf( 1, "pf owner for port %d (%s) pinned to %d local cpus", w->portid, w->pciid, ncpus );
+	}
+
+	pthread_mutex_lock( &w->lock );
+	while( 1 ) {
+		while( w->head == NULL && ! w->stop ) {
+			pthread_cond_wait( &w->cond, &w->lock );
+		}
+		if( (job = w->head) == NULL ) {				// stopping and nothing left
+			break;
+		}
+
+		if( (w->head = job->next) == NULL ) {
+			w->tail = NULL;
+		}
+		pthread_mutex_unlock( &w->lock );
+
+		run_locked( job->fn, job->data, job->port );
+		job_done( job->batch );
+
+		pthread_mutex_lock( &w->lock );
+	}
+	pthread_mutex_unlock( &w->lock );
+
+	return NULL;
+}
+
+// -----------------------------------------------------------------------------------------
+
+/*
+	Start an owner thread for each port in the config. If pin is set, each thread
+	binds itself to the CPUs local to its PF. Must be called after the ports have
+	been configured (port indexes don't change after that). Returns the number of
+	owners running; if any could not be started none are used and updates are done
+	serially.
+*/
+extern int pfw_start( sriov_conf_t* conf, int pin ) {
+	pf_worker_t* w;
+	char	name[16];
+	int		i;
+
+	if( conf == NULL || nowners > 0 ) {
+		return nowners;
+	}
+
+	for( i = 0; i < conf->num_ports && i < MAX_PORTS; i++ ) {
+		w = &owners[i];
+		memset( w, 0, sizeof( *w ) );
+		w->pidx = i;
+		w->portid = conf->ports[i].rte_port_number;
+		w->pin = pin;
+		snprintf( w->pciid, sizeof( w->pciid ), "%s", conf->ports[i].pciid );
+		pthread_mutex_init( &w->lock, NULL );
+		pthread_cond_init( &w->cond, NULL );
+
+		if( pthread_create( &w->tid, NULL, pf_owner, w ) != 0 ) {
+			bleat_printf( 0, "WRN: unable to start owner thread for port %d: %s; nic updates will be serial", w->portid, strerror( errno ) );
+			nowners = i;
+			pfw_stop( );
+			return 0;
+		}
+
+		snprintf( name, sizeof( name ), "vfd-pf%d", w->portid );
+		pthread_setname_np( w->tid, name );
+	}
+
+	nowners = i;
+	bleat_printf( 1, "%d pf owner threads started%s", nowners, pin ? " (pinned to local cpus)" : "" );
+	return nowners;
+}
+
+/*
+	Run fn for every port in the config and wait for all of them to finish. When
+	owners are running each port's call is made by its owner, so the ports are done
+	in parallel; otherwise (or if called by an owner) the calls are made serially by
+	the caller in port order. The caller must hold the update lock.
+*/
+extern void pfw_run( sriov_conf_t* conf, pfw_fn_t fn, void* data ) {
+	pfw_job_t	jobs[MAX_PORTS];
+	pfw_batch_t	batch;
+	pf_worker_t* w;
+	int	n;
+	int	i;
+
+	n = conf->num_ports < MAX_PORTS ? conf->num_ports : MAX_PORTS;
+	if( pfw_self >= 0 ) {								// an owner already holds its port's device lock
+		for( i = 0; i < n; i++ ) {
+			fn( data, &conf->ports[i] );
+		}
+		return;
+	}
+
+	if( nowners < n ) {
+		for( i = 0; i < n; i++ ) {
+			run_locked( fn, data, &conf->ports[i] );
+		}
+		return;
+	}
+
+	pthread_mutex_init( &batch.lock, NULL );
+	pthread_cond_init( &batch.cond, NULL );
+	batch.pending = n;
+
+	for( i = 0; i < n; i++ ) {
+		jobs[i].fn = fn;
+		jobs[i].data = data;
+		jobs[i].port = &conf->ports[i];
+		jobs[i].batch = &batch;
+		jobs[i].next = NULL;
+
+		w = &owners[i];
+		pthread_mutex_lock( &w->lock );
+		if( w->tail != NULL ) {
+			w->tail->next = &jobs[i];
+		} else {
+			w->head = &jobs[i];
+		}
+		w->tail = &jobs[i];
+		pthread_cond_signal( &w->cond );
+		pthread_mutex_unlock( &w->lock );
+	}
+
+	pthread_mutex_lock( &batch.lock );
+	while( batch.pending > 0 ) {
+		pthread_cond_wait( &batch.cond, &batch.lock );
+	}
+	pthread_mutex_unlock( &batch.lock );
+
+	pthread_cond_destroy( &batch.cond );
+	pthread_mutex_destroy( &batch.lock );
+}
+
+/*
+	Take the device lock for the dpdk port. Held by pfw_run() while the port is
+	programmed; a thread reading the port's counters outside of the update lock
+	must hold it around the driver calls. Never take the update lock while holding
+	a device lock.
+*/
+extern void pfw_port_lock( int portid ) {
+	if( portid >= 0 && portid < MAX_PORTS ) {
+		pthread_mutex_lock( &dev_locks[portid] );
+	}
+}
+
+/*
+	Release the device lock for the dpdk port.
+*/
+extern void pfw_port_unlock( int portid ) {
+	if( portid >= 0 && portid < MAX_PORTS ) {
+		pthread_mutex_unlock( &dev_locks[portid] );
+	}
+}
+
+/*
+	Stop the owner threads after they finish what is queued. Later updates are
+	done serially by the caller.
+*/
+extern void pfw_stop( void ) {
+	pf_worker_t* w;
+	int	n;
+	int	i;
+
+	if( (n = nowners) <= 0 ) {
+		return;
+	}
+
+	nowners = 0;
+	for( i = 0; i < n; i++ ) {
+		w = &owners[i];
+		pthread_mutex_lock( &w->lock );
+		w->stop = 1;
+		pthread_cond_signal( &w->cond );
+		pthread_mutex_unlock( &w->lock );
+	}
+
+	for( i = 0; i < n; i++ ) {
+		pthread_join( owners[i].tid, NULL );
+	}
+
+	bleat_printf( 1, "pf owner threads stopped" );
+}
@@ -0,0 +1,334 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vfd_rcu.c
+	Abstract:	Immutable, versioned snapshots of the running configuration for
+				readers which must not wait on the update lock (request workers
+				and the mailbox callbacks' policy checks).
+
+				A new snapshot is published when vfd_update_nic() starts (so
+				that a guest configuring its VF while the NIC is programmed sees
+				the new policy) and again when it finishes, and after a parm
+				reload. Updates are driven by the main thread, but also by the
+				DPDK interrupt thread (VF resets restore the VF's settings) and
+				the queue refresh thread; all hold the update lock. A
+				snapshot is a copy of the port/VF configuration; the strings
+				that readers need are duplicated and the pointers that readers
+				must not follow (tc config, xstat buffers, callbacks, deltas)
+				are nil, so nothing in a snapshot changes or is freed while it
+				is current.
+
+				The full config is several megabytes, nearly all of it unused VF
+				and mirror slots, and a snapshot is built twice for each nic
+				update while the update lock is held. Only the ports in use are
+				allocated, and only their VFs and mirrors in use are copied; the
+				unused slots are never written, so their pages aren't touched.
+
+				Reclamation is epoch based. Each reader thread is given a slot
+				the first time it enters a read side section and records the
+				global epoch in the slot on entry (0 on exit). When a snapshot
+				is replaced it is tagged with the epoch in effect and the epoch
+				is bumped; a retired snapshot is freed once no reader slot holds
+				an epoch less than or equal to its tag. Read side sections nest.
+				Publishing and reclaiming can happen on any thread: the main
+				loop reclaims without the update lock while another thread may
+				be publishing under it, so the retired list (and the swap of the
+				current snapshot which feeds it) is guarded by its own lock.
+
+				A reader which cannot get a slot, or which runs before the first
+				publish, gets nil from rcu_acquire() and must fall back to the
+				running config under the update lock.
+
+	Date:		19 October 2026
+*/
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define BLEAT_SUBSYS	BLEAT_SS_RIF		// tag our bleat messages; must be set before vfdlib.h is included
+#include <vfdlib.h>
+#include "sriov.h"
+
+#define RCU_MAX_READERS		32
+
+typedef struct {
+	uint64_t	epoch;						// epoch when the read side was entered; 0 if not reading
+	char		pad[56];					// keep each slot on its own cache line
+} rcu_reader_t;
+
+static rcu_reader_t	readers[RCU_MAX_READERS];
+static int			nreaders = 0;			// slots handed out
+static uint64_t		g_epoch = 1;
+static uint64_t		g_version = 0;
+static cfg_snap_t*	current = NULL;
+static cfg_snap_t*	retired = NULL;			// replaced snapshots waiting for readers to move on (under pub_lock)
+static pthread_mutex_t	pub_lock = PTHREAD_MUTEX_INITIALIZER;	// guards retired, g_version and the publish swap
+
+static __thread int	my_slot = -1;			// reader slot for the thread; -2 if none available
+static __thread int	my_depth = 0;			// read side nesting
+
+/*
+	Free a snapshot and the strings it owns.
+*/
+static void snap_free( cfg_snap_t* s ) {
+	struct vf_s* vf;
+	int	p;
+	int	v;
+
+	for( p = 0; p < s->conf.num_ports; p++ ) {
+		for( v = 0; v < s->conf.ports[p].num_vfs; v++ ) {
+			vf = &s->conf.ports[p].vfs[v];
+			if( vf->config_name != NULL ) {
+				free( vf->config_name );
+			}
+			if( vf->prep_name != NULL ) {
+				free( vf->prep_name );
+			}
+		}
+	}
+
+	free( s );
+}
+
+/*
+	Copy the port into the snapshot's port: the fixed fields, and the VFs and
+	mirrors in use. The VF and mirror slots past num_vfs are left as they are.
+*/
+static void port_copy( struct sriov_port_s* port, struct sriov_port_s* src ) {
+	int	nvfs;
+
+	nvfs = src->num_vfs < 0 ? 0 : (src->num_vfs > MAX_VFS ? MAX_VFS : src->num_vfs);
+
+	memcpy( port, src, offsetof( struct sriov_port_s, mirrors ) );
+	memcpy( port->mirrors, src->mirrors, sizeof( port->mirrors[0] ) * nvfs );
+	memcpy( port->vfs, src->vfs, sizeof( port->vfs[0] ) * nvfs );
+	memcpy( port->tc_config, src->tc_config, sizeof( *port ) - offsetof( struct sriov_port_s, tc_config ) );
+	port->num_vfs = nvfs;
+}
+
+/*
+	Build a snapshot of the config. Only the ports in use are allocated, and
+	only what is in use in each is copied (see port_copy()).
+*/
+static cfg_snap_t* snap_build( sriov_conf_t* conf ) {
+	cfg_snap_t*	s;
+	struct sriov_port_s* port;
+	struct vf_s* vf;
+	int	nports;
+	int	p;
+	int	v;
+
+	nports = conf->num_ports < 0 ? 0 : (conf->num_ports > MAX_PORTS ? MAX_PORTS : conf->num_ports);
+	if( (s = (cfg_snap_t *) malloc( offsetof( cfg_snap_t, conf.ports ) + sizeof( s->conf.ports[0] ) * nports )) == NULL ) {
+		return NULL;
+	}
+
+	memset( s, 0, offsetof( cfg_snap_t, conf.ports ) );
+	memcpy( s->port_map, port2config_map, sizeof( s->port_map ) );
+	s->conf.num_ports = nports;
+
+	for( p = 0; p < nports; p++ ) {
+		port = &s->conf.ports[p];
+		port_copy( port, &conf->ports[p] );
+
+		memset( port->tc_config, 0, sizeof( port->tc_config ) );		// owned by the running config; not for readers
+		port->vftc_qshares = NULL;
+		port->nxstat_pfx = 0;
+		port->xstat_pfx = NULL;
+		port->nxstats = 0;
+		port->xstat_ids = NULL;
+		port->xstat_names = NULL;
+		port->xstat_vals = NULL;
+
+		for( v = 0; v < port->num_vfs; v++ ) {
+			vf = &port->vfs[v];
+			vf->start_cb = NULL;
+			vf->stop_cb = NULL;
+			vf->delta = NULL;
+			if( vf->config_name != NULL ) {
+				vf->config_name = strdup( vf->config_name );
+			}
+			if( vf->prep_name != NULL ) {
+				vf->prep_name = strdup( vf->prep_name );
+			}
+		}
+	}
+
+	return s;
+}
+
+// -----------------------------------------------------------------------------------------
+
+/*
+	Free retired snapshots which no reader can still be looking at. Caller must hold
+	pub_lock.
+*/
+static void reclaim( void ) {
+	cfg_snap_t*	s;
+	cfg_snap_t*	next;
+	cfg_snap_t*	keep = NULL;
+	uint64_t	min = UINT64_MAX;
+	uint64_t	e;
+	int	n;
+	int	i;
+
+	if( retired == NULL ) {
+		return;
+	}
+
+	n = __atomic_load_n( &nreaders, __ATOMIC_SEQ_CST );
+	for( i = 0; i < n && i < RCU_MAX_READERS; i++ ) {
+		if( (e = __atomic_load_n( &readers[i].epoch, __ATOMIC_SEQ_CST )) != 0 && e < min ) {
+			min = e;
+		}
+	}
+
+	for( s = retired; s != NULL; s = next ) {
+		next = s->next;
+		if( s->retired_at < min ) {
+			bleat_printf( 3, "rcu: config snapshot %lld reclaimed", (long long) s->version );
+			snap_free( s );
+		} else {
+			s->next = keep;
+			keep = s;
+		}
+	}
+
+	retired = keep;
+}
+
+/*
+	Free retired snapshots which no reader can still be looking at. Safe to call
+	from any thread, with or without the update lock.
+*/
+extern void rcu_reclaim( void ) {
+	pthread_mutex_lock( &pub_lock );
+	reclaim( );
+	pthread_mutex_unlock( &pub_lock );
+}
+
+/*
+	Publish a new snapshot of the config. The one it replaces is retired and freed
+	once the readers using it have finished. May be called from any thread; the
+	caller should hold the update lock (or otherwise know the config isn't changing)
+	as the snapshot is built from it. Returns the new version, or 0 if the snapshot
+	couldn't be built (the old one remains current).
+*/
+extern uint64_t rcu_publish( sriov_conf_t* conf ) {
+	cfg_snap_t*	s;
+	cfg_snap_t*	old;
+	uint64_t	version;
+
+	if( conf == NULL || (s = snap_build( conf )) == NULL ) {
+		bleat_printf( 0, "WRN: rcu: unable to build config snapshot; readers will see the previous one" );
+		return 0;
+	}
+
+	pthread_mutex_lock( &pub_lock );
+	version = s->version = ++g_version;			// s may be retired and freed by another publisher once we let go
+	old = __atomic_exchange_n( &current, s, __ATOMIC_SEQ_CST );
+	if( old != NULL ) {
+		old->retired_at = __atomic_fetch_add( &g_epoch, 1, __ATOMIC_SEQ_CST );
+		old->next = retired;
+		retired = old;
+	}
+	reclaim( );
+	pthread_mutex_unlock( &pub_lock );
+
+	bleat_printf( 3, "rcu: config snapshot %lld published", (long long) version );
+	return version;
+}
+
+/*
+	Enter a read side section and return the current snapshot. The snapshot must
+	not be used after the matching rcu_release(). Returns nil if there is no
+	snapshot (none published yet, or no reader slot for the thread); rcu_release()
+	must still be called.
+*/
+extern cfg_snap_t* rcu_acquire( void ) {
+	if( my_slot == -1 ) {
+		if( (my_slot = __atomic_fetch_add( &nreaders, 1, __ATOMIC_SEQ_CST )) >= RCU_MAX_READERS ) {
+			bleat_printf( 0, "WRN: rcu: no reader slot available (%d in use); thread will use the update lock", RCU_MAX_READERS );
+			my_slot = -2;
+		}
+	}
+
+	my_depth++;
+	if( my_slot < 0 ) {
+		return NULL;
+	}
+
+	if( my_depth == 1 ) {
+		__atomic_store_n( &readers[my_slot].epoch, __atomic_load_n( &g_epoch, __ATOMIC_SEQ_CST ), __ATOMIC_SEQ_CST );
+	}
+
+	return __atomic_load_n( &current, __ATOMIC_SEQ_CST );
+}
+
+/*
+	Leave a read side section.
+*/
+extern void rcu_release( void ) {
+	if( my_depth <= 0 ) {
+		return;
+	}
+
+	if( --my_depth == 0 && my_slot >= 0 ) {
+		__atomic_store_n( &readers[my_slot].epoch, 0, __ATOMIC_RELEASE );
+	}
+}
+
+/*
+	Given a dpdk port id find the port in the snapshot (suss_port() for a snapshot).
+*/
+extern struct sriov_port_s* rcu_port( cfg_snap_t* s, int portid ) {
+	int idx;
+
+	if( s == NULL || portid < 0 || portid >= MAX_PORTS ) {
+		return NULL;
+	}
+
+	if( (idx = s->port_map[portid]) < 0 || idx >= s->conf.num_ports ) {
+		return NULL;
+	}
+
+	return &s->conf.ports[idx];
+}
+
+/*
+	Given a dpdk port id and vf number find the vf in the snapshot (suss_vf() for a snapshot).
+*/
+extern struct vf_s* rcu_vf( cfg_snap_t* s, int portid, int vfid ) {
+	struct sriov_port_s* p;
+	int	i;
+
+	if( (p = rcu_port( s, portid )) == NULL ) {
+		return NULL;
+	}
+
+	for( i = 0; i < p->num_vfs; i++ ) {
+		if( p->vfs[i].num == vfid ) {
+			return &p->vfs[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Free the current snapshot and anything retired. Called at termination after
+	readers have been stopped.
+*/
+extern void rcu_shutdown( void ) {
+	cfg_snap_t* s;
+
+	pthread_mutex_lock( &pub_lock );
+	if( (s = __atomic_exchange_n( &current, NULL, __ATOMIC_SEQ_CST )) != NULL ) {
+		s->retired_at = __atomic_fetch_add( &g_epoch, 1, __ATOMIC_SEQ_CST );
+		s->next = retired;
+		retired = s;
+	}
+
+	reclaim( );
+	pthread_mutex_unlock( &pub_lock );
+}
@@ -28,12 +28,45 @@
 				24 Apr 2018 : Correct double free bug if pciid wasn't right in a config file.
 				25 Jul 2018 : Add support for export command. Correct bug when unrecognised command
 								sent (was not responding with error to requestor).
+				19 Oct 2026 : Hand the PF's xstat prefix list to the port when adding ports.
+				19 Oct 2026 : Verbose request may set levels for individual subsystems.
+				19 Oct 2026 : Read/parse config files in parallel at start up; apply in name order.
+				19 Oct 2026 : Split the in memory part of delete into vfd_del_vfc() for the config
+								directory watcher; relocate_vf_config() is no longer static.
+								An add request for a file the watcher already applied succeeds.
+				19 Oct 2026 : Add offline validation of a directory of vf configs (vfd_validate).
+				19 Oct 2026 : Add single port add/delete and a definition compare for parm reload;
+								add the reload request.
+				19 Oct 2026 : Add the update request which changes a live VF in place rather than
+								deleting and adding it. Add time vetting moved to vet_vfc() so
+								that update can share it.
+				19 Oct 2026 : Add prepare, commit and abort requests (two phase add for live migration).
+				19 Oct 2026 : Accept requests on the unix domain socket; responses go back on
+								the connection the request arrived on.
+				19 Oct 2026 : Queue responses (fifo and socket) rather than writing them with
+								retries; a slow reader no longer stalls the main loop.
+				19 Oct 2026 : Add request workers which handle ping, show and export from the
+								current config snapshot. Show moved to show_request().
+				19 Oct 2026 : Read all waiting requests and queue them by priority class (liveness,
+								read only, mutation); idle workers read the intake while the main
+								thread is busy so pings are answered during long adds.
+				19 Oct 2026 : Time each request by stage (queue, parse, apply, nic, respond) and
+								add show perf.
+				19 Oct 2026 : Add async (accept then complete) mode for mutations, and the opstatus
+								request. Queued async adds share one nic update.
+				19 Oct 2026 : Accept binary (TLV) requests on the socket and answer them in kind.
+				19 Oct 2026 : Refuse prepare on NICs which cannot hold a VF's link down.
+				19 Oct 2026 : Refuse an async request rather than reuse an unfinished op's slot.
+				19 Oct 2026 : Mark a prepared VF while the add holds the update lock so that a
+								concurrent nic update never brings its link up.
 */
 
 
+#define BLEAT_SUBSYS	BLEAT_SS_RIF		// tag our bleat messages; must be set before vfdlib.h is included
 #include <vfdlib.h>		// if vfdlib.h needs an include it must be included there, can't be include prior
 #include "sriov.h"
 #include "vfd_rif.h"
+#include <pthread.h>
 
 //--------------------------------------------------------------------------------------------------------------
 
@@ -64,7 +97,7 @@ extern int vfd_init_fifo( parms_t* parms ) {
 	file adding the suffix (assuming foo.json will be renamed foo.json.error in the spot
 	where the virtualisation manager left the bad meat.
 */
-static void relocate_vf_config( parms_t* parms, char* filename, const_str suffix ) {
+extern void relocate_vf_config( parms_t* parms, char* filename, const_str suffix ) {
 	char	wbuf[2048];
 	unsigned int len;
 	const_str base;								// basename portion of filename
@@ -178,11 +211,13 @@ static int copy_vf_config( parms_t* parms, char* src_name, const_str dest_name )
 
 	Port is the PF number mapped from the pciid in the parm file.
 	req_tcs is an array of the reqested tc percentages ordered traffic class 0-7.
+	Skip is the index of a VF to leave out of the totals (the VF being updated),
+	or -1.
 
 	Return code of 0 indicates success; non-zero is failure.
 	
 */
-extern int check_qs_oversub( struct sriov_port_s* port, uint8_t* qshares ) {
+extern int check_qs_oversub( struct sriov_port_s* port, uint8_t* qshares, int skip ) {
 
 	int	totals[MAX_TCS];			// current pct totals
 	int	i;
@@ -192,7 +227,7 @@ extern int check_qs_oversub( struct sriov_port_s* port, uint8_t* qshares ) {
 	memset( totals, 0, sizeof( totals ) );
 
 	for( i = 0; i < port->num_vfs; i++ ) {			// sum the pctgs for each TC across all VFs
-		if( port->vfs[i].num >= 0 ) {				// active VF
+		if( port->vfs[i].num >= 0 && i != skip ) {	// active VF
 			for( j = 0; j < MAX_TCS; j++ ) {
 				totals[j] += port->vfs[i].qshares[j];	// add in this total
 			}
@@ -214,12 +249,12 @@ extern int check_qs_oversub( struct sriov_port_s* port, uint8_t* qshares ) {
 	min and max.  This function will check the queue shares and return non-zero if
 	the difference between min and max is greater than 10x. Qshares is a pointer to
 	the values which are being added to the port and will be taken into consideration
-	with the current port settings.
+	with the current port settings. Skip is as for check_qs_oversub().
 
 	Return of 0 indicates that the qshares can safely be added; non-zero indicates one 
 	or more of the shares busts the limit.
 */
-extern int check_qs_spread( struct sriov_port_s* port, uint8_t* qshares ) {
+extern int check_qs_spread( struct sriov_port_s* port, uint8_t* qshares, int skip ) {
 	int	min[MAX_TCS];			// min and max for each TC
 	int	max[MAX_TCS];
 	int	i;
@@ -231,7 +266,7 @@ extern int check_qs_spread( struct sriov_port_s* port, uint8_t* qshares ) {
 	}
 
 	for( i = 0; i < port->num_vfs; i++ ) {			// sum the pctgs for each TC across all VFs
-		if( port->vfs[i].num >= 0 ) {				// active VF
+		if( port->vfs[i].num >= 0 && i != skip ) {	// active VF
 			for( j = 0; j < MAX_TCS; j++ ) {
 				if( port->vfs[i].qshares[j] > 0  &&  min[j] > port->vfs[i].qshares[j] ) {		// zeros are ignored
 					min[j] = port->vfs[i].qshares[j];
@@ -351,6 +386,64 @@ void gen_port_qshares( sriov_port_t *port ) {
 
 //  --------------------- global config management ------------------------------------------------------------
 
+/*
+	Fill in a port from its parm file definition. Ownership of the tc and xstat
+	information moves from the definition to the port. Idx is used only in messages.
+*/
+static void fill_port( struct sriov_port_s* port, pfdef_t* pfc, int idx ) {
+	int j;
+	int k;
+
+	port->flags = 0;
+	port->last_updated = ADDED;						 						// flag newly added so the nic is configured next go round
+	snprintf( port->name, sizeof( port->name ), "port_%d",  idx);			// TODO--- support getting a name from the config
+	snprintf( port->pciid, sizeof( port->pciid ), "%s", pfc->id );
+	port->mtu = pfc->mtu;
+
+	if( pfc->flags & PFF_PROMISC ) {
+		port->flags |= PF_PROMISC;											// set promisc mode on the PF
+	}
+	if( pfc->flags & PFF_LOOP_BACK ) {
+		port->flags |= PF_LOOPBACK;											// enable VM->VM traffic without leaving nic
+	}
+	if( pfc->flags & PFF_VF_OVERSUB ) {
+		port->flags |= PF_OVERSUB;											// enable VM->VM traffic without leaving nic
+	}
+
+	port->num_mirrors = 0;
+	port->num_vfs = 0;
+	port->ntcs = pfc->ntcs;					// number of traffic classes to maintain
+	
+	for( j = 0; j < MAX_TCS; j++ ) {
+		port->tc_config[j] = pfc->tcs[j];	// point at the config struct
+		pfc->tcs[j] = NULL;					// unmark it so it won't free	
+	}
+
+	port->nxstat_pfx = pfc->nxstats;		// xstat prefixes to export; ownership moves to the port
+	port->xstat_pfx = pfc->xstats;
+	pfc->xstats = NULL;
+	pfc->nxstats = 0;
+
+	memset( port->tc2bwg, 0, sizeof( port->tc2bwg ) );		// by default a tc is in group 0
+	for( j = 0; j < NUM_BWGS; j++ ) {					// set the map which defines the bandwidth group each TC belongs to
+		bw_grp_t*	bwg;
+		
+		bwg = &pfc->bw_grps[j];
+		for( k = 0; k < bwg->ntcs; k++ ) {
+			port->tc2bwg[bwg->tcs[k]] = j;	// map the TC to this bw group
+		}
+	}
+
+	if( bleat_will_it( 2 ) ) {
+		bleat_printf( 2, "pf %d configured: %s %s mtu=%d flags-0x02x ntcs==%d", idx, port->name, port->pciid, port->mtu, port->flags, port->ntcs );
+		for( j = 0; j < MAX_TCS; j++ ) {
+			if( port->tc_config[j] != NULL ) {
+				bleat_printf( 2, "pf %d tc[%d]: flags=0x%02x min=%d bwg=%d", idx, j, port->tc_config[j]->flags, port->tc_config[j]->min_bw,  port->tc2bwg[j] );
+			}
+		}
+	}
+}
+
 /*
 	Pull the list of pciids from the parms and set into the in memory configuration that
 	is maintained. If this is called more than once, it will refuse to do anything.
@@ -358,70 +451,162 @@ void gen_port_qshares( sriov_port_t *port ) {
 extern void vfd_add_ports( parms_t* parms, sriov_conf_t* conf ) {
 	static int called = 0;		// doesn't makes sense to do this more than once
 	int i;
-	int j;
-	int k;
 	int pidx = 0;				// port idx in conf list
-	struct sriov_port_s* port;
-	pfdef_t*	pfc;			// pointer to the config info for a port (pciid)
 
-	rte_spinlock_lock( &conf->update_lock );
+	pthread_mutex_lock( &conf->update_lock );
 	if( called ) {
-		rte_spinlock_unlock( &conf->update_lock );
+		pthread_mutex_unlock( &conf->update_lock );
 		return;
 	}
 	called = 1;
 	
 	for( i = 0; pidx < MAX_PORTS  && i < parms->npciids; i++, pidx++ ) {
-		pfc = &parms->pciids[i];					// point at the pf's configuration info
+		fill_port( &conf->ports[pidx], &parms->pciids[i], i );		// point at the pf's configuration info
+	}
+
+	conf->num_ports = pidx;
+	pthread_mutex_unlock( &conf->update_lock );
+}
 
-		port = &conf->ports[pidx];
-		port->flags = 0;
-		port->last_updated = ADDED;						 						// flag newly added so the nic is configured next go round
-		snprintf( port->name, sizeof( port->name ), "port_%d",  i);				// TODO--- support getting a name from the config
-		snprintf( port->pciid, sizeof( port->pciid ), "%s", pfc->id );
-		port->mtu = pfc->mtu;
+/*
+	Add a single PF definition to the end of the port list (parm reload). The caller
+	must map the real port and initialise it. Returns the index of the new port, or
+	-1 if the list is full.
+*/
+extern int vfd_add_port( sriov_conf_t* conf, pfdef_t* pfc ) {
+	int pidx;
+
+	pthread_mutex_lock( &conf->update_lock );
+	if( (pidx = conf->num_ports) >= MAX_PORTS ) {
+		pthread_mutex_unlock( &conf->update_lock );
+		bleat_printf( 0, "WRN: unable to add pf %s: max ports (%d) already defined", pfc->id, MAX_PORTS );
+		return -1;
+	}
+
+	memset( &conf->ports[pidx], 0, sizeof( conf->ports[pidx] ) );
+	fill_port( &conf->ports[pidx], pfc, pidx );
+	conf->num_ports++;
+	pthread_mutex_unlock( &conf->update_lock );
+
+	return pidx;
+}
+
+/*
+	Remove the port at pidx from the list (parm reload). Ports above it slide down and
+	the hardware port to config index map is rebuilt. The caller must have stopped the
+	port and ensured that no VFs are configured on it.
+*/
+extern void vfd_del_port( sriov_conf_t* conf, int pidx ) {
+	struct sriov_port_s* port;
+	int i;
+
+	pthread_mutex_lock( &conf->update_lock );
+	if( pidx < 0 || pidx >= conf->num_ports ) {
+		pthread_mutex_unlock( &conf->update_lock );
+		return;
+	}
 
-		if( pfc->flags & PFF_PROMISC ) {
-			port->flags |= PF_PROMISC;											// set promisc mode on the PF
+	port = &conf->ports[pidx];
+	for( i = 0; i < MAX_TCS; i++ ) {
+		if( port->tc_config[i] != NULL ) {
+			free( port->tc_config[i]->hr_name );
+			free( port->tc_config[i] );
 		}
-		if( pfc->flags & PFF_LOOP_BACK ) {
-			port->flags |= PF_LOOPBACK;											// enable VM->VM traffic without leaving nic
+	}
+	for( i = 0; i < port->nxstat_pfx; i++ ) {
+		free( port->xstat_pfx[i] );
+	}
+	free( port->xstat_pfx );
+	free( port->vftc_qshares );
+	port_xstats_free( port );
+
+	conf->num_ports--;
+	memmove( port, port + 1, sizeof( *port ) * (conf->num_ports - pidx) );
+
+	for( i = 0; i < MAX_PORTS; i++ ) {
+		port2config_map[i] = -1;
+	}
+	for( i = 0; i < conf->num_ports; i++ ) {
+		port2config_map[conf->ports[i].rte_port_number] = i;
+	}
+	pthread_mutex_unlock( &conf->update_lock );
+}
+
+/*
+	Returns true if the parm file definition differs from what the port is running
+	with. Old is the definition the port was created from and is used for things that
+	are not kept with the port (crc strip); it may be nil.
+*/
+extern int vfd_port_differs( struct sriov_port_s* port, pfdef_t* old, pfdef_t* pfc ) {
+	uint8_t	tc2bwg[MAX_TCS];
+	int		flags = 0;
+	int		i;
+	int		j;
+
+	if( pfc->flags & PFF_PROMISC ) {
+		flags |= PF_PROMISC;
+	}
+	if( pfc->flags & PFF_LOOP_BACK ) {
+		flags |= PF_LOOPBACK;
+	}
+	if( pfc->flags & PFF_VF_OVERSUB ) {
+		flags |= PF_OVERSUB;
+	}
+
+	if( port->mtu != pfc->mtu || port->ntcs != pfc->ntcs || (port->flags & (PF_PROMISC | PF_LOOPBACK | PF_OVERSUB)) != flags ) {
+		return 1;
+	}
+
+	if( old != NULL && old->hw_strip_crc != pfc->hw_strip_crc ) {
+		return 1;
+	}
+
+	for( i = 0; i < MAX_TCS; i++ ) {
+		if( (port->tc_config[i] == NULL) != (pfc->tcs[i] == NULL) ) {
+			return 1;
 		}
-		if( pfc->flags & PFF_VF_OVERSUB ) {
-			port->flags |= PF_OVERSUB;											// enable VM->VM traffic without leaving nic
+		if( pfc->tcs[i] != NULL &&
+			(port->tc_config[i]->flags != pfc->tcs[i]->flags || port->tc_config[i]->max_bw != pfc->tcs[i]->max_bw || port->tc_config[i]->min_bw != pfc->tcs[i]->min_bw) ) {
+			return 1;
 		}
+	}
 
-		port->num_mirrors = 0;
-		port->num_vfs = 0;
-		port->ntcs = pfc->ntcs;					// number of traffic classes to maintain
-		
-		for( j = 0; j < MAX_TCS; j++ ) {
-			port->tc_config[j] = pfc->tcs[j];	// point at the config struct
-			pfc->tcs[j] = NULL;					// unmark it so it won't free	
+	memset( tc2bwg, 0, sizeof( tc2bwg ) );
+	for( i = 0; i < NUM_BWGS; i++ ) {
+		for( j = 0; j < pfc->bw_grps[i].ntcs; j++ ) {
+			tc2bwg[pfc->bw_grps[i].tcs[j]] = i;
 		}
+	}
+	if( memcmp( tc2bwg, port->tc2bwg, sizeof( tc2bwg ) ) != 0 ) {
+		return 1;
+	}
 
-		memset( port->tc2bwg, 0, sizeof( port->tc2bwg ) );		// by default a tc is in group 0
-		for( j = 0; j < NUM_BWGS; j++ ) {					// set the map which defines the bandwidth group each TC belongs to
-			bw_grp_t*	bwg;
-			
-			bwg = &pfc->bw_grps[j];
-			for( k = 0; k < bwg->ntcs; k++ ) {
-				port->tc2bwg[bwg->tcs[k]] = j;	// map the TC to this bw group
-			}
+	if( port->nxstat_pfx != pfc->nxstats ) {
+		return 1;
+	}
+	for( i = 0; i < pfc->nxstats; i++ ) {
+		if( strcmp( port->xstat_pfx[i], pfc->xstats[i] ) != 0 ) {
+			return 1;
 		}
+	}
 
-		if( bleat_will_it( 2 ) ) {
-			bleat_printf( 2, "pf %d configured: %s %s mtu=%d flags-0x02x ntcs==%d", i, port->name, port->pciid, port->mtu, port->flags, port->ntcs );
-			for( j = 0; j < MAX_TCS; j++ ) {
-				if( port->tc_config[j] != NULL ) {
-					bleat_printf( 2, "pf %d tc[%d]: flags=0x%02x min=%d bwg=%d", i, j, port->tc_config[j]->flags, port->tc_config[j]->min_bw,  port->tc2bwg[j] );
-				}
-			}
+	return 0;
+}
+
+/*
+	Find the mirror block for the vf on the port in conf (suss_mirror() works only
+	on the running config).
+*/
+static struct mirror_s* conf_mirror( struct sriov_port_s* port, int vfid ) {
+	int i;
+
+	for( i = 0; i < port->num_vfs; i++ ) {
+		if( port->vfs[i].num == vfid ) {
+			return &port->mirrors[i];
 		}
 	}
 
-	conf->num_ports = pidx;
-	rte_spinlock_unlock( &conf->update_lock );
+	return NULL;
 }
 
 /*
@@ -455,7 +640,7 @@ static char* gen_mirror_stats( struct sriov_conf_c* conf, int limit ) {
 		strcat( buf, wbuf );
 
 		for( v = 0; v < MAX_VFS; v++ ) {
-			if( (mirror = suss_mirror( conf->ports[p].rte_port_number, v )) != NULL ) {
+			if( (mirror = conf_mirror( &conf->ports[p], v )) != NULL ) {
 				if( mirror->target < MAX_VFS ) {		// mirror defined
 					switch( mirror->dir ) {
 						case MIRROR_IN: dir = "in"; break;
@@ -614,6 +799,156 @@ static int vfd_update_mirror( sriov_conf_t* conf, const_str req, char** reason )
 }
 
 
+/*
+	Vet a vf config against the port that it will be added to. Self is the index
+	of the VF the config is to replace (update) or -1 (add); the vlans, rate and
+	queue shares of the VF being replaced are not counted against the config, and
+	MACs that it already has are allowed. Returns 1 if the config can be applied
+	and 0, with the reason in mbuf, if not.
+*/
+static int vet_vfc( struct sriov_port_s* port, vf_config_t* vfc, int self, char* mbuf, int mlen ) {
+	struct vf_s* vf = NULL;				// the vf being replaced
+	int tot_vlans = 0;					// must count vlans and macs to ensure limit not busted
+	float tot_min_rate = 0;
+	int	i;
+	int j;
+	int m;
+
+	for( i = 0; i < port->num_vfs; i++ ) {
+		if( port->vfs[i].num >= 0 && i != self ) {
+			tot_vlans += port->vfs[i].num_vlans;
+			tot_min_rate += port->vfs[i].min_rate;
+		}
+	}
+
+	if( vfc->vfid >= port->nvfs_config ) {		// greater than the number configured
+		snprintf( mbuf, mlen, "vf %d is out of range; only %d VFs are configured on port %s", vfc->vfid, port->nvfs_config, port->pciid );
+		return 0;
+	}
+
+	if( vfc->min_rate + tot_min_rate > 1 ) {	// Rate oversubscription
+		snprintf( mbuf, mlen, "total guaranteed rate exceeds link speed" );
+		return 0;
+	}
+
+	if( vfc->nvlans > MAX_VF_VLANS ) {				// more than allowed for a single VF
+		snprintf( mbuf, mlen, "number of vlans supplied (%d) exceeds the maximum (%d)", vfc->nvlans, MAX_VF_VLANS );
+		return 0;
+	}
+
+	if( vfc->nvlans + tot_vlans > MAX_PF_VLANS ) { 			// would bust the total across the whole PF
+		snprintf( mbuf, mlen, "number of vlans supplied (%d) cauess total for PF to exceed the maximum (%d)", vfc->nvlans, MAX_PF_VLANS );
+		return 0;
+	}
+
+	if( vfc->nvlans <= 0 ) {							// must have at least one VLAN defined or bad things happen on the NIC
+		snprintf( mbuf, mlen, "vlan id list is empty; it must contain at least one id" );
+		return 0;
+	}
+
+														// check vlan and mac arrays for duplicate values and bad things
+	for( i = 0; i < vfc->nvlans; i++ ) {
+		if( vfc->vlans[i] < 1 || vfc->vlans[i] > 4095 ) {			// range check
+			snprintf( mbuf, mlen, "invalid vlan id: %d", vfc->vlans[i] );
+			return 0;
+		}
+
+		for( j = i+1; j < vfc->nvlans; j++ ) {
+			if( vfc->vlans[i] == vfc->vlans[j] ) {					// dup check
+				snprintf( mbuf, mlen, "duplicate vlan in list: %d", vfc->vlans[i] );
+				return 0;
+			}
+		}
+	}
+
+	if( vfc->nmacs > MAX_VF_MACS ) {				// too many mac addresses specified for this (can_add cannot check this until VF/PF is actually added to config)
+		snprintf( mbuf, mlen, "too many mac addresses given: %d > limit of %d", vfc->nmacs, MAX_VF_MACS );
+		return 0;
+	}
+
+	if( self >= 0 ) {
+		vf = &port->vfs[self];
+	}
+	for( i = 0; i < vfc->nmacs; i++ ) {				// if a mac is duplicated it will be weeded out when we add
+		if( vf != NULL && vfc->macs[i] != NULL ) {	// already assigned to the vf being replaced is fine
+			for( m = 1; m < vf->first_mac + vf->num_macs && strcmp( vf->macs[m], vfc->macs[i] ) != 0; m++ );
+			if( m < vf->first_mac + vf->num_macs ) {
+				continue;
+			}
+		}
+
+		if( ! can_add_mac( port->rte_port_number, -1, vfc->macs[i] ) ) {			// must pass -1 for vfid as it's not in the config yet
+			snprintf( mbuf, mlen, "mac cannot be added to this port (invalid, inuse, or max exceeded for VF): mac=(%s)", vfc->macs[i] ? vfc->macs[i] : "" );
+			return 0;
+		}
+		bleat_printf( 2, "mac address can be added to config: [%d] (%s)",  i, vfc->macs[i] );
+	}
+
+	if( ! (port->flags & PF_OVERSUB) ) {						// if in strict mode, ensure TC amounts can be added to current settings without busting 100% cap
+		if( check_qs_oversub( port, vfc->qshare, self ) != 0 ) {
+			snprintf( mbuf, mlen, "TC percentages cause one or more total allocation to exceed 100%%" );
+			return 0;
+		}
+	}
+
+	if( check_qs_spread( port, vfc->qshare, self ) != 0 ) {				// ensure that the min-max spread on any TC won't be taken out of bounds
+		snprintf( mbuf, mlen, "min-max spread for one or more TCs would exceed 10x" );
+		return 0;
+	}
+
+	if( vfc->start_cb != NULL && strchr( vfc->start_cb, ';' ) != NULL ) {
+		snprintf( mbuf, mlen, "start_cb command contains invalid character: ;" );
+		return 0;
+	}
+	if( vfc->stop_cb != NULL && strchr( vfc->stop_cb, ';' ) != NULL ) {
+		snprintf( mbuf, mlen, "stop_cb command contains invalid character: ;" );
+		return 0;
+	}
+
+	if( vfc->mirror_dir != MIRROR_OFF ) {
+		if( vfc->mirror_target == vfc->vfid ||  vfc->mirror_target < 0 || vfc->mirror_target > port->nvfs_config ) {
+			snprintf( mbuf, mlen, "mirror target is out of range or is the same as this VF (%d): target=%d range=0-%d", (int) vfc->vfid, vfc->mirror_target, port->nvfs_config );
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+	Map the link_status string from a vf config to the vf link setting. On, off or
+	auto are allowed; auto is assumed if unrecognised.
+*/
+static int link_mode( const_str status ) {
+	if( status != NULL ) {
+		if( !stricmp( status, "on" ) ) {
+			return 1;
+		}
+		if( !stricmp( status, "off" ) ) {
+			return -1;
+		}
+		if( stricmp( status, "auto" ) ) {
+			bleat_printf( 1, "link_status not recognised in config: %s; defaulting to auto", status );
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+	Return a pointer to the basename portion of a file name.
+*/
+static const_str base_name( const_str fname ) {
+	const_str base;
+
+	if( (base = strrchr( fname, '/' )) != NULL ) {
+		return base + 1;
+	}
+
+	return fname;
+}
+
 /*
 	Add one of the virtualisation manager generated configuration files to a global
 	config struct passed in.  A small amount of error checking (vf id dup, etc) is
@@ -633,17 +968,8 @@ static int vfd_update_mirror( sriov_conf_t* conf, const_str req, char** reason )
 */
 extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 	vf_config_t* vfc;					// raw vf config file contents	
-	int	i;
-	int j;
-	int vidx;							// index into the vf array
-	int	hole = -1;						// first hole in the list;
-	struct sriov_port_s* port = NULL;	// reference to a single port in the config
-	struct vf_s*	vf;					// point at the vf we need to fill in
 	char mbuf[BUF_1K];					// message buffer if we fail
-	int tot_vlans = 0;					// must count vlans and macs to ensure limit not busted
-	//int tot_macs = 0;
-	float tot_min_rate = 0;
-	
+
 
 	if( conf == NULL || fname == NULL ) {
 		bleat_printf( 0, "vfd_add_vf called with nil config or filename pointer" );
@@ -663,6 +989,33 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		return 0;
 	}
 
+	return vfd_add_vfc( conf, fname, vfc, reason );
+}
+
+/*
+	Add a vf config (vfd_add_vfc()). If prepare is set the VF is marked prepared
+	(link held down until committed) in the same update_lock section which marks
+	it added; once the lock is released a nic update may be driven from another
+	thread (mailbox, refresh) and must never see the VF live.
+*/
+static int add_vfc( sriov_conf_t* conf, char* fname, vf_config_t* vfc, char** reason, int prepare ) {
+	int	i;
+	int vidx;							// index into the vf array
+	int	hole = -1;						// first hole in the list;
+	struct sriov_port_s* port = NULL;	// reference to a single port in the config
+	struct vf_s*	vf;					// point at the vf we need to fill in
+	char mbuf[BUF_1K];					// message buffer if we fail
+
+	if( conf == NULL || fname == NULL || vfc == NULL ) {
+		bleat_printf( 0, "vfd_add_vfc called with nil config, filename or vf config pointer" );
+		if( reason ) {
+			snprintf( mbuf, sizeof( mbuf), "internal mishap: config ptr was nil" );
+			*reason = strdup( mbuf );
+		}
+		free_config( vfc );
+		return 0;
+	}
+
 	bleat_printf( 2, "add: config data: name: %s", vfc->name );
 	bleat_printf( 2, "add: config data: pciid: %s", vfc->pciid );
 	bleat_printf( 2, "add: config data: vfid: %d", vfc->vfid );
@@ -709,10 +1062,6 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 				free_config( vfc );
 				return 0;
 			}
-
-			tot_vlans += port->vfs[i].num_vlans;
-			//tot_macs += port->vfs[i].num_macs;
-			tot_min_rate += port->vfs[i].min_rate;
 		}
 	}
 
@@ -733,186 +1082,30 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		return 0;
 	}
 
-	if( vfc->vfid >= port->nvfs_config ) {		// greater than the number configured
-		snprintf( mbuf, sizeof( mbuf ), "vf %d is out of range; only %d VFs are configured on port %s", vfc->vfid, port->nvfs_config, port->pciid );
+	if( ! vet_vfc( port, vfc, -1, mbuf, sizeof( mbuf ) ) ) {
 		bleat_printf( 1, "vf not added: %s", mbuf );
 		if( reason ) {
 			*reason = strdup( mbuf );
 		}
-
 		free_config( vfc );
 		return 0;
 	}
 
-	if( vfc->min_rate + tot_min_rate > 1 ) {	// Rate oversubscription
-		snprintf( mbuf, sizeof( mbuf ), "total guaranteed rate exceeds link speed" );
-		bleat_printf( 1, "vf not added: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
-		}
-		free_config( vfc );
-		return 0;
+	if( vfc->name == NULL ) {
+		vfc->name = strdup( "missing" );
 	}
 
-	if( vfc->nvlans > MAX_VF_VLANS ) {				// more than allowed for a single VF
-		snprintf( mbuf, sizeof( mbuf ), "number of vlans supplied (%d) exceeds the maximum (%d)", vfc->nvlans, MAX_VF_VLANS );
-		bleat_printf( 1, "vf not added: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
-		}
-		free_config( vfc );
-		return 0;
-	}
+	// -------------------------------------------------------------------------------------------------------------
+	// CAUTION: if we fail because of a parm error it MUST happen before here!
 
-	if( vfc->nvlans + tot_vlans > MAX_PF_VLANS ) { 			// would bust the total across the whole PF
-		snprintf( mbuf, sizeof( mbuf ), "number of vlans supplied (%d) cauess total for PF to exceed the maximum (%d)", vfc->nvlans, MAX_PF_VLANS );
-		bleat_printf( 1, "vf not added: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
-		}
-		free_config( vfc );
-		return 0;
+	bleat_printf( 2, "vf configuration vet complete for %s", vfc->name );
+
+	// All validation was successful, safe to update the config data
+	if( vidx == port->num_vfs ) {		// inserting at end, bump the num we have used
+		port->num_vfs++;
 	}
-
-	if( vfc->nvlans <= 0 ) {							// must have at least one VLAN defined or bad things happen on the NIC
-		snprintf( mbuf, sizeof( mbuf ), "vlan id list is empty; it must contain at least one id" );
-		bleat_printf( 1, "vf not added: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
-		}
-		free_config( vfc );
-		return 0;
-	}
-
-														// check vlan and mac arrays for duplicate values and bad things
-	if( vfc->nvlans == 1 ) {							// no need for a dup check, just a range check
-		if( vfc->vlans[0] < 1 || vfc->vlans[0] > 4095 ) {
-			snprintf( mbuf, sizeof( mbuf ), "invalid vlan id: %d", vfc->vlans[0] );
-			bleat_printf( 1, "vf not added: %s", mbuf );
-			if( reason ) {
-				*reason = strdup( mbuf );
-			}
-			free_config( vfc );
-			return 0;
-		}
-	} else {
-		for( i = 0; i < vfc->nvlans-1; i++ ) {
-			if( vfc->vlans[i] < 1 || vfc->vlans[i] > 4095 ) {			// range check
-				snprintf( mbuf, sizeof( mbuf ), "invalid vlan id: %d", vfc->vlans[i] );
-				bleat_printf( 1, "vf not added: %s", mbuf );
-				if( reason ) {
-					*reason = strdup( mbuf );
-				}
-				free_config( vfc );
-				return 0;
-			}
-	
-			for( j = i+1; j < vfc->nvlans; j++ ) {
-				if( vfc->vlans[i] == vfc->vlans[j] ) {					// dup check
-					snprintf( mbuf, sizeof( mbuf ), "duplicate vlan in list: %d", vfc->vlans[i] );
-					bleat_printf( 1, "vf not added: %s", mbuf );
-					if( reason ) {
-						*reason = strdup( mbuf );
-					}
-					free_config( vfc );
-					return 0;
-				}
-			}
-		}
-	}
-
-	if( vfc->nmacs > MAX_VF_MACS ) {				// too many mac addresses specified for this (can_add cannot check this until VF/PF is actually added to config)
-		snprintf( mbuf, sizeof( mbuf ), "too many mac addresses given: %d > limit of %d", vfc->nmacs, MAX_VF_MACS );
-		bleat_printf( 0, "vf not added: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
-		}
-		free_config( vfc );
-		return 0;
-	}
-
-	for( i = 0; i < vfc->nmacs; i++ ) {				// if a mac is duplicated it will be weeded out when we add
-		if( ! can_add_mac( port->rte_port_number, -1, vfc->macs[i] ) ) {			// must pass -1 for vfid as it's not in the config yet
-			snprintf( mbuf, sizeof( mbuf ), "mac cannot be added to this port (invalid, inuse, or max exceeded for VF): mac=(%s)", vfc->macs[i] ? vfc->macs[i] : "" );
-			bleat_printf( 0, "vf not added: %s", mbuf );
-			if( reason ) {
-				*reason = strdup( mbuf );
-			}
-			free_config( vfc );
-			return 0;
-		}
-		bleat_printf( 2, "mac address can be added to config: [%d] (%s)",  i, vfc->macs[i] );
-	}
-
-	if( ! (port->flags & PF_OVERSUB) ) {						// if in strict mode, ensure TC amounts can be added to current settings without busting 100% cap
-		if( check_qs_oversub( port, vfc->qshare ) != 0 ) {
-			snprintf( mbuf, sizeof( mbuf ), "TC percentages cause one or more total allocation to exceed 100%%" );
-			bleat_printf( 1, "vf not added: %s", mbuf );
-			if( reason ) {
-				*reason = strdup( mbuf );
-			}
-			free_config( vfc );
-			return 0;
-		}
-	}
-
-	if( check_qs_spread( port, vfc->qshare ) != 0 ) {				// ensure that the min-max spread on any TC won't be taken out of bounds
-		snprintf( mbuf, sizeof( mbuf ), "min-max spread for one or more TCs would exceed 10x" );
-		bleat_printf( 1, "vf not added: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
-		}
-		free_config( vfc );
-		return 0;
-	}
-
-	if( vfc->start_cb != NULL && strchr( vfc->start_cb, ';' ) != NULL ) {
-		snprintf( mbuf, sizeof( mbuf ), "start_cb command contains invalid character: ;" );
-		bleat_printf( 1, "vf not added: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
-		}
-		free_config( vfc );
-		return 0;
-	}
-	if( vfc->stop_cb != NULL && strchr( vfc->stop_cb, ';' ) != NULL ) {
-		snprintf( mbuf, sizeof( mbuf ), "stop_cb command contains invalid character: ;" );
-		bleat_printf( 1, "vf not added: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
-		}
-		free_config( vfc );
-		return 0;
-	}
-
-	if( vfc->mirror_dir != MIRROR_OFF ) {
-		if( vfc->mirror_target == vfc->vfid ||  vfc->mirror_target < 0 || vfc->mirror_target > port->nvfs_config ) {
-			snprintf( mbuf, sizeof( mbuf ), "mirror target is out of range or is the same as this VF (%d): target=%d range=0-%d", (int) vfc->vfid, vfc->mirror_target, port->nvfs_config );
-			if( reason ) {
-				*reason = strdup( mbuf );
-			}
-			bleat_printf( 1, "vf not added: %s", mbuf );
-			free_config( vfc );
-			return 0;
-		}
-
-	}
-
-	if( vfc->name == NULL ) {
-		vfc->name = strdup( "missing" );
-	}
-
-	// -------------------------------------------------------------------------------------------------------------
-	// CAUTION: if we fail because of a parm error it MUST happen before here!
-
-	bleat_printf( 2, "vf configuration vet complete for %s", vfc->name );
-
-	// All validation was successful, safe to update the config data
-	if( vidx == port->num_vfs ) {		// inserting at end, bump the num we have used
-		port->num_vfs++;
-	}
-	
-	rte_spinlock_lock( &conf->update_lock );
+	
+	pthread_mutex_lock( &conf->update_lock );
 
 	vf = &port->vfs[vidx];						// copy from config data doing any translation needed
 	memset( vf, 0, sizeof( *vf ) );				// assume zeroing everything is good
@@ -920,6 +1113,9 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 	vf->owner = vfc->owner;
 	vf->num = vfc->vfid;
 	port->vfs[vidx].last_updated = ADDED;		// signal main code to configure the buggger
+	if( prepare ) {
+		vf->prep_name = strdup( base_name( fname ) );
+	}
 	vf->strip_stag = vfc->strip_stag;
 	vf->strip_ctag = vfc->strip_ctag;
 	vf->insert_stag = vfc->strip_stag;			// both are pulled from same config parm
@@ -951,17 +1147,7 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		vf->stop_cb = strdup( vfc->stop_cb );
 	}
 
-	vf->link = 0;							// default if parm missing or mis-set (not fatal)
-											// on, off or auto are allowed in config file, default to auto if unrecognised
-    if (!stricmp(vfc->link_status, "on")) {
-        vf->link = 1;
-    } else if (!stricmp(vfc->link_status, "off")) {
-        vf->link = -1;
-    } else if (!stricmp(vfc->link_status, "auto")) {
-        vf->link = 0;
-    } else {
-        bleat_printf( 1, "link_status not recognised in config: %s; defaulting to auto", vfc->link_status );
-    }
+	vf->link = link_mode( vfc->link_status );		// auto if parm missing or mis-set (not fatal)
 	
 	for( i = 0; i < vfc->nvlans; i++ ) {
 		vf->vlans[i] = vfc->vlans[i];
@@ -980,7 +1166,7 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 		vf->qshares[i] = vfc->qshare[i];
 	}
 
-	rte_spinlock_unlock( &conf->update_lock );		// updates finished, safe to release now
+	pthread_mutex_unlock( &conf->update_lock );		// updates finished, safe to release now
 
 	if( reason ) {
 		*reason = NULL;								// no reason passed back when successful
@@ -992,148 +1178,133 @@ extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason ) {
 }
 
 /*
-	Get a list of all config files and add each one to the current config.
-	If one fails, we will generate an error and ignore it. We take the config dir name
-	supplied in the main VFd configuration and add "_live" to build the directory 
-	of live vf configuration files.  This prevents the virtualisation manager from 
-	dropping a few files while we're down which have conflicts/duplications that
-	would cause a non-deterministic start state.
+	Add a vf config which has already been read from fname (the file name is
+	needed to save with the VF). This is the second half of vfd_add_vf() and
+	allows the read/parse to be done elsewhere (e.g. in parallel at start up).
+	The config is freed before return regardless of the outcome. Returns 1 on
+	success and 0 on failure; reason is handled as for vfd_add_vf().
 */
-extern void vfd_add_all_vfs(  parms_t* parms, sriov_conf_t* conf ) {
-	char** flist; 					// list of files to pull in
-	int		llen;					// list length
-	int		i;
-	char	wbuf[2048];				// we'll bang on our 'live' designation to the config dir string in this
-
-	if( parms == NULL || conf == NULL ) {
-		bleat_printf( 0, "internal mishap: NULL conf or parms pointer passed to add_all_vfs" );
-		return;
-	}
-
-	if( snprintf( wbuf, sizeof( wbuf ), "%s_live", parms->config_dir ) >= (int) sizeof( wbuf ) ) {		// create something like /var/lib/vfd/config_live
-		bleat_printf( 0, "WRN: cannot construct live directory; work buffer not large enough (%d)", (int) sizeof( wbuf ) );
-		return;
-	}
-
-	flist = list_files( wbuf, "json", 1, &llen );
-	if( flist == NULL || llen <= 0 ) {
-		bleat_printf( 1, "zero vf configuration files (*.json) found in %s_live; nothing restored", parms->config_dir );
-		free_list( flist, 0 );											// still must free core structure
-		return;
-	}
-
-	bleat_printf( 1, "adding %d existing vf configuration files to the mix", llen );
-	
-	for( i = 0; i < llen; i++ ) {
-		bleat_printf( 2, "parsing %s", flist[i] );
-		if( ! vfd_add_vf( conf, flist[i], NULL ) ) {
-			bleat_printf( 0, "add_all_vfs: could not add %s (moved off to %s)", flist[i], parms->config_dir );
-			delete_vf_config( flist[i], parms->config_dir );
-		}
-	}
-	
-	free_list( flist, llen );
+extern int vfd_add_vfc( sriov_conf_t* conf, char* fname, vf_config_t* vfc, char** reason ) {
+	return add_vfc( conf, fname, vfc, reason, 0 );
 }
 
 /*
-	Delete a VF from a port.  We expect the name of a file which we can read the
-	parms from and suss out the pciid and the vfid.  Those are used to find the
-	info in the global config and render it useless. The delete will be rejected
-	if the name in the parm file doesn't match the name we saved when adding the
-	configuration.  This is a false sense of security, but was a user request
-	so it was added.  The first thing we attempt to do is to remove or rename the 
-	config file.  If we can't do that we don't do anything else because we'd give 
-	the false sense that it was deleted but on restart we'd recreate it, or worse 
-	have a conflict with something that was added. 
-
-	Regardless of the outcome after reading the configuration file, if we can open 
-	the file we will delete it.
+	Update a VF in place from a config file (update request). The file is read and
+	the changes applied with vfd_update_vfc(). Returns 1 on success and 0 on failure;
+	reason is handled as for vfd_add_vf().
 */
-extern int vfd_del_vf( parms_t* parms, sriov_conf_t* conf, char* fname, char** reason ) {
-	vf_config_t* vfc;					// raw vf config file contents	
-	int	i;
-	int vidx;							// index into the vf array
-	struct sriov_port_s* port = NULL;	// reference to a single port in the config
+extern int vfd_update_vf( sriov_conf_t* conf, char* fname, char** reason ) {
+	vf_config_t* vfc;					// raw vf config file contents
 	char mbuf[BUF_1K];					// message buffer if we fail
-	unsigned int mblen = BUF_1K - 1;	// length of usable spaece in work buffer
-	char*	target_dir = NULL;			// target directory if keep is set
-
-	mbuf[mblen-1] = 0;					// avoid needing a check for each snprintf	
 
-	
-	if( parms->delete_keep ) {											// need to keep the old by renaming it with a trailing -
-		target_dir = parms->config_dir;									// we'll move files back to this dir
-	}
-	
 	if( conf == NULL || fname == NULL ) {
-		bleat_printf( 0, "vfd_del_vf called with nil config or filename pointer" );
+		bleat_printf( 0, "vfd_update_vf called with nil config or filename pointer" );
 		if( reason ) {
-			snprintf( mbuf, mblen, "internal mishap: config ptr was nil" );
+			snprintf( mbuf, sizeof( mbuf), "internal mishap: config ptr was nil" );
 			*reason = strdup( mbuf );
 		}
 		return 0;
 	}
 
 	if( (vfc = read_config( fname )) == NULL ) {
-		snprintf( mbuf, mblen, "unable to read config file: %s: %s", fname, errno > 0 ? strerror( errno ) : "unknown sub-reason" );
-		bleat_printf( 1, "vfd_del_vf failed: %s", mbuf );
+		snprintf( mbuf, sizeof( mbuf ), "unable to read config file: %s: %s", fname, errno > 0 ? strerror( errno ) : "unknown sub-reason" );
+		bleat_printf( 1, "vfd_update_vf failed: %s", mbuf );
 		if( reason ) {
 			*reason = strdup( mbuf );
 		}
 		return 0;
 	}
 
-	if( vfc->pciid == NULL || vfc->vfid < 0 ) {						// file opened and parsed, but information we need was missing
-		snprintf( mbuf, mblen, "invalid configuration contents in file: %s", fname );
-		bleat_printf( 1, "no config change related to del request: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
-		}
-		free_config( vfc );
-		delete_vf_config( fname, target_dir );
-		return 0;
-	}
+	return vfd_update_vfc( conf, fname, vfc, reason );
+}
 
-	for( i = 0; i < conf->num_ports; i++ ) {						// find the port that this vf is attached to
-		if( strcmp( conf->ports[i].pciid, vfc->pciid ) == 0 ) {	// match
-			port = &conf->ports[i];
-			break;
+/*
+	Return true if v is in the list.
+*/
+static int has_vlan( int* vlans, int nvlans, int v ) {
+	int i;
+
+	for( i = 0; i < nvlans; i++ ) {
+		if( vlans[i] == v ) {
+			return 1;
 		}
 	}
 
-	if( port == NULL ) {
-		snprintf( mbuf, mblen, "%s: could not find port %s in the config", vfc->name, vfc->pciid );
-		bleat_printf( 1, "no config change related to del request: %s", mbuf );
+	return 0;
+}
+
+/*
+	Apply a config which has already been read to the VF it describes, which must
+	already be configured, rather than deleting and adding the VF. The config is
+	vetted as for an add (the VF's current settings don't count against it) and
+	then compared with the VF; only what differs is changed. The changes are hung
+	off the VF (vf->delta) and the VF is marked UPDATED so that update_nic pushes
+	just those to the NIC: adding a VLAN to a trunk leaves the other VLANs, the
+	MACs, rate limits and link alone and the guest sees no reset.
+
+	The pciid, vfid and name in the config must match the live VF; moving a VF is
+	a delete and add. The config is freed before return regardless of the outcome.
+	Returns 1 on success (including when nothing changed) and 0 on failure; reason
+	is handled as for vfd_add_vf().
+*/
+extern int vfd_update_vfc( sriov_conf_t* conf, char* fname, vf_config_t* vfc, char** reason ) {
+	struct sriov_port_s* port = NULL;
+	struct vf_s* vf = NULL;
+	struct mirror_s* mirror;
+	vf_delta_t*	delta = NULL;
+	char mbuf[BUF_1K];					// message buffer if we fail
+	int	vidx = -1;
+	int	nm;								// number of configured macs on the vf
+	char old_def[18];					// default mac before the change ("" if none or the guest pushed one)
+	int	link;
+	int	i;
+
+	if( conf == NULL || fname == NULL || vfc == NULL ) {
+		bleat_printf( 0, "vfd_update_vfc called with nil config, filename or vf config pointer" );
 		if( reason ) {
+			snprintf( mbuf, sizeof( mbuf), "internal mishap: config ptr was nil" );
 			*reason = strdup( mbuf );
 		}
 		free_config( vfc );
-		delete_vf_config( fname, target_dir );
 		return 0;
 	}
 
-	vidx = -1;
-	for( i = 0; i < port->num_vfs; i++ ) {				// suss out the id that is listed
-		if( port->vfs[i].num == vfc->vfid ) {			// this is it.
-			vidx = i;
-			break;
+	*mbuf = 0;
+	if( vfc->pciid == NULL || vfc->vfid < 0 ) {
+		snprintf( mbuf, sizeof( mbuf ), "unable to read or parse config file: %s", fname );
+	} else {
+		for( i = 0; i < conf->num_ports && port == NULL; i++ ) {		// find the port and the vf on it
+			if( strcmp( conf->ports[i].pciid, vfc->pciid ) == 0 ) {
+				port = &conf->ports[i];
+			}
+		}
+		for( i = 0; port != NULL && i < port->num_vfs && vf == NULL; i++ ) {
+			if( port->vfs[i].num == vfc->vfid ) {
+				vidx = i;
+				vf = &port->vfs[i];
+			}
 		}
 	}
 
-	if( vidx < 0 ) {									//  vf not configured on this port
-		snprintf( mbuf, mblen, "%s: vf %d not configured on port %s", vfc->name, vfc->vfid, vfc->pciid );
-		bleat_printf( 1, "no config change related to del request: %s", mbuf );
-		if( reason ) {
-			*reason = strdup( mbuf );
+	if( ! *mbuf ) {
+		if( port == NULL ) {
+			snprintf( mbuf, sizeof( mbuf ), "%s: could not find port %s in the config", vfc->name, vfc->pciid );
+		} else if( vf == NULL ) {
+			snprintf( mbuf, sizeof( mbuf ), "vf %d is not configured on port %s; add it first", vfc->vfid, vfc->pciid );
+		} else if( vf->last_updated != UNCHANGED ) {
+			snprintf( mbuf, sizeof( mbuf ), "vf %d on port %s has a change pending; try again", vfc->vfid, vfc->pciid );
+		} else if( vfc->name == NULL || vf->config_name == NULL || strcmp( vfc->name, vf->config_name ) != 0 ) {	// same check as delete
+			snprintf( mbuf, sizeof( mbuf ), "name in config did not match name given when VF was added: expected %s, found %s",
+				vf->config_name ? vf->config_name : "", vfc->name ? vfc->name : "" );
+		} else if( vet_vfc( port, vfc, vidx, mbuf, sizeof( mbuf ) ) ) {
+			if( (delta = (vf_delta_t *) calloc( 1, sizeof( *delta ) )) == NULL ) {
+				snprintf( mbuf, sizeof( mbuf ), "memory allocation error" );
+			}
 		}
-		free_config( vfc );
-		delete_vf_config( fname, target_dir );
-		return 0;
 	}
 
-	if( strcmp( vfc->name, port->vfs[vidx].config_name ) != 0 ) { 				// confirm name in current config matches what we had when we added it
-		snprintf( mbuf, mblen, "%s: name in config did not match name given when VF was added: expected %s, found %s", vfc->name,  port->vfs[vidx].config_name, vfc->name );
-		bleat_printf( 1, "no config change related to del request: %s", mbuf );
+	if( *mbuf ) {
+		bleat_printf( 1, "vf not updated: %s", mbuf );
 		if( reason ) {
 			*reason = strdup( mbuf );
 		}
@@ -1141,313 +1312,1861 @@ extern int vfd_del_vf( parms_t* parms, sriov_conf_t* conf, char* fname, char** r
 		return 0;
 	}
 
-	delete_vf_config( fname, target_dir );
+	// -------------------------------------------------------------------------------------------------------------
+	// CAUTION: if we fail because of a parm error it MUST happen before here!
 
-	bleat_printf( 2, "del: config data: name: %s", vfc->name );
-	bleat_printf( 2, "del: config data: pciid: %s", vfc->pciid );
-	bleat_printf( 2, "del: config data: vfid: %d", vfc->vfid );
+	pthread_mutex_lock( &conf->update_lock );
 
-	port->vfs[vidx].last_updated = DELETED;			// signal main code to nuke the puppy (vfid stays set so we don't see it as a hole until it's gone)
-	
-	if( reason ) {
-		*reason = NULL;
+	for( i = 0; i < vf->num_vlans; i++ ) {							// vlans which are going away
+		if( ! has_vlan( vfc->vlans, vfc->nvlans, vf->vlans[i] ) ) {
+			delta->vlans_del[delta->nvlans_del++] = vf->vlans[i];
+		}
+	}
+	for( i = 0; i < vfc->nvlans; i++ ) {								// and those that are new
+		if( ! has_vlan( vf->vlans, vf->num_vlans, vfc->vlans[i] ) ) {
+			delta->vlans_add[delta->nvlans_add++] = vfc->vlans[i];
+		}
+	}
+	if( delta->nvlans_add + delta->nvlans_del > 0 ) {
+		delta->what |= VD_VLANS;
 	}
-	bleat_printf( 2, "VF internal config was deleted: %s %s id=%d", vfc->name, vfc->pciid, vfc->vfid );
-	free_config( vfc );
-	return 1;
-}
 
-// ---- request/response functions -----------------------------------------------------------------------------
+	if( vf->strip_stag != vfc->strip_stag || vf->strip_ctag != vfc->strip_ctag ) {
+		delta->what |= VD_INS_STRIP;
+	} else {
+		if( (vf->strip_stag || vf->strip_ctag) &&								// insert id depends on the list when stripping
+			((vf->num_vlans == 1) != (vfc->nvlans == 1) || vf->vlans[0] != vfc->vlans[0]) ) {
+			delta->what |= VD_INS_STRIP;
+		}
+	}
+
+	for( i = 0; i < vfc->nvlans; i++ ) {
+		vf->vlans[i] = vfc->vlans[i];
+	}
+	vf->num_vlans = vfc->nvlans;
+	vf->strip_stag = vf->insert_stag = vfc->strip_stag;				// both are pulled from same config parm
+	vf->strip_ctag = vf->insert_ctag = vfc->strip_ctag;
+
+	*old_def = 0;
+	if( vf->first_mac > 0 && vf->num_macs > 0 ) {					// guest hasn't pushed one, so first configured is the default
+		strcpy( old_def, vf->macs[1] );
+	}
+
+	nm = vf->first_mac + vf->num_macs - 1;							// configured macs are [1..nm]
+	for( i = nm; i >= 1; i-- ) {										// drop those not in the new list (backwards as del closes the hole)
+		int j;
+
+		for( j = 0; j < vfc->nmacs && (vfc->macs[j] == NULL || strcmp( vfc->macs[j], vf->macs[i] ) != 0); j++ );
+		if( j >= vfc->nmacs ) {
+			strcpy( delta->macs_del[delta->nmacs_del], vf->macs[i] );
+			if( del_mac( port->rte_port_number, vf->num, delta->macs_del[delta->nmacs_del] ) ) {
+				delta->nmacs_del++;
+			}
+		}
+	}
+	for( i = 0; i < vfc->nmacs; i++ ) {
+		int	before;
+
+		before = vf->num_macs;
+		if( add_mac( port->rte_port_number, vf->num, vfc->macs[i] ) && vf->num_macs > before ) {		// vetted, so this should not fail
+			strcpy( delta->macs_add[delta->nmacs_add++], vfc->macs[i] );
+		}
+	}
+	if( vf->first_mac > 0 && vf->num_macs > 0 && strcmp( old_def, vf->macs[1] ) != 0 ) {		// first configured mac is the default and it changed
+		delta->what |= VD_DEFMAC;
+	}
+	if( delta->nmacs_add + delta->nmacs_del > 0 ) {
+		delta->what |= VD_MACS;
+	}
+
+	if( vf->allow_bcast != vfc->allow_bcast || vf->allow_mcast != vfc->allow_mcast || vf->allow_un_ucast != vfc->allow_un_ucast ) {
+		delta->what |= VD_RXMODE;
+		vf->allow_bcast = vfc->allow_bcast;
+		vf->allow_mcast = vfc->allow_mcast;
+		vf->allow_un_ucast = vfc->allow_un_ucast;
+	}
+
+	if( vf->rate != vfc->rate ) {
+		delta->what |= VD_RATE;
+		vf->rate = vfc->rate;
+	}
+	if( vf->min_rate != vfc->min_rate ) {
+		delta->what |= VD_MIN_RATE;
+		vf->min_rate = vfc->min_rate;
+	}
+
+	if( (link = link_mode( vfc->link_status )) != vf->link ) {
+		delta->what |= VD_LINK;
+		vf->link = link;
+	}
+
+	if( memcmp( vf->qshares, vfc->qshare, sizeof( vf->qshares ) ) != 0 ) {
+		delta->what |= VD_QSHARES;
+		memcpy( vf->qshares, vfc->qshare, sizeof( vf->qshares ) );
+	}
+
+	mirror = &port->mirrors[vidx];
+	if( mirror->dir != vfc->mirror_dir || (vfc->mirror_dir != MIRROR_OFF && mirror->target != vfc->mirror_target) ) {
+		delta->what |= VD_MIRROR;
+		delta->old_mirror = *mirror;
+		if( vfc->mirror_dir != MIRROR_OFF ) {
+			if( mirror->dir == MIRROR_OFF ) {
+				mirror->id = idm_alloc( conf->mir_id_mgr );			// was off, so it needs an id; else keep the one it has
+			}
+			mirror->target = vfc->mirror_target;
+		} else {
+			mirror->target = MAX_VFS + 1;								// target is unsigned -- make high
+		}
+		mirror->dir = vfc->mirror_dir;
+	}
+
+	vf->owner = vfc->owner;												// these don't touch the nic
+	if( vf->start_cb != NULL ) {
+		free( vf->start_cb );
+	}
+	vf->start_cb = vfc->start_cb != NULL ? strdup( vfc->start_cb ) : NULL;
+	if( vf->stop_cb != NULL ) {
+		free( vf->stop_cb );
+	}
+	vf->stop_cb = vfc->stop_cb != NULL ? strdup( vfc->stop_cb ) : NULL;
+
+	if( delta->what ) {
+		vf->delta = delta;
+		vf->last_updated = UPDATED;										// signal main code to push the changes
+	} else {
+		free( delta );
+	}
+
+	pthread_mutex_unlock( &conf->update_lock );
+
+	if( reason ) {
+		*reason = NULL;
+	}
+
+	bleat_printf( 1, "VF was updated in internal config: %s %s id=%d changes=0x%03x", vfc->name, vfc->pciid, vfc->vfid, vf->delta ? vf->delta->what : 0 );
+	free_config( vfc );
+	return 1;
+}
+
+// ---- two phase add (prepare/commit) for live migration -----------------------------------------------
 
 /*
-	Write to an open file des with a simple retry mechanism.  We cannot afford to block forever,
-	so we'll try only a few times if we make absolutely no progress.
+	Find the VF prepared from the config file with the basename given. Port is
+	set if the pointer is not nil. Returns nil if there is no such VF.
 */
-extern int vfd_write( int fd, const_str buf, int len ) {
-	int	tries = 10;				// we'll try for about 2.5 seconds and then we give up
-	int	nsent = 0;				// number of bytes actually sent
-	int n2send = 0;				// number of bytes left to send
+static struct vf_s* find_prepared( sriov_conf_t* conf, const_str base, struct sriov_port_s** port ) {
+	struct vf_s* vf;
+	int	i;
+	int j;
+
+	for( i = 0; i < conf->num_ports; i++ ) {
+		for( j = 0; j < conf->ports[i].num_vfs; j++ ) {
+			vf = &conf->ports[i].vfs[j];
+			if( vf->num >= 0 && vf->last_updated != DELETED && vf->prep_name != NULL && strcmp( vf->prep_name, base ) == 0 ) {
+				if( port != NULL ) {
+					*port = &conf->ports[i];
+				}
+				return vf;
+			}
+		}
+	}
 
+	return NULL;
+}
 
-	if( (n2send = len) <= 0 ) {
-		bleat_printf( 0, "WARN: response send length invalid: %d", len );
+/*
+	Prepare a VF (first phase of a two phase add, used for live migration). The
+	config is read, vetted and added exactly as for an add, so the VF slot, MACs
+	and queue shares are reserved and update_nic programs everything, but the
+	VF is marked prepared which keeps its link down until it is committed. The
+	caller is expected to park the config file (PREP_SUFFIX) rather than moving
+	it to the live directory; prepared VFs are not saved in the snapshot.
+
+	Only NICs which can force a VF's link down are able to hold a prepared VF
+	quiet; on the others (niantic, fortville) the VF would pass traffic as soon
+	as update_nic programs it, so the prepare is refused.
+
+	Returns 1 on success and 0 on failure; reason is handled as for vfd_add_vf().
+*/
+extern int vfd_prepare_vf( sriov_conf_t* conf, char* fname, char** reason ) {
+	vf_config_t* vfc;
+	char	mbuf[BUF_1K];
+	char*	pciid;
+	int		vfid;
+	int		i;
+
+	if( conf == NULL || fname == NULL ) {
+		if( reason ) {
+			*reason = strdup( "internal mishap: config ptr was nil" );
+		}
 		return 0;
 	}
 
-	bleat_printf( 3, "response write starts for %d bytes", len );
-	while( n2send > 0 && tries > 0 ) {
-		nsent = write( fd, buf, n2send );
-		if( nsent < 0 ) {
-			if( errno != EAGAIN ) { 					// hard error; quit immediately
-				bleat_printf( 0, "WRN: write error attempting %d, wrote only %d bytes: %s", len, len - n2send, strerror( errno ) );
-				return -1;
+	if( find_prepared( conf, base_name( fname ), NULL ) != NULL ) {
+		snprintf( mbuf, sizeof( mbuf ), "a vf is already prepared from %s; commit or abort it first", base_name( fname ) );
+		bleat_printf( 1, "vf not prepared: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	if( (vfc = read_config( fname )) == NULL ) {
+		snprintf( mbuf, sizeof( mbuf ), "unable to read config file: %s: %s", fname, errno > 0 ? strerror( errno ) : "unknown sub-reason" );
+		bleat_printf( 1, "vfd_prepare_vf failed: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	for( i = 0; vfc->pciid != NULL && i < conf->num_ports; i++ ) {
+		if( strcmp( conf->ports[i].pciid, vfc->pciid ) == 0 && ! vf_link_holdable( conf->ports[i].rte_port_number ) ) {
+			snprintf( mbuf, sizeof( mbuf ), "the nic at %s cannot hold a vf's link down; prepare is not supported (use add)", vfc->pciid );
+			bleat_printf( 1, "vf not prepared: %s", mbuf );
+			if( reason ) {
+				*reason = strdup( mbuf );
 			}
+			free_config( vfc );
+			return 0;
+		}
+	}
 
-			bleat_printf( 2, "response write would block (will retry ) attempting=%d, prev-written=%d bytes total-desired=%d: %s", n2send, len - n2send, len, strerror( errno ) );
-			nsent = 0;									// will soft fail and try up to max
-		} 
-			
-		if( nsent == n2send ) {
-			return len;
+	pciid = vfc->pciid != NULL ? strdup( vfc->pciid ) : NULL;		// add frees the config
+	vfid = vfc->vfid;
+	if( ! add_vfc( conf, fname, vfc, reason, 1 ) ) {					// marked prepared under the same lock as the add
+		if( pciid ) {
+			free( pciid );
 		}
+		return 0;
+	}
 
-		if( nsent > 0 ) { 		// something sent, so we assume iplex is actively reading
-			bleat_printf( 2, "response write partial:  nsent=%d n2send=%d", nsent, n2send - nsent );
-			n2send -= nsent;
-			buf += nsent;
+	bleat_printf( 1, "vf prepared: %s %s id=%d", base_name( fname ), pciid, vfid );
+	free( pciid );
+	return 1;
+}
+
+/*
+	Commit a prepared VF: the link is brought up (the one NIC change made) and the
+	parked config is moved to the live directory so that the VF is from now on
+	the same as one which was added. Name is the config file name used on the
+	prepare request (any path is ignored). If the prepared VF has not been pushed
+	to the NIC yet (update_nic) the link is left to it.
+
+	Returns 1 on success and 0 on failure; reason is handled as for vfd_add_vf().
+*/
+extern int vfd_commit_vf( parms_t* parms, sriov_conf_t* conf, const_str name, char** reason ) {
+	struct sriov_port_s* port = NULL;
+	struct vf_s* vf;
+	char	src[2048];
+	char	dest[2048];
+	char	mbuf[BUF_1K];
+	const_str base;
+
+	if( conf == NULL || name == NULL ) {
+		if( reason ) {
+			*reason = strdup( "internal mishap: config ptr or name was nil" );
+		}
+		return 0;
+	}
+
+	base = base_name( name );
+	*mbuf = 0;
+	if( (vf = find_prepared( conf, base, &port )) == NULL ) {
+		snprintf( mbuf, sizeof( mbuf ), "no vf is prepared from %s", base );
+	} else {
+		if( snprintf( src, sizeof( src ), "%s/%s%s", parms->config_dir, base, PREP_SUFFIX ) >= (int) sizeof( src ) ||
+			snprintf( dest, sizeof( dest ), "%s_live/%s", parms->config_dir, base ) >= (int) sizeof( dest ) ) {
+			snprintf( mbuf, sizeof( mbuf ), "cannot construct config file names for %s", base );
 		} else {
-			tries--;
-			usleep(250000);			// .25s
-			
+			if( ! cp_file( src, dest, 1 ) ) {										// copy and unlink src; without it the vf can't be deleted or restored
+				snprintf( mbuf, sizeof( mbuf ), "unable to move prepared config %s to %s: %s", src, dest, strerror( errno ) );
+			}
 		}
 	}
 
-	bleat_printf( 0, "WRN: write timed out attempting %d, but wrote only %d bytes", len, len - n2send );
-	return -1;
+	if( *mbuf ) {
+		bleat_printf( 1, "vf not committed: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	pthread_mutex_lock( &conf->update_lock );
+	free( vf->prep_name );
+	vf->prep_name = NULL;
+	if( vf->last_updated == UNCHANGED && parms->forreal && (parms->rflags & RF_INITIALISED) ) {		// already on the nic; just the link to do
+		bleat_printf( 2, "port: %d vf: %d set link status to %d (commit)", port->rte_port_number, vf->num, vf->link );
+		set_vf_link_status( port->rte_port_number, vf->num, vf->link );
+	}
+	pthread_mutex_unlock( &conf->update_lock );
+
+	bleat_printf( 1, "vf committed: %s pf=%d vf=%d", base, port->rte_port_number, vf->num );
+	return 1;
+}
+
+/*
+	Abort a prepared VF: it is deleted (update_nic removes it from the NIC) and the
+	parked config file is removed. Returns 1 on success and 0 on failure; reason is
+	handled as for vfd_add_vf().
+*/
+extern int vfd_abort_vf( parms_t* parms, sriov_conf_t* conf, const_str name, char** reason ) {
+	struct vf_s* vf;
+	char	wbuf[2048];
+	char	mbuf[BUF_1K];
+	const_str base;
+
+	if( conf == NULL || name == NULL ) {
+		if( reason ) {
+			*reason = strdup( "internal mishap: config ptr or name was nil" );
+		}
+		return 0;
+	}
+
+	base = base_name( name );
+	if( (vf = find_prepared( conf, base, NULL )) == NULL ) {
+		snprintf( mbuf, sizeof( mbuf ), "no vf is prepared from %s", base );
+		bleat_printf( 1, "vf not aborted: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	vf->last_updated = DELETED;						// update_nic does the rest, and frees the name
+
+	if( snprintf( wbuf, sizeof( wbuf ), "%s/%s%s", parms->config_dir, base, PREP_SUFFIX ) < (int) sizeof( wbuf ) ) {
+		delete_vf_config( wbuf, NULL );
+	}
+
+	bleat_printf( 1, "prepared vf aborted: %s vf=%d", base, vf->num );
+	return 1;
+}
+
+// ---- parallel read of config files at start up -----------------------------------------------------
+
+#define MAX_CFG_READERS		4		// max threads used to read/parse config files at start
+#define FILES_PER_READER	16		// don't start a thread unless it has at least this many files to do
+
+/*
+	Shared by the reader threads. Each thread takes the next unread file until
+	there are none left; results are saved by index so that they can be applied
+	in list order.
+*/
+typedef struct {
+	char**			flist;
+	int				nfiles;
+	int				next;			// next file to read (atomic)
+	vf_config_t**	vfcs;			// config read for each file (nil if it failed)
+	int*			errs;			// errno from a failed read
+} cfg_readers_t;
+
+static void* cfg_reader( void* data ) {
+	cfg_readers_t*	cr;
+	int				i;
+
+	cr = (cfg_readers_t *) data;
+	while( (i = __sync_fetch_and_add( &cr->next, 1 )) < cr->nfiles ) {
+		errno = 0;
+		if( (cr->vfcs[i] = read_config( cr->flist[i] )) == NULL ) {
+			cr->errs[i] = errno;
+		}
+	}
+
+	return NULL;
+}
+
+static int cmp_fnames( const void* a, const void* b ) {
+	return strcmp( *((char * const *) a), *((char * const *) b) );
+}
+
+static double elapsed_ms( struct timespec* start ) {
+	struct timespec now;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (double) (now.tv_sec - start->tv_sec) * 1000.0 + (double) (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/*
+	Get a list of all config files and add each one to the current config.
+	If one fails, we will generate an error and ignore it. We take the config dir name
+	supplied in the main VFd configuration and add "_live" to build the directory 
+	of live vf configuration files.  This prevents the virtualisation manager from 
+	dropping a few files while we're down which have conflicts/duplications that
+	would cause a non-deterministic start state.
+
+	The files are read and parsed by a small pool of threads; the results are then
+	added to the config one at a time in file name order so the end state is the
+	same as if they'd been read and added one after the other.
+*/
+extern void vfd_add_all_vfs(  parms_t* parms, sriov_conf_t* conf ) {
+	char** flist; 					// list of files to pull in
+	int		llen;					// list length
+	int		i;
+	int		nthreads;				// reader threads started
+	int		nadded = 0;
+	char	wbuf[2048];				// we'll bang on our 'live' designation to the config dir string in this
+	char	mbuf[BUF_1K];
+	cfg_readers_t	cr;
+	pthread_t		tids[MAX_CFG_READERS];
+	struct timespec	start;
+	double	read_ms;
+
+	if( parms == NULL || conf == NULL ) {
+		bleat_printf( 0, "internal mishap: NULL conf or parms pointer passed to add_all_vfs" );
+		return;
+	}
+
+	if( snprintf( wbuf, sizeof( wbuf ), "%s_live", parms->config_dir ) >= (int) sizeof( wbuf ) ) {		// create something like /var/lib/vfd/config_live
+		bleat_printf( 0, "WRN: cannot construct live directory; work buffer not large enough (%d)", (int) sizeof( wbuf ) );
+		return;
+	}
+
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	flist = list_files( wbuf, "json", 1, &llen );
+	if( flist == NULL || llen <= 0 ) {
+		bleat_printf( 1, "zero vf configuration files (*.json) found in %s_live; nothing restored", parms->config_dir );
+		free_list( flist, 0 );											// still must free core structure
+		return;
+	}
+
+	bleat_printf( 1, "adding %d existing vf configuration files to the mix", llen );
+	qsort( flist, llen, sizeof( *flist ), cmp_fnames );					// directory order isn't predictable; ours must be
+
+	memset( &cr, 0, sizeof( cr ) );
+	cr.flist = flist;
+	cr.nfiles = llen;
+	cr.vfcs = (vf_config_t **) malloc( sizeof( *cr.vfcs ) * llen );
+	cr.errs = (int *) malloc( sizeof( *cr.errs ) * llen );
+	if( cr.vfcs == NULL || cr.errs == NULL ) {
+		bleat_printf( 0, "WRN: add_all_vfs: unable to allocate memory for %d configs; nothing restored", llen );
+		free( cr.vfcs );
+		free( cr.errs );
+		free_list( flist, llen );
+		return;
+	}
+	memset( cr.vfcs, 0, sizeof( *cr.vfcs ) * llen );
+	memset( cr.errs, 0, sizeof( *cr.errs ) * llen );
+
+	nthreads = llen / FILES_PER_READER;
+	if( nthreads > MAX_CFG_READERS ) {
+		nthreads = MAX_CFG_READERS;
+	}
+	for( i = 0; i < nthreads; i++ ) {
+		if( pthread_create( &tids[i], NULL, cfg_reader, &cr ) != 0 ) {
+			bleat_printf( 1, "add_all_vfs: unable to start config reader thread: %s", strerror( errno ) );
+			break;
+		}
+	}
+	nthreads = i;
+
+	cfg_reader( &cr );													// we pitch in too; if no threads started we do them all
+	for( i = 0; i < nthreads; i++ ) {
+		pthread_join( tids[i], NULL );
+	}
+	read_ms = elapsed_ms( &start );
+
+	for( i = 0; i < llen; i++ ) {
+		bleat_printf( 2, "adding %s", flist[i] );
+		if( cr.vfcs[i] == NULL ) {
+			snprintf( mbuf, sizeof( mbuf ), "unable to read config file: %s: %s", flist[i], cr.errs[i] > 0 ? strerror( cr.errs[i] ) : "unknown sub-reason" );
+			bleat_printf( 1, "vfd_add_vf failed: %s", mbuf );
+		} else {
+			if( vfd_add_vfc( conf, flist[i], cr.vfcs[i], NULL ) ) {		// the config is freed by this
+				nadded++;
+				continue;
+			}
+		}
+
+		bleat_printf( 0, "add_all_vfs: could not add %s (moved off to %s)", flist[i], parms->config_dir );
+		delete_vf_config( flist[i], parms->config_dir );
+	}
+
+	bleat_printf( 1, "add_all_vfs: %d of %d vf configs added; read/parse %.1fms (%d threads) total %.1fms",
+		nadded, llen, read_ms, nthreads + 1, elapsed_ms( &start ) );
+
+	free( cr.vfcs );
+	free( cr.errs );
+	free_list( flist, llen );
+}
+
+/*
+	Return the number of VFs configured on the PF according to sysfs, or dflt if
+	it can't be read (validating on a host without the nic).
+*/
+static int sysfs_numvfs( const_str pciid, int dflt ) {
+	char	wbuf[256];
+	FILE*	f;
+	int		n;
+
+	snprintf( wbuf, sizeof( wbuf ), "/sys/bus/pci/devices/%s/sriov_numvfs", pciid );
+	if( (f = fopen( wbuf, "r" )) == NULL ) {
+		return dflt;
+	}
+
+	if( fscanf( f, "%d", &n ) != 1 || n <= 0 ) {
+		n = dflt;
+	}
+	fclose( f );
+
+	return n;
+}
+
+/*
+	Offline validation (vfd --validate dir). The ports from the parm file are added to
+	conf and each json file in the directory is added, in name order, using the same
+	code as a live add. Thus duplicate MACs on a PF, VLAN and MAC limits, TC over
+	subscription and spread, rate over subscription and VF id conflicts are all caught.
+	DPDK is not initialised: the config index is used as the port number and the number
+	of VFs on each PF comes from sysfs (32 if it can't be read). A line is written to
+	stdout for each file followed by a capacity summary for each PF.
+
+	Returns the number of files which would be rejected.
+*/
+extern int vfd_validate( parms_t* parms, sriov_conf_t* conf, const_str dir ) {
+	struct sriov_port_s* port;
+	char**	flist;
+	char*	reason;
+	int		llen = 0;
+	int		nerrs = 0;
+	int		nvfs;
+	int		nmacs;
+	int		nvlans;
+	int		tc_tot[MAX_TCS];
+	int		i;
+	int		j;
+	int		k;
+
+	vfd_add_ports( parms, conf );
+	for( i = 0; i < conf->num_ports; i++ ) {
+		conf->ports[i].rte_port_number = i;								// no dpdk, so the config index stands in for the port
+		port2config_map[i] = i;
+		conf->ports[i].nvfs_config = sysfs_numvfs( conf->ports[i].pciid, 32 );
+	}
+
+	if( (flist = list_files( (char *) dir, "json", 1, &llen )) == NULL || llen <= 0 ) {
+		printf( "no vf configuration files (*.json) found in %s\n", dir );
+		free_list( flist, 0 );
+		return 0;
+	}
+	qsort( flist, llen, sizeof( *flist ), cmp_fnames );
+
+	for( i = 0; i < llen; i++ ) {
+		reason = NULL;
+		if( vfd_add_vf( conf, flist[i], &reason ) ) {
+			printf( "OK     %s\n", flist[i] );
+		} else {
+			printf( "ERROR  %s: %s\n", flist[i], reason ? reason : "unknown reason" );
+			nerrs++;
+		}
+
+		if( reason ) {
+			free( reason );
+		}
+	}
+	free_list( flist, llen );
+
+	for( i = 0; i < conf->num_ports; i++ ) {
+		port = &conf->ports[i];
+		nvfs = nmacs = nvlans = 0;
+		memset( tc_tot, 0, sizeof( tc_tot ) );
+
+		for( j = 0; j < port->num_vfs; j++ ) {
+			if( port->vfs[j].num >= 0 ) {
+				nvfs++;
+				nmacs += port->vfs[j].num_macs;
+				nvlans += port->vfs[j].num_vlans;
+				for( k = 0; k < MAX_TCS; k++ ) {
+					tc_tot[k] += port->vfs[j].qshares[k];
+				}
+			}
+		}
+
+		printf( "pf %s: vfs=%d/%d macs=%d/%d vlans=%d", port->pciid, nvfs, port->nvfs_config, nmacs, MAX_PF_MACS, nvlans );
+		if( parms->rflags & RF_ENABLE_QOS ) {
+			printf( " tc_shares=" );
+			for( k = 0; k < port->ntcs && k < MAX_TCS; k++ ) {
+				printf( "%s%d%%", k ? "," : "", tc_tot[k] );
+			}
+		}
+		printf( "\n" );
+	}
+
+	printf( "%d files checked, %d rejected\n", llen, nerrs );
+	return nerrs;
+}
+
+/*
+	Delete a VF from a port.  We expect the name of a file which we can read the
+	parms from and suss out the pciid and the vfid.  Those are used to find the
+	info in the global config and render it useless. The delete will be rejected
+	if the name in the parm file doesn't match the name we saved when adding the
+	configuration.  This is a false sense of security, but was a user request
+	so it was added.  The first thing we attempt to do is to remove or rename the 
+	config file.  If we can't do that we don't do anything else because we'd give 
+	the false sense that it was deleted but on restart we'd recreate it, or worse 
+	have a conflict with something that was added. 
+
+	Regardless of the outcome after reading the configuration file, if we can open 
+	the file we will delete it.
+*/
+extern int vfd_del_vf( parms_t* parms, sriov_conf_t* conf, char* fname, char** reason ) {
+	vf_config_t* vfc;					// raw vf config file contents	
+	char mbuf[BUF_1K];					// message buffer if we fail
+	unsigned int mblen = BUF_1K - 1;	// length of usable spaece in work buffer
+	char*	target_dir = NULL;			// target directory if keep is set
+	int		rc;
+
+	mbuf[mblen-1] = 0;					// avoid needing a check for each snprintf	
+
+	
+	if( parms->delete_keep ) {											// need to keep the old by renaming it with a trailing -
+		target_dir = parms->config_dir;									// we'll move files back to this dir
+	}
+	
+	if( conf == NULL || fname == NULL ) {
+		bleat_printf( 0, "vfd_del_vf called with nil config or filename pointer" );
+		if( reason ) {
+			snprintf( mbuf, mblen, "internal mishap: config ptr was nil" );
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	if( (vfc = read_config( fname )) == NULL ) {
+		snprintf( mbuf, mblen, "unable to read config file: %s: %s", fname, errno > 0 ? strerror( errno ) : "unknown sub-reason" );
+		bleat_printf( 1, "vfd_del_vf failed: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	if( (rc = vfd_del_vfc( conf, fname, vfc, reason )) >= 0 ) {		// deleted, or the config was stale/bad; either way the file goes
+		delete_vf_config( fname, target_dir );
+	}
+
+	free_config( vfc );
+	return rc > 0;
+}
+
+/*
+	Delete the VF described by a config which has already been read (fname is
+	used only in messages). This is the in memory half of vfd_del_vf(); no files
+	are touched and the config is not freed.  Returns 1 if the VF was marked for
+	deletion, 0 if the config is bad or the VF isn't configured (the config is
+	stale), and -1 if the VF is configured but the name given when it was added
+	doesn't match. Reason is handled as for vfd_del_vf().
+*/
+extern int vfd_del_vfc( sriov_conf_t* conf, const_str fname, vf_config_t* vfc, char** reason ) {
+	int	i;
+	int vidx;							// index into the vf array
+	struct sriov_port_s* port = NULL;	// reference to a single port in the config
+	char mbuf[BUF_1K];					// message buffer if we fail
+	unsigned int mblen = BUF_1K - 1;	// length of usable spaece in work buffer
+
+	mbuf[mblen-1] = 0;					// avoid needing a check for each snprintf	
+
+	if( conf == NULL || vfc == NULL ) {
+		bleat_printf( 0, "vfd_del_vfc called with nil config or vf config pointer" );
+		if( reason ) {
+			snprintf( mbuf, mblen, "internal mishap: config ptr was nil" );
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	if( vfc->pciid == NULL || vfc->vfid < 0 ) {						// file opened and parsed, but information we need was missing
+		snprintf( mbuf, mblen, "invalid configuration contents in file: %s", fname );
+		bleat_printf( 1, "no config change related to del request: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	for( i = 0; i < conf->num_ports; i++ ) {						// find the port that this vf is attached to
+		if( strcmp( conf->ports[i].pciid, vfc->pciid ) == 0 ) {	// match
+			port = &conf->ports[i];
+			break;
+		}
+	}
+
+	if( port == NULL ) {
+		snprintf( mbuf, mblen, "%s: could not find port %s in the config", vfc->name, vfc->pciid );
+		bleat_printf( 1, "no config change related to del request: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	vidx = -1;
+	for( i = 0; i < port->num_vfs; i++ ) {				// suss out the id that is listed
+		if( port->vfs[i].num == vfc->vfid ) {			// this is it.
+			vidx = i;
+			break;
+		}
+	}
+
+	if( vidx < 0 ) {									//  vf not configured on this port
+		snprintf( mbuf, mblen, "%s: vf %d not configured on port %s", vfc->name, vfc->vfid, vfc->pciid );
+		bleat_printf( 1, "no config change related to del request: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		return 0;
+	}
+
+	if( strcmp( vfc->name, port->vfs[vidx].config_name ) != 0 ) { 				// confirm name in current config matches what we had when we added it
+		snprintf( mbuf, mblen, "%s: name in config did not match name given when VF was added: expected %s, found %s", vfc->name,  port->vfs[vidx].config_name, vfc->name );
+		bleat_printf( 1, "no config change related to del request: %s", mbuf );
+		if( reason ) {
+			*reason = strdup( mbuf );
+		}
+		return -1;
+	}
+
+	bleat_printf( 2, "del: config data: name: %s", vfc->name );
+	bleat_printf( 2, "del: config data: pciid: %s", vfc->pciid );
+	bleat_printf( 2, "del: config data: vfid: %d", vfc->vfid );
+
+	port->vfs[vidx].last_updated = DELETED;			// signal main code to nuke the puppy (vfid stays set so we don't see it as a hole until it's gone)
+	
+	if( reason ) {
+		*reason = NULL;
+	}
+	bleat_printf( 2, "VF internal config was deleted: %s %s id=%d", vfc->name, vfc->pciid, vfc->vfid );
+	return 1;
+}
+
+// ---- request/response functions -----------------------------------------------------------------------------
+
+/*
+	Write to an open file des with a simple retry mechanism.  We cannot afford to block forever,
+	so we'll try only a few times if we make absolutely no progress.
+*/
+extern int vfd_write( int fd, const_str buf, int len ) {
+	int	tries = 10;				// we'll try for about 2.5 seconds and then we give up
+	int	nsent = 0;				// number of bytes actually sent
+	int n2send = 0;				// number of bytes left to send
+
+
+	if( (n2send = len) <= 0 ) {
+		bleat_printf( 0, "WARN: response send length invalid: %d", len );
+		return 0;
+	}
+
+	bleat_printf( 3, "response write starts for %d bytes", len );
+	while( n2send > 0 && tries > 0 ) {
+		nsent = write( fd, buf, n2send );
+		if( nsent < 0 ) {
+			if( errno != EAGAIN ) { 					// hard error; quit immediately
+				bleat_printf( 0, "WRN: write error attempting %d, wrote only %d bytes: %s", len, len - n2send, strerror( errno ) );
+				return -1;
+			}
+
+			bleat_printf( 2, "response write would block (will retry ) attempting=%d, prev-written=%d bytes total-desired=%d: %s", n2send, len - n2send, len, strerror( errno ) );
+			nsent = 0;									// will soft fail and try up to max
+		} 
+			
+		if( nsent == n2send ) {
+			return len;
+		}
+
+		if( nsent > 0 ) { 		// something sent, so we assume iplex is actively reading
+			bleat_printf( 2, "response write partial:  nsent=%d n2send=%d", nsent, n2send - nsent );
+			n2send -= nsent;
+			buf += nsent;
+		} else {
+			tries--;
+			usleep(250000);			// .25s
+			
+		}
+	}
+
+	bleat_printf( 0, "WRN: write timed out attempting %d, but wrote only %d bytes", len, len - n2send );
+	return -1;
+}
+
+/*
+	Queue a response on a connection; either the response pipe or a socket (see
+	sock_send()). The json has an action of 'response' and the vfd_rid which was
+	passed in; messages are split on newlines into an array. The message is
+	terminated by @eom@ on a line by itself. The whole response is built and then
+	queued with one call so that responses from workers sharing a connection are
+	never interleaved.
+*/
+static void write_response( int cid, const_str what, const_str action, uint64_t op_id, int state, const_str vfd_rid, const_str msg ) {
+	char*	buf;
+	char*	dmsg;			// duplicate message that we can mutilate
+	char*	dptr;			// pointer into dmsg for strtok
+	char*	tok;
+	const_str	sep = "\n";	// message seperators in the array; lead newline helps with visual alignment which can be important
+	int		bsize;
+	int		blen;
+	int		nlines = 1;
+
+	if( vfd_rid == NULL ) {
+		bleat_printf( 1, "response: did not have a vfd_rid to send back" );
+		vfd_rid = "not-supplied";
+	}
+
+	if( bleat_will_it( 4 ) ) {
+		bleat_printf( 4, "sending response: %s(%d) [%d] %s", what, cid, state, msg );
+	} else {
+		bleat_printf( 2, "sending response: %s(%d) [%d] %d bytes", what, cid, state, msg != NULL ? strlen( msg ) : 0 );
+	}
+
+	if( msg != NULL ) {
+		for( tok = (char *) msg; (tok = strchr( tok, '\n' )) != NULL; tok++, nlines++ );
+	}
+	bsize = 128 + strlen( vfd_rid ) + (msg != NULL ? strlen( msg ) : 0) + (nlines * 4);		// each line adds quotes, comma and newline
+	if( (buf = (char *) malloc( sizeof( char ) * bsize )) == NULL ) {
+		bleat_printf( 0, "ERR: response: unable to allocate %d bytes for the response to %s", bsize, what );
+		return;
+	}
+
+	blen = snprintf( buf, bsize, "{ \"action\": \"%s\", \"vfd_rid\": \"%s\", \"state\": \"%s\", ", action, vfd_rid, state ? "ERROR" : "OK" );
+	if( op_id ) {
+		blen += snprintf( buf + blen, bsize - blen, "\"op_id\": %llu, ", (unsigned long long) op_id );
+	}
+	blen += snprintf( buf + blen, bsize - blen, "\"msg\": [" );
+	bleat_printf( 3, "response: header: %s", buf );
+
+	if( msg != NULL  && (dmsg = strdup( msg )) != NULL ) {
+		dptr = dmsg;
+		while( (tok = strtok_r( NULL, "\n", &dptr )) != NULL ) {	//  bloody json doesn't accept strings with newlines, so we build an array; grrr
+			blen += snprintf( buf + blen, bsize - blen, "%s\"%s\"", sep, tok );
+			sep = ",\n";											// after the first we need commas before the next
+		}
+
+		free( dmsg );
+	}
+	
+	blen += snprintf( buf + blen, bsize - blen, " ] }\n@eom@\n" );				// terminate the the message array, then the json
+	if( sock_send( cid, buf, blen ) > 0 ) {
+		bleat_printf( 2, "response queued for %s", what );
+	}
+
+	free( buf );
+}
+
+/*
+	Queue a binary response (see lib/vbin.c) on a socket connection; used when the
+	request arrived as a binary frame. Kind is VBK_RESPONSE, or VBK_COMPLETE for the
+	completion of an async operation. The message goes as a single string with its
+	newlines; no json is built.
+*/
+static void write_bresponse( int cid, int kind, uint64_t op_id, int state, const_str vfd_rid, const_str msg ) {
+	vb_buf_t*	b;
+	int		len;
+
+	bleat_printf( 2, "sending binary response: socket(%d) [%d] %d bytes", cid, state, msg != NULL ? strlen( msg ) : 0 );
+
+	if( (b = vb_start( 64 + (msg != NULL ? strlen( msg ) : 0) )) == NULL ) {
+		bleat_printf( 0, "ERR: response: unable to allocate a binary response for socket(%d)", cid );
+		return;
+	}
+
+	vb_add_uint( b, VBT_KIND, kind, 1 );
+	vb_add_uint( b, VBT_STATE, state, 1 );
+	if( op_id ) {
+		vb_add_uint( b, VBT_OPID, op_id, 8 );
+	}
+	vb_add_str( b, VBT_RID, vfd_rid );
+	vb_add_str( b, VBT_MSG, msg );								// long messages (show all) go in pieces
+
+	if( (len = vb_finish( b )) < 0 ) {
+		bleat_printf( 0, "ERR: response: binary response for socket(%d) is too large", cid );
+	} else if( sock_send( cid, (const_str) b->data, len ) > 0 ) {
+		bleat_printf( 2, "binary response queued for socket(%d)", cid );
+	}
+
+	vb_free( b );
+}
+
+/*
+	Open the response pipe and queue the response on it.  The response pipe is opened in non-block
+	mode so that it will fail immiediately if there isn't a reader or the pipe doesn't exist.
+*/
+static void fifo_response( char* rpipe, uint64_t op_id, int state, const_str vfd_rid, const_str msg ) {
+	int 	fd;
+	int		cid;
+
+	if( rpipe == NULL ) {
+		bleat_printf( 1, "response: unable to respond, response pipe name is nil" );
+		return;
+	}
+
+	bleat_printf( 3, "response: opening response pipe: %s", rpipe );
+	if( (fd = open( rpipe, O_WRONLY | O_NONBLOCK, 0 )) < 0 ) {
+	 	bleat_printf( 0, "unable to deliver response: open failed: %s: %s", rpipe, strerror( errno ) );
+		return;
+	}
+
+	if( (cid = sock_adopt( fd )) >= 0 ) {
+		write_response( cid, rpipe, "response", op_id, state, vfd_rid, msg );
+		sock_flush();			// most of the time this gets it all out; the main loop finishes it if not
+	} else {
+	 	bleat_printf( 0, "unable to deliver response: cannot queue response: %s", rpipe );
+		close( fd );
+	}
+}
+
+/*
+	Construct json to write onto the response pipe.  The response pipe is opened in non-block mode
+	so that it will fail immiediately if there isn't a reader or the pipe doesn't exist. We assume
+	that the requestor opens the pipe before sending the request so that if it is delayed after
+	sending the request it does not prevent us from writing to the pipe.  If we don't open in 	
+	non-blocked mode we could hang foever if the requestor dies/aborts.
+
+	The open pipe is handed to the socket code which queues the response and writes it as the
+	reader drains the pipe; the pipe is closed once the response is out, or if the reader doesn't
+	take it within the delivery timeout. We never wait on a slow reader.
+
+	To work with remote requests (tokay and containers) the response must contain an action which
+	is 'response', and the vfd_rid which was passed in.  This allows a single response pipe to be
+	used, and allows for future expansion of other information sent via the pipe, not just responses.
+*/
+extern void vfd_response( char* rpipe, int state, const_str vfd_rid, const_str msg ) {
+	fifo_response( rpipe, 0, state, vfd_rid, msg );
+	bleat_pop_lvl();			// we assume it was pushed when the request received; we pop it once we respond
+}
+
+/*
+	Send the response to a request back the way it came: on the socket connection if
+	the request arrived on the request socket, otherwise on the response pipe named
+	in the request. The connection is left open for the client's next request.
+	For an async request (already accepted) the operation is completed instead.
+
+	The log level pushed when the request was read is popped, unless the request
+	was handed to a worker; the level isn't pushed for those.
+*/
+extern void vfd_req_response( req_t* req, int state, const_str msg ) {
+	uint64_t	now = 0;
+	uint64_t	nic;
+
+	if( req == NULL ) {
+		return;
+	}
+
+	if( req->mark ) {										// time the handling (less nic update) and the nic update
+		now = perf_now( );
+		nic = perf_nic_us( );
+		perf_record( req->rtype, PS_APPLY, now - req->mark > nic ? now - req->mark - nic : 0 );
+		if( nic > 0 ) {
+			perf_record( req->rtype, PS_NIC, nic );
+		}
+		if( state != RESP_OK ) {
+			perf_error( req->rtype );
+		}
+	}
+
+	if( req->op_id ) {										// async; accepted already, this is the outcome
+		op_complete( req->op_id, state, msg );
+		req->op_id = 0;
+	} else if( req->rsock < 0 ) {
+		fifo_response( req->resp_fifo, 0, state, req->vfd_rid, msg );
+	} else if( req->binary ) {
+		write_bresponse( req->rsock, VBK_RESPONSE, 0, state, req->vfd_rid, msg );
+		sock_flush();
+	} else {
+		write_response( req->rsock, "socket", "response", 0, state, req->vfd_rid, msg );
+		sock_flush();
+	}
+
+	if( req->mark ) {
+		perf_record( req->rtype, PS_RESPOND, perf_now( ) - now );
+		perf_record( req->rtype, PS_TOTAL, perf_now( ) - req->rx_us );
+		req->mark = 0;										// only the first response is timed
+	}
+
+	if( ! req->worker ) {
+		bleat_pop_lvl();
+	}
+}
+
+/*
+	Send the completion of an async operation on the connection the request came in
+	on. The message is a response with an action of "complete" and the operation id;
+	it is sent regardless of what else the client has sent since. If the request
+	was binary the completion is too.
+*/
+extern void vfd_op_notify( int cid, int binary, const_str vfd_rid, uint64_t op_id, int state, const_str msg ) {
+	if( binary ) {
+		write_bresponse( cid, VBK_COMPLETE, op_id, state, vfd_rid, msg );
+	} else {
+		write_response( cid, "socket", "complete", op_id, state, vfd_rid, msg );
+	}
+	sock_flush();
+}
+
+/*
+	Tell the sender of an async request that it was accepted. The response carries
+	the operation id which is used to ask for its status (opstatus request) and is
+	in the completion message sent later on a socket connection.
+*/
+static void accept_response( req_t* req ) {
+	char	mbuf[128];
+
+	snprintf( mbuf, sizeof( mbuf ), "accepted: op %llu", (unsigned long long) req->op_id );
+	if( req->rsock < 0 ) {
+		fifo_response( req->resp_fifo, req->op_id, RESP_OK, req->vfd_rid, mbuf );
+	} else if( req->binary ) {
+		write_bresponse( req->rsock, VBK_RESPONSE, req->op_id, RESP_OK, req->vfd_rid, mbuf );
+		sock_flush();
+	} else {
+		write_response( req->rsock, "socket", "response", req->op_id, RESP_OK, req->vfd_rid, mbuf );
+		sock_flush();
+	}
+}
+
+/*
+	Cleanup a request and free the memory.
+*/
+extern void vfd_free_request( req_t* req ) {
+	if( req->vfd_rid != NULL ) {
+		free( req->vfd_rid );
+	}
+
+	if( req->resource != NULL ) {
+		free( req->resource );
+	}
+	if( req->resp_fifo != NULL ) {
+		free( req->resp_fifo );
+	}
+	if( req->output != NULL ) {
+		free( req->output );
+	}
+
+	free( req );
+}
+
+/*
+	Map a request's action name (json or binary) to its RT_ type; RT_UNKNOWN if
+	it isn't recognised.
+*/
+static int action_type( const_str action ) {
+	switch( *action ) {				// we assume compiler builds a jump table which makes it faster than a bunch of nested string compares
+		case 'a':
+		case 'A':					// assume add unless abort
+			return strcmp( action, "abort" ) == 0 ? RT_ABORT : RT_ADD;
+
+		case 'c':					// assume "cpu_alrm_thresh" unless commit
+			return strcmp( action, "commit" ) == 0 ? RT_COMMIT : RT_CPU_ALARM;
+
+		case 'e':
+			return RT_EXPORT;		// export a live config
+
+		case 'd':
+		case 'D':
+			return strcmp( action, "dump" ) == 0 ? RT_DUMP : RT_DEL;
+
+		case 'm':
+			return RT_MIRROR;
+
+		case 'o':					// status of async operation(s)
+			return RT_OPSTATUS;
+
+		case 'p':					// ping or prepare
+			return strcmp( action, "prepare" ) == 0 ? RT_PREPARE : RT_PING;
+
+		case 'r':					// reload the parm file
+			return RT_RELOAD;
+
+		case 's':
+		case 'S':					// assume show
+			return RT_SHOW;
+
+		case 'u':
+		case 'U':					// update a live vf in place
+			return RT_UPDATE;
+
+		case 'v':
+			return RT_VERBOSE;
+	}
+
+	return RT_UNKNOWN;
+}
+
+/*
+	Build a request from a binary frame (see lib/vbin.c) of rlen bytes; no json is
+	involved. The frame is freed. Returns nil if the frame is short or has no
+	action, or memory can't be had.
+*/
+static req_t* parse_binary( char* rbuf, int rlen, int cid ) {
+	const unsigned char* frame;
+	const unsigned char* val;
+	req_t*	req;
+	char*	action = NULL;
+	int		off = 0;
+	int		tag;
+	int		vlen;
+
+	frame = (const unsigned char *) rbuf;
+	if( vb_frame_len( frame, rlen ) != rlen ) {							// header must describe exactly what we were given
+		bleat_printf( 0, "ERR: binary request frame length doesn't match the %d bytes received", rlen );
+		free( rbuf );
+		return NULL;
+	}
+
+	if( (req = (req_t *) malloc( sizeof( *req ) )) == NULL ) {
+		bleat_printf( 0, "ERR: memory allocation error tying to alloc request for binary frame" );
+		free( rbuf );
+		return NULL;
+	}
+	memset( req, 0, sizeof( *req ) );
+	req->rsock = cid;
+	req->binary = 1;
+
+	while( vb_next( frame, rlen, &off, &tag, &val, &vlen ) ) {
+		switch( tag ) {
+			case VBT_ACTION:
+				if( action == NULL ) {
+					action = vb_strdup( val, vlen );
+				}
+				break;
+
+			case VBT_RID:
+				if( req->vfd_rid == NULL ) {
+					req->vfd_rid = vb_strdup( val, vlen );
+				}
+				break;
+
+			case VBT_RESOURCE:
+				if( req->resource == NULL ) {
+					req->resource = vb_strdup( val, vlen );
+				}
+				break;
+
+			case VBT_OUTPUT:
+				if( req->output == NULL ) {
+					req->output = vb_strdup( val, vlen );
+				}
+				break;
+
+			case VBT_RFIFO:
+				if( req->resp_fifo == NULL ) {
+					req->resp_fifo = vb_strdup( val, vlen );
+				}
+				break;
+
+			case VBT_LOGLEVEL:
+				req->log_level = (int) vb_uint( val, vlen );
+				break;
+
+			case VBT_ASYNC:
+				req->async = vb_uint( val, vlen ) != 0;
+				break;
+
+			default:					// unknown tags are skipped so newer clients still work
+				break;
+		}
+	}
+	free( rbuf );
+
+	if( action == NULL || ! *action ) {
+		bleat_printf( 0, "ERR: binary request received without action" );
+		if( action != NULL ) {
+			free( action );
+		}
+		vfd_free_request( req );
+		return NULL;
+	}
+
+	if( (req->rtype = action_type( action )) == RT_UNKNOWN ) {
+		bleat_printf( 0, "ERR: unrecognised action in binary request: %s", action );
+	}
+	bleat_printf( 2, "binary request: %s %s", action, req->resource ? req->resource : "" );
+
+	free( action );
+	return req;
+}
+
+/*
+	Format a raw request (from the fifo, or from socket connection cid) into a
+	request block. Rbuf is freed; rlen is its length. A binary frame from a socket
+	connection is handed to parse_binary(); anything from the fifo is json. A pointer to the struct is returned; the caller
+	must use vfd_free_request() to properly free it.
+*/
+static req_t* parse_request( char* rbuf, int rlen, int cid ) {
+	void*	jblob;				// json parsing stuff
+	char*	stuff;				// stuff teased out of the json blob
+	char*	rid;				// request id we must track for caller
+	req_t*	req = NULL;
+
+	if( cid >= 0 && (unsigned char) *rbuf == VB_MAGIC ) {		// binary frames are taken on the socket only
+		return parse_binary( rbuf, rlen, cid );
+	}
+
+	if( (jblob = jw_new( rbuf )) == NULL ) {
+		bleat_printf( 0, "ERR: failed to create a json parsing object for: %s", rbuf );
+		free( rbuf );
+		return NULL;
+	}
+
+	if( (stuff = jw_string( jblob, "action" )) == NULL ) {					// CAUTION: switch below expects stuff to have action
+		bleat_printf( 0, "ERR: request received without action: %s", rbuf );
+		free( rbuf );
+		jw_nuke( jblob );
+		return NULL;
+	}
+
+	if( (req = (req_t *) malloc( sizeof( *req ) )) == NULL ) {
+		bleat_printf( 0, "ERR: memory allocation error tying to alloc request for: %s", rbuf );
+		free( rbuf );
+		jw_nuke( jblob );
+		return NULL;
+	}
+	memset( req, 0, sizeof( *req ) );
+	req->rsock = cid;
+
+	bleat_printf( 2, "raw message: (%s)", rbuf );
+
+	if( (rid = jw_string( jblob, "params.vfd_rid" )) != NULL ) {					// if request id supplied
+		req->vfd_rid = strdup( rid );
+	}
+
+	if( (req->rtype = action_type( stuff )) == RT_UNKNOWN ) {
+		bleat_printf( 0, "ERR: unrecognised action in request: %s", rbuf );
+	}
+
+	if( (stuff = jw_string( jblob, "params.filename")) != NULL ) {
+		req->resource = strdup( stuff );
+	} else {
+		if( (stuff = jw_string( jblob, "params.resource")) != NULL ) {
+			req->resource = strdup( stuff );
+		}
+	}
+
+	if( (stuff = jw_string( jblob, "params.output")) != NULL ) {
+		req->output = strdup( stuff );
+	}
+
+	if( (stuff = jw_string( jblob, "params.r_fifo")) != NULL ) {
+		req->resp_fifo = strdup( stuff );
+	} else {
+		if( cid < 0 ) {						// not needed when the response goes back on the socket
+			bleat_printf( 1, "no response fifo given in request" );
+		}
+	}
+	
+	req->log_level = jw_missing( jblob, "params.loglevel" ) ? 0 : (int) jw_value( jblob, "params.loglevel" );
+	req->async = ! jw_missing( jblob, "params.async" ) && jw_value( jblob, "params.async" ) != 0;
+
+	free( rbuf );
+	jw_nuke( jblob );
+	return req;
+}
+
+/*
+	Set subsystem log levels from a verbose request. Spec is a comma separated
+	list of subsystem[=level] (e.g. "qos=3,mbox=0"); when the level is omitted
+	dlevel is used. A level of -1, or the word "global" (e.g. qos=global), returns
+	the subsystem to the global level; "reset" does so for all subsystems.
+
+	The current settings (or the reason for failure) are placed into mbuf.
+	Returns 0 on success, 1 on error. All names are checked before anything is
+	changed.
+*/
+static int set_ss_levels( char* spec, int dlevel, char* mbuf, int mlen ) {
+	char*	dup;
+	char*	tok;
+	char*	tstate = NULL;
+	char*	lstr;
+	int		ss;
+	int		l;
+	int		pass;
+	int		len;
+
+	dup = strdup( spec );
+	for( pass = 0; pass < 2; pass++ ) {							// pass 0 validates, pass 1 sets
+		strcpy( dup, spec );
+		for( tok = strtok_r( dup, ", ", &tstate ); tok != NULL; tok = strtok_r( NULL, ", ", &tstate ) ) {
+			if( strcmp( tok, "reset" ) == 0 ) {
+				if( pass ) {
+					for( ss = BLEAT_SS_GEN + 1; ss < BLEAT_NSS; ss++ ) {
+						bleat_set_ss_lvl( ss, -1 );
+					}
+				}
+				continue;
+			}
+
+			l = dlevel;
+			if( (lstr = strchr( tok, '=' )) != NULL ) {
+				*(lstr++) = 0;
+				l = strcmp( lstr, "global" ) == 0 ? -1 : atoi( lstr );
+			}
+
+			if( (ss = bleat_ss_id( tok )) <= BLEAT_SS_GEN ) {
+				snprintf( mbuf, mlen, "unknown subsystem: %s (expected one of rif, nic, mbox, qos, mac, stats or reset)", tok );
+				free( dup );
+				return 1;
+			}
+
+			if( pass ) {
+				bleat_set_ss_lvl( ss, l );
+				bleat_printf( 0, "verbose level for %s changed to %d", tok, l );
+			}
+		}
+	}
+	free( dup );
+
+	len = snprintf( mbuf, mlen, "verbose levels:" );
+	for( ss = BLEAT_SS_GEN + 1; ss < BLEAT_NSS && len < mlen; ss++ ) {
+		if( (l = bleat_get_ss_lvl( ss )) >= 0 ) {
+			len += snprintf( mbuf + len, mlen - len, " %s=%d", bleat_ss_name( ss ), l );
+		} else {
+			len += snprintf( mbuf + len, mlen - len, " %s=global", bleat_ss_name( ss ) );
+		}
+	}
+
+	return 0;
+}
+
+/*
+	Fill a buffer with the extended stats for all ports. Caller must free the buffer.
+	If memory becomes an issue, this returns NULL to indicate error.
+*/
+static char* gen_exstats( sriov_conf_t* conf ) {
+	char*	xbuf = NULL;							// extended stats from one port
+	char*	rbuf = NULL;							// response buffer with all output
+	int		rbsize = sizeof( char ) * 1024 * 10;	// amount allocated in rbuf
+	int		rbused = 0;								// amount used in the response buffer
+	int		xbsize = sizeof( char ) * 1024 * 5;
+	int		i;
+	int		len;
+
+	if( (rbuf = (char *) malloc( rbsize )) != NULL ) {
+		*rbuf = 0;
+		if( (xbuf = (char *) malloc( xbsize )) != NULL ) {
+			for( i = 0; i < conf->num_ports; i++ ) {
+				len = sprintf( xbuf, "\nport %d:\n", i );
+				len += port_xstats_display( conf->ports[i].rte_port_number, xbuf + len, xbsize - len );
+				if( len + rbused > rbsize ) {
+					while( rbused + len < rbsize ) {
+						rbsize += rbsize/2;
+					}
+					if( (rbuf = (char *) realloc( rbuf, rbsize )) == NULL ) {
+						bleat_printf( 0, "WARN: unable to get enough memory to display extended stats" );
+						return NULL;
+					}
+				}
+
+				strcat( rbuf, xbuf );
+				rbused += len;
+			}
+
+			free( xbuf );
+		}
+	}
+
+	return rbuf;
+}
+
+/*
+	Generate the response for a show request. Conf is either the running config
+	(main thread) or a config snapshot (request worker). Extended stats use the
+	per port xstat buffers in the running config and so must only be requested
+	on the main thread (see ro_request()).
+*/
+static void show_request( parms_t* parms, sriov_conf_t* conf, req_t* req ) {
+	char*	buf;				// buffer generated by the stats functions
+
+	if( parms->forreal ) {
+		if( req->resource == NULL ) {
+			vfd_req_response( req, RESP_ERROR, "unable to generate stats: internal mishap: null resource" );
+		} else {
+			switch( *req->resource ) {
+				case 'a':
+					if( strcmp( req->resource, "all" ) == 0 ) {				// dump just the VF information
+						if( (buf = gen_stats( conf, !PFS_ONLY, ALL_PFS )) != NULL )  {
+							vfd_req_response( req, RESP_OK, buf );
+							free( buf );
+						} else {
+							vfd_req_response( req, RESP_ERROR, "unable to generate stats" );
+						}
+					} else {
+						vfd_req_response( req, RESP_ERROR, "unrecognised show suboption" );
+					}
+					break;
+
+				case 'e':
+					if( strncmp( req->resource, "ex", 2 ) == 0 ) {							// show extended stats
+						buf = gen_exstats( conf );						// create a buffer with stats for all ports
+						if( buf != NULL ) {
+							vfd_req_response( req, RESP_OK, buf );
+							free( buf );
+						} else {
+							vfd_req_response( req, RESP_ERROR, "unable to generate extended stats" );
+						}
+					} else {
+						vfd_req_response( req, RESP_ERROR, "unrecognised show suboption" );
+					}
+					break;
+
+				case 'm':			// show mirrors for a pf
+					if( strncmp( req->resource, "mirror", 6 ) == 0 ) {
+						if( (buf = gen_mirror_stats( conf, -1 )) != NULL ) {
+							vfd_req_response( req, RESP_OK, buf );
+							free( buf );
+						} else {
+							vfd_req_response( req, RESP_ERROR, "unable to generate mirror stats" );
+						}
+					} else {
+						vfd_req_response( req, RESP_ERROR, "unrecognised show suboption" );
+					}
+					break;
+
+				case 'p':
+					if( strcmp( req->resource, "perf" ) == 0 ) {							// request latency by action and stage
+						if( (buf = perf_show( )) != NULL ) {
+							vfd_req_response( req, RESP_OK, buf );
+							free( buf );
+						} else {
+							vfd_req_response( req, RESP_ERROR, "unable to generate perf stats" );
+						}
+					} else if( strcmp( req->resource, "pfs" ) == 0 ) {						// dump just the PF information (skip vf)
+						if( (buf = gen_stats( conf, PFS_ONLY, ALL_PFS )) != NULL )  {
+							vfd_req_response( req, RESP_OK, buf );
+							free( buf );
+						} else {
+							vfd_req_response( req, RESP_ERROR, "unable to generate pf stats" );
+						}
+					} else {
+						vfd_req_response( req, RESP_ERROR, "unrecognised show suboption" );
+					}
+					break;
+				
+				default:
+					if( isdigit( *req->resource ) ) {						// dump just for the indicated pf
+						if( (buf = gen_stats( conf, !PFS_ONLY, atoi( req->resource ) )) != NULL )  {
+							vfd_req_response( req, RESP_OK, buf );
+							free( buf );
+						} else {
+							vfd_req_response( req, RESP_ERROR, "unable to generate pf stats" );
+						}
+					} else {												// assume we dump for all
+						if( req->resource ) {
+							bleat_printf( 2, "show: unknown target supplied: %s", req->resource );
+						}
+						vfd_req_response( req, RESP_ERROR, 
+								"unable to generate stats: unnown target supplied (not one of all, pfs, extended or pf-number)" );
+					}
+			}
+		}
+	} else {
+		vfd_req_response( req, RESP_ERROR, "VFD running in 'no harm' (-n) mode; no stats available." );
+	}
+}
+
+/*
+	Mark the start of handling for the request: the time it waited since it was read
+	is recorded and the thread's nic update time is cleared.
+*/
+static void req_begin( req_t* req ) {
+	uint64_t now;
+
+	now = perf_now( );
+	if( req->rx_us ) {
+		perf_record( req->rtype, PS_QUEUE, now - req->rx_us );
+	}
+	req->mark = now;
+	perf_begin( );
+
+	if( req->op_id ) {
+		op_start( req->op_id );
+	}
+}
+
+// ---- request workers ------------------------------------------------------------------------------
+
+static pthread_mutex_t	wq_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	wq_cond = PTHREAD_COND_INITIALIZER;
+static req_t*		wq_head = NULL;			// requests waiting for a worker; liveness requests are first
+static req_t*		wq_tail = NULL;
+static req_t*		wq_ltail = NULL;		// last liveness request in the worker queue
+static int			wq_stop = 0;
+static int			nworkers = 0;
+static pthread_t*	wtids = NULL;
+static parms_t*		wparms = NULL;
+
+static pthread_mutex_t	intake_lock = PTHREAD_MUTEX_INITIALIZER;	// raw reads and the class queues
+static req_t*		rq_head[RC_NCLASSES];		// requests read but not yet handled by the main thread, by class
+static req_t*		rq_tail[RC_NCLASSES];
+static int			rq_pending = 0;				// number in the class queues
+static int			rif_busy = 0;				// main thread is handling a request (workers sweep the intake)
+
+static void intake_sweep( void );
+
+/*
+	Returns true if the request only reads the configuration and can be handled by
+	a worker from a config snapshot. Extended stats are not included as they are
+	gathered into buffers hung off the running config's ports.
+*/
+static int ro_request( req_t* req ) {
+	switch( req->rtype ) {
+		case RT_PING:
+		case RT_EXPORT:
+		case RT_OPSTATUS:
+			return 1;
+
+		case RT_SHOW:
+			return req->resource != NULL && strncmp( req->resource, "ex", 2 ) != 0;
+	}
+
+	return 0;
 }
 
 /*
-	Construct json to write onto the response pipe.  The response pipe is opened in non-block mode
-	so that it will fail immiediately if there isn't a reader or the pipe doesn't exist. We assume
-	that the requestor opens the pipe before sending the request so that if it is delayed after
-	sending the request it does not prevent us from writing to the pipe.  If we don't open in 	
-	non-blocked mode we could hang foever if the requestor dies/aborts.
-
-	To work with remote requests (tokay and containers) the response must contain an action which
-	is 'response', and the vfd_rid which was passed in.  This allows a single response pipe to be
-	used, and allows for future expansion of other information sent via the pipe, not just responses.
+	Handle a read only request on a worker thread. Conf is the config snapshot; if
+	there isn't one yet the running config is used under the update lock.
 */
-extern void vfd_response( char* rpipe, int state, const_str vfd_rid, const_str msg ) {
-	int 	fd;
-	char	buf[BUF_1K * 4];
-	char*	dmsg;			// duplicate message that we can mutilate
-	char*	dptr;			// pointer into dmsg for strtok
-	char*	tok;
-	const_str	sep = "\n";	// message seperators in the array; lead newline helps with visual alignment which can be important
+static void worker_request( parms_t* parms, req_t* req ) {
+	cfg_snap_t*	snap;
+	char*	buf;
+	char	mbuf[2048];
+
+	switch( req->rtype ) {
+		case RT_PING:
+			snprintf( mbuf, sizeof( mbuf ), "pong: %s", version );
+			vfd_req_response( req, RESP_OK, mbuf );
+			break;
 
-	if( rpipe == NULL ) {
-		bleat_printf( 1, "response: unable to respond, response pipe name is nil" );
-		return;
-	}
+		case RT_EXPORT:
+			if( copy_vf_config( parms, req->resource, req->output ) ) {
+				snprintf( mbuf, sizeof( mbuf ), "config %s exported to %s", req->resource, req->output );
+				vfd_req_response( req, RESP_OK, mbuf );
+			} else {
+				snprintf( mbuf, sizeof( mbuf ), "unable to export config %s to %s: %s", req->resource, req->output, strerror( errno ) );
+				vfd_req_response( req, RESP_ERROR, mbuf );
+			}
+			break;
 
-	if( vfd_rid == NULL ) {
-		bleat_printf( 1, "response: did not have a vfd_rid to send back" );
-		vfd_rid = "not-supplied";
-	}
+		case RT_SHOW:
+			if( (snap = rcu_acquire( )) != NULL ) {
+				bleat_printf( 3, "worker: show from config snapshot %lld", (long long) snap->version );
+				show_request( parms, &snap->conf, req );
+			} else {
+				pthread_mutex_lock( &running_config->update_lock );			// nothing published yet (startup)
+				show_request( parms, running_config, req );
+				pthread_mutex_unlock( &running_config->update_lock );
+			}
+			rcu_release( );
+			break;
 
-	bleat_printf( 3, "response: opening response pipe: %s", rpipe );
-	if( (fd = open( rpipe, O_WRONLY | O_NONBLOCK, 0 )) < 0 ) {
-	 	bleat_printf( 0, "unable to deliver response: open failed: %s: %s", rpipe, strerror( errno ) );
-		return;
+		case RT_OPSTATUS:
+			if( (buf = op_status( req->resource )) != NULL ) {
+				vfd_req_response( req, RESP_OK, buf );
+				free( buf );
+			} else {
+				vfd_req_response( req, RESP_ERROR, "unable to generate op status" );
+			}
+			break;
 	}
+}
 
-	if( bleat_will_it( 4 ) ) {
-		bleat_printf( 4, "sending response: %s(%d) [%d] %s", rpipe, fd, state, msg );
-	} else {
-		bleat_printf( 2, "sending response: %s(%d) [%d] %d bytes", rpipe, fd, state, strlen( msg ) );
-	}
+/*
+	Worker thread: pull requests from the queue and handle them until stopped.
+*/
+static void* req_worker( void* data ) {
+	req_t*	req;
 
-	snprintf( buf, sizeof( buf ), "{ \"action\": \"response\", \"vfd_rid\": \"%s\", \"state\": \"%s\", \"msg\": [", vfd_rid, state ? "ERROR" : "OK" );
-	bleat_printf( 3, "response: header: %s", buf );
+	struct timespec	ts;
 
-	if( vfd_write( fd, buf, strlen( buf ) ) > 0 ) {
-		if( msg != NULL  && (dmsg = strdup( msg )) != NULL ) {
-			dptr = dmsg;
-			while( (tok = strtok_r( NULL, "\n", &dptr )) != NULL ) {	//  bloody json doesn't accept strings with newlines, so we build an array; grrr
-				snprintf( buf, sizeof( buf ), "%s\"%s\"", sep, tok );
-				vfd_write( fd, buf, strlen( buf ) );					// ignore state; we need to close the json regardless
-				sep = ",\n";											// after the first we need commas before the next
+	while( 1 ) {
+		pthread_mutex_lock( &wq_lock );
+		while( wq_head == NULL && ! wq_stop ) {
+			clock_gettime( CLOCK_REALTIME, &ts );
+			ts.tv_nsec += RQ_SWEEP_MS * 1000000L;
+			if( ts.tv_nsec >= 1000000000L ) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
 			}
 
-			free( dmsg );
+			if( pthread_cond_timedwait( &wq_cond, &wq_lock, &ts ) == ETIMEDOUT && wq_head == NULL && ! wq_stop ) {
+				pthread_mutex_unlock( &wq_lock );
+				intake_sweep( );							// main thread may be stuck in a long request
+				pthread_mutex_lock( &wq_lock );
+			}
 		}
-	}
-	
-	snprintf( buf, sizeof( buf ), " ] }\n@eom@\n" );				// terminate the the message array, then the json
-	vfd_write( fd, buf, strlen( buf ) );
-	bleat_printf( 2, "response written to pipe" );			// only if all of message written
+		if( (req = wq_head) == NULL ) {						// stopping and nothing left
+			pthread_mutex_unlock( &wq_lock );
+			break;
+		}
+		if( (wq_head = req->next) == NULL ) {
+			wq_tail = NULL;
+		}
+		if( req == wq_ltail ) {
+			wq_ltail = NULL;
+		}
+		pthread_mutex_unlock( &wq_lock );
 
+		req_begin( req );
+		worker_request( wparms, req );
+		vfd_free_request( req );
+	}
 
-	bleat_pop_lvl();			// we assume it was pushed when the request received; we pop it once we respond
-	close( fd );
+	return NULL;
 }
 
 /*
-	Cleanup a request and free the memory.
+	Queue the request for a worker. Liveness requests go ahead of everything else
+	waiting (but stay in order among themselves). Returns 0 if there are no workers;
+	the caller must handle the request.
 */
-extern void vfd_free_request( req_t* req ) {
-	if( req->vfd_rid != NULL ) {
-		free( req->vfd_rid );
+static int queue_request( req_t* req ) {
+	if( nworkers <= 0 ) {
+		return 0;
 	}
 
-	if( req->resource != NULL ) {
-		free( req->resource );
-	}
-	if( req->resp_fifo != NULL ) {
-		free( req->resp_fifo );
+	req->worker = 1;
+	req->next = NULL;
+	pthread_mutex_lock( &wq_lock );
+	if( req->rclass == RC_LIVE ) {
+		if( wq_ltail != NULL ) {
+			req->next = wq_ltail->next;
+			wq_ltail->next = req;
+		} else {
+			req->next = wq_head;
+			wq_head = req;
+		}
+		wq_ltail = req;
+		if( req->next == NULL ) {
+			wq_tail = req;
+		}
+	} else {
+		if( wq_tail != NULL ) {
+			wq_tail->next = req;
+		} else {
+			wq_head = req;
+		}
+		wq_tail = req;
 	}
+	pthread_cond_signal( &wq_cond );
+	pthread_mutex_unlock( &wq_lock );
 
-	free( req );
+	return 1;
 }
 
 /*
-	Read a request from the fifo, and format it into a request block.
-	A pointer to the struct is returned; the caller must use vfd_free_request() to
-	properly free it.
+	Start n request worker threads. Read only requests (ping, show and export) are
+	then handled by the workers against the current config snapshot rather than on
+	the main thread. Returns the number started.
 */
-extern req_t* vfd_read_request( parms_t* parms ) {
-	void*	jblob;				// json parsing stuff
-	char*	rbuf;				// raw request buffer from the pipe
-	char*	stuff;				// stuff teased out of the json blob
-	char*	rid;				// request id we must track for caller
-	req_t*	req = NULL;
-	int		lvl;				// log level supplied
+extern int vfd_start_workers( parms_t* parms, int n ) {
+	int	i;
 
-	rbuf = rfifo_read( parms->rfifo );
-	if( ! *rbuf ) {				// empty, nothing to do
-		free( rbuf );
-		return NULL;
+	if( n <= 0 || nworkers > 0 ) {
+		return nworkers;
 	}
 
-	if( (jblob = jw_new( rbuf )) == NULL ) {
-		bleat_printf( 0, "ERR: failed to create a json parsing object for: %s", rbuf );
-		free( rbuf );
-		return NULL;
+	if( (wtids = (pthread_t *) malloc( sizeof( *wtids ) * n )) == NULL ) {
+		bleat_printf( 0, "ERR: unable to allocate request worker thread ids" );
+		return 0;
 	}
 
-	if( (stuff = jw_string( jblob, "action" )) == NULL ) {					// CAUTION: switch below expects stuff to have action
-		bleat_printf( 0, "ERR: request received without action: %s", rbuf );
-		free( rbuf );
-		jw_nuke( jblob );
-		return NULL;
+	wparms = parms;
+	wq_stop = 0;
+	for( i = 0; i < n; i++ ) {
+		if( pthread_create( &wtids[i], NULL, req_worker, NULL ) != 0 ) {
+			bleat_printf( 0, "WRN: unable to start request worker %d: %s", i, strerror( errno ) );
+			break;
+		}
+		nworkers++;
 	}
 
-	if( (req = (req_t *) malloc( sizeof( *req ) )) == NULL ) {
-		bleat_printf( 0, "ERR: memory allocation error tying to alloc request for: %s", rbuf );
-		free( rbuf );
-		jw_nuke( jblob );
-		return NULL;
+	bleat_printf( 1, "%d request workers started", nworkers );
+	return nworkers;
+}
+
+/*
+	Stop the request workers after they have finished what is queued.
+*/
+extern void vfd_stop_workers( void ) {
+	int	i;
+	int	n;
+
+	if( (n = nworkers) <= 0 ) {
+		return;
 	}
-	memset( req, 0, sizeof( *req ) );
 
-	bleat_printf( 2, "raw message: (%s)", rbuf );
+	pthread_mutex_lock( &wq_lock );
+	wq_stop = 1;
+	nworkers = 0;										// nothing more is queued
+	pthread_cond_broadcast( &wq_cond );
+	pthread_mutex_unlock( &wq_lock );
 
-	if( (rid = jw_string( jblob, "params.vfd_rid" )) != NULL ) {					// if request id supplied
-		req->vfd_rid = strdup( rid );
+	for( i = 0; i < n; i++ ) {
+		pthread_join( wtids[i], NULL );
 	}
 
-	switch( *stuff ) {				// we assume compiler builds a jump table which makes it faster than a bunch of nested string compares
-		case 'a':
-		case 'A':					// assume add until something else starts with a
-			req->rtype = RT_ADD;
-			break;
+	free( wtids );
+	wtids = NULL;
+	bleat_printf( 1, "request workers stopped" );
+}
 
-		case 'c':					// assume "cpu_alrm_thresh"
-			req->rtype = RT_CPU_ALARM;
-			break;
+// ---- request intake ----------------------------------------------------------------------------
 
-		case 'e':
-			req->rtype = RT_EXPORT;			// export a live config
-			break;
+/*
+	Return the priority class of the request. Liveness (ping) is answered before
+	anything else; read only requests (show, export, dump) are next and go to the
+	workers when they can; everything which changes the configuration or the nic
+	is a mutation and is handled by the main thread in arrival order.
+*/
+static int req_class( req_t* req ) {
+	switch( req->rtype ) {
+		case RT_PING:
+			return RC_LIVE;
 
-		case 'd':
-		case 'D':
-			if( strcmp( stuff, "dump" ) == 0 ) {
-				req->rtype = RT_DUMP;
-			} else {
-				req->rtype = RT_DEL;
-			}
-			break;
+		case RT_SHOW:
+		case RT_EXPORT:
+		case RT_DUMP:
+		case RT_OPSTATUS:
+			return RC_READ;
+	}
 
-		case 'm':
-			req->rtype = RT_MIRROR;
-			break;
+	return RC_MUTATE;
+}
 
-		case 'p':					// ping
-			req->rtype = RT_PING;
-			break;
+/*
+	Read everything waiting on the fifo and the request socket (up to the queue
+	limit) and classify it. Read only requests are given to the workers straight
+	away; the rest are queued by class for the main thread. The caller must hold the
+	intake lock. Returns the number of requests read.
+*/
+static int intake( parms_t* parms ) {
+	req_t*	req;
+	char*	rbuf;
+	uint64_t now;
+	int		cid;
+	int		rlen;
+	int		n = 0;
+
+	while( rq_pending < RQ_MAX_PENDING ) {				// at the limit we leave the rest unread; writers block or queue
+		cid = -1;
+		rbuf = rfifo_read( parms->rfifo );
+		if( ! *rbuf ) {									// fifo empty, try the socket
+			free( rbuf );
+			if( (rbuf = sock_read( &cid, &rlen )) == NULL ) {	// nothing left
+				break;
+			}
+		} else {
+			rlen = strlen( rbuf );
+		}
 
-		case 's':
-		case 'S':					// assume show
-			req->rtype = RT_SHOW;
-			break;
+		now = perf_now( );
+		if( (req = parse_request( rbuf, rlen, cid )) == NULL ) {
+			continue;
+		}
+		n++;
+		req->rx_us = now;
+		perf_record( req->rtype, PS_PARSE, perf_now( ) - now );
 
-		case 'v':
-			req->rtype = RT_VERBOSE;
-			break;	
-
-		default:
-			req->rtype = RT_UNKNOWN;
-			bleat_printf( 0, "ERR: unrecognised action in request: %s", rbuf );
-			//jw_nuke( jblob );
-			//return NULL;
-			break;
-	}
+		req->rclass = req_class( req );
+		if( ro_request( req ) && queue_request( req ) ) {		// a worker has it from here
+			continue;
+		}
 
-	if( (stuff = jw_string( jblob, "params.filename")) != NULL ) {
-		req->resource = strdup( stuff );
-	} else {
-		if( (stuff = jw_string( jblob, "params.resource")) != NULL ) {
-			req->resource = strdup( stuff );
+		if( req->async && req->rclass == RC_MUTATE ) {			// accept now; outcome is reported when it's done
+			if( (req->op_id = op_accept( req )) == 0 ) {
+				vfd_req_response( req, RESP_ERROR, "unable to accept async request: too many unfinished operations" );
+				vfd_free_request( req );
+				continue;
+			}
+			accept_response( req );
+		}
+
+		req->next = NULL;
+		if( rq_tail[req->rclass] != NULL ) {
+			rq_tail[req->rclass]->next = req;
+		} else {
+			rq_head[req->rclass] = req;
 		}
+		rq_tail[req->rclass] = req;
+		rq_pending++;
 	}
 
-	if( (stuff = jw_string( jblob, "params.output")) != NULL ) {
-		req->output = strdup( stuff );
+	return n;
+}
+
+/*
+	Called by an idle worker. While the main thread is in the middle of a request
+	(a large add can take a while) nothing is reading the fifo or the socket, so a
+	worker reads what is waiting; pings and read only requests are answered, and
+	mutations are left queued for the main thread. If another thread is reading
+	there is nothing to do.
+*/
+static void intake_sweep( void ) {
+	int n;
+
+	if( ! __atomic_load_n( &rif_busy, __ATOMIC_ACQUIRE ) || wparms == NULL ) {
+		return;
 	}
 
-	if( (stuff = jw_string( jblob, "params.r_fifo")) != NULL ) {
-		req->resp_fifo = strdup( stuff );
-	} else {
-		bleat_printf( 1, "no response fifo given in request" );
+	if( pthread_mutex_trylock( &intake_lock ) != 0 ) {
+		return;
 	}
-	
-	req->log_level = lvl = jw_missing( jblob, "params.loglevel" ) ? 0 : (int) jw_value( jblob, "params.loglevel" );
-	bleat_push_glvl( lvl );					// push the level if greater, else push current so pop won't fail
 
-	free( rbuf );
-	jw_nuke( jblob );
-	return req;
+	if( (n = intake( wparms )) > 0 ) {
+		bleat_printf( 3, "worker: %d requests read while the main thread was busy", n );
+	}
+	pthread_mutex_unlock( &intake_lock );
 }
 
 /*
-	Fill a buffer with the extended stats for all ports. Caller must free the buffer.
-	If memory becomes an issue, this returns NULL to indicate error.
+	Read all waiting requests from the fifo and the request socket, and return the
+	next one the main thread should handle: liveness first, then read only requests
+	(those the workers can't take), then mutations in arrival order. Returns nil if
+	there is nothing for the main thread. The request's log level is pushed; the
+	caller must use vfd_free_request() to properly free it.
 */
-static char* gen_exstats( sriov_conf_t* conf ) {
-	char*	xbuf = NULL;							// extended stats from one port
-	char*	rbuf = NULL;							// response buffer with all output
-	int		rbsize = sizeof( char ) * 1024 * 10;	// amount allocated in rbuf
-	int		rbused = 0;								// amount used in the response buffer
-	int		xbsize = sizeof( char ) * 1024 * 5;
-	int		i;
-	int		len;
+extern req_t* vfd_read_request( parms_t* parms ) {
+	req_t*	req = NULL;
+	int		c;
 
-	if( (rbuf = (char *) malloc( rbsize )) != NULL ) {
-		*rbuf = 0;
-		if( (xbuf = (char *) malloc( xbsize )) != NULL ) {
-			for( i = 0; i < conf->num_ports; i++ ) {
-				len = sprintf( xbuf, "\nport %d:\n", i );
-				len += port_xstats_display( conf->ports[i].rte_port_number, xbuf + len, xbsize - len );
-				if( len + rbused > rbsize ) {
-					while( rbused + len < rbsize ) {
-						rbsize += rbsize/2;
-					}
-					if( (rbuf = (char *) realloc( rbuf, rbsize )) == NULL ) {
-						bleat_printf( 0, "WARN: unable to get enough memory to display extended stats" );
-						return NULL;
-					}
-				}
+	pthread_mutex_lock( &intake_lock );
+	intake( parms );
 
-				strcat( rbuf, xbuf );
-				rbused += len;
+	for( c = 0; c < RC_NCLASSES; c++ ) {
+		if( (req = rq_head[c]) != NULL ) {
+			if( (rq_head[c] = req->next) == NULL ) {
+				rq_tail[c] = NULL;
 			}
-
-			free( xbuf );
+			req->next = NULL;
+			rq_pending--;
+			break;
 		}
 	}
+	pthread_mutex_unlock( &intake_lock );
 
-	return rbuf;
+	if( req != NULL ) {
+		bleat_push_glvl( req->log_level );		// push the level if greater, else push current so pop won't fail
+	}
+	return req;
+}
+
+/*
+	Returns true if the next mutation queued for the main thread is an async add and
+	the current batch of deferred adds isn't full. While that holds the nic update
+	for an async add can be left to the add which follows it.
+*/
+static int batch_next( void ) {
+	req_t*	next;
+	int		rc;
+
+	if( op_ndeferred( ) >= OP_MAX_BATCH ) {
+		return 0;
+	}
+
+	pthread_mutex_lock( &intake_lock );
+	next = rq_head[RC_MUTATE];
+	rc = next != NULL && next->rtype == RT_ADD && next->op_id != 0;
+	pthread_mutex_unlock( &intake_lock );
+
+	return rc;
 }
 
 /*
@@ -1458,7 +3177,7 @@ static char* gen_exstats( sriov_conf_t* conf ) {
 extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 	req_t*	req;
 	char	mbuf[2048];			// message and work buffer
-	char*	buf;				// buffer gnerated by something else
+	char*	buf;
 	int		rc = 0;
 	char*	reason;
 	int		req_handled = 0;
@@ -1473,12 +3192,14 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 		if( (req = vfd_read_request( parms )) != NULL ) {
 			bleat_printf( 3, "got request" );
 			req_handled = 1;
+			__atomic_store_n( &rif_busy, 1, __ATOMIC_RELEASE );		// idle workers watch the intake while we're busy
+			req_begin( req );
 
 			switch( req->rtype ) {
 				case RT_PING:
 					bleat_printf( 3, "responding to ping" );
 					snprintf( mbuf, sizeof( mbuf ), "pong: %s", version );
-					vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, mbuf );
+					vfd_req_response( req, RESP_OK, mbuf );
 					break;
 
 				case RT_ADD:
@@ -1489,23 +3210,35 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 					}
 
 					bleat_printf( 2, "adding vf from file: %s", mbuf );
-					if( vfd_add_vf( conf, mbuf, &reason ) ) {				// read the config file and add to in mem config if ok
+					if( access( mbuf, R_OK ) != 0 && watch_is_live( mbuf ) ) {		// watcher got to it first; nothing left to do
+						snprintf( mbuf, sizeof( mbuf ), "vf added successfully (config watcher): %s", req->resource );
+						vfd_req_response( req, RESP_OK, mbuf );
+						bleat_printf( 1, "vf added: %s", mbuf );
+					} else if( vfd_add_vf( conf, mbuf, &reason ) ) {				// read the config file and add to in mem config if ok
 						relocate_vf_config( parms, mbuf, NULL );			// move the config to the live directory on success (nil suffix indicates live dir)
-						if( vfd_update_nic( parms, conf ) == 0 ) {			// added to config was good, drive the nic update
+						if( req->op_id && batch_next( ) ) {					// more async adds queued; they share one nic update
 							snprintf( mbuf, sizeof( mbuf ), "vf added successfully: %s", req->resource );
-							vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, mbuf );
+							op_defer( req->op_id, mbuf );
+							req->op_id = 0;
+							bleat_pop_lvl( );
+							bleat_printf( 2, "vf add: nic update deferred for batch: %s", req->resource );
+						} else if( vfd_update_nic( parms, conf ) == 0 ) {			// added to config was good, drive the nic update
+							snprintf( mbuf, sizeof( mbuf ), "vf added successfully: %s", req->resource );
+							vfd_req_response( req, RESP_OK, mbuf );
 							bleat_printf( 1, "vf added: %s", mbuf );
+							op_nic_done( RESP_OK );							// any adds deferred in the batch are on the nic too
 						} else {
 							// TODO -- must turn the vf off so that another add can be sent without forcing a delete
 							// 		update_nic always returns good now, so this waits until it catches errors and returns bad
 							snprintf( mbuf, sizeof( mbuf ), "vf add failed: unable to configure the vf for: %s", req->resource );
-							vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, mbuf );
+							vfd_req_response( req, RESP_ERROR, mbuf );
 							bleat_printf( 1, "vf add failed nic update error" );
+							op_nic_done( RESP_ERROR );
 						}
 					} else {
 						relocate_vf_config( parms, mbuf, ".error" );		// move the config file to *.error for debugging, but keep in same directory
 						snprintf( mbuf, sizeof( mbuf ), "unable to add vf: %s: %s", req->resource, reason );
-						vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, mbuf );
+						vfd_req_response( req, RESP_ERROR, mbuf );
 						free( reason );
 					}
 					if( bleat_will_it( 4 ) ) {					// TODO:  remove after testing
@@ -1513,6 +3246,69 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 					}
 					break;
 
+				case RT_UPDATE:
+					if( strchr( req->resource, '/' ) != NULL ) {									// assume fully qualified if it has a slant
+						strcpy( mbuf, req->resource );
+					} else {
+						snprintf( mbuf, sizeof( mbuf ), "%s/%s", parms->config_dir, req->resource );
+					}
+
+					bleat_printf( 2, "updating vf from file: %s", mbuf );
+					if( access( mbuf, R_OK ) != 0 && watch_is_live( mbuf ) ) {		// watcher got to it first; nothing left to do
+						snprintf( mbuf, sizeof( mbuf ), "vf updated successfully (config watcher): %s", req->resource );
+						vfd_req_response( req, RESP_OK, mbuf );
+						bleat_printf( 1, "vf updated: %s", mbuf );
+					} else if( vfd_update_vf( conf, mbuf, &reason ) ) {			// changes only what differs from the live vf
+						relocate_vf_config( parms, mbuf, NULL );					// replaces the live config
+						vfd_update_nic( parms, conf );
+						snprintf( mbuf, sizeof( mbuf ), "vf updated successfully: %s", req->resource );
+						vfd_req_response( req, RESP_OK, mbuf );
+						bleat_printf( 1, "vf updated: %s", mbuf );
+					} else {
+						relocate_vf_config( parms, mbuf, ".error" );				// live vf and config are left as they were
+						snprintf( mbuf, sizeof( mbuf ), "unable to update vf: %s: %s", req->resource, reason );
+						vfd_req_response( req, RESP_ERROR, mbuf );
+						free( reason );
+					}
+					break;
+
+				case RT_PREPARE:
+					if( strchr( req->resource, '/' ) != NULL ) {									// assume fully qualified if it has a slant
+						strcpy( mbuf, req->resource );
+					} else {
+						snprintf( mbuf, sizeof( mbuf ), "%s/%s", parms->config_dir, req->resource );
+					}
+
+					bleat_printf( 2, "preparing vf from file: %s", mbuf );
+					if( vfd_prepare_vf( conf, mbuf, &reason ) ) {
+						relocate_vf_config( parms, mbuf, PREP_SUFFIX );				// parked until commit (watcher and restart ignore it)
+						vfd_update_nic( parms, conf );								// everything but the link
+						snprintf( mbuf, sizeof( mbuf ), "vf prepared successfully: %s", req->resource );
+						vfd_req_response( req, RESP_OK, mbuf );
+					} else {
+						relocate_vf_config( parms, mbuf, ".error" );
+						snprintf( mbuf, sizeof( mbuf ), "unable to prepare vf: %s: %s", req->resource, reason );
+						vfd_req_response( req, RESP_ERROR, mbuf );
+						free( reason );
+					}
+					break;
+
+				case RT_COMMIT:
+				case RT_ABORT:
+					if( (req->rtype == RT_COMMIT ? vfd_commit_vf( parms, conf, req->resource, &reason ) : vfd_abort_vf( parms, conf, req->resource, &reason )) ) {
+						if( req->rtype == RT_ABORT ) {
+							vfd_update_nic( parms, conf );
+						}
+						snprintf( mbuf, sizeof( mbuf ), "vf %s successfully: %s", req->rtype == RT_COMMIT ? "committed" : "aborted", req->resource );
+						vfd_req_response( req, RESP_OK, mbuf );
+					} else {
+						snprintf( mbuf, sizeof( mbuf ), "unable to %s vf: %s: %s", req->rtype == RT_COMMIT ? "commit" : "abort", req->resource, reason );
+						vfd_req_response( req, RESP_ERROR, mbuf );
+						free( reason );
+					}
+					bleat_printf( 1, "%s", mbuf );
+					break;
+
 				case RT_DEL:
 					if( strchr( req->resource, '/' ) != NULL ) {									// assume fully qualified if it has a slant
 						strcpy( mbuf, req->resource );
@@ -1524,12 +3320,12 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 					if( vfd_del_vf( parms, conf, mbuf, &reason ) ) {		// successfully updated internal struct
 						if( vfd_update_nic( parms, conf ) == 0 ) {			// nic update was good too
 							snprintf( mbuf, sizeof( mbuf ), "vf deleted successfully: %s", req->resource );
-							vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, mbuf );
+							vfd_req_response( req, RESP_OK, mbuf );
 							bleat_printf( 1, "vf deleted: %s", mbuf );
 						} // TODO need else -- see above
 					} else {
 						snprintf( mbuf, sizeof( mbuf ), "unable to delete internal config for vf: %s: %s", req->resource, reason );
-						vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, mbuf );
+						vfd_req_response( req, RESP_ERROR, mbuf );
 						free( reason );
 					}
 					if( bleat_will_it( 4 ) ) {					// TODO:  remove after testing
@@ -1540,7 +3336,7 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 				case RT_DUMP:									// spew everything to the log
 					dump_dev_info( conf->num_ports);			// general info about each port
   					dump_sriov_config( conf );					// pf/vf specific info
-					vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, "dump captured in the log" );
+					vfd_req_response( req, RESP_OK, "dump captured in the log" );
 
 					char*	stats_buf;
 					if( (stats_buf = (char *) malloc( sizeof( char ) * 10 * 1024 )) != NULL ) {
@@ -1555,10 +3351,10 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 				case RT_EXPORT:						// copy the named config file to a supplied location
 					if( copy_vf_config( parms, req->resource, req->output ) ) {
 						snprintf( mbuf, sizeof( mbuf ), "config %s exported to %s", req->resource, req->output );
-						vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, mbuf );
+						vfd_req_response( req, RESP_OK, mbuf );
 					} else {
 						snprintf( mbuf, sizeof( mbuf ), "unable to export config %s to %s: %s", req->resource, req->output, strerror( errno ) );
-						vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, mbuf );
+						vfd_req_response( req, RESP_ERROR, mbuf );
 					}
 					break;
 
@@ -1566,10 +3362,10 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 					if( parms->forreal ) {
 						if( vfd_update_mirror( conf, req->resource, &reason ) ) {
 							snprintf( mbuf, sizeof( mbuf ), "mirror update successful: %s", req->resource );
-							vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, mbuf );
+							vfd_req_response( req, RESP_OK, mbuf );
 						} else {
 							snprintf( mbuf, sizeof( mbuf ), "mirror update failed: %s: %s", req->resource, reason ? reason : "" );
-							vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, mbuf );
+							vfd_req_response( req, RESP_ERROR, mbuf );
 						}
 						bleat_printf( 1, "%s", mbuf );
 
@@ -1579,83 +3375,23 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 					break;
 
 				case RT_SHOW:
-					if( parms->forreal ) {
-						if( req->resource == NULL ) {
-							vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate stats: internal mishap: null resource" );
-						} else {
-							switch( *req->resource ) {
-								case 'a':
-									if( strcmp( req->resource, "all" ) == 0 ) {				// dump just the VF information
-										if( (buf = gen_stats( conf, !PFS_ONLY, ALL_PFS )) != NULL )  {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
-										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate stats" );
-										}
-									} else {
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unrecognised show suboption" );
-									}
-									break;
-
-								case 'e':
-									if( strncmp( req->resource, "ex", 2 ) == 0 ) {							// show extended stats
-										buf = gen_exstats( conf );						// create a buffer with stats for all ports
-										if( buf != NULL ) {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
-										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate extended stats" );
-										}
-									} else {
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unrecognised show suboption" );
-									}
-									break;
-
-								case 'm':			// show mirrors for a pf
-									if( strncmp( req->resource, "mirror", 6 ) == 0 ) {
-										if( (buf = gen_mirror_stats( conf, -1 )) != NULL ) {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
-										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate mirror stats" );
-										}
-									} else {
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unrecognised show suboption" );
-									}
-									break;
-
-								case 'p':
-									if( strcmp( req->resource, "pfs" ) == 0 ) {								// dump just the PF information (skip vf)
-										if( (buf = gen_stats( conf, PFS_ONLY, ALL_PFS )) != NULL )  {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
-										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate pf stats" );
-										}
-									} else {
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unrecognised show suboption" );
-									}
-									break;
-								
-								default:
-									if( isdigit( *req->resource ) ) {						// dump just for the indicated pf
-										if( (buf = gen_stats( conf, !PFS_ONLY, atoi( req->resource ) )) != NULL )  {
-											vfd_response( req->resp_fifo, RESP_OK, req->vfd_rid, buf );
-											free( buf );
-										} else {
-											vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "unable to generate pf stats" );
-										}
-									} else {												// assume we dump for all
-										if( req->resource ) {
-											bleat_printf( 2, "show: unknown target supplied: %s", req->resource );
-										}
-										vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, 
-												"unable to generate stats: unnown target supplied (not one of all, pfs, extended or pf-number)" );
-									}
-							}
-						}
+					show_request( parms, conf, req );
+					break;
+
+				case RT_OPSTATUS:
+					if( (buf = op_status( req->resource )) != NULL ) {
+						vfd_req_response( req, RESP_OK, buf );
+						free( buf );
+					} else {
+						vfd_req_response( req, RESP_ERROR, "unable to generate op status" );
+					}
+					break;
+
+				case RT_RELOAD:
+					if( vfd_reload( parms, conf, mbuf, sizeof( mbuf ) ) == 0 ) {
+						vfd_req_response( req, RESP_OK, mbuf );
 					} else {
-						vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "VFD running in 'no harm' (-n) mode; no stats available." );
+						vfd_req_response( req, RESP_ERROR, mbuf );
 					}
 					break;
 
@@ -1677,12 +3413,14 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 							snprintf( mbuf, sizeof( mbuf ), "cpu alarm threshold not changed to: bad or missing value" );
 						}
 
-						vfd_response( req->resp_fifo, rc, req->vfd_rid, mbuf );
+						vfd_req_response( req, rc, mbuf );
 						break;
 
 
 				case RT_VERBOSE:
-					if( req->log_level >= 0 ) {
+					if( req->resource != NULL && *req->resource ) {			// subsystem level(s) rather than the global level
+						rc = set_ss_levels( req->resource, req->log_level, mbuf, sizeof( mbuf ) );
+					} else if( req->log_level >= 0 ) {
 						bleat_set_lvl( req->log_level );
 						bleat_push_lvl( req->log_level );			// save it so when we pop later it doesn't revert
 
@@ -1693,16 +3431,24 @@ extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever ) {
 						snprintf( mbuf, sizeof( mbuf ), "loglevel out of range: %d", req->log_level );
 					}
 
-					vfd_response( req->resp_fifo, rc, req->vfd_rid, mbuf );
+					vfd_req_response( req, rc, mbuf );
 					break;
 					
 
 				default:
-					vfd_response( req->resp_fifo, RESP_ERROR, req->vfd_rid, "urrecognised request." );
+					vfd_req_response( req, RESP_ERROR, "urrecognised request." );
 					break;
 			}
 
+			if( req->op_id ) {											// async request finished without a response
+				op_complete( req->op_id, RESP_ERROR, "request finished without a result" );
+			}
+			if( op_ndeferred( ) > 0 && ! batch_next( ) ) {				// batch ended with something other than a good add
+				op_nic_done( vfd_update_nic( parms, conf ) == 0 ? RESP_OK : RESP_ERROR );
+			}
+
 			vfd_free_request( req );
+			__atomic_store_n( &rif_busy, 0, __ATOMIC_RELEASE );
 		}
 		
 		if( forever )
@@ -14,6 +14,7 @@
 #define DELETED (-1)
 #define UNCHANGED 0
 #define RESET	2
+#define UPDATED	3				// changed in place by an update request; vf->delta has the details
 
 #define RESP_ERROR	1			// states for response bundler
 #define RESP_OK		0
@@ -28,8 +29,25 @@
 #define RT_MIRROR 7				// mirror on/off command
 #define RT_CPU_ALARM 8			// set the cpu alarm threshold
 #define RT_EXPORT 9				// copy a live config file to given filename
+#define RT_RELOAD 10			// reread the parm file and add/retire PFs
+#define RT_UPDATE 11			// change a live VF in place
+#define RT_PREPARE 12			// configure a VF with the link held down
+#define RT_COMMIT 13			// bring up the link on a prepared VF
+#define RT_ABORT 14				// remove a prepared VF
+#define RT_OPSTATUS 15			// status of an async operation
 #define RT_UNKNOWN 100
 
+#define RC_LIVE		0			// request priority classes (highest first)
+#define RC_READ		1
+#define RC_MUTATE	2
+#define RC_NCLASSES	3
+
+#define RQ_MAX_PENDING	1024	// requests read and queued for the main thread before we stop reading
+#define RQ_SWEEP_MS		100		// idle workers read the intake this often while the main thread is busy
+#define OP_MAX_BATCH	32		// async adds applied before a nic update is forced
+
+#define PREP_SUFFIX	".prep"		// suffix given to a prepared VF's config file until commit
+
 #define BUF_1K	1024			// simple buffer size constants
 #define BUF_10K BUF_1K * 10
 
@@ -40,20 +58,55 @@ typedef struct request {
 	char*	resp_fifo;			// name of the return pipe
 	int		log_level;			// for verbose
 	char*	vfd_rid;			// request id that must be placed into the response (allows single response pipe by request process)
+	int		rsock;				// socket connection id the request arrived on; -1 if from the fifo
+	int		worker;				// handled by a request worker (log level not pushed)
+	int		rclass;				// priority class: RC_ const
+	uint64_t	rx_us;			// perf_now() when read
+	uint64_t	mark;			// perf_now() when handling started; 0 once the response is timed
+	int		async;				// caller asked for accept-then-complete (params.async)
+	uint64_t	op_id;			// async operation id; 0 if synchronous or once completed
+	int		binary;				// arrived as a binary frame; respond in kind
+	struct request* next;		// worker queue
 } req_t;
 
 // ------------------ prototypes ---------------------------------------------
 extern int vfd_init_fifo( parms_t* parms );
 extern int check_tcs( struct sriov_port_s* port, uint8_t *tc_pctgs );
 extern void vfd_add_ports( parms_t* parms, sriov_conf_t* conf );
+extern int vfd_add_port( sriov_conf_t* conf, pfdef_t* pfc );
+extern void vfd_del_port( sriov_conf_t* conf, int pidx );
+extern int vfd_port_differs( struct sriov_port_s* port, pfdef_t* old, pfdef_t* pfc );
 extern int vfd_add_vf( sriov_conf_t* conf, char* fname, char** reason );
+extern int vfd_add_vfc( sriov_conf_t* conf, char* fname, vf_config_t* vfc, char** reason );
+extern int vfd_update_vf( sriov_conf_t* conf, char* fname, char** reason );
+extern int vfd_update_vfc( sriov_conf_t* conf, char* fname, vf_config_t* vfc, char** reason );
+extern int vfd_prepare_vf( sriov_conf_t* conf, char* fname, char** reason );
+extern int vfd_commit_vf( parms_t* parms, sriov_conf_t* conf, const_str name, char** reason );
+extern int vfd_abort_vf( parms_t* parms, sriov_conf_t* conf, const_str name, char** reason );
 extern void vfd_add_all_vfs(  parms_t* parms, sriov_conf_t* conf );
 extern int vfd_del_vf( parms_t* parms, sriov_conf_t* conf, char* fname, char** reason );
+extern int vfd_del_vfc( sriov_conf_t* conf, const_str fname, vf_config_t* vfc, char** reason );
+extern void relocate_vf_config( parms_t* parms, char* filename, const_str suffix );
 extern int vfd_write( int fd, const char* buf, int len );
 extern void vfd_response( char* rpipe, int state, const_str vfd_rid, const char* msg );
+extern void vfd_req_response( req_t* req, int state, const_str msg );
 extern void vfd_free_request( req_t* req );
 extern req_t* vfd_read_request( parms_t* parms );
 extern int vfd_req_if( parms_t *parms, sriov_conf_t* conf, int forever );
+extern int vfd_validate( parms_t* parms, sriov_conf_t* conf, const_str dir );
+extern int vfd_start_workers( parms_t* parms, int n );
+extern void vfd_stop_workers( void );
+extern const char* vfd_rtype_name( int rtype );
+extern void vfd_op_notify( int cid, int binary, const_str vfd_rid, uint64_t op_id, int state, const_str msg );
+
+// ---- async operations (vfd_ops.c) ----
+extern uint64_t op_accept( req_t* req );
+extern void op_start( uint64_t id );
+extern void op_complete( uint64_t id, int state, const_str msg );
+extern void op_defer( uint64_t id, const_str msg );
+extern int op_ndeferred( void );
+extern void op_nic_done( int state );
+extern char* op_status( const_str which );
 
 
 #endif
@@ -0,0 +1,713 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vfd_snap.c
+	Abstract:	Binary snapshot of the running configuration used for a fast
+				warm restart. The snapshot is rebuilt from the main loop (at
+				most once a second) and written to snap_path (parm file) only
+				when it differs from what was last written. The file is
+				written to a temporary name and renamed into place.
+
+				At start up, if the snapshot is valid (magic, version, struct
+				sizes and checksum) and the parm file and the live vf config
+				files have not changed since it was written (fingerprint of
+				name, size, inode, mtime and ctime of each), the ports' VF
+				lists are restored directly from it rather than reading and
+				parsing every config file. Otherwise the caller falls back to
+				the full parse (vfd_add_all_vfs()).
+
+				Warm restart is off unless warm_restart is set in the parm file;
+				without it nothing is saved or restored and the config directory
+				is always read.
+
+				The snapshot holds everything that is in the vf_s struct which
+				isn't transient, including MACs that the guest has pushed, and
+				the mirror for each VF slot. The port's vftc_qshares are not
+				kept as they are generated from the VF qshares when the NIC is
+				updated.
+
+				Layout:
+					snap_hdr_t
+					snap_port_t[nports]
+					snap_vf_t[nvfs]
+					string area (nil terminated strings referenced by offset)
+
+	Date:		19 October 2026
+*/
+
+#define BLEAT_SUBSYS	BLEAT_SS_RIF		// tag our bleat messages; must be set before vfdlib.h is included
+#include <vfdlib.h>		// if vfdlib.h needs an include it must be included there, can't be include prior
+#include "sriov.h"
+#include "vfd_rif.h"
+
+#define SNAP_MAGIC		"VFDSNAP"
+#define SNAP_VERSION	1
+
+typedef struct {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	hdr_size;			// struct sizes; a snapshot from a build with different structs is ignored
+	uint32_t	port_size;
+	uint32_t	vf_size;
+	uint32_t	nports;
+	uint32_t	nvfs;
+	uint32_t	str_len;			// bytes in the string area
+	uint32_t	crc;				// crc32 of everything following the header
+	uint64_t	fprint;				// fingerprint of the parm file and live configs when written
+} snap_hdr_t;
+
+typedef struct {
+	char		pciid[64];
+	int32_t		num_vfs;			// slots used in the vfs array (includes holes)
+	int32_t		nvfs;				// VFs in the snapshot for this port
+} snap_port_t;
+
+typedef struct {
+	int32_t		port;				// index of the port in the snapshot
+	int32_t		vidx;				// slot in the port's vfs array
+	int32_t		num;
+	int32_t		strip_ctag;
+	int32_t		strip_stag;
+	int32_t		insert_stag;
+	int32_t		insert_ctag;
+	int32_t		vlan_anti_spoof;
+	int32_t		mac_anti_spoof;
+	int32_t		allow_bcast;
+	int32_t		allow_mcast;
+	int32_t		allow_un_ucast;
+	int32_t		allow_untagged;
+	int32_t		link;
+	double		rate;
+	double		min_rate;
+	int32_t		num_vlans;
+	int32_t		num_macs;
+	int32_t		first_mac;
+	uint32_t	owner;
+	int32_t		vlans[MAX_VF_VLANS];
+	char		macs[MAX_VF_MACS][18];
+	uint8_t		qshares[MAX_TCS];
+	int32_t		mirror_dir;
+	uint8_t		mirror_target;
+	uint8_t		mirror_id;
+	uint32_t	start_cb;			// offset+1 into the string area; 0 is nil
+	uint32_t	stop_cb;
+	uint32_t	config_name;
+} snap_vf_t;
+
+typedef struct {
+	char*		data;
+	size_t		len;
+} snap_img_t;
+
+static char*		parm_fname = NULL;		// parm file we were started with (part of the fingerprint)
+static snap_img_t	last = { NULL, 0 };		// last image written (or loaded)
+
+// -----------------------------------------------------------------------------------------------------------
+
+/*
+	Compute the crc32 (ieee polynomial) of the buffer.
+*/
+static uint32_t crc32( const unsigned char* buf, size_t len ) {
+	static uint32_t	table[256];
+	static int		have_table = 0;
+	uint32_t	c;
+	int			i;
+	int			j;
+
+	if( ! have_table ) {
+		for( i = 0; i < 256; i++ ) {
+			c = (uint32_t) i;
+			for( j = 0; j < 8; j++ ) {
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			}
+			table[i] = c;
+		}
+		have_table = 1;
+	}
+
+	c = 0xffffffff;
+	while( len-- > 0 ) {
+		c = table[(c ^ *buf++) & 0xff] ^ (c >> 8);
+	}
+
+	return c ^ 0xffffffff;
+}
+
+/*
+	Fold the data into the running FNV-1a hash h.
+*/
+static uint64_t fnv( uint64_t h, const void* data, size_t len ) {
+	const unsigned char* p;
+
+	for( p = (const unsigned char *) data; len > 0; len--, p++ ) {
+		h = (h ^ *p) * 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+/*
+	Fold the name and the stat() info of the file into the hash.
+*/
+static uint64_t fprint_file( uint64_t h, const char* fname ) {
+	struct stat sb;
+	int64_t		v[6];
+
+	h = fnv( h, fname, strlen( fname ) + 1 );
+	memset( v, 0, sizeof( v ) );
+	if( stat( fname, &sb ) == 0 ) {
+		v[0] = (int64_t) sb.st_size;
+		v[1] = (int64_t) sb.st_ino;
+		v[2] = (int64_t) sb.st_mtim.tv_sec;
+		v[3] = (int64_t) sb.st_mtim.tv_nsec;
+		v[4] = (int64_t) sb.st_ctim.tv_sec;
+		v[5] = (int64_t) sb.st_ctim.tv_nsec;
+	} else {
+		v[0] = -1;
+	}
+
+	return fnv( h, v, sizeof( v ) );
+}
+
+static int cmp_fnames( const void* a, const void* b ) {
+	return strcmp( *((char * const *) a), *((char * const *) b) );
+}
+
+/*
+	Generate the fingerprint of the parm file and the config files in the live
+	directory. Any add, delete or edit of a config (or the parm file) changes it.
+*/
+static uint64_t cfg_fprint( parms_t* parms ) {
+	char	wbuf[2048];
+	char**	flist;
+	int		llen = 0;
+	int		i;
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	if( parm_fname != NULL ) {
+		h = fprint_file( h, parm_fname );
+	}
+
+	snprintf( wbuf, sizeof( wbuf ), "%s_live", parms->config_dir );
+	h = fnv( h, wbuf, strlen( wbuf ) + 1 );
+	if( (flist = list_files( wbuf, "json", 1, &llen )) != NULL ) {
+		qsort( flist, llen, sizeof( *flist ), cmp_fnames );
+		for( i = 0; i < llen; i++ ) {
+			h = fprint_file( h, flist[i] );
+		}
+	}
+	free_list( flist, llen );
+
+	h = fnv( h, &llen, sizeof( llen ) );
+	return h;
+}
+
+/*
+	Add the string to the string area returning the offset+1 that is kept in the
+	record (0 for a nil string).
+*/
+static uint32_t add_str( char* area, uint32_t* used, const char* str ) {
+	uint32_t off;
+	size_t	len;
+
+	if( str == NULL ) {
+		return 0;
+	}
+
+	len = strlen( str ) + 1;
+	off = *used;
+	memcpy( area + off, str, len );
+	*used += len;
+
+	return off + 1;
+}
+
+/*
+	True if the VF in the slot is one that should be in the snapshot.
+*/
+static inline int is_live( struct vf_s* vf ) {
+	return vf->num >= 0 && vf->last_updated != DELETED && vf->prep_name == NULL;		// prepared VFs aren't live until committed
+}
+
+/*
+	Build the snapshot image of the configuration. The fingerprint is left
+	zero (the caller adds it) so that images can be compared to decide if the
+	configuration has changed. Returns 1 on success and 0 on failure.
+*/
+static int build_image( sriov_conf_t* conf, snap_img_t* img ) {
+	snap_hdr_t*	hdr;
+	snap_port_t* sp;
+	snap_vf_t*	svf;
+	struct sriov_port_s* port;
+	struct vf_s* vf;
+	struct mirror_s* mir;
+	size_t		slen = 0;
+	size_t		len;
+	uint32_t	sused = 0;
+	char*		sarea;
+	int			nvfs = 0;
+	int			p;
+	int			v;
+
+	img->data = NULL;
+	img->len = 0;
+
+	pthread_mutex_lock( &conf->update_lock );
+
+	for( p = 0; p < conf->num_ports; p++ ) {								// size things up first
+		port = &conf->ports[p];
+		for( v = 0; v < port->num_vfs; v++ ) {
+			vf = &port->vfs[v];
+			if( is_live( vf ) ) {
+				nvfs++;
+				slen += vf->start_cb ? strlen( vf->start_cb ) + 1 : 0;
+				slen += vf->stop_cb ? strlen( vf->stop_cb ) + 1 : 0;
+				slen += vf->config_name ? strlen( vf->config_name ) + 1 : 0;
+			}
+		}
+	}
+
+	len = sizeof( snap_hdr_t ) + (sizeof( snap_port_t ) * conf->num_ports) + (sizeof( snap_vf_t ) * nvfs) + slen;
+	if( (img->data = (char *) malloc( len )) == NULL ) {
+		pthread_mutex_unlock( &conf->update_lock );
+		return 0;
+	}
+	memset( img->data, 0, len );											// padding must be consistent for comparisons
+	img->len = len;
+
+	hdr = (snap_hdr_t *) img->data;
+	sp = (snap_port_t *) (img->data + sizeof( *hdr ));
+	svf = (snap_vf_t *) (sp + conf->num_ports);
+	sarea = (char *) (svf + nvfs);
+
+	for( p = 0; p < conf->num_ports; p++, sp++ ) {
+		port = &conf->ports[p];
+		strncpy( sp->pciid, port->pciid, sizeof( sp->pciid ) - 1 );
+		sp->num_vfs = port->num_vfs;
+
+		for( v = 0; v < port->num_vfs; v++ ) {
+			vf = &port->vfs[v];
+			if( ! is_live( vf ) ) {
+				continue;
+			}
+
+			sp->nvfs++;
+			svf->port = p;
+			svf->vidx = v;
+			svf->num = vf->num;
+			svf->strip_ctag = vf->strip_ctag;
+			svf->strip_stag = vf->strip_stag;
+			svf->insert_stag = vf->insert_stag;
+			svf->insert_ctag = vf->insert_ctag;
+			svf->vlan_anti_spoof = vf->vlan_anti_spoof;
+			svf->mac_anti_spoof = vf->mac_anti_spoof;
+			svf->allow_bcast = vf->allow_bcast;
+			svf->allow_mcast = vf->allow_mcast;
+			svf->allow_un_ucast = vf->allow_un_ucast;
+			svf->allow_untagged = vf->allow_untagged;
+			svf->link = vf->link;
+			svf->rate = vf->rate;
+			svf->min_rate = vf->min_rate;
+			svf->num_vlans = vf->num_vlans;
+			svf->num_macs = vf->num_macs;
+			svf->first_mac = vf->first_mac;
+			svf->owner = (uint32_t) vf->owner;
+			memcpy( svf->vlans, vf->vlans, sizeof( svf->vlans ) );
+			memcpy( svf->macs, vf->macs, sizeof( svf->macs ) );
+			memcpy( svf->qshares, vf->qshares, sizeof( svf->qshares ) );
+
+			mir = &port->mirrors[v];
+			svf->mirror_dir = mir->dir;
+			svf->mirror_target = mir->target;
+			svf->mirror_id = mir->id;
+
+			svf->start_cb = add_str( sarea, &sused, vf->start_cb );
+			svf->stop_cb = add_str( sarea, &sused, vf->stop_cb );
+			svf->config_name = add_str( sarea, &sused, vf->config_name );
+			svf++;
+		}
+	}
+
+	pthread_mutex_unlock( &conf->update_lock );
+
+	memcpy( hdr->magic, SNAP_MAGIC, sizeof( SNAP_MAGIC ) );
+	hdr->version = SNAP_VERSION;
+	hdr->hdr_size = sizeof( snap_hdr_t );
+	hdr->port_size = sizeof( snap_port_t );
+	hdr->vf_size = sizeof( snap_vf_t );
+	hdr->nports = conf->num_ports;
+	hdr->nvfs = nvfs;
+	hdr->str_len = sused;
+	hdr->crc = crc32( (unsigned char *) (hdr + 1), len - sizeof( *hdr ) );
+
+	return 1;
+}
+
+/*
+	Write the image to the snapshot file. Returns 1 on success, 0 on failure
+	(reason is logged).
+*/
+static int write_image( const char* fname, snap_img_t* img ) {
+	char	tname[PATH_MAX];
+	size_t	done = 0;
+	ssize_t	n;
+	int		fd;
+
+	snprintf( tname, sizeof( tname ), "%s.tmp", fname );			// must be in same directory for rename to be atomic
+	if( (fd = open( tname, O_WRONLY | O_CREAT | O_TRUNC, 0600 )) < 0 ) {
+		bleat_printf( 0, "snapshot: unable to open %s: %s", tname, strerror( errno ) );
+		return 0;
+	}
+
+	while( done < img->len ) {
+		if( (n = write( fd, img->data + done, img->len - done )) < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			break;
+		}
+		done += n;
+	}
+
+	if( done < img->len || fsync( fd ) != 0 ) {
+		bleat_printf( 0, "snapshot: write to %s failed: %s", tname, strerror( errno ) );
+		close( fd );
+		unlink( tname );
+		return 0;
+	}
+	close( fd );
+
+	if( rename( tname, fname ) != 0 ) {
+		bleat_printf( 0, "snapshot: unable to rename %s to %s: %s", tname, fname, strerror( errno ) );
+		unlink( tname );
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+	Read the snapshot file into an image. Returns 1 on success.
+*/
+static int read_image( const char* fname, snap_img_t* img ) {
+	struct stat sb;
+	size_t	done = 0;
+	ssize_t	n;
+	int		fd;
+
+	img->data = NULL;
+	img->len = 0;
+
+	if( (fd = open( fname, O_RDONLY )) < 0 ) {
+		return 0;
+	}
+
+	if( fstat( fd, &sb ) != 0 || sb.st_size < (off_t) sizeof( snap_hdr_t ) ||
+		(img->data = (char *) malloc( sb.st_size )) == NULL ) {
+		close( fd );
+		return 0;
+	}
+
+	while( done < (size_t) sb.st_size ) {
+		if( (n = read( fd, img->data + done, sb.st_size - done )) <= 0 ) {
+			if( n < 0 && errno == EINTR ) {
+				continue;
+			}
+			break;
+		}
+		done += n;
+	}
+	close( fd );
+
+	if( done < (size_t) sb.st_size ) {
+		free( img->data );
+		img->data = NULL;
+		return 0;
+	}
+
+	img->len = done;
+	return 1;
+}
+
+/*
+	Check the image header and contents; returns a reason if the image isn't
+	usable, nil if it is.
+*/
+static const char* vet_image( snap_img_t* img ) {
+	snap_hdr_t*	hdr;
+
+	hdr = (snap_hdr_t *) img->data;
+	if( memcmp( hdr->magic, SNAP_MAGIC, sizeof( SNAP_MAGIC ) ) != 0 ) {
+		return "not a vfd snapshot";
+	}
+	if( hdr->version != SNAP_VERSION || hdr->hdr_size != sizeof( snap_hdr_t ) ||
+		hdr->port_size != sizeof( snap_port_t ) || hdr->vf_size != sizeof( snap_vf_t ) ) {
+		return "snapshot version or layout is different";
+	}
+	if( hdr->nports > MAX_PORTS || hdr->nvfs > MAX_PORTS * MAX_VFS ||
+		img->len != sizeof( *hdr ) + (sizeof( snap_port_t ) * hdr->nports) + (sizeof( snap_vf_t ) * hdr->nvfs) + hdr->str_len ) {
+		return "snapshot is truncated or has a bad length";
+	}
+	if( crc32( (unsigned char *) (hdr + 1), img->len - sizeof( *hdr ) ) != hdr->crc ) {
+		return "snapshot checksum does not match";
+	}
+
+	return NULL;
+}
+
+/*
+	Return a pointer to the string at off in the string area, or nil if off is
+	0 or isn't sane (not inside the area, or not terminated there).
+*/
+static const char* get_str( const char* area, uint32_t alen, uint32_t off ) {
+	if( off == 0 || off > alen || memchr( area + off - 1, 0, alen - (off - 1) ) == NULL ) {
+		return NULL;
+	}
+
+	return area + off - 1;
+}
+
+// --------------------- public ------------------------------------------------------------------------------
+
+/*
+	Build a snapshot of the running config and write it to parms->snap_path if it
+	(or the config fingerprint) is different than the last one written. A runtime
+	add and delete can leave the image as it was while the config files changed;
+	the fingerprint must still be rewritten or every later start would reject the
+	snapshot. Returns 1 if the snapshot on disk is current, 0 on failure (reason
+	logged).
+*/
+extern int snap_save( parms_t* parms, sriov_conf_t* conf ) {
+	snap_img_t	img;
+	uint64_t	fprint;
+
+	if( parms == NULL || conf == NULL || parms->snap_path == NULL || ! (parms->rflags & RF_WARM_RESTART) ) {
+		return 0;
+	}
+
+	if( ! build_image( conf, &img ) ) {
+		bleat_printf( 0, "snapshot: unable to allocate memory for the image" );
+		return 0;
+	}
+
+	fprint = cfg_fprint( parms );											// config files are updated before the config, so this is current
+	if( last.data != NULL && last.len == img.len && ((snap_hdr_t *) last.data)->fprint == fprint &&
+		memcmp( last.data + sizeof( snap_hdr_t ), img.data + sizeof( snap_hdr_t ), img.len - sizeof( snap_hdr_t ) ) == 0 ) {
+		free( img.data );													// nothing changed since last write
+		return 1;
+	}
+
+	((snap_hdr_t *) img.data)->fprint = fprint;
+	if( ! write_image( parms->snap_path, &img ) ) {
+		free( img.data );
+		return 0;
+	}
+
+	bleat_printf( 2, "snapshot: %d vfs written to %s (%d bytes)", (int) ((snap_hdr_t *) img.data)->nvfs, parms->snap_path, (int) img.len );
+	free( last.data );
+	last = img;
+	return 1;
+}
+
+/*
+	Called from the main loop; saves the snapshot at most once a second. After a
+	failure we back off for a minute so as not to flood the log.
+*/
+extern void snap_check( parms_t* parms, sriov_conf_t* conf ) {
+	static time_t next_check = 0;
+	time_t	now;
+
+	if( parms == NULL || ! (parms->rflags & RF_WARM_RESTART) || ! parms->forreal ) {
+		return;
+	}
+
+	now = time( NULL );
+	if( now < next_check ) {
+		return;
+	}
+
+	next_check = now + (snap_save( parms, conf ) ? 1 : 60);
+}
+
+/*
+	Restore the VFs from the snapshot if it is valid and the parm file and live
+	configs haven't changed since it was written. Parm_file is the name of the
+	parm file we were started with and is saved for future fingerprints.
+
+	Nothing is changed unless the whole snapshot is usable. Restored VFs are
+	marked as added so that vfd_update_nic() will configure them exactly as it
+	does after the configs are parsed.
+
+	Returns 1 if the VFs were restored and 0 if the caller must read the config
+	files (the reason is logged).
+*/
+extern int snap_load( parms_t* parms, sriov_conf_t* conf, const char* parm_file ) {
+	snap_img_t	img;
+	snap_hdr_t*	hdr;
+	snap_port_t* sp;
+	snap_vf_t*	svf;
+	struct sriov_port_s* port;
+	struct sriov_port_s* pmap[MAX_PORTS];	// snapshot port index to our port
+	char	used_slot[MAX_PORTS][MAX_VFS];	// duplicate checks
+	char	used_num[MAX_PORTS][MAX_VFS];
+	struct vf_s* vf;
+	const char*	reason;
+	const char*	area;
+	const char*	str;
+	struct timespec	start;
+	struct timespec	end;
+	int		i;
+	int		j;
+	int		v;
+
+	if( parms == NULL || conf == NULL ) {
+		return 0;
+	}
+
+	if( parm_file != NULL && parm_fname == NULL ) {
+		parm_fname = strdup( parm_file );
+	}
+
+	if( parms->snap_path == NULL || ! (parms->rflags & RF_WARM_RESTART) ) {
+		return 0;
+	}
+
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	if( ! read_image( parms->snap_path, &img ) ) {
+		bleat_printf( 1, "snapshot: %s could not be read: %s; reading vf configs", parms->snap_path, strerror( errno ) );
+		return 0;
+	}
+
+	if( (reason = vet_image( &img )) != NULL ) {
+		bleat_printf( 0, "WRN: snapshot: %s: %s; reading vf configs", parms->snap_path, reason );
+		free( img.data );
+		return 0;
+	}
+
+	hdr = (snap_hdr_t *) img.data;
+	if( hdr->fprint != cfg_fprint( parms ) ) {
+		bleat_printf( 1, "snapshot: parm file or vf configs changed since the snapshot was written; reading vf configs" );
+		free( img.data );
+		return 0;
+	}
+
+	sp = (snap_port_t *) (hdr + 1);											// map ports by pciid; every port with VFs must still be ours
+	svf = (snap_vf_t *) (sp + hdr->nports);
+	area = (const char *) (svf + hdr->nvfs);
+	reason = NULL;
+	memset( used_slot, 0, sizeof( used_slot ) );
+	memset( used_num, 0, sizeof( used_num ) );
+	for( i = 0; i < (int) hdr->nports && reason == NULL; i++ ) {
+		pmap[i] = NULL;
+		for( j = 0; j < conf->num_ports; j++ ) {
+			if( strncmp( sp[i].pciid, conf->ports[j].pciid, sizeof( sp[i].pciid ) ) == 0 ) {
+				pmap[i] = &conf->ports[j];
+				break;
+			}
+		}
+
+		if( sp[i].nvfs > 0 && (pmap[i] == NULL || sp[i].num_vfs < 0 || sp[i].num_vfs > MAX_VFS || pmap[i]->num_vfs != 0) ) {
+			reason = "port in the snapshot is not configured";
+		}
+	}
+
+	for( i = 0; i < (int) hdr->nvfs && reason == NULL; i++ ) {				// vet every vf before anything is changed
+		if( svf[i].port < 0 || svf[i].port >= (int) hdr->nports || (port = pmap[svf[i].port]) == NULL ) {
+			reason = "vf references an unknown port";
+			break;
+		}
+		if( svf[i].vidx < 0 || svf[i].vidx >= sp[svf[i].port].num_vfs || svf[i].num < 0 || svf[i].num >= port->nvfs_config ||
+			svf[i].num_vlans < 0 || svf[i].num_vlans > MAX_VF_VLANS || svf[i].first_mac < 0 || svf[i].first_mac > 1 ||
+			svf[i].num_macs < 0 || svf[i].num_macs + svf[i].first_mac > MAX_VF_MACS ) {
+			reason = "vf values are out of range";
+			break;
+		}
+		if( svf[i].mirror_dir < MIRROR_OFF || svf[i].mirror_dir > MIRROR_ALL ||		// same rules applied to a vf config's mirror
+			(svf[i].mirror_dir != MIRROR_OFF && (svf[i].mirror_target > port->nvfs_config || svf[i].mirror_target == svf[i].num)) ) {
+			reason = "vf mirror values are out of range";
+			break;
+		}
+		if( used_slot[svf[i].port][svf[i].vidx] || used_num[svf[i].port][svf[i].num] ) {
+			reason = "duplicate vf";
+			break;
+		}
+		used_slot[svf[i].port][svf[i].vidx] = 1;
+		used_num[svf[i].port][svf[i].num] = 1;
+	}
+
+	if( reason != NULL ) {
+		bleat_printf( 0, "WRN: snapshot: %s: %s; reading vf configs", parms->snap_path, reason );
+		free( img.data );
+		return 0;
+	}
+
+	pthread_mutex_lock( &conf->update_lock );
+
+	for( i = 0; i < (int) hdr->nports; i++ ) {
+		if( sp[i].nvfs > 0 ) {
+			port = pmap[i];
+			port->num_vfs = sp[i].num_vfs;
+			for( v = 0; v < port->num_vfs; v++ ) {							// anything not restored is a hole
+				port->vfs[v].num = -1;
+			}
+		}
+	}
+
+	for( i = 0; i < (int) hdr->nvfs; i++, svf++ ) {
+		port = pmap[svf->port];
+		vf = &port->vfs[svf->vidx];
+
+		memset( vf, 0, sizeof( *vf ) );
+		vf->num = svf->num;
+		vf->last_updated = ADDED;											// signal main code to configure the buggger
+		vf->strip_ctag = svf->strip_ctag;
+		vf->strip_stag = svf->strip_stag;
+		vf->insert_stag = svf->insert_stag;
+		vf->insert_ctag = svf->insert_ctag;
+		vf->vlan_anti_spoof = svf->vlan_anti_spoof;
+		vf->mac_anti_spoof = svf->mac_anti_spoof;
+		vf->allow_bcast = svf->allow_bcast;
+		vf->allow_mcast = svf->allow_mcast;
+		vf->allow_un_ucast = svf->allow_un_ucast;
+		vf->allow_untagged = svf->allow_untagged;
+		vf->link = svf->link;
+		vf->rate = svf->rate;
+		vf->min_rate = svf->min_rate;
+		vf->num_vlans = svf->num_vlans;
+		vf->num_macs = svf->num_macs;
+		vf->first_mac = svf->first_mac;
+		vf->owner = (uid_t) svf->owner;
+		memcpy( vf->vlans, svf->vlans, sizeof( vf->vlans ) );
+		memcpy( vf->macs, svf->macs, sizeof( vf->macs ) );
+		memcpy( vf->qshares, svf->qshares, sizeof( vf->qshares ) );
+		for( j = 0; j < MAX_VF_MACS; j++ ) {
+			vf->macs[j][17] = 0;
+		}
+
+		if( (str = get_str( area, hdr->str_len, svf->start_cb )) != NULL ) {
+			vf->start_cb = strdup( str );
+		}
+		if( (str = get_str( area, hdr->str_len, svf->stop_cb )) != NULL ) {
+			vf->stop_cb = strdup( str );
+		}
+		vf->config_name = strdup( (str = get_str( area, hdr->str_len, svf->config_name )) != NULL ? str : "unnamed" );
+
+		port->mirrors[svf->vidx].dir = svf->mirror_dir;
+		port->mirrors[svf->vidx].target = svf->mirror_target;
+		port->mirrors[svf->vidx].id = svf->mirror_id;
+		if( svf->mirror_dir != MIRROR_OFF && idm_use( conf->mir_id_mgr, svf->mirror_id ) != 1 ) {
+			port->mirrors[svf->vidx].id = idm_alloc( conf->mir_id_mgr );		// not expected, but don't share an id
+		}
+
+		claim_macs( port->rte_port_number, vf->num );
+	}
+
+	pthread_mutex_unlock( &conf->update_lock );
+
+	last = img;																// nothing to write until something changes
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	bleat_printf( 1, "snapshot: %d vfs on %d ports restored from %s in %.1fms", (int) hdr->nvfs, (int) hdr->nports, parms->snap_path,
+		((end.tv_sec - start.tv_sec) * 1000.0) + ((end.tv_nsec - start.tv_nsec) / 1000000.0) );
+
+	return 1;
+}
@@ -0,0 +1,597 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vfd_sock.c
+	Abstract:	Unix domain socket request interface. When a socket path is given
+				in the parm file (socket) we listen on a SOCK_STREAM socket in
+				addition to the fifo. A client may keep its connection open and
+				send any number of requests; each response is written back on the
+				connection that the request arrived on, so there is no response
+				fifo to create for each request. Requests and responses are framed
+				exactly as they are on the fifo: a request is json followed by an
+				empty line, and a response is json followed by @eom@ on a line by
+				itself. The vfd_rid in the request is returned in the response for
+				correlation.
+
+				A request may instead be a binary frame (see lib/vbin.c); these
+				start with a byte which never starts json and carry their own
+				length, so they are taken whole and passed up as is. The request
+				interface answers a binary request with a binary response.
+
+				Everything here is non-blocking. Connections are accepted and
+				read by the request interface (vfd_read_request) in the main
+				loop; responses may also be queued by the request workers, so
+				the client table is protected by a mutex.
+
+				Responses (socket and fifo) are never written directly. They are
+				queued on the connection's output buffer and flushed by the main
+				loop as the file descriptor becomes writable. A response fifo is
+				given a write-only slot which is closed once its queue drains. A
+				connection whose queue grows past SOCK_MAX_OUTQ bytes, or which
+				has not accepted all queued output within SOCK_DELIVERY_TO
+				seconds, is dropped; a slow or hung reader costs only its own
+				connection and never stalls the main loop.
+
+	Date:		19 October 2026
+	Mods:		19 Oct 2026 : Add per connection output queues; response fifos are
+								queued and flushed the same way.
+				19 Oct 2026 : Make thread safe so request workers can respond; connections
+								are referenced by id rather than file descriptor so that
+								a reused descriptor never gets another client's response.
+				19 Oct 2026 : Accept binary (length prefixed TLV) request frames.
+				19 Oct 2026 : Never let a departed reader raise SIGPIPE; sockets are
+								written with MSG_NOSIGNAL and the signal is ignored.
+*/
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+
+#define BLEAT_SUBSYS	BLEAT_SS_RIF		// tag our bleat messages; must be set before vfdlib.h is included
+#include <vfdlib.h>
+#include "sriov.h"
+
+#define MAX_SOCK_CLIENTS	64				// max concurrent connections
+#define SOCK_RBUF			8192			// max request size (same as the fifo)
+#define SOCK_MAX_OUTQ		(4 * 1024 * 1024)	// max bytes queued for one connection before it's dropped
+#define SOCK_DELIVERY_TO	5				// seconds queued output may wait before the connection is dropped
+
+typedef struct {
+	int		fd;								// -1 when the slot is unused
+	int		cid;							// connection id given to callers (generation and slot)
+	int		wonly;							// write only (response fifo); closed when the output queue drains
+	int		len;							// bytes buffered
+	char	rbuf[SOCK_RBUF];				// partial request(s) read from the connection
+
+	char*	obuf;							// output queue
+	int		osize;							// allocated size of obuf
+	int		olen;							// bytes in obuf (including those already written)
+	int		ooff;							// offset of the next byte to write
+	time_t	odeadline;						// time by which the queue must be flushed
+} sclient_t;
+
+static int			lfd = -1;				// listen file des
+static char*		sock_path = NULL;
+static sclient_t*	clients = NULL;
+static int			next_client = 0;		// round robin start so one busy client can't starve the others
+static int			cid_gen = 0;			// generation for connection ids
+static pthread_mutex_t	slock = PTHREAD_MUTEX_INITIALIZER;		// all access to the client table
+
+/*
+	Allocate the client table if it's not already there. Returns 0 on failure.
+*/
+static int alloc_clients( void ) {
+	int i;
+
+	if( clients != NULL ) {
+		return 1;
+	}
+
+	if( (clients = (sclient_t *) malloc( sizeof( *clients ) * MAX_SOCK_CLIENTS )) == NULL ) {
+		bleat_printf( 0, "ERR: sock: unable to allocate client table" );
+		return 0;
+	}
+
+	memset( clients, 0, sizeof( *clients ) * MAX_SOCK_CLIENTS );
+	for( i = 0; i < MAX_SOCK_CLIENTS; i++ ) {
+		clients[i].fd = -1;
+	}
+
+	return 1;
+}
+
+/*
+	Return a free slot, with a new connection id assigned, or nil if the table is full.
+*/
+static sclient_t* free_slot( void ) {
+	int i;
+
+	for( i = 0; i < MAX_SOCK_CLIENTS; i++ ) {
+		if( clients[i].fd < 0 ) {
+			cid_gen = (cid_gen + 1) & 0x7fffff;
+			clients[i].cid = (cid_gen << 8) | i;
+			return &clients[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Find the slot for the connection id; nil if the connection has been closed.
+*/
+static sclient_t* find_client( int cid ) {
+	sclient_t* c;
+
+	if( clients == NULL || cid < 0 || (cid & 0xff) >= MAX_SOCK_CLIENTS ) {
+		return NULL;
+	}
+
+	c = &clients[cid & 0xff];
+	if( c->fd < 0 || c->cid != cid ) {
+		return NULL;
+	}
+
+	return c;
+}
+
+/*
+	Close a client connection and free the slot. Anything left on the output
+	queue is discarded.
+*/
+static void drop_client( sclient_t* c ) {
+	if( c->olen > c->ooff ) {
+		bleat_printf( 1, "WRN: sock: %d bytes of queued output discarded: fd=%d", c->olen - c->ooff, c->fd );
+	}
+	bleat_printf( c->wonly ? 3 : 2, "sock: %s closed: fd=%d", c->wonly ? "response fifo" : "client connection", c->fd );
+
+	close( c->fd );
+	c->fd = -1;
+	c->wonly = 0;
+	c->len = 0;
+	c->olen = 0;
+	c->ooff = 0;
+	if( c->osize > SOCK_RBUF ) {					// don't hang on to a large buffer from one big response
+		free( c->obuf );
+		c->obuf = NULL;
+		c->osize = 0;
+	}
+}
+
+/*
+	Write as much of the client's output queue as the file descriptor will take
+	without blocking. Returns 0 if the connection was dropped (hard error, or a
+	write only slot that drained) and 1 otherwise. A reader which has gone away
+	shows up as EPIPE and the connection is dropped; sockets are written with
+	MSG_NOSIGNAL, and SIGPIPE is ignored (sock_init) for the response fifos.
+*/
+static int flush_client( sclient_t* c ) {
+	int n;
+
+	while( c->ooff < c->olen ) {
+		if( c->wonly ) {
+			n = write( c->fd, c->obuf + c->ooff, c->olen - c->ooff );		// response fifo; send() would fail with ENOTSOCK
+		} else {
+			n = send( c->fd, c->obuf + c->ooff, c->olen - c->ooff, MSG_NOSIGNAL );
+		}
+		if( n < 0 ) {
+			if( errno == EAGAIN || errno == EWOULDBLOCK ) {
+				break;
+			}
+			if( errno == EINTR ) {
+				continue;
+			}
+
+			bleat_printf( 1, "WRN: sock: write error; connection dropped: fd=%d: %s", c->fd, strerror( errno ) );
+			drop_client( c );
+			return 0;
+		}
+
+		c->ooff += n;
+	}
+
+	if( c->ooff >= c->olen ) {					// all out; reset the queue
+		c->ooff = c->olen = 0;
+		if( c->wonly ) {
+			drop_client( c );
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+	Accept all pending connections. If there are no free slots the connection
+	is closed straight away.
+*/
+static void accept_clients( void ) {
+	sclient_t*	c;
+	int	fd;
+
+	while( (fd = accept( lfd, NULL, NULL )) >= 0 ) {
+		fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+		fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+		if( (c = free_slot( )) == NULL ) {
+			bleat_printf( 0, "WRN: sock: too many connections (%d); new connection refused", MAX_SOCK_CLIENTS );
+			close( fd );
+			continue;
+		}
+
+		c->fd = fd;
+		c->len = 0;
+		bleat_printf( 2, "sock: client connected: fd=%d slot=%d", fd, (int) (c - clients) );
+	}
+}
+
+/*
+	If the client's buffer holds a complete request (terminated by an empty line,
+	or a whole binary frame) return a copy of it (caller must free) and shift what
+	follows down; len is set to its length. Returns nil if there isn't a complete
+	request. If the buffer starts with a frame that can't be taken bad is set.
+*/
+static char* next_request( sclient_t* c, int* bad, int* len ) {
+	char*	eor;						// end of request
+	char*	req;
+	int		rlen;
+	int		skip = 2;					// bytes after the request that are dropped (the empty line)
+
+	if( c->len > 0 && (unsigned char) c->rbuf[0] == VB_MAGIC ) {			// binary frame; its length is in the header
+		if( (rlen = vb_frame_len( (unsigned char *) c->rbuf, c->len )) < 0 || rlen > SOCK_RBUF - 1 ) {
+			*bad = 1;
+			return NULL;
+		}
+		if( rlen == 0 || rlen > c->len ) {
+			return NULL;
+		}
+		skip = 0;
+	} else {
+		c->rbuf[c->len] = 0;
+		if( (eor = strstr( c->rbuf, "\n\n" )) == NULL ) {
+			return NULL;
+		}
+		rlen = eor - c->rbuf;
+	}
+
+	if( (req = (char *) malloc( sizeof( char ) * (rlen + 1) )) == NULL ) {
+		return NULL;
+	}
+	memcpy( req, c->rbuf, rlen );
+	req[rlen] = 0;
+	*len = rlen;
+
+	c->len -= rlen + skip;
+	memmove( c->rbuf, c->rbuf + rlen + skip, c->len );
+
+	return req;
+}
+
+// --------------------------------------------------------------------------------------------------------
+
+/*
+	Create the listening socket if a path is given in the parms. Any existing file
+	at the path is removed first. Returns 1 if listening, 0 if not configured and
+	-1 on error.
+
+	SIGPIPE is ignored whether or not the socket is configured: response fifos
+	are flushed from here too, and a reader closing its end early must cost only
+	that response (EPIPE) rather than the process, or a trip through a handler
+	which isn't signal safe.
+*/
+extern int sock_init( parms_t* parms ) {
+	struct sockaddr_un addr;
+	int	i;
+
+	signal( SIGPIPE, SIG_IGN );
+
+	if( parms == NULL || parms->sock_path == NULL || ! *parms->sock_path ) {
+		return 0;
+	}
+
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sun_family = AF_UNIX;
+	if( strlen( parms->sock_path ) >= sizeof( addr.sun_path ) ) {
+		bleat_printf( 0, "ERR: sock: socket path is too long: %s", parms->sock_path );
+		return -1;
+	}
+	strcpy( addr.sun_path, parms->sock_path );
+
+	pthread_mutex_lock( &slock );
+	i = alloc_clients( );
+	pthread_mutex_unlock( &slock );
+	if( ! i ) {
+		return -1;
+	}
+
+	if( (lfd = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 )) < 0 ) {
+		bleat_printf( 0, "ERR: sock: unable to create socket: %s", strerror( errno ) );
+		return -1;
+	}
+
+	unlink( parms->sock_path );
+	if( bind( lfd, (struct sockaddr *) &addr, sizeof( addr ) ) < 0 || listen( lfd, 16 ) < 0 ) {
+		bleat_printf( 0, "ERR: sock: unable to listen on %s: %s", parms->sock_path, strerror( errno ) );
+		close( lfd );
+		lfd = -1;
+		return -1;
+	}
+	chmod( parms->sock_path, 0666 );				// same (wide open) permissions as the request fifo
+
+	sock_path = strdup( parms->sock_path );
+	bleat_printf( 0, "listening for requests on socket: %s", sock_path );
+	return 1;
+}
+
+/*
+	Close the listener and all client connections (including pending response
+	fifos), and remove the socket file. A last non-blocking attempt is made to
+	flush any queued output.
+*/
+extern void sock_close( void ) {
+	int i;
+
+	pthread_mutex_lock( &slock );
+	if( clients != NULL ) {
+		for( i = 0; i < MAX_SOCK_CLIENTS; i++ ) {
+			if( clients[i].fd >= 0 && flush_client( &clients[i] ) ) {
+				drop_client( &clients[i] );
+			}
+		}
+	}
+
+	if( lfd < 0 ) {
+		pthread_mutex_unlock( &slock );
+		return;
+	}
+
+	close( lfd );
+	lfd = -1;
+	if( sock_path != NULL ) {
+		unlink( sock_path );
+		free( sock_path );
+		sock_path = NULL;
+	}
+	pthread_mutex_unlock( &slock );
+}
+
+/*
+	Return the next complete request received on any connection, or nil if there
+	isn't one. The connection id is placed in cid so that the response can be
+	sent back on it (sock_send()). New connections are accepted and closed
+	connections are cleaned up as a side effect. The request's length is placed in
+	len; a binary frame may hold nil bytes so its length must come from here. The
+	caller must free the buffer returned.
+*/
+extern char* sock_read( int* cid, int* len ) {
+	sclient_t*	c;
+	char*	req;
+	int		i;
+	int		n;
+	int		bad = 0;
+
+	if( lfd < 0 ) {
+		return NULL;
+	}
+
+	pthread_mutex_lock( &slock );
+	accept_clients();
+
+	for( i = 0; i < MAX_SOCK_CLIENTS; i++ ) {
+		c = &clients[(next_client + i) % MAX_SOCK_CLIENTS];
+		if( c->fd < 0 || c->wonly ) {
+			continue;
+		}
+
+		if( (req = next_request( c, &bad, len )) == NULL && ! bad ) {	// nothing already buffered; see if there's more
+			n = read( c->fd, c->rbuf + c->len, SOCK_RBUF - 1 - c->len );
+			if( n == 0 && c->olen > c->ooff ) {					// client shut down its side; let the queued response drain first
+				c->wonly = 1;
+				continue;
+			}
+			if( n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ) {
+				drop_client( c );
+				continue;
+			}
+
+			if( n > 0 ) {
+				c->len += n;
+				if( (req = next_request( c, &bad, len )) == NULL && c->len >= SOCK_RBUF - 1 ) {
+					bleat_printf( 0, "WRN: sock: request exceeds %d bytes; connection dropped: fd=%d", SOCK_RBUF, c->fd );
+					drop_client( c );
+					continue;
+				}
+			}
+		}
+
+		if( bad ) {
+			bleat_printf( 0, "WRN: sock: bad binary request frame (version or length); connection dropped: fd=%d", c->fd );
+			drop_client( c );
+			bad = 0;
+			continue;
+		}
+
+		if( req != NULL ) {
+			next_client = (next_client + i + 1) % MAX_SOCK_CLIENTS;
+			*cid = c->cid;
+			pthread_mutex_unlock( &slock );
+			return req;
+		}
+	}
+
+	pthread_mutex_unlock( &slock );
+	return NULL;
+}
+
+/*
+	Adopt an open file descriptor (a response fifo) as a write only slot so that
+	a response can be queued on it with sock_send(). The file descriptor is closed
+	once the queue has been written, or if it cannot be written in time. Returns
+	the connection id, or -1 if there is no free slot; the caller still owns the
+	file descriptor in that case.
+*/
+extern int sock_adopt( int fd ) {
+	sclient_t*	c;
+	int	cid = -1;
+
+	if( fd < 0 ) {
+		return -1;
+	}
+
+	pthread_mutex_lock( &slock );
+	if( alloc_clients( ) ) {
+		if( (c = free_slot( )) != NULL ) {
+			fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK );
+			c->fd = fd;
+			c->wonly = 1;
+			c->len = 0;
+			c->olen = c->ooff = 0;
+			cid = c->cid;
+		} else {
+			bleat_printf( 0, "WRN: sock: no free slot to queue a response (%d in use)", MAX_SOCK_CLIENTS );
+		}
+	}
+	pthread_mutex_unlock( &slock );
+
+	return cid;
+}
+
+/*
+	Queue the buffer for the connection. The caller holds the lock.
+*/
+static int queue_output( sclient_t* c, const_str buf, int len ) {
+	char*	nb;
+	int		nsize;
+
+	if( c->olen - c->ooff + len > SOCK_MAX_OUTQ ) {
+		bleat_printf( 0, "WRN: sock: output queue limit (%d bytes) reached; connection dropped: fd=%d", SOCK_MAX_OUTQ, c->fd );
+		drop_client( c );
+		return -1;
+	}
+
+	if( c->ooff > 0 && c->olen + len > c->osize ) {				// slide unwritten bytes down before growing
+		memmove( c->obuf, c->obuf + c->ooff, c->olen - c->ooff );
+		c->olen -= c->ooff;
+		c->ooff = 0;
+	}
+
+	if( c->olen + len > c->osize ) {
+		for( nsize = c->osize > 0 ? c->osize : SOCK_RBUF; nsize < c->olen + len; nsize *= 2 );
+		if( (nb = (char *) realloc( c->obuf, nsize )) == NULL ) {
+			bleat_printf( 0, "ERR: sock: unable to grow output queue to %d bytes; connection dropped: fd=%d", nsize, c->fd );
+			drop_client( c );
+			return -1;
+		}
+		c->obuf = nb;
+		c->osize = nsize;
+	}
+
+	if( c->olen == c->ooff ) {								// queue was empty; start the delivery clock
+		c->odeadline = time( NULL ) + SOCK_DELIVERY_TO;
+	}
+
+	memcpy( c->obuf + c->olen, buf, len );
+	c->olen += len;
+	return len;
+}
+
+/*
+	Queue the buffer for the connection. Nothing is written here; sock_flush()
+	pushes queued output as the connection can take it. A response should be
+	queued with a single call so that responses from different threads on the
+	same connection are not interleaved. Returns the number of bytes queued, or
+	-1 if the connection has been closed or was dropped because the queue grew
+	past the limit.
+*/
+extern int sock_send( int cid, const_str buf, int len ) {
+	sclient_t*	c;
+	int		rc;
+
+	if( len <= 0 ) {
+		return 0;
+	}
+
+	pthread_mutex_lock( &slock );
+	if( (c = find_client( cid )) == NULL ) {
+		pthread_mutex_unlock( &slock );
+		bleat_printf( 1, "WRN: sock: connection closed before response could be sent: cid=%d", cid );
+		return -1;
+	}
+
+	rc = queue_output( c, buf, len );
+	pthread_mutex_unlock( &slock );
+
+	return rc;
+}
+
+/*
+	Write whatever queued output the connections will take without blocking, and
+	drop any connection which has had output waiting longer than the delivery
+	timeout. Called from the main loop and after each response is queued.
+*/
+extern void sock_flush( void ) {
+	sclient_t*	c;
+	time_t	now;
+	int		i;
+
+	pthread_mutex_lock( &slock );
+	if( clients == NULL ) {
+		pthread_mutex_unlock( &slock );
+		return;
+	}
+
+	now = time( NULL );
+	for( i = 0; i < MAX_SOCK_CLIENTS; i++ ) {
+		c = &clients[i];
+		if( c->fd < 0 || (c->olen <= c->ooff && ! c->wonly) ) {
+			continue;
+		}
+
+		if( flush_client( c ) && c->olen > c->ooff && now > c->odeadline ) {
+			bleat_printf( 0, "WRN: sock: %d bytes not delivered in %ds; connection dropped: fd=%d", c->olen - c->ooff, SOCK_DELIVERY_TO, c->fd );
+			drop_client( c );
+		}
+	}
+	pthread_mutex_unlock( &slock );
+}
+
+/*
+	Fill in poll structs for the listener and each connection so that the main loop
+	can wait for a request, or for a connection with queued output to become
+	writable, rather than sleeping. Returns the number filled in.
+*/
+extern int sock_pollfds( struct pollfd* pfds, int max ) {
+	int	n = 0;
+	int i;
+
+	if( max <= 0 ) {
+		return 0;
+	}
+
+	pthread_mutex_lock( &slock );
+	if( lfd >= 0 ) {
+		pfds[n].fd = lfd;
+		pfds[n].events = POLLIN;
+		pfds[n++].revents = 0;
+	}
+
+	if( clients == NULL ) {
+		pthread_mutex_unlock( &slock );
+		return n;
+	}
+
+	for( i = 0; i < MAX_SOCK_CLIENTS && n < max; i++ ) {
+		if( clients[i].fd >= 0 ) {
+			pfds[n].fd = clients[i].fd;
+			pfds[n].events = (clients[i].wonly ? 0 : POLLIN) | (clients[i].olen > clients[i].ooff ? POLLOUT : 0);
+			pfds[n++].revents = 0;
+		}
+	}
+	pthread_mutex_unlock( &slock );
+
+	return n;
+}
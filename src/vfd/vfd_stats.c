@@ -0,0 +1,211 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vfd_stats.c
+	Abstract:	Periodic dump of PF/VF statistics to the file named by stats_path
+				in the parm file. The snapshot is written to a temporary file in
+				the same directory and then renamed over the target so that a
+				reader (log shipper etc.) never sees a partially written file.
+
+				Two formats are supported:
+					json -- one object with a list of ports, each with its counters,
+							selected xstats and a list of VFs.
+					csv  -- one counter per line: timestamp,pf,vf,name,value
+							(vf is empty for PF counters).
+
+				Request latency (vfd_perf.c) follows the port data in either
+				format.
+
+	Date:		19 October 2026
+*/
+
+#define BLEAT_SUBSYS	BLEAT_SS_STATS		// tag our bleat messages; must be set before vfdlib.h is included
+#include <vfdlib.h>		// if vfdlib.h needs an include it must be included there, can't be include prior
+#include "sriov.h"
+
+// -----------------------------------------------------------------------------------------------------------
+
+/*
+	Write one counter for the csv format.
+*/
+static void csv_counter( FILE* f, time_t now, int pf, int vf, const char* name, uint64_t value ) {
+	if( vf >= 0 ) {
+		fprintf( f, "%ld,%d,%d,%s,%"PRIu64"\n", (long) now, pf, vf, name, value );
+	} else {
+		fprintf( f, "%ld,%d,,%s,%"PRIu64"\n", (long) now, pf, name, value );
+	}
+}
+
+/*
+	Write the stats for one port in csv format.
+*/
+static void csv_port( FILE* f, time_t now, sriov_port_t* port ) {
+	struct rte_eth_stats stats;
+	struct rte_eth_link link;
+	uint64_t	spoofed;
+	int			pf;
+	int			v;
+	int			i;
+
+	pf = port->rte_port_number;
+	nic_stats_get( pf, &stats, &link, &spoofed );
+
+	csv_counter( f, now, pf, -1, "link_up", (uint64_t) (link.link_speed != 1 && link.link_status) );
+	csv_counter( f, now, pf, -1, "link_speed", (uint64_t) link.link_speed );
+	csv_counter( f, now, pf, -1, "rx_pkts", stats.ipackets );
+	csv_counter( f, now, pf, -1, "rx_bytes", stats.ibytes );
+	csv_counter( f, now, pf, -1, "rx_errors", stats.ierrors );
+	csv_counter( f, now, pf, -1, "rx_missed", stats.imissed );
+	csv_counter( f, now, pf, -1, "tx_pkts", stats.opackets );
+	csv_counter( f, now, pf, -1, "tx_bytes", stats.obytes );
+	csv_counter( f, now, pf, -1, "tx_errors", stats.oerrors );
+	csv_counter( f, now, pf, -1, "spoofed", spoofed );
+
+	if( port_xstats_get( port ) > 0 ) {
+		for( i = 0; i < port->nxstats; i++ ) {
+			csv_counter( f, now, pf, -1, port->xstat_names[i], port->xstat_vals[i] );
+		}
+	}
+
+	for( v = 0; v < port->num_vfs; v++ ) {
+		if( port->vfs[v].num < 0 ) {						// deleted/unused slot
+			continue;
+		}
+
+		vf_stats_get( pf, port->vfs[v].num, &stats, &spoofed );
+		csv_counter( f, now, pf, port->vfs[v].num, "rx_pkts", stats.ipackets );
+		csv_counter( f, now, pf, port->vfs[v].num, "rx_bytes", stats.ibytes );
+		csv_counter( f, now, pf, port->vfs[v].num, "rx_errors", stats.ierrors );
+		csv_counter( f, now, pf, port->vfs[v].num, "tx_pkts", stats.opackets );
+		csv_counter( f, now, pf, port->vfs[v].num, "tx_bytes", stats.obytes );
+		csv_counter( f, now, pf, port->vfs[v].num, "tx_errors", stats.oerrors );
+		csv_counter( f, now, pf, port->vfs[v].num, "spoofed", spoofed );
+	}
+}
+
+/*
+	Write the stats for one port as a json object. Sep is written first so
+	that the caller can manage commas between ports.
+*/
+static void json_port( FILE* f, sriov_port_t* port, const char* sep ) {
+	struct rte_eth_stats stats;
+	struct rte_eth_link link;
+	uint64_t	spoofed;
+	int			pf;
+	int			v;
+	int			i;
+	const char*	vsep = "";
+
+	pf = port->rte_port_number;
+	nic_stats_get( pf, &stats, &link, &spoofed );
+
+	fprintf( f, "%s\n    { \"pf\": %d, \"pciid\": \"%s\", \"link\": \"%s\", \"speed\": %u,\n", sep, pf, port->pciid,
+		link.link_speed == 1 ? "unknown" : (link.link_status ? "up" : "down"), (unsigned int) link.link_speed );
+	fprintf( f, "      \"rx_pkts\": %"PRIu64", \"rx_bytes\": %"PRIu64", \"rx_errors\": %"PRIu64", \"rx_missed\": %"PRIu64",\n",
+		stats.ipackets, stats.ibytes, stats.ierrors, stats.imissed );
+	fprintf( f, "      \"tx_pkts\": %"PRIu64", \"tx_bytes\": %"PRIu64", \"tx_errors\": %"PRIu64", \"spoofed\": %"PRIu64",\n",
+		stats.opackets, stats.obytes, stats.oerrors, spoofed );
+
+	fprintf( f, "      \"xstats\": {" );
+	if( port_xstats_get( port ) > 0 ) {
+		for( i = 0; i < port->nxstats; i++ ) {
+			fprintf( f, "%s \"%s\": %"PRIu64, i ? "," : "", port->xstat_names[i], port->xstat_vals[i] );
+		}
+	}
+	fprintf( f, " },\n" );
+
+	fprintf( f, "      \"vfs\": [" );
+	for( v = 0; v < port->num_vfs; v++ ) {
+		if( port->vfs[v].num < 0 ) {						// deleted/unused slot
+			continue;
+		}
+
+		vf_stats_get( pf, port->vfs[v].num, &stats, &spoofed );
+		fprintf( f, "%s\n        { \"vf\": %d, \"rx_pkts\": %"PRIu64", \"rx_bytes\": %"PRIu64", \"rx_errors\": %"PRIu64", "
+				"\"tx_pkts\": %"PRIu64", \"tx_bytes\": %"PRIu64", \"tx_errors\": %"PRIu64", \"spoofed\": %"PRIu64" }",
+			vsep, port->vfs[v].num, stats.ipackets, stats.ibytes, stats.ierrors, stats.opackets, stats.obytes, stats.oerrors, spoofed );
+		vsep = ",";
+	}
+	fprintf( f, "\n      ]\n    }" );
+}
+
+// --------------------- public ------------------------------------------------------------------------------
+
+/*
+	Write a snapshot of all PF/VF stats to parms->stats_path. The data is written
+	to <stats_path>.tmp and renamed into place once it is flushed to disk.
+
+	Returns 1 on success, 0 on failure (reason is logged).
+*/
+extern int stats_dump( parms_t* parms, sriov_conf_t* conf ) {
+	char	tname[PATH_MAX];
+	FILE*	f;
+	time_t	now;
+	int		i;
+	int		ok;
+
+	if( parms == NULL || conf == NULL || parms->stats_path == NULL ) {
+		return 0;
+	}
+
+	snprintf( tname, sizeof( tname ), "%s.tmp", parms->stats_path );			// must be in same directory for rename to be atomic
+	if( (f = fopen( tname, "w" )) == NULL ) {
+		bleat_printf( 0, "stats_dump: unable to open %s: %s", tname, strerror( errno ) );
+		return 0;
+	}
+
+	now = time( NULL );
+	if( parms->stats_fmt == SF_CSV ) {
+		fprintf( f, "timestamp,pf,vf,name,value\n" );
+		for( i = 0; i < conf->num_ports; i++ ) {
+			csv_port( f, now, &conf->ports[i] );
+		}
+		perf_dump( f, SF_CSV, now );
+	} else {
+		fprintf( f, "{\n  \"timestamp\": %ld,\n  \"ports\": [", (long) now );
+		for( i = 0; i < conf->num_ports; i++ ) {
+			json_port( f, &conf->ports[i], i ? "," : "" );
+		}
+		fprintf( f, "\n  ]" );
+		perf_dump( f, SF_JSON, now );
+		fprintf( f, "\n}\n" );
+	}
+
+	ok = fflush( f ) == 0 && fsync( fileno( f ) ) == 0;
+	if( fclose( f ) != 0 || ! ok ) {
+		bleat_printf( 0, "stats_dump: write to %s failed: %s", tname, strerror( errno ) );
+		unlink( tname );
+		return 0;
+	}
+
+	if( rename( tname, parms->stats_path ) != 0 ) {
+		bleat_printf( 0, "stats_dump: unable to rename %s to %s: %s", tname, parms->stats_path, strerror( errno ) );
+		unlink( tname );
+		return 0;
+	}
+
+	bleat_printf( 3, "stats_dump: stats written to %s", parms->stats_path );
+	return 1;
+}
+
+/*
+	Called from the main loop; writes the stats if the configured interval has
+	passed since the last dump. Does nothing if the interval is 0 (the default)
+	or if we aren't driving the NIC.
+*/
+extern void stats_dump_check( parms_t* parms, sriov_conf_t* conf ) {
+	static time_t next_dump = 0;
+	time_t	now;
+
+	if( parms == NULL || parms->stats_interval <= 0 || ! parms->forreal ) {
+		return;
+	}
+
+	now = time( NULL );
+	if( now < next_dump ) {
+		return;
+	}
+
+	next_dump = now + parms->stats_interval;
+	stats_dump( parms, conf );
+}
@@ -0,0 +1,471 @@
+// vi: sw=4 ts=4 noet:
+
+/*
+	Mnemonic:	vfd_watch.c
+	Abstract:	Config directory watcher. When enabled (config_watch in the parm
+				file) inotify is used to watch the config directory and the live
+				directory. A json file which is written (or moved) into the config
+				directory is applied as an add, or as an (in place) update if a
+				config with the same name is already live. A json file which is removed from
+				the live directory causes the VF to be deleted. This allows the
+				virtualisation manager to drop a file and be done rather than
+				having to invoke iplex for each VF.
+
+				Because the live file is gone by the time we hear about a delete,
+				the pciid, vfid and name from each live file are kept in a table
+				keyed by the file's basename. The table is loaded at start and is
+				kept current from the live directory events, so VFs added by an
+				iplex request can also be deleted by removing the live file.
+
+				The result of each add/update/delete is written to a status file
+				(<config_dir>/<name>.status) in the same form as a response
+				written on a response pipe. If the config was accepted but the
+				nic update failed the status is an error; the VF stays in the
+				running config (and live directory) and the nic update is
+				retried from watch_check() until it succeeds.
+
+	Date:		19 October 2026
+*/
+
+#include <sys/inotify.h>
+#include <poll.h>
+
+#define BLEAT_SUBSYS	BLEAT_SS_RIF		// tag our bleat messages; must be set before vfdlib.h is included
+#include <vfdlib.h>
+#include <symtab.h>
+#include "sriov.h"
+#include "vfd_rif.h"
+
+#define SFREE(p) if((p)){free(p);}			// safe free
+#define WATCH_EVBUF		(64 * (sizeof( struct inotify_event ) + NAME_MAX + 1))
+
+static int		ifd = -1;				// inotify file des
+static int		wd_cfg = -1;			// watch descriptors for config and live directories
+static int		wd_live = -1;
+static char*	live_dir = NULL;
+static void*	live_cfgs = NULL;		// vf config (pciid, vfid, name only) for each live file; keyed by basename
+static int		nic_retry = 0;			// last nic update failed; retried on each check
+
+/*
+	Return true if the name is one we should pay attention to (ends with .json and
+	isn't hidden). Our own .error, .status and keep (-) files are thus ignored.
+*/
+static int is_config( const_str name ) {
+	int len;
+
+	if( name == NULL || *name == '.' ) {
+		return 0;
+	}
+
+	len = strlen( name );
+	return len > 5 && strcmp( name + len - 5, ".json" ) == 0;
+}
+
+/*
+	Read the config and keep just what is needed to delete the VF later.
+	Returns nil if the file couldn't be read.
+*/
+static vf_config_t* read_key( const_str fname ) {
+	vf_config_t* vfc;
+	vf_config_t* key;
+
+	if( (vfc = read_config( (char *) fname )) == NULL ) {
+		return NULL;
+	}
+
+	if( (key = (vf_config_t *) calloc( 1, sizeof( *key ) )) != NULL ) {
+		key->vfid = vfc->vfid;
+		key->pciid = vfc->pciid;
+		key->name = vfc->name;
+		vfc->pciid = vfc->name = NULL;			// now belong to the key
+	}
+
+	free_config( vfc );
+	return key;
+}
+
+/*
+	Remember (or forget if key is nil) the config for a live file.
+*/
+static void set_key( const_str base, vf_config_t* key ) {
+	vf_config_t* old;
+
+	if( (old = (vf_config_t *) sym_get( live_cfgs, base, 0 )) != NULL ) {
+		free_config( old );
+		sym_del( live_cfgs, base, 0 );
+	}
+
+	if( key != NULL ) {
+		sym_map( live_cfgs, base, 0, key );
+	}
+}
+
+/*
+	Push the config changes to the nic. A failure is logged and the update is
+	retried from watch_check() until one succeeds. Returns 1 if the nic was
+	updated, 0 if not.
+*/
+static int update_nic( parms_t* parms, sriov_conf_t* conf ) {
+	if( vfd_update_nic( parms, conf ) == 0 ) {
+		nic_retry = 0;
+		return 1;
+	}
+
+	if( ! nic_retry ) {
+		bleat_printf( 0, "ERR: watch: nic update failed; it will be retried" );
+	}
+	nic_retry = 1;
+	return 0;
+}
+
+/*
+	Write the status file for a config file. Written to a temp name and then
+	renamed so that a reader never sees a partial file.
+*/
+static void write_status( parms_t* parms, const_str base, int state, const_str msg ) {
+	char	fname[2048];
+	char	tname[2048];
+	FILE*	f;
+
+	if( snprintf( fname, sizeof( fname ), "%s/%s.status", parms->config_dir, base ) >= (int) sizeof( fname ) ||
+		snprintf( tname, sizeof( tname ), "%s/.%s.status", parms->config_dir, base ) >= (int) sizeof( tname ) ) {
+		bleat_printf( 0, "WRN: watch: cannot construct status file name for %s", base );
+		return;
+	}
+
+	if( (f = fopen( tname, "w" )) == NULL ) {
+		bleat_printf( 0, "WRN: watch: unable to create status file: %s: %s", tname, strerror( errno ) );
+		return;
+	}
+
+	fprintf( f, "{ \"action\": \"response\", \"vfd_rid\": \"%s\", \"state\": \"%s\", \"msg\": [ \"%s\" ] }\n", base, state ? "ERROR" : "OK", msg );
+	if( fclose( f ) != 0 || rename( tname, fname ) < 0 ) {
+		bleat_printf( 0, "WRN: watch: unable to write status file: %s: %s", fname, strerror( errno ) );
+		unlink( tname );
+	}
+}
+
+/*
+	A config file appeared in, or was changed in, the config directory. If there is
+	a live config with the same name for the same PF and VF, the VF is updated in
+	place. If the name is live for a different PF/VF the VF is deleted and the new
+	config added; if the new config can't be added the old one is put back.
+*/
+static void apply_config( parms_t* parms, sriov_conf_t* conf, const_str base ) {
+	char	fname[2048];
+	char	lname[2048];
+	char	mbuf[BUF_1K];
+	vf_config_t* old;
+	vf_config_t* vfc;
+	char*	reason = NULL;
+	int		update;
+	int		deleted = 0;
+
+	if( snprintf( fname, sizeof( fname ), "%s/%s", parms->config_dir, base ) >= (int) sizeof( fname ) ||
+		snprintf( lname, sizeof( lname ), "%s/%s", live_dir, base ) >= (int) sizeof( lname ) ) {
+		bleat_printf( 0, "WRN: watch: cannot construct file names for %s", base );
+		return;
+	}
+
+	if( access( fname, R_OK ) != 0 ) {						// already handled (e.g. a second close after we moved it)
+		bleat_printf( 2, "watch: %s is gone; ignored", fname );
+		return;
+	}
+
+	if( (vfc = read_config( fname )) == NULL ) {
+		snprintf( mbuf, sizeof( mbuf ), "unable to read config file: %s: %s", base, errno > 0 ? strerror( errno ) : "unknown sub-reason" );
+		relocate_vf_config( parms, fname, ".error" );
+		write_status( parms, base, RESP_ERROR, mbuf );
+		bleat_printf( 1, "watch: %s", mbuf );
+		return;
+	}
+
+	old = (vf_config_t *) sym_get( live_cfgs, base, 0 );
+	if( old != NULL && old->vfid == vfc->vfid && old->pciid != NULL && vfc->pciid != NULL && strcmp( old->pciid, vfc->pciid ) == 0 ) {
+		bleat_printf( 1, "watch: updating vf in place from file: %s", fname );			// same vf; change only what differs
+		if( vfd_update_vfc( conf, fname, vfc, &reason ) ) {		// vfc is freed regardless
+			relocate_vf_config( parms, fname, NULL );				// live dir must match the running config either way
+			set_key( base, read_key( lname ) );
+			if( update_nic( parms, conf ) ) {
+				snprintf( mbuf, sizeof( mbuf ), "vf updated successfully: %s", base );
+				write_status( parms, base, RESP_OK, mbuf );
+			} else {
+				snprintf( mbuf, sizeof( mbuf ), "vf config updated but the nic update failed (will be retried): %s", base );
+				write_status( parms, base, RESP_ERROR, mbuf );
+			}
+		} else {
+			relocate_vf_config( parms, fname, ".error" );			// live vf is left as it was
+			snprintf( mbuf, sizeof( mbuf ), "unable to update vf: %s: %s", base, reason ? reason : "" );
+			SFREE( reason );
+			write_status( parms, base, RESP_ERROR, mbuf );
+		}
+		bleat_printf( 1, "watch: %s", mbuf );
+		return;
+	}
+
+	if( (update = old != NULL) ) {								// moved to another pf/vf; the old one must go first
+		bleat_printf( 1, "watch: updating vf from file: %s", fname );
+		if( vfd_del_vfc( conf, lname, old, &reason ) > 0 ) {
+			deleted = 1;
+			update_nic( parms, conf );						// the slot is free only after the nic has been updated
+		} else {
+			bleat_printf( 1, "watch: update of %s: old config not deleted: %s", base, reason ? reason : "" );
+			SFREE( reason );
+		}
+	} else {
+		bleat_printf( 1, "watch: adding vf from file: %s", fname );
+	}
+
+	if( vfd_add_vfc( conf, fname, vfc, &reason ) ) {			// vfc is freed regardless
+		relocate_vf_config( parms, fname, NULL );				// overwrites the live file if an update
+		set_key( base, read_key( lname ) );						// in the running config, so a live delete must find it
+		if( update_nic( parms, conf ) ) {
+			snprintf( mbuf, sizeof( mbuf ), "vf %s successfully: %s", update ? "updated" : "added", base );
+			write_status( parms, base, RESP_OK, mbuf );
+		} else {
+			snprintf( mbuf, sizeof( mbuf ), "vf config %s but the nic update failed (will be retried): %s", update ? "updated" : "added", base );
+			write_status( parms, base, RESP_ERROR, mbuf );
+		}
+		bleat_printf( 1, "watch: %s", mbuf );
+		return;
+	}
+
+	relocate_vf_config( parms, fname, ".error" );
+	snprintf( mbuf, sizeof( mbuf ), "unable to %s vf: %s: %s", update ? "update" : "add", base, reason ? reason : "" );
+	SFREE( reason );
+
+	if( deleted ) {												// put the previous config back
+		if( vfd_add_vf( conf, lname, &reason ) ) {
+			strncat( mbuf, update_nic( parms, conf ) ? "; previous config restored" : "; previous config restored, nic update failed (will be retried)",
+				sizeof( mbuf ) - strlen( mbuf ) - 1 );
+		} else {
+			bleat_printf( 0, "ERR: watch: unable to restore previous config %s: %s", lname, reason ? reason : "" );
+			SFREE( reason );
+		}
+	}
+
+	write_status( parms, base, RESP_ERROR, mbuf );
+	bleat_printf( 1, "watch: %s", mbuf );
+}
+
+/*
+	A config file was removed from the live directory. If we know about it, the VF is
+	deleted. If the VF is already gone (deleted by an iplex request which removed the
+	file) we just forget it.
+*/
+static void drop_config( parms_t* parms, sriov_conf_t* conf, const_str base ) {
+	char	lname[2048];
+	char	mbuf[BUF_1K];
+	vf_config_t* old;
+	char*	reason = NULL;
+	int		rc;
+
+	if( (old = (vf_config_t *) sym_get( live_cfgs, base, 0 )) == NULL ) {
+		return;
+	}
+
+	snprintf( lname, sizeof( lname ), "%s/%s", live_dir, base );
+	if( access( lname, F_OK ) == 0 ) {							// moved away and back again; nothing to do
+		return;
+	}
+
+	if( (rc = vfd_del_vfc( conf, lname, old, &reason )) > 0 ) {
+		if( update_nic( parms, conf ) ) {
+			snprintf( mbuf, sizeof( mbuf ), "vf deleted successfully: %s", base );
+			write_status( parms, base, RESP_OK, mbuf );
+		} else {
+			snprintf( mbuf, sizeof( mbuf ), "vf config deleted but the nic update failed (will be retried): %s", base );
+			write_status( parms, base, RESP_ERROR, mbuf );
+		}
+		bleat_printf( 1, "watch: %s", mbuf );
+	} else {
+		if( rc < 0 ) {
+			snprintf( mbuf, sizeof( mbuf ), "unable to delete vf: %s: %s", base, reason ? reason : "" );
+			write_status( parms, base, RESP_ERROR, mbuf );
+			bleat_printf( 1, "watch: %s", mbuf );
+		} else {
+			bleat_printf( 2, "watch: live config removed for vf which is not configured: %s", base );
+		}
+		SFREE( reason );
+	}
+
+	set_key( base, NULL );
+}
+
+/*
+	Load the table from the current live directory.
+*/
+static void load_live( void ) {
+	char**	flist;
+	char	fname[2048];
+	int		llen = 0;
+	int		i;
+
+	if( (flist = list_files( live_dir, "json", 0, &llen )) == NULL ) {
+		return;
+	}
+
+	for( i = 0; i < llen; i++ ) {
+		snprintf( fname, sizeof( fname ), "%s/%s", live_dir, flist[i] );
+		set_key( flist[i], read_key( fname ) );
+	}
+
+	free_list( flist, llen );
+	bleat_printf( 2, "watch: %d live configs known", llen );
+}
+
+// -------------------------------------------------------------------------------------------
+
+/*
+	Start watching the config and live directories if config_watch is set. Any
+	config files which were left in the config directory (written while we were
+	not running) are applied. Returns 1 if watching, 0 otherwise.
+*/
+extern int watch_init( parms_t* parms, sriov_conf_t* conf ) {
+	char	wbuf[2048];
+	char**	flist;
+	int		llen = 0;
+	int		i;
+
+	if( parms == NULL || ! (parms->rflags & RF_WATCH_CFG) || ifd >= 0 ) {
+		return ifd >= 0;
+	}
+
+	snprintf( wbuf, sizeof( wbuf ), "%s_live", parms->config_dir );
+	live_dir = strdup( wbuf );
+	live_cfgs = sym_alloc( 1023 );
+
+	if( (ifd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC )) < 0 ) {
+		bleat_printf( 0, "ERR: watch: unable to initialise inotify; config directory not watched: %s", strerror( errno ) );
+		return 0;
+	}
+
+	wd_cfg = inotify_add_watch( ifd, parms->config_dir, IN_CLOSE_WRITE | IN_MOVED_TO );
+	wd_live = inotify_add_watch( ifd, live_dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM );
+	if( wd_cfg < 0 || wd_live < 0 ) {
+		bleat_printf( 0, "ERR: watch: unable to watch %s or %s; config directory not watched: %s", parms->config_dir, live_dir, strerror( errno ) );
+		close( ifd );
+		ifd = -1;
+		return 0;
+	}
+
+	load_live( );
+
+	if( (flist = list_files( parms->config_dir, "json", 0, &llen )) != NULL ) {		// anything left waiting
+		for( i = 0; i < llen; i++ ) {
+			if( is_config( flist[i] ) ) {
+				apply_config( parms, conf, flist[i] );
+			}
+		}
+		free_list( flist, llen );
+	}
+
+	bleat_printf( 0, "watching for vf configs in %s (deletes in %s)", parms->config_dir, live_dir );
+	return 1;
+}
+
+/*
+	Process any pending inotify events. Returns the number of config changes
+	applied. A nic update which failed earlier is retried first.
+*/
+extern int watch_check( parms_t* parms, sriov_conf_t* conf ) {
+	char	buf[WATCH_EVBUF] __attribute__ ((aligned( __alignof__( struct inotify_event ) )));
+	struct inotify_event* ev;
+	char	lname[2048];
+	ssize_t	len;
+	char*	ep;
+	int		napplied = 0;
+	int		resync = 0;
+
+	if( ifd < 0 ) {
+		return 0;
+	}
+
+	if( nic_retry && update_nic( parms, conf ) ) {
+		bleat_printf( 0, "watch: nic update retried successfully" );
+	}
+
+	while( (len = read( ifd, buf, sizeof( buf ) )) > 0 ) {
+		for( ep = buf; ep < buf + len; ep += sizeof( struct inotify_event ) + ev->len ) {
+			ev = (struct inotify_event *) ep;
+
+			if( ev->mask & IN_Q_OVERFLOW ) {
+				resync = 1;
+				continue;
+			}
+
+			if( ev->len == 0 || ! is_config( ev->name ) ) {
+				continue;
+			}
+
+			if( ev->wd == wd_cfg ) {
+				apply_config( parms, conf, ev->name );
+				napplied++;
+			} else {
+				if( ev->wd == wd_live ) {
+					if( ev->mask & (IN_DELETE | IN_MOVED_FROM) ) {
+						drop_config( parms, conf, ev->name );
+						napplied++;
+					} else {
+						if( sym_get( live_cfgs, ev->name, 0 ) == NULL ) {			// added by an iplex request; remember it
+							snprintf( lname, sizeof( lname ), "%s/%s", live_dir, ev->name );
+							set_key( ev->name, read_key( lname ) );
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if( resync ) {
+		bleat_printf( 1, "watch: event queue overflowed; reloading live configs" );
+		load_live( );
+	}
+
+	return napplied;
+}
+
+/*
+	Wait up to ms milliseconds for a config directory change or for something on
+	the request socket; if there is nothing to watch this is just a sleep. Used in
+	place of the main loop's usleep so that changes and socket requests are picked
+	up as soon as they arrive.
+*/
+extern void watch_wait( int ms ) {
+	struct pollfd pfds[72];
+	int	n = 0;
+
+	if( ifd >= 0 ) {
+		pfds[n].fd = ifd;
+		pfds[n].events = POLLIN;
+		pfds[n++].revents = 0;
+	}
+	n += sock_pollfds( &pfds[n], (sizeof( pfds ) / sizeof( pfds[0] )) - n );
+
+	if( n == 0 ) {
+		usleep( ms * 1000 );
+		return;
+	}
+
+	poll( pfds, n, ms );
+}
+
+/*
+	Returns true if the watcher knows the named (basename) config file is live.
+	Used to answer an iplex add request for a file the watcher already applied.
+*/
+extern int watch_is_live( const_str fname ) {
+	const_str base;
+
+	if( ifd < 0 || fname == NULL ) {
+		return 0;
+	}
+
+	if( (base = strrchr( fname, '/' )) != NULL ) {
+		base++;
+	} else {
+		base = fname;
+	}
+
+	return sym_get( live_cfgs, base, 0 ) != NULL;
+}